@@ -0,0 +1,104 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stdint.h>
+
+/*
+ * Decodificador IMA-ADPCM (4 bits por muestra, 4:1 sobre PCM de 16 bits)
+ * con los bloques de WAV (WAVE_FORMAT_IMA_ADPCM, 0x11):
+ *
+ *   por canal: predictor int16 | índice uint8 | reservado    (4 B, 1.ª muestra)
+ *   después, de 4 en 4 bytes por canal: 8 muestras, nibble bajo primero
+ *
+ * Cada bloque empieza con su propio estado, así que se decodifica suelto
+ * (y se puede cortar o repetir en cualquier bloque). Solo enteros y dos
+ * tablas pequeñas. No depende de ESP-IDF. El codificador está en
+ * tools/pack_prompts.py.
+ */
+
+#define ADPCM_MAX_BLOCK     1024    // bytes por bloque (todos los canales)
+#define ADPCM_MAX_SAMPLES   ((ADPCM_MAX_BLOCK - 4) * 2 + 1)   // caso peor: mono
+
+static const int16_t ADPCM_STEP[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t ADPCM_INDEX[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+typedef struct {
+    int32_t pred;
+    int32_t index;
+} adpcm_state_t;
+
+static inline int16_t adpcm_nibble(adpcm_state_t *s, uint8_t nib)
+{
+    int32_t step = ADPCM_STEP[s->index];
+    int32_t diff = step >> 3;
+    if (nib & 1) diff += step >> 2;
+    if (nib & 2) diff += step >> 1;
+    if (nib & 4) diff += step;
+    s->pred += (nib & 8) ? -diff : diff;
+    if (s->pred > 32767) s->pred = 32767;
+    else if (s->pred < -32768) s->pred = -32768;
+    s->index += ADPCM_INDEX[nib];
+    if (s->index < 0) s->index = 0;
+    else if (s->index > 88) s->index = 88;
+    return (int16_t)s->pred;
+}
+
+// Muestras por canal en un bloque completo de block_align bytes
+static inline uint32_t adpcm_block_samples(uint32_t block_align, uint32_t channels)
+{
+    return (block_align / channels - 4) * 2 + 1;
+}
+
+/*
+ * Decodifica un bloque (len <= ADPCM_MAX_BLOCK; el último del fichero
+ * puede venir corto) a PCM entrelazado en out. Devuelve las tramas
+ * escritas; 0 si el bloque no llega ni a la cabecera.
+ */
+static int adpcm_decode_block(const uint8_t *in, uint32_t len, uint32_t channels, int16_t *out)
+{
+    adpcm_state_t st[2];
+    if (channels < 1 || channels > 2 || len < 4 * channels) return 0;
+    for (uint32_t c = 0; c < channels; c++) {
+        st[c].pred  = (int16_t)(in[4 * c] | in[4 * c + 1] << 8);
+        st[c].index = in[4 * c + 2] > 88 ? 88 : in[4 * c + 2];
+        out[c] = (int16_t)st[c].pred;
+    }
+    const uint8_t *p = in + 4 * channels;
+    uint32_t left = len - 4 * channels;
+
+    if (channels == 1) {
+        int16_t *o = out + 1;
+        for (uint32_t i = 0; i < left; i++) {
+            *o++ = adpcm_nibble(&st[0], p[i] & 0x0F);
+            *o++ = adpcm_nibble(&st[0], p[i] >> 4);
+        }
+        return (int)(1 + left * 2);
+    }
+
+    // Estéreo: grupos de 4 bytes (8 muestras) alternando canal
+    uint32_t groups = left / 8;
+    int16_t *o = out + 2;
+    for (uint32_t g = 0; g < groups; g++, p += 8, o += 16) {
+        for (uint32_t c = 0; c < 2; c++) {
+            const uint8_t *q = p + 4 * c;
+            for (int k = 0; k < 4; k++) {
+                o[(2 * k) * 2 + c]     = adpcm_nibble(&st[c], q[k] & 0x0F);
+                o[(2 * k + 1) * 2 + c] = adpcm_nibble(&st[c], q[k] >> 4);
+            }
+        }
+    }
+    return (int)(1 + groups * 8);
+}
+
+#endif // ADPCM_H
@@ -0,0 +1,303 @@
+#ifndef ALERT_CORE_H
+#define ALERT_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config_record.h"
+#include "journal.h"
+#include "vib_detect.h"
+#include "vib_pattern.h"
+
+/*
+ * Máquina de estados de la alerta (IDLE → ARMED → ALARM → CALLING), sin
+ * hardware.
+ *
+ * Los eventos entran ya traducidos y con su instante (flanco del lector,
+ * ráfaga del sensor, botón, vencimiento de un temporizador) y todo lo que
+ * sale (relés, temporizadores, escalado, diario) pasa por alert_hal_t.
+ * main.c la conecta a GPIO, FreeRTOS y esp_timer; con pines y
+ * temporizadores simulados sobre un reloj virtual se pueden recorrer
+ * horas de escenario en milisegundos. No depende de ESP-IDF.
+ *
+ * Las alert_core_* se llaman desde una sola tarea (alert_task), también
+ * alert_core_test(): los comandos SMS se la piden con una notificación.
+ */
+
+// Mensajes: quien incluya esto puede definirlos antes (main.c → ESP_LOGx)
+// Si no, no imprimen nada pero sus argumentos cuentan como usados
+#ifndef AC_LOGI
+#define AC_LOGI(...)   ((void)sizeof(printf(__VA_ARGS__)))
+#define AC_LOGW(...)   ((void)sizeof(printf(__VA_ARGS__)))
+#define AC_LOGE(...)   ((void)sizeof(printf(__VA_ARGS__)))
+#endif
+
+#define AC_CH_MAX       32
+
+// Histéresis del lector: tiempo estable antes de aceptar el cambio
+#define ARM_INSERT_MS   50      // lector puesto → ARMED
+#define ARM_REMOVE_MS   300     // lector quitado → IDLE (más conservador)
+
+typedef enum { ST_IDLE=0, ST_ARMED, ST_ALARM, ST_CALLING } alert_state_t;
+
+// Temporizadores de un disparo; ATTEND y ARM hay uno por canal
+typedef enum { AC_T_ATTEND = 0, AC_T_ARM, AC_T_LAMP, AC_T_TEST, AC_T_COUNT } ac_timer_t;
+
+typedef struct {
+    void     *ctx;
+    int64_t (*now_us)(void *ctx);
+    const app_config_t *(*cfg)(void *ctx);
+    bool    (*arm_present)(void *ctx, int ch);          // nivel actual del lector
+    void    (*relays)(void *ctx, uint8_t mask);         // salida combinada (máscara de relés)
+    void    (*timer_start)(void *ctx, ac_timer_t t, int ch, uint32_t ms);  // (re)arranca
+    void    (*timer_stop)(void *ctx, ac_timer_t t, int ch);
+    void    (*escalate)(void *ctx, int ch);             // sin atender: empezar las llamadas
+    void    (*cancel)(void *ctx);                       // atendido: cortar el escalado
+    void    (*sample)(void *ctx, int ch);               // modo patrón: abrir ventana
+    void    (*arm_changed)(void *ctx, int ch, bool present);
+    void    (*note)(void *ctx, jr_event_t type, int ch, uint16_t arg);    // diario
+} alert_hal_t;
+
+typedef struct {
+    uint8_t       state;            // alert_state_t
+    uint8_t       relays;           // relés que pide ahora
+    bool          arm_present;      // estado aceptado del lector
+    int64_t       arm_edge_us;      // primer flanco del cambio pendiente
+    int64_t       alarm_us;         // inicio de la alarma en curso
+    vib_detect_t  vib;
+} ac_channel_t;
+
+typedef struct {
+    const alert_hal_t *hal;
+    uint8_t           light;                    // relé de la lámpara
+    uint32_t          n_ch;
+    const char       *name[AC_CH_MAX];
+    uint8_t           alarm_relays[AC_CH_MAX];  // lo que enciende la alarma de cada canal
+    ac_channel_t      ch[AC_CH_MAX];
+    bool              lamp_on;                  // lámpara del botón
+    volatile bool     test_active;              // prueba/forzado por SMS: manda sobre los relés
+    volatile uint8_t  test_relays;
+} alert_core_t;
+
+static int alert_core_add_channel(alert_core_t *a, const char *name, uint8_t relays)
+{
+    if (a->n_ch >= AC_CH_MAX) return -1;
+    a->name[a->n_ch] = name;
+    a->alarm_relays[a->n_ch] = relays;
+    return (int)a->n_ch++;
+}
+
+// Aplica a los relés lo que piden los canales y la lámpara (o la prueba, que manda)
+static void alert_core_refresh(alert_core_t *a)
+{
+    uint8_t out = a->test_relays;
+    if (!a->test_active) {
+        out = a->lamp_on ? a->light : 0;
+        for (uint32_t c = 0; c < a->n_ch; c++) out |= a->ch[c].relays;
+    }
+    a->hal->relays(a->hal->ctx, out);
+}
+
+/* ───────────────────────── estados ───────────────────────── */
+static void ac_enter_idle(alert_core_t *a, int ch)
+{
+    const alert_hal_t *h = a->hal;
+    a->ch[ch].state = ST_IDLE;
+    a->ch[ch].relays = 0;
+    h->timer_stop(h->ctx, AC_T_ATTEND, ch);
+    alert_core_refresh(a);
+    AC_LOGI("%s: IDLE (lector ausente)", a->name[ch]);
+}
+
+static void ac_enter_armed(alert_core_t *a, int ch)
+{
+    const alert_hal_t *h = a->hal;
+    a->ch[ch].state = ST_ARMED;
+    a->ch[ch].relays = 0;
+    h->timer_stop(h->ctx, AC_T_ATTEND, ch);
+    alert_core_refresh(a);
+    AC_LOGI("%s: ARMED (lector presente)", a->name[ch]);
+}
+
+// Alarma del canal: relés, cuenta atrás para atender y diario
+static void ac_raise_alarm(alert_core_t *a, int ch, const char *why, uint16_t conf)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    c->state = ST_ALARM;
+    c->alarm_us = h->now_us(h->ctx);
+    h->note(h->ctx, JR_EV_ALARM, ch, conf);
+    c->relays = a->alarm_relays[ch];
+    alert_core_refresh(a);
+    h->timer_start(h->ctx, AC_T_ATTEND, ch, h->cfg(h->ctx)->attend_timeout_ms);
+    AC_LOGE("ALERTA %s: %s (%u ráfagas, %u alertas desde el arranque)",
+            a->name[ch], why, (unsigned)c->vib.bursts, (unsigned)c->vib.detections);
+}
+
+// Estado inicial según el lector (los canales ya añadidos)
+static void alert_core_start(alert_core_t *a)
+{
+    const alert_hal_t *h = a->hal;
+    for (uint32_t ch = 0; ch < a->n_ch; ch++) {
+        a->ch[ch].arm_present = h->arm_present(h->ctx, ch);
+        if (a->ch[ch].arm_present) ac_enter_armed(a, ch); else ac_enter_idle(a, ch);
+        h->arm_changed(h->ctx, ch, a->ch[ch].arm_present);
+    }
+}
+
+/* ───────────────────────── eventos ───────────────────────── */
+// El botón atiende todos los canales en alarma o llamando
+static void alert_core_button(alert_core_t *a, bool pressed)
+{
+    const alert_hal_t *h = a->hal;
+    if (a->test_active) { // cancelar test/forzado si estaba activo
+        h->timer_stop(h->ctx, AC_T_TEST, 0);
+        a->test_active = false;
+    }
+    if (!pressed) {
+        alert_core_refresh(a);
+        return;
+    }
+    uint32_t lamp_ms = h->cfg(h->ctx)->lamp_on_ms;
+    a->lamp_on = true;
+    h->timer_start(h->ctx, AC_T_LAMP, 0, lamp_ms);
+
+    int attended = 0;
+    int64_t now = h->now_us(h->ctx);
+    for (uint32_t ch = 0; ch < a->n_ch; ch++) {
+        ac_channel_t *c = &a->ch[ch];
+        if (c->state != ST_ALARM && c->state != ST_CALLING) continue;
+        h->timer_stop(h->ctx, AC_T_ATTEND, ch);
+        h->note(h->ctx, JR_EV_ACK, ch, (uint16_t)((now - c->alarm_us) / 1000000));
+        c->relays = 0;
+        c->state = c->arm_present ? ST_ARMED : ST_IDLE;
+        AC_LOGI("%s: atendido por botón", a->name[ch]);
+        attended++;
+    }
+    alert_core_refresh(a);
+    if (attended) {
+        h->cancel(h->ctx);
+        AC_LOGI("Lámpara ON %u ms.", (unsigned)lamp_ms);
+    }
+}
+
+// Ráfaga del sensor en t_us (ya sin rebotes)
+static void alert_core_sensor(alert_core_t *a, int ch, int64_t t_us)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    if (a->test_active) return; // ignora durante test/forzado
+    if (c->state != ST_ARMED || !h->arm_present(h->ctx, ch)) return;
+    const app_config_t *cf = h->cfg(h->ctx);
+    if (cf->vib_mode == 1) {
+        c->vib.bursts++;
+        h->sample(h->ctx, ch);
+        return;
+    }
+    if (vib_detect_feed(&c->vib, t_us, cf->vib_threshold, (int64_t)cf->vib_window_ms * 1000)) {
+        char why[48];
+        snprintf(why, sizeof why, "%u vibraciones en %u ms",
+                 (unsigned)cf->vib_threshold, (unsigned)cf->vib_window_ms);
+        ac_raise_alarm(a, ch, why, 0);
+    }
+}
+
+// Ventana de patrón clasificada; true si ha levantado la alarma
+static bool alert_core_pattern(alert_core_t *a, int ch, const vp_result_t *r, const vp_pattern_t *pats)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    if (a->test_active || c->state != ST_ARMED || !h->arm_present(h->ctx, ch)) return false;
+    if (r->best < 0 || r->conf[r->best] < h->cfg(h->ctx)->vib_min_conf) return false;
+    c->vib.detections++;
+    char why[48];
+    snprintf(why, sizeof why, "patrón %s (%u/256)", pats[r->best].name, (unsigned)r->conf[r->best]);
+    ac_raise_alarm(a, ch, why, r->conf[r->best]);
+    return true;
+}
+
+// Flanco del lector: (re)lanza la histéresis según hacia dónde va
+static void alert_core_arm_edge(alert_core_t *a, int ch, bool present, int64_t t_us)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    if (present == c->arm_present) {
+        h->timer_stop(h->ctx, AC_T_ARM, ch);   // rebote que vuelve al estado aceptado
+        c->arm_edge_us = 0;
+        return;
+    }
+    if (!c->arm_edge_us) c->arm_edge_us = t_us;
+    h->timer_start(h->ctx, AC_T_ARM, ch, present ? ARM_INSERT_MS : ARM_REMOVE_MS);
+}
+
+// Fin de la histéresis: se acepta el nivel si sigue distinto
+static void ac_arm_settled(alert_core_t *a, int ch)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    bool now = h->arm_present(h->ctx, ch);
+    if (now != c->arm_present) {
+        c->arm_present = now;
+        if (now) ac_enter_armed(a, ch); else ac_enter_idle(a, ch);
+        h->arm_changed(h->ctx, ch, now);
+        if (c->arm_edge_us) {
+            AC_LOGI("%s: lector %s, transición en %lld ms desde el primer flanco",
+                    a->name[ch], now ? "puesto" : "quitado",
+                    (long long)((h->now_us(h->ctx) - c->arm_edge_us) / 1000));
+        }
+    }
+    c->arm_edge_us = 0;
+}
+
+static void ac_attend_timeout(alert_core_t *a, int ch)
+{
+    const alert_hal_t *h = a->hal;
+    ac_channel_t *c = &a->ch[ch];
+    if (c->state != ST_ALARM) return;
+    AC_LOGW("%s: no atendida en %u s → llamadas", a->name[ch],
+            (unsigned)(h->cfg(h->ctx)->attend_timeout_ms / 1000));
+    c->state = ST_CALLING;
+    h->escalate(h->ctx, ch);
+}
+
+// Venció un temporizador (ch solo cuenta para ATTEND y ARM)
+static void alert_core_timeout(alert_core_t *a, ac_timer_t t, int ch)
+{
+    switch (t) {
+    case AC_T_ATTEND: ac_attend_timeout(a, ch); break;
+    case AC_T_ARM:    ac_arm_settled(a, ch); break;
+    case AC_T_LAMP:
+        a->lamp_on = false;
+        alert_core_refresh(a);
+        AC_LOGI("Lamparita OFF (timeout)");
+        break;
+    case AC_T_TEST:
+        a->test_active = false;
+        alert_core_refresh(a);
+        AC_LOGI("TEST/FORCE: FIN (relés como piden los canales)");
+        break;
+    default: break;
+    }
+}
+
+// Escalado terminado sin que nadie atienda: vib OFF, lámpara ON fija
+static void alert_core_called(alert_core_t *a, int ch)
+{
+    ac_channel_t *c = &a->ch[ch];
+    if (c->state != ST_CALLING) return;
+    c->relays = a->alarm_relays[ch] & a->light;
+    alert_core_refresh(a);
+}
+
+// Prueba/forzado: esos relés durante ms, por encima de los canales
+static void alert_core_test(alert_core_t *a, uint8_t relays, uint32_t ms)
+{
+    const alert_hal_t *h = a->hal;
+    a->test_relays = relays;
+    a->test_active = true;
+    alert_core_refresh(a);
+    h->timer_start(h->ctx, AC_T_TEST, 0, ms);
+}
+
+#endif // ALERT_CORE_H
@@ -0,0 +1,334 @@
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "modem_line.h"
+
+/*
+ * Motor de comandos AT.
+ *
+ * Los comandos se encolan (dos prioridades) y at_task los envía de uno en
+ * uno: escribe el comando y espera su resultado final en vez de dormir un
+ * tiempo fijo. modem_task le pasa cada línea con at_on_line(); lo que no
+ * pertenece al comando en curso (URC) sigue hacia el despachador.
+ *
+ * at_exec()/at_cmd() bloquean hasta el resultado, así que NO deben
+ * llamarse desde modem_task ni desde un callback on_line/on_done.
+ */
+
+extern const uart_port_t MODEM_UART;
+
+static const char *AT_TAG = "AT";
+
+#define AT_CMD_MAX        64
+#define AT_QUEUE_LEN      16
+#define AT_TIMEOUT_MS     2000
+#define AT_PROMPT_MS      5000    // espera del '>' de AT+CMGS
+#define AT_TASK_STACK     4096
+
+typedef enum { AT_PRIO_NORMAL = 0, AT_PRIO_HIGH, AT_PRIO_COUNT } at_prio_t;
+
+typedef enum {
+    AT_RES_OK = 0,
+    AT_RES_ERROR,       // ERROR, +CME ERROR, +CMS ERROR
+    AT_RES_FINAL,       // uno de los resultados propios del comando (finals)
+    AT_RES_TIMEOUT,
+    AT_RES_NO_PROMPT,   // no llegó el '>' para el payload
+} at_result_t;
+
+typedef void (*at_line_cb_t)(const char *line, void *ctx);
+typedef void (*at_done_cb_t)(at_result_t res, const char *final_line, void *ctx);
+
+typedef struct at_waiter at_waiter_t;
+
+typedef struct {
+    char               cmd[AT_CMD_MAX];   // sin "\r"
+    const char        *payload;           // tras '>' (se cierra con Ctrl+Z)
+    const char *const *finals;            // resultados finales extra, NULL al final
+    uint32_t           timeout_ms;        // 0 = AT_TIMEOUT_MS
+    at_prio_t          prio;
+    at_line_cb_t       on_line;           // líneas de respuesta (contexto de modem_task)
+    at_done_cb_t       on_done;           // contexto de at_task
+    void              *ctx;
+    // internos
+    char               resp[16];          // "+CMGS:" para "AT+CMGS=..."
+    int64_t            t_submit;
+    at_waiter_t       *waiter;
+} at_cmd_t;
+
+struct at_waiter {
+    StaticSemaphore_t buf;
+    SemaphoreHandle_t sem;
+    at_result_t       res;
+};
+
+typedef enum { AT_PH_PROMPT, AT_PH_FINAL, AT_PH_DONE } at_phase_t;
+
+typedef struct {
+    uint32_t done;
+    uint32_t errors;
+    uint32_t timeouts;
+    int64_t  sum_us;      // envío → resultado
+    int64_t  max_us;
+    int64_t  sum_wait_us; // encolado → envío
+} at_stats_t;
+
+static struct {
+    QueueHandle_t     q[AT_PRIO_COUNT];
+    SemaphoreHandle_t work;     // una unidad por comando encolado
+    SemaphoreHandle_t done;     // la da el lector al cambiar de fase
+    SemaphoreHandle_t lock;     // protege cur/phase/result
+    at_cmd_t         *cur;
+    at_phase_t        phase;
+    at_result_t       result;
+    char              final_line[48];
+    at_stats_t        stats;
+} at;
+
+static void at_stats_log(void)
+{
+    uint32_t n = at.stats.done ? at.stats.done : 1;
+    ESP_LOGI(AT_TAG, "%u comandos (%u error, %u timeout): media %lld ms, máx %lld ms, cola %lld ms",
+             (unsigned)at.stats.done, (unsigned)at.stats.errors, (unsigned)at.stats.timeouts,
+             (long long)(at.stats.sum_us / n / 1000), (long long)(at.stats.max_us / 1000),
+             (long long)(at.stats.sum_wait_us / n / 1000));
+}
+
+/*
+ * Aviso opcional de actividad en el enlace (power.h): tx=true en at_task
+ * antes de enviar cada comando (puede esperar a que el módem despierte),
+ * tx=false desde modem_task por cada línea recibida (no debe bloquear).
+ */
+static void (*at_activity_hook)(bool tx) = NULL;
+
+// Sin comando en curso ni encolado (lectura sin cerrojo: solo orientativa)
+static bool at_idle(void)
+{
+    return at.cur == NULL && uxSemaphoreGetCount(at.work) == 0;
+}
+
+/* ─────────────────────── encolado de comandos ─────────────────────── */
+// Solo desde tareas: las ISR pasan por isr_ring.h y alert_task
+static bool at_submit(const at_cmd_t *c)
+{
+    at_cmd_t item = *c;
+    if (!item.timeout_ms) item.timeout_ms = AT_TIMEOUT_MS;
+    item.resp[0] = '\0';
+    if (strncmp(item.cmd, "AT+", 3) == 0) {
+        // Prefijo de la respuesta: "AT+CMGS=..." → "+CMGS:"
+        size_t n = strcspn(item.cmd + 2, "=?");
+        if (n < sizeof item.resp - 1) {
+            memcpy(item.resp, item.cmd + 2, n);
+            item.resp[n] = ':';
+            item.resp[n + 1] = '\0';
+        }
+    }
+    item.t_submit = esp_timer_get_time();
+
+    if (xQueueSend(at.q[item.prio], &item, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGW(AT_TAG, "Cola AT llena, se descarta %s", item.cmd);
+        return false;
+    }
+    xSemaphoreGive(at.work);
+    return true;
+}
+
+static bool at_cmd_async(const char *cmd, at_prio_t prio)
+{
+    at_cmd_t c = { .prio = prio };
+    strncpy(c.cmd, cmd, sizeof c.cmd - 1);
+    return at_submit(&c);
+}
+
+// Encola y espera el resultado (no usar desde modem_task)
+static at_result_t at_exec(at_cmd_t *c)
+{
+    at_waiter_t w;
+    w.sem = xSemaphoreCreateBinaryStatic(&w.buf);
+    w.res = AT_RES_TIMEOUT;
+    c->waiter = &w;
+    if (!at_submit(c)) return AT_RES_TIMEOUT;
+    xSemaphoreTake(w.sem, portMAX_DELAY);   // at_task siempre completa
+    return w.res;
+}
+
+static at_result_t at_cmd(const char *cmd, uint32_t timeout_ms)
+{
+    at_cmd_t c = { .timeout_ms = timeout_ms };
+    snprintf(c.cmd, sizeof c.cmd, "%s", cmd);
+    return at_exec(&c);
+}
+
+/* ─────────────────────── lado lector (modem_task) ─────────────────────── */
+static void at_finish_locked(at_result_t res, const char *line)
+{
+    at.result = res;
+    at.phase  = AT_PH_DONE;
+    snprintf(at.final_line, sizeof at.final_line, "%.*s", (int)sizeof at.final_line - 1, line);   // recortada a propósito
+    xSemaphoreGive(at.done);
+}
+
+/*
+ * Ofrece una línea al comando en curso. Devuelve true si la consume;
+ * is_urc indica que el despachador de URC la reconoce.
+ */
+static bool at_on_line(const modem_line_t *l, bool is_urc)
+{
+    bool used = true;
+    xSemaphoreTake(at.lock, portMAX_DELAY);
+    at_cmd_t *c = at.cur;
+    const char *s = l->text;
+    if (!c || at.phase == AT_PH_DONE || l->cont) {
+        used = false;
+    } else if (at.phase == AT_PH_PROMPT && s[0] == '>') {
+        at.phase = AT_PH_FINAL;
+        xSemaphoreGive(at.done);
+    } else if (strcmp(s, "OK") == 0) {
+        at_finish_locked(AT_RES_OK, s);
+    } else if (strcmp(s, "ERROR") == 0 ||
+               strncmp(s, "+CME ERROR:", 11) == 0 || strncmp(s, "+CMS ERROR:", 11) == 0) {
+        at_finish_locked(AT_RES_ERROR, s);
+    } else {
+        bool final = false;
+        for (const char *const *f = c->finals; f && *f; f++) {
+            if (strncmp(s, *f, strlen(*f)) == 0) { final = true; break; }
+        }
+        if (final) {
+            at_finish_locked(AT_RES_FINAL, s);
+        } else if (strcmp(s, c->cmd) == 0) {
+            // eco (antes de ATE0)
+        } else if ((c->resp[0] && strncmp(s, c->resp, strlen(c->resp)) == 0) || !is_urc) {
+            if (c->on_line) c->on_line(s, c->ctx);
+        } else {
+            used = false;
+        }
+    }
+    xSemaphoreGive(at.lock);
+    return used;
+}
+
+/* ─────────────────────────── tarea AT ─────────────────────────── */
+static void at_write(const char *data, size_t len)
+{
+    modem_io->write(data, len);
+    modem_trace(MT_TX, data, len);
+}
+
+/*
+ * Interrumpe el comando en curso si empieza por prefix (p.ej. un ATD que
+ * aún suena): el SIM800 aborta la ejecución al recibir cualquier carácter.
+ * El resultado llega por el camino normal. No usar desde una ISR.
+ */
+static bool at_interrupt(const char *prefix)
+{
+    xSemaphoreTake(at.lock, portMAX_DELAY);
+    bool hit = at.cur && at.phase == AT_PH_FINAL &&
+               strncmp(at.cur->cmd, prefix, strlen(prefix)) == 0;
+    xSemaphoreGive(at.lock);
+    if (hit) at_write("\r", 1);
+    return hit;
+}
+
+static at_phase_t at_wait_phase(uint32_t ms)
+{
+    xSemaphoreTake(at.done, pdMS_TO_TICKS(ms));
+    xSemaphoreTake(at.lock, portMAX_DELAY);
+    at_phase_t ph = at.phase;
+    xSemaphoreGive(at.lock);
+    return ph;
+}
+
+static void at_run(at_cmd_t *c)
+{
+    xSemaphoreTake(at.lock, portMAX_DELAY);
+    at.cur    = c;
+    at.phase  = c->payload ? AT_PH_PROMPT : AT_PH_FINAL;
+    at.result = AT_RES_TIMEOUT;
+    at.final_line[0] = '\0';
+    xSemaphoreGive(at.lock);
+    xSemaphoreTake(at.done, 0);
+    if (at_activity_hook) at_activity_hook(true);
+    if (c->payload) ml_prompt_armed = true;
+
+    int64_t t0 = esp_timer_get_time();
+    at_write(c->cmd, strlen(c->cmd));
+    at_write("\r", 1);
+
+    at_phase_t ph = AT_PH_FINAL;
+    bool no_prompt = false;
+    if (c->payload) {
+        ph = at_wait_phase(AT_PROMPT_MS);
+        if (ph == AT_PH_PROMPT) {
+            at_write("\x1B", 1);   // ESC: aborta el comando
+            no_prompt = true;
+        } else if (ph == AT_PH_FINAL) {
+            at_write(c->payload, strlen(c->payload));
+            at_write("\x1A", 1);   // Ctrl+Z
+        }
+    }
+    if (ph == AT_PH_FINAL) at_wait_phase(c->timeout_ms);
+
+    xSemaphoreTake(at.lock, portMAX_DELAY);
+    at.cur = NULL;
+    at_result_t res = no_prompt ? AT_RES_NO_PROMPT : at.result;
+    xSemaphoreGive(at.lock);
+    ml_prompt_armed = false;
+    xSemaphoreTake(at.done, 0);
+
+    int64_t dt = esp_timer_get_time() - t0;
+    at.stats.done++;
+    at.stats.sum_us += dt;
+    at.stats.sum_wait_us += t0 - c->t_submit;
+    if (dt > at.stats.max_us) at.stats.max_us = dt;
+    if (res == AT_RES_ERROR) at.stats.errors++;
+    if (res == AT_RES_TIMEOUT || res == AT_RES_NO_PROMPT) {
+        at.stats.timeouts++;
+        ESP_LOGW(AT_TAG, "%s → sin respuesta (%lld ms)", c->cmd, (long long)(dt / 1000));
+    } else if (modem_trace_level >= MT_LEVEL_LOG) {
+        ESP_LOGI(AT_TAG, "%s → %s (%lld ms)", c->cmd, at.final_line, (long long)(dt / 1000));
+    }
+
+    if (c->on_done) c->on_done(res, at.final_line, c->ctx);
+    if (c->waiter) {
+        c->waiter->res = res;
+        xSemaphoreGive(c->waiter->sem);
+    }
+}
+
+static void at_task(void *arg)
+{
+    (void)arg;
+    at_cmd_t c;
+    for (;;) {
+        xSemaphoreTake(at.work, portMAX_DELAY);
+        if (xQueueReceive(at.q[AT_PRIO_HIGH], &c, 0) != pdTRUE &&
+            xQueueReceive(at.q[AT_PRIO_NORMAL], &c, 0) != pdTRUE) continue;
+        at_run(&c);
+    }
+}
+
+static esp_err_t at_engine_start(void)
+{
+    for (int p = 0; p < AT_PRIO_COUNT; p++) at.q[p] = xQueueCreate(AT_QUEUE_LEN, sizeof(at_cmd_t));
+    at.work = xSemaphoreCreateCounting(2 * AT_QUEUE_LEN, 0);
+    at.done = xSemaphoreCreateBinary();
+    at.lock = xSemaphoreCreateMutex();
+    if (xTaskCreate(at_task, "at_task", AT_TASK_STACK, NULL, 6, NULL) != pdPASS) {
+        ESP_LOGE(AT_TAG, "No pude crear at_task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+#endif // AT_ENGINE_H
@@ -2,10 +2,12 @@
 #define AUDIO_H
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "driver/i2s.h"
 #include "driver/sdmmc_host.h"
@@ -13,6 +15,16 @@
 #include "driver/spi_common.h"
 #include "sdmmc_cmd.h"
 #include "esp_vfs_fat.h"
+#include "esp_partition.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "adpcm.h"
+#include "prompt_bundle.h"
+#include "wav.h"
 
 #define I2S_NUM             (0)
 #define I2S_SAMPLE_RATE     (16000)
@@ -28,36 +40,91 @@
 #define PIN_NUM_CLK   GPIO_NUM_18
 #define PIN_NUM_CS    GPIO_NUM_5
 #define SD_MOUNT_POINT      "/sdcard"
+#define SD_ALLOC_UNIT       (16 * 1024)
+
+// Locuciones en flash (tools/pack_prompts.py); las de la SD, si las hay, mandan
+#define PROMPTS_PARTITION   "prompts"
+#define PROMPTS_SUBTYPE     0x41
+
+/*
+ * Reproductor: audio_play()/audio_enqueue()/audio_loop()/audio_stop()
+ * solo encolan una orden y vuelven. audio_task lee la SD de bloque en
+ * bloque (del tamaño del cluster FAT) en dos búferes que se alternan;
+ * audio_out los va pasando al I2S mientras se llena el otro (los de
+ * IMA-ADPCM, decodificando bloque a bloque justo antes). Cada orden
+ * que corta (play, loop, stop) sube una generación: los búferes de la
+ * anterior se tiran sin sonar y audio_out pone a cero lo que ya estaba en
+ * el DMA, así que un dígito DTMF calla la locución en menos de un búfer
+ * DMA (64 ms a 16 kHz) en vez de dejar sonar los cuatro encolados.
+ */
+#define AUDIO_DMA_BUF_LEN   1024                // tramas por búfer DMA
+#define AUDIO_CHUNK         SD_ALLOC_UNIT       // una lectura de SD = un cluster
+#define AUDIO_SLICE         (AUDIO_DMA_BUF_LEN * 2)   // por i2s_write: un búfer DMA en mono
+#define AUDIO_NAME_MAX      PB_NAME_MAX
+#define AUDIO_QUEUE_LEN     4
+#define AUDIO_LIST_LEN      4                   // ficheros en espera (enqueue)
+#define AUDIO_TASK_STACK    4096
+#define AUDIO_OUT_STACK     3072
 
 static const char *AUDIO_TAG = "AUDIO";
-static bool audio_ready = false;
+static bool audio_ready = false;    // hay de dónde sacar locuciones (flash o SD) y reproductor
+static bool s_sd_ready  = false;
 
-static void audio_init(void) {
-    // I2S config
-    i2s_config_t i2s_cfg = {
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
-        .sample_rate = I2S_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS,
-        .channel_format = I2S_CHANNEL_FORMAT,
-        .communication_format = I2S_COMM_FORMAT,
-        .intr_alloc_flags = 0,
-        .dma_buf_count = 4,
-        .dma_buf_len = 1024,
-        .use_apll = false
-    };
+// Paquete de locuciones mapeado en memoria (NULL si no hay)
+static const void *s_bundle = NULL;
+static esp_partition_mmap_handle_t s_bundle_map;
 
-    i2s_pin_config_t pin_cfg = {
-        .bck_io_num = I2S_PIN_BCK,
-        .ws_io_num = I2S_PIN_WS,
-        .data_out_num = I2S_PIN_DOUT,
-        .data_in_num = I2S_PIN_NO_CHANGE
-    };
+// Formato actual del I2S: solo se reprograma el reloj si el fichero trae otro
+static uint32_t s_i2s_rate     = I2S_SAMPLE_RATE;
+static uint16_t s_i2s_channels = 1;
+static uint32_t s_i2s_reclocks = 0;
 
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM, &i2s_cfg, 0, NULL));
-    ESP_ERROR_CHECK(i2s_set_pin(I2S_NUM, &pin_cfg));
-    ESP_LOGI(AUDIO_TAG, "I2S inicializado.");
+// Cómo acabó un fichero (para el on_done de quien lo pidió)
+typedef enum {
+    AUDIO_END_DONE = 0,     // sonó entero
+    AUDIO_END_STOPPED,      // lo cortó otra orden
+    AUDIO_END_ERROR,        // no se pudo abrir o no es un WAV válido
+} audio_end_t;
+
+// Desde audio_task o audio_out: no bloquear
+typedef void (*audio_done_t)(audio_end_t end, void *ctx);
+
+static esp_err_t audio_player_start(void);
+
+// Mapea el paquete de la partición "prompts" si hay uno válido
+static void audio_bundle_init(void) {
+    int64_t t0 = esp_timer_get_time();
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PROMPTS_SUBTYPE, PROMPTS_PARTITION);
+    if (!part) {
+        ESP_LOGW(AUDIO_TAG, "Sin partición '%s': solo locuciones de la SD", PROMPTS_PARTITION);
+        return;
+    }
+    pb_header_t h;
+    if (esp_partition_read(part, 0, &h, sizeof h) != ESP_OK || h.magic != PB_MAGIC ||
+        h.total < sizeof h || h.total > part->size) {
+        ESP_LOGW(AUDIO_TAG, "Partición '%s' sin paquete de locuciones", PROMPTS_PARTITION);
+        return;
+    }
+    const void *base;
+    esp_err_t err = esp_partition_mmap(part, 0, h.total, ESP_PARTITION_MMAP_DATA, &base, &s_bundle_map);
+    if (err != ESP_OK) {
+        ESP_LOGE(AUDIO_TAG, "No pude mapear '%s' (%u bytes): %s", PROMPTS_PARTITION,
+                 (unsigned)h.total, esp_err_to_name(err));
+        return;
+    }
+    pb_status_t st = pb_check(base, part->size);
+    if (st != PB_OK) {
+        ESP_LOGE(AUDIO_TAG, "Paquete de locuciones no válido: %s", PB_STATUS_NAME[st]);
+        esp_partition_munmap(s_bundle_map);
+        return;
+    }
+    s_bundle = base;
+    ESP_LOGI(AUDIO_TAG, "Paquete de locuciones: %u, %u KB mapeados en %lld us", (unsigned)h.count,
+             (unsigned)(h.total / 1024), (long long)(esp_timer_get_time() - t0));
+}
 
-    // SPI SD
+// SD por SPI; sin ella se sigue con el paquete de la flash
+static bool audio_sd_mount(void) {
     sdmmc_host_t host = SDSPI_HOST_DEFAULT();
     spi_bus_config_t bus_cfg = {
         .mosi_io_num = PIN_NUM_MOSI,
@@ -67,7 +134,11 @@ static void audio_init(void) {
         .quadhd_io_num = -1,
         .max_transfer_sz = 4000
     };
-    ESP_ERROR_CHECK(spi_bus_initialize(host.slot, &bus_cfg, SDSPI_DEFAULT_DMA));
+    esp_err_t ret = spi_bus_initialize(host.slot, &bus_cfg, SDSPI_DEFAULT_DMA);
+    if (ret != ESP_OK) {
+        ESP_LOGE(AUDIO_TAG, "Bus SPI de la SD: %s", esp_err_to_name(ret));
+        return false;
+    }
 
     sdspi_device_config_t dev_cfg = SDSPI_DEVICE_CONFIG_DEFAULT();
     dev_cfg.gpio_cs = PIN_NUM_CS;
@@ -76,14 +147,14 @@ static void audio_init(void) {
     esp_vfs_fat_mount_config_t mount_cfg = {
         .format_if_mount_failed = false,
         .max_files = 5,
-        .allocation_unit_size = 16 * 1024
+        .allocation_unit_size = SD_ALLOC_UNIT
     };
 
     sdmmc_card_t *card;
-    esp_err_t ret = esp_vfs_fat_sdspi_mount(SD_MOUNT_POINT, &host, &dev_cfg, &mount_cfg, &card);
+    ret = esp_vfs_fat_sdspi_mount(SD_MOUNT_POINT, &host, &dev_cfg, &mount_cfg, &card);
     if (ret != ESP_OK) {
         ESP_LOGE(AUDIO_TAG, "Falló montar la SD: %s", esp_err_to_name(ret));
-        return;
+        return false;
     }
     ESP_LOGI(AUDIO_TAG, "SD montada correctamente.");
     // Listar archivos en la SD para depuración
@@ -98,29 +169,522 @@ static void audio_init(void) {
     } else {
         ESP_LOGE(AUDIO_TAG, "No se pudo abrir el directorio SD");
     }
-    audio_ready = true;
+    return true;
 }
 
-static void playWav(const char *path) {
-    if (!audio_ready) {
-        ESP_LOGW(AUDIO_TAG, "Audio no listo");
+static void audio_init(void) {
+    // I2S config
+    i2s_config_t i2s_cfg = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
+        .sample_rate = I2S_SAMPLE_RATE,
+        .bits_per_sample = I2S_BITS,
+        .channel_format = I2S_CHANNEL_FORMAT,
+        .communication_format = I2S_COMM_FORMAT,
+        .intr_alloc_flags = 0,
+        .dma_buf_count = 4,
+        .dma_buf_len = AUDIO_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = true   // sin datos, silencio (no repetir el último búfer)
+    };
+
+    i2s_pin_config_t pin_cfg = {
+        .bck_io_num = I2S_PIN_BCK,
+        .ws_io_num = I2S_PIN_WS,
+        .data_out_num = I2S_PIN_DOUT,
+        .data_in_num = I2S_PIN_NO_CHANGE
+    };
+
+    ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM, &i2s_cfg, 0, NULL));
+    ESP_ERROR_CHECK(i2s_set_pin(I2S_NUM, &pin_cfg));
+    ESP_LOGI(AUDIO_TAG, "I2S inicializado.");
+
+    audio_bundle_init();
+    s_sd_ready = audio_sd_mount();
+    if (!s_bundle && !s_sd_ready) {
+        ESP_LOGE(AUDIO_TAG, "Sin locuciones: ni paquete en flash ni SD");
         return;
     }
+    audio_ready = audio_player_start() == ESP_OK;
+}
+
+static int audio_file_read(void *ctx, uint32_t off, void *dst, size_t n) {
+    FILE *f = (FILE *)ctx;
+    if (fseek(f, (long)off, SEEK_SET) != 0) return -1;
+    return fread(dst, 1, n, f) == n ? 0 : -1;
+}
+
+// Ajusta el reloj del I2S a la frecuencia y canales del fichero (si cambian)
+static esp_err_t audio_set_format(const wav_info_t *w) {
+    if (w->rate == s_i2s_rate && w->channels == s_i2s_channels) return ESP_OK;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = i2s_set_clk(I2S_NUM, w->rate, I2S_BITS,
+                                w->channels == 2 ? I2S_CHANNEL_STEREO : I2S_CHANNEL_MONO);
+    if (err != ESP_OK) {
+        ESP_LOGE(AUDIO_TAG, "I2S a %u Hz/%u canales: %s", (unsigned)w->rate,
+                 (unsigned)w->channels, esp_err_to_name(err));
+        return err;
+    }
+    s_i2s_rate = w->rate;
+    s_i2s_channels = w->channels;
+    s_i2s_reclocks++;
+    ESP_LOGI(AUDIO_TAG, "I2S a %u Hz, %u canal(es) en %lld us (%u cambios)", (unsigned)w->rate,
+             (unsigned)w->channels, (long long)(esp_timer_get_time() - t0), (unsigned)s_i2s_reclocks);
+    return ESP_OK;
+}
+
+/* ──────────────────────────── reproductor ──────────────────────────── */
+typedef enum { AUDIO_CMD_PLAY = 0, AUDIO_CMD_ENQUEUE, AUDIO_CMD_LOOP, AUDIO_CMD_STOP } audio_cmd_type_t;
+
+typedef struct {
+    uint8_t      type;                  // audio_cmd_type_t
+    uint32_t     gen;                   // generación que le toca
+    audio_done_t on_done;
+    void        *ctx;
+    int64_t      t_req;                 // cuándo se pidió (tiempo hasta la primera muestra)
+    char         name[AUDIO_NAME_MAX];  // "menu.wav": SD_MOUNT_POINT/name o el paquete
+} audio_cmd_t;
+
+// Un búfer del ping-pong y lo que audio_out necesita saber de él
+typedef enum { AUDIO_SRC_FLASH = 0, AUDIO_SRC_SD, AUDIO_SRC_COUNT } audio_src_t;
+static const char *const AUDIO_SRC_NAME[AUDIO_SRC_COUNT] = { "flash", "SD" };
+
+typedef struct {
+    uint8_t     *mem;                   // búfer propio (lecturas de SD)
+    const uint8_t *data;                // lo que suena: mem o directamente la flash mapeada
+    uint32_t     len;
+    uint32_t     gen;
+    uint32_t     rate;
+    uint16_t     channels;
+    uint16_t     format;                // WAV_FMT_PCM o WAV_FMT_IMA_ADPCM
+    uint16_t     block_align;           // ADPCM: el búfer lleva bloques enteros de este tamaño
+    bool         first;                 // primer bloque del fichero: ajustar el reloj
+    bool         last;                  // último: avisar a on_done al acabar de sonar
+    uint8_t      src;                   // audio_src_t
+    int64_t      t_req;
+    audio_done_t on_done;
+    void        *ctx;
+} audio_buf_t;
 
-    FILE *f = fopen(path, "rb");
-    if (!f) {
-        ESP_LOGW(AUDIO_TAG, "No puedo abrir archivo: %s", path);
+typedef struct {
+    uint32_t n;
+    int64_t  sum_us;
+    int64_t  max_us;
+} audio_lat_t;
+
+static struct {
+    QueueHandle_t cmd_q;
+    QueueHandle_t free_q;               // búferes libres (los llena audio_task)
+    QueueHandle_t full_q;               // búferes llenos (los vacía audio_out)
+    audio_buf_t   buf[2];
+    audio_cmd_t   list[AUDIO_LIST_LEN]; // ficheros pendientes (audio_task)
+    uint32_t      list_head, list_n;
+    uint32_t      gen;                  // sube con cada orden que corta
+    uint32_t      pending;              // ficheros pedidos y aún sin on_done
+    // Estadística
+    uint32_t      files;
+    uint32_t      underruns;            // audio_out esperó datos a mitad de fichero
+    uint64_t      read_bytes;
+    int64_t       read_us;
+    int64_t       read_max_us;          // lectura de bloque más lenta
+    audio_lat_t   ttfs[AUDIO_SRC_COUNT];  // orden → primera muestra en el DMA, por origen
+    audio_lat_t   cut;                  // orden que corta → DMA en silencio
+    uint32_t      t_cut;                // esp_timer (us, 32 bits bajos) de la última orden que corta
+    bool          dirty;                // audio_out ha escrito en el DMA desde el último vaciado
+    int64_t       out_end_us;           // cuándo acaba de sonar lo escrito en el DMA (estimado)
+    uint64_t      adpcm_cycles;         // decodificando (audio_out)
+    uint64_t      adpcm_samples;
+    int16_t       pcm[ADPCM_MAX_SAMPLES];   // un bloque ADPCM decodificado (audio_out)
+} s_audio;
+
+static inline uint32_t audio_gen(void) { return __atomic_load_n(&s_audio.gen, __ATOMIC_ACQUIRE); }
+
+static void audio_finish(audio_done_t on_done, void *ctx, audio_end_t end)
+{
+    if (on_done) on_done(end, ctx);
+    __atomic_fetch_sub(&s_audio.pending, 1, __ATOMIC_RELEASE);
+}
+
+static bool audio_send(audio_cmd_type_t type, const char *name, audio_done_t on_done, void *ctx)
+{
+    if (!audio_ready) return false;
+    audio_cmd_t c = { .type = (uint8_t)type, .on_done = on_done, .ctx = ctx, .t_req = esp_timer_get_time() };
+    if (name) snprintf(c.name, sizeof c.name, "%s", name);
+    if (type == AUDIO_CMD_ENQUEUE) {
+        c.gen = audio_gen();
+    } else {
+        // Lo que corta sube la generación ya y despierta a audio_out (un NULL en full_q)
+        // para que calle sin esperar a audio_task ni al siguiente búfer
+        __atomic_store_n(&s_audio.t_cut, (uint32_t)c.t_req, __ATOMIC_RELAXED);
+        c.gen = __atomic_add_fetch(&s_audio.gen, 1, __ATOMIC_ACQ_REL);
+        audio_buf_t *wake = NULL;
+        xQueueSendToFront(s_audio.full_q, &wake, 0);
+    }
+    if (type != AUDIO_CMD_STOP) __atomic_fetch_add(&s_audio.pending, 1, __ATOMIC_RELEASE);
+    if (xQueueSend(s_audio.cmd_q, &c, pdMS_TO_TICKS(100)) == pdTRUE) return true;
+    if (type != AUDIO_CMD_STOP) __atomic_fetch_sub(&s_audio.pending, 1, __ATOMIC_RELEASE);
+    ESP_LOGW(AUDIO_TAG, "Cola de audio llena");
+    return false;
+}
+
+// Corta lo que suene y reproduce la locución name (on_done puede ser NULL)
+static bool audio_play(const char *name, audio_done_t on_done, void *ctx)
+{
+    return audio_send(AUDIO_CMD_PLAY, name, on_done, ctx);
+}
+// Detrás de lo que ya suena o espera
+static bool audio_enqueue(const char *name, audio_done_t on_done, void *ctx)
+{
+    return audio_send(AUDIO_CMD_ENQUEUE, name, on_done, ctx);
+}
+// Como audio_play, pero vuelve a empezar hasta audio_stop() u otra orden
+static bool audio_loop(const char *name)
+{
+    return audio_send(AUDIO_CMD_LOOP, name, NULL, NULL);
+}
+static void audio_stop(void)
+{
+    audio_send(AUDIO_CMD_STOP, NULL, NULL, NULL);
+}
+static bool audio_busy(void)
+{
+    return __atomic_load_n(&s_audio.pending, __ATOMIC_ACQUIRE) != 0;
+}
+// Espera a que termine todo lo pedido; false si vence antes
+static bool audio_wait_idle(uint32_t timeout_ms)
+{
+    int64_t end = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (audio_busy()) {
+        if (esp_timer_get_time() >= end) return false;
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    return true;
+}
+
+static void audio_list_clear(void)
+{
+    while (s_audio.list_n) {
+        audio_cmd_t *c = &s_audio.list[s_audio.list_head++ % AUDIO_LIST_LEN];
+        s_audio.list_n--;
+        audio_finish(c->on_done, c->ctx, AUDIO_END_STOPPED);
+    }
+}
+
+// audio_task: aplica una orden a la lista de pendientes
+static void audio_cmd_apply(const audio_cmd_t *c)
+{
+    if (c->type == AUDIO_CMD_STOP) {
+        audio_list_clear();
         return;
     }
+    if (c->gen != audio_gen()) {        // ya la ha cortado otra posterior
+        audio_finish(c->on_done, c->ctx, AUDIO_END_STOPPED);
+        return;
+    }
+    if (c->type != AUDIO_CMD_ENQUEUE) audio_list_clear();
+    if (s_audio.list_n == AUDIO_LIST_LEN) {
+        ESP_LOGW(AUDIO_TAG, "Lista llena: %s descartado", c->name);
+        audio_finish(c->on_done, c->ctx, AUDIO_END_STOPPED);
+        return;
+    }
+    s_audio.list[(s_audio.list_head + s_audio.list_n++) % AUDIO_LIST_LEN] = *c;
+}
 
-    fseek(f, 44, SEEK_SET);  // Saltar cabecera WAV
+/*
+ * Dónde está la locución: un fichero con ese nombre en la SD manda (para
+ * cambiarla sin regrabar); si no, el paquete de la flash. *f queda
+ * abierto si es de la SD.
+ */
+static bool audio_resolve(const char *name, FILE **f, wav_info_t *w, const uint8_t **mapped)
+{
+    *f = NULL;
+    *mapped = NULL;
+    if (s_sd_ready) {
+        char path[sizeof SD_MOUNT_POINT + AUDIO_NAME_MAX + 1];
+        snprintf(path, sizeof path, SD_MOUNT_POINT "/%s", name);
+        *f = fopen(path, "rb");
+    }
+    if (*f) {
+        int64_t t0 = esp_timer_get_time();
+        wav_status_t st = wav_parse(audio_file_read, *f, w);
+        if (st != WAV_OK || fseek(*f, (long)w->data_off, SEEK_SET) != 0) {
+            ESP_LOGW(AUDIO_TAG, "%s (SD): %s (fmt %u, %u bits, %u canales, %u Hz)", name, WAV_STATUS_NAME[st],
+                     (unsigned)w->format, (unsigned)w->bits, (unsigned)w->channels, (unsigned)w->rate);
+            fclose(*f);
+            *f = NULL;
+            return false;
+        }
+        ESP_LOGD(AUDIO_TAG, "%s (SD): %u Hz, %u canal(es), %u bytes en %u, %u chunks leídos en %lld us", name,
+                 (unsigned)w->rate, (unsigned)w->channels, (unsigned)w->data_len, (unsigned)w->data_off,
+                 (unsigned)w->chunks, (long long)(esp_timer_get_time() - t0));
+        return true;
+    }
+    const pb_entry_t *e = s_bundle ? pb_find(s_bundle, name) : NULL;
+    if (!e) {
+        ESP_LOGW(AUDIO_TAG, "No hay locución '%s' ni en la SD ni en la flash", name);
+        return false;
+    }
+    memset(w, 0, sizeof *w);
+    w->format      = e->format;
+    w->channels    = e->channels;
+    w->rate        = e->rate;
+    w->bits        = e->format == WAV_FMT_IMA_ADPCM ? 4 : 16;
+    w->block_align = e->block_align;
+    if (!wav_supported(w)) {
+        ESP_LOGW(AUDIO_TAG, "%s (flash): formato no soportado (fmt %u, bloque %u)", name,
+                 (unsigned)e->format, (unsigned)e->block_align);
+        return false;
+    }
+    w->data_len = w->format == WAV_FMT_IMA_ADPCM ? e->len : e->len - e->len % w->block_align;
+    *mapped = pb_data(s_bundle, e);
+    return true;
+}
 
-    uint8_t buf[512];
-    size_t len, written;
-    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
-        i2s_write(I2S_NUM, buf, len, &written, portMAX_DELAY);
+// audio_task: pasa una locución a audio_out por bloques (de la SD, leídos; de la flash, tal cual)
+static void audio_stream(const audio_cmd_t *it)
+{
+    FILE *f;
+    wav_info_t w;
+    const uint8_t *mapped;
+    if (!audio_resolve(it->name, &f, &w, &mapped)) {
+        audio_finish(it->on_done, it->ctx, AUDIO_END_ERROR);
+        return;
+    }
+
+    bool loop = it->type == AUDIO_CMD_LOOP;
+    bool first = true, handed = false;
+    uint32_t left = w.data_len, rounds = 0;
+    uint64_t bytes = 0;
+    int64_t  us = 0;
+    s_audio.files++;
+    for (;;) {
+        audio_cmd_t c;
+        while (xQueueReceive(s_audio.cmd_q, &c, 0) == pdTRUE) audio_cmd_apply(&c);
+        if (audio_gen() != it->gen) break;
+        if (!left) {
+            if (!loop || (f && fseek(f, (long)w.data_off, SEEK_SET) != 0)) break;
+            left = w.data_len;
+            rounds++;
+        }
+        audio_buf_t *b;
+        xQueueReceive(s_audio.free_q, &b, portMAX_DELAY);
+        if (audio_gen() != it->gen) {
+            xQueueSend(s_audio.free_q, &b, 0);
+            break;
+        }
+        // Bloques ADPCM enteros por búfer (en PCM, AUDIO_CHUNK ya es múltiplo de la trama)
+        size_t chunk = AUDIO_CHUNK - AUDIO_CHUNK % w.block_align;
+        size_t n = left < chunk ? left : chunk;
+        if (f) {
+            int64_t r0 = esp_timer_get_time();
+            n = fread(b->mem, 1, n, f);
+            int64_t dt = esp_timer_get_time() - r0;
+            us += dt;
+            bytes += n;
+            if (dt > s_audio.read_max_us) s_audio.read_max_us = dt;
+            b->data = b->mem;
+        } else {
+            // Sin búfer intermedio en RAM: i2s_write copia directo de la flash mapeada a los descriptores DMA
+            b->data = mapped + (w.data_len - left);
+        }
+        left = n ? left - n : 0;                  // fichero más corto de lo que dice: se acaba aquí
+        b->len      = n;
+        b->gen      = it->gen;
+        b->rate     = w.rate;
+        b->channels = w.channels;
+        b->format   = w.format;
+        b->block_align = w.block_align;
+        b->first    = first;
+        b->last     = !left && !loop;
+        b->src      = f ? AUDIO_SRC_SD : AUDIO_SRC_FLASH;
+        b->t_req    = it->t_req;
+        b->on_done  = it->on_done;
+        b->ctx      = it->ctx;
+        first = false;
+        handed = b->last;                         // desde aquí el on_done lo da audio_out
+        xQueueSend(s_audio.full_q, &b, portMAX_DELAY);
+        if (handed) break;
     }
+    if (!handed) audio_finish(it->on_done, it->ctx, AUDIO_END_STOPPED);
+    if (rounds) ESP_LOGD(AUDIO_TAG, "%s: %u vueltas", it->name, (unsigned)rounds);
+    if (!f) return;
+
     fclose(f);
+    s_audio.read_bytes += bytes;
+    s_audio.read_us += us;
+    ESP_LOGI(AUDIO_TAG, "%s: %llu KB%s a %llu KB/s de SD (bloque más lento %lld ms), %u huecos en total",
+             it->name, (unsigned long long)(bytes / 1024), handed ? "" : " (cortado)",
+             (unsigned long long)(us ? bytes * 1000000 / 1024 / us : 0),
+             (long long)(s_audio.read_max_us / 1000), (unsigned)s_audio.underruns);
+}
+
+static void audio_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        if (!s_audio.list_n) {
+            audio_cmd_t c;
+            if (xQueueReceive(s_audio.cmd_q, &c, portMAX_DELAY) == pdTRUE) audio_cmd_apply(&c);
+            continue;
+        }
+        audio_cmd_t it = s_audio.list[s_audio.list_head++ % AUDIO_LIST_LEN];
+        s_audio.list_n--;
+        audio_stream(&it);
+    }
+}
+
+static void audio_lat_note(audio_lat_t *t, int64_t us)
+{
+    t->n++;
+    t->sum_us += us;
+    if (us > t->max_us) t->max_us = us;
+}
+
+// Tiempo desde la orden hasta que la primera muestra entra en el DMA
+static void audio_ttfs_note(const audio_buf_t *b)
+{
+    audio_lat_t *t = &s_audio.ttfs[b->src];
+    int64_t us = esp_timer_get_time() - b->t_req;
+    audio_lat_note(t, us);
+    ESP_LOGI(AUDIO_TAG, "Primera muestra (%s) a %lld us de la orden (media %lld, máx %lld)",
+             AUDIO_SRC_NAME[b->src], (long long)us, (long long)(t->sum_us / t->n), (long long)t->max_us);
+}
+
+/*
+ * Han cortado lo que sonaba: a cero los búferes DMA (también el que está
+ * saliendo), en vez de dejar que se vacíen solos. timed: había audio en
+ * curso, se apunta el tiempo desde la orden hasta el silencio.
+ */
+static void audio_out_flush(bool timed)
+{
+    if (!s_audio.dirty) return;
+    i2s_zero_dma_buffer(I2S_NUM);
+    s_audio.dirty = false;
+    s_audio.out_end_us = 0;
+    if (!timed) return;
+    int64_t us = (uint32_t)esp_timer_get_time() - __atomic_load_n(&s_audio.t_cut, __ATOMIC_RELAXED);
+    audio_lat_note(&s_audio.cut, us);
+    ESP_LOGI(AUDIO_TAG, "Silencio a %lld us de la orden (media %lld, máx %lld)", (long long)us,
+             (long long)(s_audio.cut.sum_us / s_audio.cut.n), (long long)s_audio.cut.max_us);
+}
+
+// PCM al I2S en trozos de un búfer DMA, mirando entre trozo y trozo si lo han cortado
+static bool audio_out_write(const audio_buf_t *b, const uint8_t *p, uint32_t len, bool *note)
+{
+    bool live = true;
+    for (uint32_t off = 0; live && off < len; off += AUDIO_SLICE) {
+        size_t n = len - off < AUDIO_SLICE ? len - off : AUDIO_SLICE, written = 0;
+        i2s_write(I2S_NUM, p + off, n, &written, portMAX_DELAY);
+        s_audio.dirty = true;
+        int64_t now = esp_timer_get_time();
+        if (s_audio.out_end_us < now) s_audio.out_end_us = now;
+        s_audio.out_end_us += (int64_t)(written / (2 * b->channels)) * 1000000 / b->rate;
+        live = b->gen == audio_gen();
+        if (*note) {
+            audio_ttfs_note(b);
+            *note = false;
+        }
+    }
+    return live;
+}
+
+// IMA-ADPCM: bloque a bloque a s_audio.pcm y de ahí al I2S
+static bool audio_out_adpcm(const audio_buf_t *b, bool *note)
+{
+    bool live = true;
+    for (uint32_t off = 0; live && off < b->len; off += b->block_align) {
+        uint32_t n = b->len - off < b->block_align ? b->len - off : b->block_align;
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        int frames = adpcm_decode_block(b->data + off, n, b->channels, s_audio.pcm);
+        s_audio.adpcm_cycles += esp_cpu_get_cycle_count() - c0;
+        s_audio.adpcm_samples += (uint32_t)frames * b->channels;
+        live = audio_out_write(b, (const uint8_t *)s_audio.pcm, (uint32_t)frames * b->channels * 2, note);
+    }
+    return live;
+}
+
+static void audio_adpcm_stats(const audio_buf_t *b)
+{
+    if (!s_audio.adpcm_samples) return;
+    uint32_t cps = (uint32_t)(s_audio.adpcm_cycles / s_audio.adpcm_samples);
+    // Parte de la CPU a la frecuencia de este fichero (en milésimas)
+    uint64_t permil = (uint64_t)cps * b->rate * b->channels / (esp_rom_get_cpu_ticks_per_us() * 1000ULL);
+    ESP_LOGI(AUDIO_TAG, "ADPCM: %u ciclos/muestra, %llu.%llu%% de CPU a %u Hz (%llu muestras)", (unsigned)cps,
+             (unsigned long long)(permil / 10), (unsigned long long)(permil % 10), (unsigned)b->rate,
+             (unsigned long long)s_audio.adpcm_samples);
+}
+
+/*
+ * El final de un fichero ya está en el DMA pero aún no ha sonado (hasta
+ * 4 búferes, 256 ms a 16 kHz). Se espera a que salga antes del on_done:
+ * quien cuelga al acabar la locución no debe comerse la cola. Deja de
+ * esperar si llega el siguiente fichero o una orden que corta (false).
+ */
+static bool audio_out_drain(void)
+{
+    int64_t left = s_audio.out_end_us - esp_timer_get_time();
+    if (left <= 0) return true;
+    audio_buf_t *next;
+    if (xQueuePeek(s_audio.full_q, &next, pdMS_TO_TICKS(left / 1000) + 1) != pdTRUE) return true;
+    return next != NULL;
+}
+
+// Del búfer al I2S, decodificando si hace falta
+static void audio_out_task(void *arg)
+{
+    (void)arg;
+    uint32_t stream_gen = 0;
+    bool in_stream = false;                       // a mitad de un fichero que sigue vivo
+    for (;;) {
+        audio_buf_t *b;
+        if (xQueueReceive(s_audio.full_q, &b, 0) != pdTRUE) {
+            if (in_stream && stream_gen == audio_gen()) s_audio.underruns++;
+            xQueueReceive(s_audio.full_q, &b, portMAX_DELAY);
+        }
+        if (!b) {                                 // orden que corta (audio_send)
+            audio_out_flush(in_stream);
+            in_stream = false;
+            continue;
+        }
+        bool live = b->gen == audio_gen();
+        if (live && b->first && audio_set_format(&(wav_info_t){ .rate = b->rate, .channels = b->channels }) != ESP_OK) {
+            live = false;
+        }
+        bool note = live && b->first;             // tiempo hasta la primera muestra
+        if (live) {
+            live = b->format == WAV_FMT_IMA_ADPCM ? audio_out_adpcm(b, &note)
+                                                  : audio_out_write(b, b->data, b->len, &note);
+            if (!live) audio_out_flush(true);     // cortado a mitad del búfer
+        }
+        stream_gen = b->gen;
+        in_stream = live && !b->last;
+        if (b->last && b->format == WAV_FMT_IMA_ADPCM) audio_adpcm_stats(b);
+        if (b->last) audio_finish(b->on_done, b->ctx, live && audio_out_drain() ? AUDIO_END_DONE : AUDIO_END_STOPPED);
+        xQueueSend(s_audio.free_q, &b, 0);
+    }
+}
+
+static esp_err_t audio_player_start(void)
+{
+    s_audio.cmd_q  = xQueueCreate(AUDIO_QUEUE_LEN, sizeof(audio_cmd_t));
+    s_audio.free_q = xQueueCreate(2, sizeof(audio_buf_t *));
+    s_audio.full_q = xQueueCreate(3, sizeof(audio_buf_t *));   // los 2 búferes + el aviso de corte
+    if (!s_audio.cmd_q || !s_audio.free_q || !s_audio.full_q) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < 2; i++) {
+        audio_buf_t *b = &s_audio.buf[i];
+        b->mem = malloc(AUDIO_CHUNK);
+        if (!b->mem) return ESP_ERR_NO_MEM;
+        xQueueSend(s_audio.free_q, &b, 0);
+    }
+    // audio_out por encima de audio_task (que el I2S no espere a la SD) y de urc_task
+    // (que un corte por DTMF no espere a que acabe el manejador: el tick es de 10 ms)
+    if (xTaskCreate(audio_out_task, "audio_out", AUDIO_OUT_STACK, NULL, 6, NULL) != pdPASS ||
+        xTaskCreate(audio_task, "audio", AUDIO_TASK_STACK, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(AUDIO_TAG, "No pude crear las tareas de audio");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(AUDIO_TAG, "Reproductor listo (2 x %u KB; locuciones de %s%s)", (unsigned)(AUDIO_CHUNK / 1024),
+             s_bundle ? "flash" : "", s_sd_ready ? (s_bundle ? " y SD" : "SD") : "");
+    return ESP_OK;
 }
 
 #endif // AUDIO_H
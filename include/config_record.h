@@ -0,0 +1,221 @@
+#ifndef CONFIG_RECORD_H
+#define CONFIG_RECORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Registro binario de configuración (lo que se guarda en NVS).
+ *
+ * Cabecera fija (magic, versión, tamaño) + campos + CRC-32 de todo lo
+ * anterior. Los campos nuevos se añaden SIEMPRE al final y suben la
+ * versión: un registro más corto de una versión anterior se acepta y los
+ * campos que le faltan toman su valor por defecto. No depende de ESP-IDF.
+ */
+
+#define CFG_MAGIC        0x43464731u    // "CFG1"
+#define CFG_VERSION      2
+#define CFG_KEY_MAX      16
+
+// Valores de fábrica
+#define CFG_DEF_VIB_WINDOW_MS     800
+#define CFG_DEF_VIB_THRESHOLD     3
+#define CFG_DEF_ATTEND_TIMEOUT_MS 30000
+#define CFG_DEF_CALL_PLAY_MS      12000
+#define CFG_DEF_LAMP_ON_MS        30000
+#define CFG_DEF_RELAY_ACTIVE_HIGH 0     // 0 = activo-bajo (LOW=ON), 1 = activo-alto
+#define CFG_DEF_KEY               "0000"
+#define CFG_DEF_VIB_MODE          0     // 0 = ráfagas en ventana, 1 = patrón muestreado
+#define CFG_DEF_VIB_MIN_CONF      104   // Q8: confianza mínima del patrón (mejor F1 en test_vib_pattern)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // bytes del registro, CRC incluido
+    // v1
+    uint32_t vib_window_ms;
+    uint32_t vib_threshold;     // ráfagas dentro de la ventana
+    uint32_t attend_timeout_ms;
+    uint32_t call_play_ms;
+    uint32_t lamp_on_ms;
+    uint8_t  relay_active_high;
+    uint8_t  reserved[3];
+    char     key[CFG_KEY_MAX];  // clave de los comandos SMS, terminada en '\0'
+    // v2
+    uint8_t  vib_mode;
+    uint8_t  vib_min_conf;
+    uint8_t  reserved2[2];
+    // nuevos campos aquí
+    uint32_t crc;               // siempre el último
+} app_config_t;
+
+#define CFG_MIN_SIZE   (offsetof(app_config_t, vib_window_ms) + sizeof(uint32_t))
+
+// CRC-32 (IEEE 802.3, reflejado), sin tabla: se calcula una vez por arranque o cambio
+static uint32_t cfg_crc32(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void cfg_seal(app_config_t *c)
+{
+    c->magic   = CFG_MAGIC;
+    c->version = CFG_VERSION;
+    c->size    = sizeof *c;
+    c->crc     = cfg_crc32(c, offsetof(app_config_t, crc));
+}
+
+static void cfg_defaults(app_config_t *c)
+{
+    memset(c, 0, sizeof *c);
+    c->vib_window_ms     = CFG_DEF_VIB_WINDOW_MS;
+    c->vib_threshold     = CFG_DEF_VIB_THRESHOLD;
+    c->attend_timeout_ms = CFG_DEF_ATTEND_TIMEOUT_MS;
+    c->call_play_ms      = CFG_DEF_CALL_PLAY_MS;
+    c->lamp_on_ms        = CFG_DEF_LAMP_ON_MS;
+    c->relay_active_high = CFG_DEF_RELAY_ACTIVE_HIGH;
+    strcpy(c->key, CFG_DEF_KEY);
+    c->vib_mode          = CFG_DEF_VIB_MODE;
+    c->vib_min_conf      = CFG_DEF_VIB_MIN_CONF;
+    cfg_seal(c);
+}
+
+// Rangos aceptados; NULL si todo está bien, si no el nombre del campo
+static const char *cfg_check(const app_config_t *c)
+{
+    if (c->vib_window_ms < 100 || c->vib_window_ms > 10000) return "ventana";
+    if (c->vib_threshold < 1 || c->vib_threshold > 8)       return "umbral";   // VIB_RING_LEN
+    if (c->attend_timeout_ms < 5000 || c->attend_timeout_ms > 600000) return "atender";
+    if (c->call_play_ms < 1000 || c->call_play_ms > 120000) return "llamada";
+    if (c->lamp_on_ms < 1000 || c->lamp_on_ms > 3600000)    return "lampara";
+    if (c->relay_active_high > 1)                           return "polaridad";
+    if (c->vib_mode > 1)                                    return "modo";
+    if (c->vib_min_conf == 0)                               return "confianza";
+    if (memchr(c->key, '\0', sizeof c->key) == NULL || c->key[0] == '\0') return "clave";
+    return NULL;
+}
+
+typedef enum {
+    CFG_OK = 0,
+    CFG_ERR_SIZE,       // más corto que la cabecera o distinto de lo que dice
+    CFG_ERR_MAGIC,
+    CFG_ERR_VERSION,    // de una versión posterior a este firmware
+    CFG_ERR_CRC,
+    CFG_ERR_RANGE,
+} cfg_status_t;
+
+static const char *const CFG_STATUS_NAME[] = { "ok", "tamaño", "magic", "versión", "crc", "rango" };
+
+/*
+ * Valida un registro leído (len bytes) y lo deja en out, completado con
+ * los valores de fábrica si es de una versión anterior. Si falla, out
+ * queda con los valores de fábrica.
+ */
+static cfg_status_t cfg_decode(const void *buf, size_t len, app_config_t *out)
+{
+    cfg_defaults(out);
+    app_config_t hdr;
+    if (len < CFG_MIN_SIZE + sizeof(uint32_t) || len > sizeof *out) return CFG_ERR_SIZE;
+    memcpy(&hdr, buf, CFG_MIN_SIZE);
+    if (hdr.magic != CFG_MAGIC) return CFG_ERR_MAGIC;
+    if (hdr.version < 1 || hdr.version > CFG_VERSION) return CFG_ERR_VERSION;
+    if (hdr.size != len) return CFG_ERR_SIZE;
+
+    uint32_t crc;
+    memcpy(&crc, (const uint8_t *)buf + len - sizeof crc, sizeof crc);
+    if (crc != cfg_crc32(buf, len - sizeof crc)) return CFG_ERR_CRC;
+
+    app_config_t c;
+    cfg_defaults(&c);
+    memcpy(&c, buf, len - sizeof crc);   // los campos que no trae se quedan de fábrica
+    if (cfg_check(&c)) return CFG_ERR_RANGE;
+    cfg_seal(&c);
+    *out = c;
+    return CFG_OK;
+}
+
+/* ───────────────────── edición por nombre (SMS) ───────────────────── */
+typedef struct {
+    const char *name;
+    size_t      off;
+    uint8_t     bytes;      // 4 = uint32_t, 1 = uint8_t
+} cfg_field_t;
+
+static const cfg_field_t CFG_FIELDS[] = {
+    { "ventana",   offsetof(app_config_t, vib_window_ms),     4 },
+    { "umbral",    offsetof(app_config_t, vib_threshold),     4 },
+    { "atender",   offsetof(app_config_t, attend_timeout_ms), 4 },
+    { "llamada",   offsetof(app_config_t, call_play_ms),      4 },
+    { "lampara",   offsetof(app_config_t, lamp_on_ms),        4 },
+    { "polaridad", offsetof(app_config_t, relay_active_high), 1 },
+    { "modo",      offsetof(app_config_t, vib_mode),          1 },
+    { "confianza", offsetof(app_config_t, vib_min_conf),      1 },
+};
+#define CFG_FIELD_COUNT  (sizeof CFG_FIELDS / sizeof CFG_FIELDS[0])
+
+/*
+ * Cambia un campo numérico por su nombre sobre una copia y la valida.
+ * Devuelve NULL si ha ido bien o un texto corto con el motivo.
+ */
+static const char *cfg_set_field(app_config_t *c, const char *name, const char *value)
+{
+    const cfg_field_t *f = NULL;
+    for (size_t i = 0; i < CFG_FIELD_COUNT; i++) {
+        if (strcmp(CFG_FIELDS[i].name, name) == 0) { f = &CFG_FIELDS[i]; break; }
+    }
+    if (!f) return "campo desconocido";
+    char *end;
+    unsigned long long v = strtoull(value, &end, 10);
+    if (end == value || *end != '\0' || strchr(value, '-')) return "valor no numérico";
+
+    app_config_t tmp = *c;
+    uint8_t *p = (uint8_t *)&tmp + f->off;
+    if (f->bytes == 1) {
+        if (v > 0xFF) return "fuera de rango";
+        *p = (uint8_t)v;
+    } else {
+        if (v > UINT32_MAX) return "fuera de rango";   // 2^32 + 800 no es 800
+        uint32_t v32 = (uint32_t)v;
+        memcpy(p, &v32, sizeof v32);
+    }
+    if (cfg_check(&tmp)) return "fuera de rango";
+    cfg_seal(&tmp);
+    *c = tmp;
+    return NULL;
+}
+
+static const char *cfg_set_key(app_config_t *c, const char *key)
+{
+    size_t n = strlen(key);
+    if (n == 0 || n >= CFG_KEY_MAX || strchr(key, ' ')) return "clave no válida";
+    memset(c->key, 0, sizeof c->key);
+    memcpy(c->key, key, n);
+    cfg_seal(c);
+    return NULL;
+}
+
+// Resumen legible "ventana=800 umbral=3 ..." (sin la clave)
+static int cfg_format(const app_config_t *c, char *out, size_t cap)
+{
+    int n = 0;
+    for (size_t i = 0; i < CFG_FIELD_COUNT && n >= 0 && (size_t)n < cap; i++) {
+        const uint8_t *p = (const uint8_t *)c + CFG_FIELDS[i].off;
+        uint32_t v = 0;
+        if (CFG_FIELDS[i].bytes == 1) v = *p;
+        else memcpy(&v, p, sizeof v);
+        n += snprintf(out + n, cap - n, "%s%s=%u", i ? "\n" : "", CFG_FIELDS[i].name, (unsigned)v);
+    }
+    return n;
+}
+
+#endif // CONFIG_RECORD_H
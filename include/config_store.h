@@ -0,0 +1,97 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "config_record.h"
+
+/*
+ * Configuración persistente en NVS (formato en config_record.h).
+ *
+ * Se lee de una vez al arrancar (un solo nvs_get_blob); si falta o no es
+ * válida se usan los valores de fábrica. Los cambios se hacen sobre una
+ * copia, se validan, se guardan y se publican cambiando un puntero: quien
+ * lea con cfg() ve el registro viejo o el nuevo, nunca una mezcla.
+ */
+
+static const char *CFG_TAG = "CONFIG";
+
+#define CFG_NVS_NAMESPACE  "centralita"
+#define CFG_NVS_KEY        "cfg"
+
+static app_config_t                 s_cfg_buf[2];
+static const app_config_t *volatile s_cfg = &s_cfg_buf[0];
+
+// Registro en vigor (solo lectura)
+static inline const app_config_t *cfg(void) { return s_cfg; }
+
+// Publica c como registro en vigor (un solo escritor: quien procesa los SMS)
+static void config_apply(const app_config_t *c)
+{
+    app_config_t *next = (s_cfg == &s_cfg_buf[0]) ? &s_cfg_buf[1] : &s_cfg_buf[0];
+    *next = *c;
+    __atomic_store_n(&s_cfg, next, __ATOMIC_RELEASE);
+}
+
+static esp_err_t config_save(const app_config_t *c)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, CFG_NVS_KEY, c, sizeof *c);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) ESP_LOGE(CFG_TAG, "No se pudo guardar la configuración: %s", esp_err_to_name(err));
+    return err;
+}
+
+// Guarda y, si se pudo, aplica
+static esp_err_t config_commit(const app_config_t *c)
+{
+    esp_err_t err = config_save(c);
+    if (err == ESP_OK) config_apply(c);
+    return err;
+}
+
+// Al arrancar, antes de crear timers y tareas que lean cfg()
+static void config_init(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(CFG_TAG, "NVS sin espacio o de otra versión: se borra");
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    int64_t t_init = esp_timer_get_time();
+
+    app_config_t c;
+    uint8_t raw[sizeof c];
+    size_t len = sizeof raw;
+    cfg_status_t st = CFG_ERR_SIZE;
+    nvs_handle_t h;
+    if (err == ESP_OK && (err = nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &h)) == ESP_OK) {
+        err = nvs_get_blob(h, CFG_NVS_KEY, raw, &len);
+        nvs_close(h);
+    }
+    if (err == ESP_OK) st = cfg_decode(raw, len, &c);
+    else cfg_defaults(&c);
+    config_apply(&c);
+
+    int64_t t1 = esp_timer_get_time();
+    if (st == CFG_OK) {
+        ESP_LOGI(CFG_TAG, "Configuración v%u cargada en %lld us (NVS init %lld us)",
+                 (unsigned)c.version, (long long)(t1 - t0), (long long)(t_init - t0));
+    } else {
+        ESP_LOGW(CFG_TAG, "Configuración de fábrica (%s) en %lld us",
+                 err == ESP_OK ? CFG_STATUS_NAME[st] : esp_err_to_name(err), (long long)(t1 - t0));
+    }
+}
+
+#endif // CONFIG_STORE_H
@@ -0,0 +1,147 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "journal.h"
+
+/*
+ * Diario de eventos (journal.h) sobre la partición "journal".
+ *
+ * event_log() solo encola: la escritura (y el borrado de sector, ~50 ms
+ * cada 256 registros) la hace una tarea de baja prioridad, así que se
+ * puede llamar desde alert_task o urc_task sin retrasarlas. Las
+ * consultas leen la flash bajo el mismo cerrojo que la tarea.
+ */
+
+static const char *EVLOG_TAG = "EVLOG";
+
+#define EVLOG_PARTITION    "journal"
+#define EVLOG_SUBTYPE      0x40
+#define EVLOG_QUEUE_LEN    16
+#define EVLOG_TASK_STACK   3072
+#define EVLOG_NO_CH        0xFF
+
+typedef struct {
+    uint32_t time_s;
+    uint8_t  type;
+    uint8_t  ch;
+    uint16_t arg;
+} evlog_item_t;
+
+static struct {
+    const esp_partition_t *part;
+    jr_flash_t             fl;
+    journal_t              j;
+    QueueHandle_t          q;
+    SemaphoreHandle_t      lock;
+    bool                   ready;
+    uint32_t               dropped;
+    uint32_t               errors;
+} s_evlog;
+
+static int evlog_fl_read(void *ctx, uint32_t off, void *dst, size_t n)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, off, dst, n) == ESP_OK ? 0 : -1;
+}
+static int evlog_fl_write(void *ctx, uint32_t off, const void *src, size_t n)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, off, src, n) == ESP_OK ? 0 : -1;
+}
+static int evlog_fl_erase(void *ctx, uint32_t off, size_t n)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, off, n) == ESP_OK ? 0 : -1;
+}
+
+// Registra un evento (no bloquea; si la cola está llena se cuenta y se pierde)
+static void event_log(jr_event_t type, uint8_t ch, uint16_t arg)
+{
+    if (!s_evlog.ready) return;
+    evlog_item_t it = {
+        .time_s = (uint32_t)(esp_timer_get_time() / 1000000),
+        .type = (uint8_t)type, .ch = ch, .arg = arg,
+    };
+    if (xQueueSend(s_evlog.q, &it, 0) != pdTRUE) s_evlog.dropped++;
+}
+
+static void evlog_task(void *arg)
+{
+    (void)arg;
+    evlog_item_t it;
+    for (;;) {
+        if (xQueueReceive(s_evlog.q, &it, portMAX_DELAY) != pdTRUE) continue;
+        xSemaphoreTake(s_evlog.lock, portMAX_DELAY);
+        bool ok = jr_append(&s_evlog.j, it.type, it.ch, it.arg, it.time_s);
+        xSemaphoreGive(s_evlog.lock);
+        if (!ok && s_evlog.errors++ == 0) ESP_LOGE(EVLOG_TAG, "Error escribiendo en el diario");
+    }
+}
+
+/*
+ * Resumen de los n eventos más recientes en out. Devuelve cuántos hay.
+ * Bloquea mientras la tarea escribe (no usar desde alert_task).
+ */
+static int event_log_tail(int n, char *out, size_t cap)
+{
+    jr_record_t r[16];
+    if (n > (int)(sizeof r / sizeof r[0])) n = sizeof r / sizeof r[0];
+    if (!s_evlog.ready || n <= 0) {
+        snprintf(out, cap, "Diario no disponible");
+        return 0;
+    }
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_evlog.lock, portMAX_DELAY);
+    int got = jr_tail(&s_evlog.j, r, n);
+    uint32_t total = s_evlog.j.seq - 1;
+    xSemaphoreGive(s_evlog.lock);
+    int len = snprintf(out, cap, "Eventos: %u (arranque %u)", (unsigned)total, (unsigned)s_evlog.j.boot);
+    if (got && len >= 0 && (size_t)len + 1 < cap) {
+        out[len++] = '\n';
+        jr_format(r, got, out + len, cap - len);
+    }
+    ESP_LOGI(EVLOG_TAG, "Consulta de %d eventos en %lld us", got, (long long)(esp_timer_get_time() - t0));
+    return got;
+}
+
+// Al arrancar: monta el diario y apunta el reinicio
+static esp_err_t event_log_init(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    s_evlog.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, EVLOG_SUBTYPE, EVLOG_PARTITION);
+    if (!s_evlog.part) {
+        ESP_LOGW(EVLOG_TAG, "Sin partición '%s': no se guardan eventos", EVLOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_evlog.fl = (jr_flash_t){
+        .ctx = (void *)s_evlog.part, .size = s_evlog.part->size,
+        .read = evlog_fl_read, .write = evlog_fl_write, .erase = evlog_fl_erase,
+    };
+    if (!jr_mount(&s_evlog.j, &s_evlog.fl)) {
+        ESP_LOGE(EVLOG_TAG, "No se pudo montar el diario");
+        return ESP_FAIL;
+    }
+    s_evlog.q    = xQueueCreate(EVLOG_QUEUE_LEN, sizeof(evlog_item_t));
+    s_evlog.lock = xSemaphoreCreateMutex();
+    if (xTaskCreate(evlog_task, "evlog", EVLOG_TASK_STACK, NULL, 2, NULL) != pdPASS) {
+        ESP_LOGE(EVLOG_TAG, "No pude crear evlog");
+        return ESP_FAIL;
+    }
+    s_evlog.ready = true;
+    ESP_LOGI(EVLOG_TAG, "Diario: %u huecos, siguiente #%u, arranque %u (montado en %lld us)",
+             (unsigned)s_evlog.j.slots, (unsigned)s_evlog.j.seq, (unsigned)s_evlog.j.boot,
+             (long long)(esp_timer_get_time() - t0));
+    event_log(JR_EV_BOOT, EVLOG_NO_CH, (uint16_t)esp_reset_reason());
+    return ESP_OK;
+}
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,79 @@
+#ifndef ISR_RING_H
+#define ISR_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+
+/*
+ * Anillo sin bloqueos de un productor y un consumidor para pasar eventos
+ * de las ISR a una tarea.
+ *
+ * El productor es el servicio de ISR de GPIO: todas las ISR de pin se
+ * ejecutan desde la misma interrupción, una tras otra, así que cuentan
+ * como un solo productor. El consumidor es una única tarea. Solo el
+ * productor escribe head y solo el consumidor escribe tail; basta con
+ * publicar cada índice con semántica release/acquire.
+ */
+
+#define ISR_RING_LEN   32            // potencia de 2
+
+typedef struct {
+    int64_t  t_us;       // instante de la interrupción
+    uint8_t  type;
+    uint8_t  ch;         // canal (índice en la tabla de canales)
+    uint8_t  level;      // nivel del pin leído en la ISR
+} isr_event_t;
+
+typedef struct {
+    isr_event_t ev[ISR_RING_LEN];
+    uint32_t    head;        // lo escribe la ISR
+    uint32_t    tail;        // lo escribe la tarea
+    uint32_t    dropped;     // eventos perdidos con el anillo lleno
+} isr_ring_t;
+
+// Lado ISR; false si el anillo está lleno (el evento se cuenta y se pierde)
+static inline bool IRAM_ATTR isr_ring_push(isr_ring_t *r, uint8_t type, uint8_t ch, uint8_t level)
+{
+    uint32_t head = r->head;
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= ISR_RING_LEN) {
+        r->dropped++;
+        return false;
+    }
+    isr_event_t *e = &r->ev[head & (ISR_RING_LEN - 1)];
+    e->t_us  = esp_timer_get_time();
+    e->type  = type;
+    e->ch    = ch;
+    e->level = level;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * Lado ISR de un pin que se calla hasta que la tarea lo reactive (el
+ * sensor: el resto de la ráfaga no despierta a nadie). Solo se calla si
+ * el evento entró: perdido con el anillo lleno, la tarea no sabría que
+ * tiene que reactivarlo y el pin quedaría mudo hasta reiniciar.
+ */
+static inline bool IRAM_ATTR isr_ring_push_mute(isr_ring_t *r, uint8_t type, uint8_t ch, gpio_num_t pin)
+{
+    if (!isr_ring_push(r, type, ch, (uint8_t)gpio_get_level(pin))) return false;
+    gpio_intr_disable(pin);
+    return true;
+}
+
+// Lado tarea; false si no hay eventos
+static inline bool isr_ring_pop(isr_ring_t *r, isr_event_t *out)
+{
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+    *out = r->ev[tail & (ISR_RING_LEN - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif // ISR_RING_H
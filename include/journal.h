@@ -0,0 +1,203 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Diario de eventos en flash: anillo de registros binarios de tamaño fijo.
+ *
+ * Solo se añade. Los registros se escriben en orden por toda la partición
+ * y, al entrar en un sector, se borra entero (era el más antiguo); así
+ * cada sector se borra una vez por vuelta y el desgaste queda repartido.
+ * Cada registro lleva un número de secuencia creciente y un CRC: al
+ * montar basta leer el primer registro de cada sector y una búsqueda
+ * binaria dentro del último para encontrar la cabeza. Un registro a medio
+ * escribir (corte de corriente) ocupa su hueco pero no se muestra.
+ *
+ * La flash se usa a través de jr_flash_t, así que se puede probar con una
+ * partición simulada en RAM. No depende de ESP-IDF.
+ */
+
+#define JR_SECTOR        4096
+#define JR_ERASED_SEQ    0xFFFFFFFFu
+
+typedef enum {
+    JR_EV_BOOT = 1,      // arg: motivo del reinicio
+    JR_EV_ALARM,         // arg: 0 = ráfagas, 1..256 = confianza del patrón
+    JR_EV_ACK,           // atendida con el botón; arg: segundos desde la alarma
+    JR_EV_CALL,          // arg: (contacto << 8) | resultado de la llamada
+    JR_EV_SMS,           // arg: número de comando
+    JR_EV_COUNT
+} jr_event_t;
+
+static const char *const JR_EV_NAME[JR_EV_COUNT] = {
+    "?", "ARRANQUE", "ALARMA", "ATENDIDA", "LLAMADA", "SMS",
+};
+
+typedef struct {
+    uint32_t seq;
+    uint32_t time_s;     // segundos desde el arranque
+    uint16_t boot;       // número de arranque
+    uint8_t  type;       // jr_event_t
+    uint8_t  ch;         // canal, 0xFF = ninguno
+    uint16_t arg;
+    uint16_t crc;        // CRC-16/CCITT de lo anterior
+} jr_record_t;
+
+_Static_assert(sizeof(jr_record_t) == 16, "registro de 16 bytes");
+#define JR_PER_SECTOR   (JR_SECTOR / sizeof(jr_record_t))
+
+// Acceso a la partición; devuelven 0 si todo fue bien
+typedef struct {
+    void     *ctx;
+    uint32_t  size;      // bytes, múltiplo de JR_SECTOR (al menos 2 sectores)
+    int     (*read)(void *ctx, uint32_t off, void *dst, size_t n);
+    int     (*write)(void *ctx, uint32_t off, const void *src, size_t n);
+    int     (*erase)(void *ctx, uint32_t off, size_t n);
+} jr_flash_t;
+
+typedef struct {
+    const jr_flash_t *fl;
+    uint32_t slots;
+    uint32_t head;       // siguiente hueco a escribir
+    uint32_t seq;        // secuencia del siguiente registro
+    uint16_t boot;
+} journal_t;
+
+static uint16_t jr_crc16(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int k = 0; k < 8; k++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static bool jr_read_slot(const journal_t *j, uint32_t slot, jr_record_t *r)
+{
+    return j->fl->read(j->fl->ctx, slot * sizeof *r, r, sizeof *r) == 0;
+}
+
+static bool jr_is_erased(const jr_record_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    for (size_t i = 0; i < sizeof *r; i++) if (p[i] != 0xFF) return false;
+    return true;
+}
+
+static bool jr_is_valid(const jr_record_t *r)
+{
+    return r->seq != JR_ERASED_SEQ && r->crc == jr_crc16(r, offsetof(jr_record_t, crc));
+}
+
+/*
+ * Encuentra la cabeza. Devuelve false si la partición no sirve (tamaño o
+ * error de lectura); una partición vacía o ilegible se da por nueva.
+ */
+static bool jr_mount(journal_t *j, const jr_flash_t *fl)
+{
+    memset(j, 0, sizeof *j);
+    j->fl = fl;
+    uint32_t sectors = fl->size / JR_SECTOR;
+    if (sectors < 2) return false;
+    j->slots = sectors * JR_PER_SECTOR;
+
+    // Sector con el primer registro de secuencia más alta
+    jr_record_t r;
+    int32_t  last = -1;
+    uint32_t last_seq = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (!jr_read_slot(j, s * JR_PER_SECTOR, &r)) return false;
+        if (jr_is_valid(&r) && (last < 0 || r.seq > last_seq)) {
+            last = (int32_t)s;
+            last_seq = r.seq;
+        }
+    }
+    if (last < 0) {                       // nueva (o irreconocible): se empieza de cero
+        if (fl->erase(fl->ctx, 0, JR_SECTOR) != 0) return false;
+        j->head = 0;
+        j->seq  = 1;
+        j->boot = 1;
+        return true;
+    }
+
+    // Primer hueco borrado del sector: se escriben en orden, búsqueda binaria
+    uint32_t base = (uint32_t)last * JR_PER_SECTOR;
+    uint32_t lo = 1, hi = JR_PER_SECTOR;  // el hueco 0 está escrito
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!jr_read_slot(j, base + mid, &r)) return false;
+        if (jr_is_erased(&r)) hi = mid; else lo = mid + 1;
+    }
+    j->head = (base + lo) % j->slots;
+    j->seq  = last_seq + lo;
+
+    // Número de arranque: el del último registro válido + 1
+    j->boot = 1;
+    for (uint32_t k = 1; k <= lo; k++) {
+        if (!jr_read_slot(j, base + lo - k, &r)) break;
+        if (jr_is_valid(&r)) { j->boot = (uint16_t)(r.boot + 1); break; }
+    }
+    return true;
+}
+
+// Añade un registro: O(1) (más un borrado de sector cada JR_PER_SECTOR)
+static bool jr_append(journal_t *j, uint8_t type, uint8_t ch, uint16_t arg, uint32_t time_s)
+{
+    const jr_flash_t *fl = j->fl;
+    if (j->head % JR_PER_SECTOR == 0) {
+        if (fl->erase(fl->ctx, j->head * sizeof(jr_record_t), JR_SECTOR) != 0) return false;
+    }
+    jr_record_t r = {
+        .seq = j->seq, .time_s = time_s, .boot = j->boot, .type = type, .ch = ch, .arg = arg,
+    };
+    r.crc = jr_crc16(&r, offsetof(jr_record_t, crc));
+    int err = fl->write(fl->ctx, j->head * sizeof r, &r, sizeof r);
+    j->head = (j->head + 1) % j->slots;   // aunque falle: ese hueco ya no está limpio
+    j->seq++;
+    return err == 0;
+}
+
+/*
+ * Los n registros más recientes, del más nuevo al más antiguo. Se para en
+ * el primer hueco borrado o al saltar la secuencia (vuelta ya pisada).
+ */
+static int jr_tail(const journal_t *j, jr_record_t *out, int n)
+{
+    int got = 0;
+    uint32_t slot = j->head;
+    uint32_t want = j->seq;
+    for (uint32_t k = 0; k < j->slots && got < n; k++) {
+        slot = (slot + j->slots - 1) % j->slots;
+        want--;
+        jr_record_t r;
+        if (!jr_read_slot(j, slot, &r) || jr_is_erased(&r)) break;
+        if (!jr_is_valid(&r)) continue;          // a medio escribir
+        if (r.seq != want) break;
+        out[got++] = r;
+    }
+    return got;
+}
+
+// Una línea por registro: "#12 b3 +125s ALARMA c0 160"
+static int jr_format(const jr_record_t *r, int n, char *out, size_t cap)
+{
+    int len = 0;
+    for (int i = 0; i < n && len >= 0 && (size_t)len < cap; i++) {
+        const jr_record_t *e = &r[i];
+        const char *name = e->type < JR_EV_COUNT ? JR_EV_NAME[e->type] : "?";
+        len += snprintf(out + len, cap - len, "%s#%u b%u +%us %s", i ? "\n" : "",
+                        (unsigned)e->seq, (unsigned)e->boot, (unsigned)e->time_s, name);
+        if (len >= 0 && (size_t)len < cap && e->ch != 0xFF) len += snprintf(out + len, cap - len, " c%u", e->ch);
+        if (len >= 0 && (size_t)len < cap && e->arg) len += snprintf(out + len, cap - len, " %u", e->arg);
+    }
+    return len;
+}
+
+#endif // JOURNAL_H
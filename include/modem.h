@@ -13,7 +13,11 @@
 #include "driver/gpio.h"   
 
 #include "audio.h"
-#include "sms.h"          // read_sms(), procesar_sms()
+#include "modem_line.h"   // ml_next()
+#include "at_engine.h"    // at_cmd(), at_submit()
+#include "modem_link.h"   // modem_link_probe(), modem_link_negotiate()
+#include "urc.h"          // urc_register(), urc_feed()
+#include "sms.h"          // sms_on_pdu(), sms_inbox_request()
 #include "dtmf.h"         // caller_authorized(), dtmf_files[]
 
 
@@ -21,59 +25,26 @@ extern const uart_port_t MODEM_UART;
 
 static const char *MODEM_TAG = "MODEM";
 #define UART_BUF_LEN 512
-#define MODEM_TASK_STACK 12288
-
-/* ─────────────────────────── utilidades ─────────────────────────── */
-static int read_line(char *buf, int max, int timeout_ms)
-{
-    int len = 0;
-    int64_t t0 = esp_timer_get_time();
-    while (((esp_timer_get_time() - t0) / 1000) < timeout_ms && len < max - 1) {
-        if (uart_read_bytes(MODEM_UART, (uint8_t *)buf + len, 1,
-                            pdMS_TO_TICKS(50)) == 1 && buf[len++] == '\n')
-            break;
-    }
-    buf[len] = '\0';
-    return len;
-}
-
-static void send_at_wait(const char *cmd)
-{
-    ESP_LOGI(MODEM_TAG, "AT> %s", cmd);
-    uart_write_bytes(MODEM_UART, cmd, strlen(cmd));
-    uart_write_bytes(MODEM_UART, "\r", 1);
-
-    char l[96];
-    /* lee hasta OK/ERROR o agota 1,5 s */
-    while (read_line(l, sizeof l, 1500) > 0) {
-        ESP_LOGI(MODEM_TAG, "<< %s", l);
-        if (strstr(l, "OK") || strstr(l, "ERROR")) break;
-    }
-}
+#define MODEM_TASK_STACK 4096    // solo lee: los manejadores van en urc_task
 
 /* ──────────────────────── manejadores URC ──────────────────────── */
-static void handle_sms_push(const char *first)
+static void handle_sms_push(const char *first, const char *body)
 {
-    char sender[32] = {0};
-    sscanf(first, "+CMT: \"%31[^\"]\"", sender);
-
-    char body[161] = {0};
-    if (read_line(body, sizeof body, 3000) <= 0) return;
-    ESP_LOGI(MODEM_TAG, "SMS %s: %s", sender, body);
-
-    procesar_sms(sender, body);          // función del usuario
+    // Modo PDU: "+CMT: [<alfa>],<len>" y la PDU en la línea siguiente
+    ESP_LOGI(MODEM_TAG, "SMS directo: %s", first);
+    sms_on_pdu(body);
 }
 
-static void handle_sms_notification(const char *line)
+static void handle_sms_notification(const char *line, const char *body)
 {
-    char *comma = strchr(line, ',');
-    if (!comma) return;
-    int idx = atoi(comma + 1);
-    read_sms(idx);
+    (void)body;
+    ESP_LOGI(MODEM_TAG, "Nuevo SMS: %s", line);
+    sms_inbox_request();
 }
 
-static void handle_call_notification(const char *line)
+static void handle_call_notification(const char *line, const char *body)
 {
+    (void)body;
     ESP_LOGI(MODEM_TAG, "URC llamada: %s", line);
     char raw[32] = {0}, full[36] = {0};
     // Acepta +CLIP: o +CLIP2:
@@ -92,16 +63,23 @@ static void handle_call_notification(const char *line)
         //uart_write_bytes(MODEM_UART, "ATH\r", 4);
         return;
     }
-    uart_write_bytes(MODEM_UART, "ATA\r", 4);
-    vTaskDelay(pdMS_TO_TICKS(300));
+    if (at_cmd("ATA", 5000) != AT_RES_OK) ESP_LOGW(MODEM_TAG, "ATA sin OK");
     // Enviar lista de comandos por SMS al descolgar
     send_sms_to(NUM1, "Comando 1: Listar comandos.\nComando 2: Cambiar clave.\nComando 3: Mostrar alertas.\nComando 4: Probar llamadas.\nComando 5: Probar SMS.\nComando 6: Cancelar alerta.\nComando 7: Reiniciar dispositivo.\nComando 8: Prueba sistema.\nComando 9: Estado del sistema.");
-    if (audio_ready) playWav(SD_MOUNT_POINT "/menu.wav");
+    audio_play("menu.wav", NULL, NULL);
     // NO colgar aquí: dejar la llamada abierta para DTMF
 }
 
-static void handle_dtmf_event(const char *line)
+// Fin del audio de un dígito: se cuelga, salvo que otro dígito lo haya cortado
+static void dtmf_prompt_done(audio_end_t end, void *ctx)
+{
+    (void)ctx;
+    if (end != AUDIO_END_STOPPED) at_cmd_async("ATH", AT_PRIO_NORMAL);
+}
+
+static void handle_dtmf_event(const char *line, const char *body)
 {
+    (void)body;
     ESP_LOGI(MODEM_TAG, "DTMF URC recibido: %s", line);
     char tone = 0;
     if (sscanf(line, "+DTMF: %c", &tone) != 1) {
@@ -110,7 +88,7 @@ static void handle_dtmf_event(const char *line)
     }
     ESP_LOGI(MODEM_TAG, "DTMF recibido: %c", tone);
     if (tone == '*') {
-        if (audio_ready) playWav(SD_MOUNT_POINT "/menu.wav");
+        audio_play("menu.wav", NULL, NULL);
         return;
     }
     if (tone < '0' || tone > '9') {
@@ -118,7 +96,8 @@ static void handle_dtmf_event(const char *line)
         return;
     }
     int idx = tone - '0';
-    // Primero reproducir el audio correspondiente
+    // Primero el audio correspondiente (sin esperar: cuelga dtmf_prompt_done)
+    bool playing = false;
     if (audio_ready) {
         const char *dtmf_audio_files[10] = {
             "0.wav",  
@@ -132,17 +111,16 @@ static void handle_dtmf_event(const char *line)
             "8.wav",  
             "9.wav"  
         };
-        char path[64];
-        snprintf(path, sizeof(path), SD_MOUNT_POINT "/%s", dtmf_audio_files[idx]);
-        ESP_LOGI(MODEM_TAG, "Reproduciendo: %s", path);
-        playWav(path);
+        ESP_LOGI(MODEM_TAG, "Reproduciendo: %s", dtmf_audio_files[idx]);
+        playing = audio_play(dtmf_audio_files[idx], dtmf_prompt_done, NULL);
     }
-    // Después de reproducir el audio, ejecutar la acción asociada
+    // Mientras suena, la acción asociada
     if (tone >= '1' && tone <= '9') {
         char sms_msg[64];
         if (tone == '7') {
             send_sms_to(NUM1, "Reiniciando...");
-            vTaskDelay(pdMS_TO_TICKS(500));
+            sms_outbox_flush(SMS_SEND_TIMEOUT_MS);
+            audio_wait_idle(10000);
             esp_restart();
             return;
         } else if (tone == '9') {
@@ -166,33 +144,192 @@ static void handle_dtmf_event(const char *line)
             send_sms_to(NUM1, sms_msgs[idx]);
         }
     }
-    uart_write_bytes(MODEM_UART, "ATH\r", 4);
+    if (!playing) at_cmd("ATH", 5000);
+}
+
+/* ───────────────────── llamadas salientes ─────────────────────
+ * Con AT+COLP=1 el "ATD<n>;" no termina hasta que el destino descuelga
+ * (+COLP y OK) o la red da BUSY / NO ANSWER / NO CARRIER / NO DIALTONE,
+ * así que el resultado del comando ES el progreso de la llamada. La
+ * llamada se lanza sin bloquear y el resultado llega por callback, para
+ * que quien llama pueda atender otros eventos (p.ej. cancelar) mientras.
+ */
+#define CALL_DIAL_TIMEOUT_MS   45000   // sin respuesta de la red: se cuelga
+
+typedef enum {
+    CALL_ANSWERED = 0,
+    CALL_BUSY,
+    CALL_NO_ANSWER,
+    CALL_NO_CARRIER,
+    CALL_NO_DIALTONE,
+    CALL_FAILED,        // ERROR o comando no aceptado
+    CALL_CANCELLED,     // modem_call_abort()
+} call_result_t;
+
+static const char *const CALL_RESULT_NAME[] = {
+    "descolgada", "ocupado", "sin respuesta", "sin portadora", "sin tono", "error", "cancelada",
+};
+
+static const char *const CALL_FINALS[] = {
+    "BUSY", "NO ANSWER", "NO CARRIER", "NO DIALTONE", NULL,
+};
+
+// Contexto de at_task
+typedef void (*call_done_t)(call_result_t r, void *ctx);
+
+static volatile bool call_active = false;   // llamada saliente conectada
+
+static struct {
+    call_done_t   cb;
+    void         *ctx;
+    int64_t       t0;
+    char          number[24];
+    volatile bool abort;
+} call;
+
+static void handle_call_ended(const char *line, const char *body)
+{
+    (void)body;
+    if (call_active) ESP_LOGI(MODEM_TAG, "Llamada terminada por el otro extremo: %s", line);
+    call_active = false;
+}
+
+static bool modem_call_active(void) { return call_active; }
+
+static void call_dial_done(at_result_t res, const char *final_line, void *ctx)
+{
+    (void)ctx;
+    call_result_t r = CALL_FAILED;
+    switch (res) {
+        case AT_RES_OK:
+            r = CALL_ANSWERED;
+            break;
+        case AT_RES_FINAL:
+            r = strcmp(final_line, "BUSY") == 0        ? CALL_BUSY :
+                strcmp(final_line, "NO ANSWER") == 0   ? CALL_NO_ANSWER :
+                strcmp(final_line, "NO DIALTONE") == 0 ? CALL_NO_DIALTONE :
+                                                         CALL_NO_CARRIER;
+            break;
+        case AT_RES_TIMEOUT:
+            r = CALL_NO_ANSWER;
+            at_cmd_async("ATH", AT_PRIO_HIGH);   // la red no ha dicho nada: se corta
+            break;
+        default:
+            break;
+    }
+    if (call.abort) {
+        r = CALL_CANCELLED;
+        if (res == AT_RES_OK) at_cmd_async("ATH", AT_PRIO_HIGH);   // descolgó justo al cancelar
+    }
+    call_active = r == CALL_ANSWERED;
+    ESP_LOGI(MODEM_TAG, "Llamada a %s: %s en %lld ms", call.number, CALL_RESULT_NAME[r],
+             (long long)((esp_timer_get_time() - call.t0) / 1000));
+    if (call.cb) call.cb(r, call.ctx);
+}
+
+// Marca sin bloquear; cb recibe el resultado (descuelgue o fallo)
+static bool modem_call_start(const char *number, call_done_t cb, void *ctx)
+{
+    at_cmd_t c = {
+        .finals = CALL_FINALS, .timeout_ms = CALL_DIAL_TIMEOUT_MS, .prio = AT_PRIO_HIGH,
+        .on_done = call_dial_done,
+    };
+    int n = snprintf(c.cmd, sizeof c.cmd, "ATD%s;", number);
+    if (n <= 0 || n >= (int)sizeof c.cmd) return false;
+
+    snprintf(call.number, sizeof call.number, "%s", number);
+    call.cb = cb;
+    call.ctx = ctx;
+    call.abort = false;
+    call.t0 = esp_timer_get_time();
+    call_active = false;
+    return at_submit(&c);
+}
+
+// Corta la llamada en curso: aborta el ATD si aún suena y encola ATH
+static void modem_call_abort(void)
+{
+    call.abort = true;
+    call_active = false;
+    at_interrupt("ATD");
+    at_cmd_async("ATH", AT_PRIO_HIGH);
+}
+
+/* ────────────────────────── arranque ────────────────────────── */
+static int64_t s_modem_boot_t0;
+
+static void modem_boot_done(at_result_t res, const char *final_line, void *ctx)
+{
+    (void)final_line; (void)ctx;
+    ESP_LOGI(MODEM_TAG, "Módem %s en %lld ms (%lld ms desde el arranque)",
+             res == AT_RES_OK ? "listo" : "configurado con errores",
+             (long long)((esp_timer_get_time() - s_modem_boot_t0) / 1000),
+             (long long)(esp_timer_get_time() / 1000));
+    at_stats_log();
+    sms_inbox_request();   // SMS acumulados mientras estaba apagado
+}
+
+/* Enlace primero (síncrono, en urc_task: cambia los baudios y necesita
+ * que no haya nada más en vuelo); el resto se encola entero y at_task lo
+ * encadena sin pausas fijas. */
+static void modem_boot_sequence(void)
+{
+    static const char *const boot[] = {
+        "AT+CMGF=0",            // SMS en modo PDU (sms_pdu.h)
+        "AT+CPMS=\"ME\",\"ME\",\"ME\"",  // almacenamiento en memoria interna
+        "AT+CNMI=2,1,0,0,0",    // URC +CMTI
+        "AT+CLIP=1",
+        "AT+COLP=1",            // ATD espera al descuelgue (progreso de llamada)
+        "AT+CFGRI=1",           // RI también con los URC: despierta al ESP32 (power.h)
+        "AT+DDET=1,0",          // DTMF SIEMPRE con ,0
+    };
+    modem_link_probe();
+    at_cmd("ATE0", AT_TIMEOUT_MS);   // sin eco
+    modem_link_negotiate();
+    modem_link_flowctrl();
+    if (at_activity_hook) at_cmd_async("AT+CSCLK=1", AT_PRIO_NORMAL);   // duerme con DTR alto (power.h)
+
+    const int n = sizeof boot / sizeof boot[0];
+    for (int i = 0; i < n; i++) {
+        at_cmd_t c = {0};
+        snprintf(c.cmd, sizeof c.cmd, "%s", boot[i]);
+        if (i == n - 1) c.on_done = modem_boot_done;
+        at_submit(&c);
+    }
+}
+
+static void modem_boot(void)
+{
+    s_modem_boot_t0 = esp_timer_get_time();
+    urc_call(modem_boot_sequence);
 }
 
 /* ────────────────────────── tarea módem ────────────────────────── */
 void modem_task(void *arg)
 {
     (void)arg;
-    /* secuencia de arranque */
-    send_at_wait("AT");
-    send_at_wait("ATE0");                // sin eco
-    send_at_wait("AT+IPR=115200");       // fija baudios
-    send_at_wait("AT+IFC=0,0");          // sin RTS/CTS
-    send_at_wait("AT+CMGF=1");           // SMS texto
-    send_at_wait("AT+CNMI=2,1,0,0,0");   // URC +CMTI
-    send_at_wait("AT+CLIP=1");
-    send_at_wait("AT+DDET=1,0");         // DTMF SIEMPRE con ,0
-
-    char line[UART_BUF_LEN];
+    urc_register(URC_CMT,  handle_sms_push);
+    urc_register(URC_CMTI, handle_sms_notification);
+    urc_register(URC_CLIP, handle_call_notification);
+    urc_register(URC_DTMF, handle_dtmf_event);
+    urc_register(URC_NO_CARRIER, handle_call_ended);
 
-    while (true) {
-        if (read_line(line, sizeof line, 30000) <= 0) continue;
-        ESP_LOGI(MODEM_TAG, "<< %s", line);
+    modem_boot();
 
-        if (strstr(line, "+CMT:"))       handle_sms_push(line);
-        else if (strstr(line, "+CMTI:")) handle_sms_notification(line);
-        else if (strstr(line, "+CLIP:")) handle_call_notification(line);
-        else if (strstr(line, "+DTMF:")) handle_dtmf_event(line);
+    /* lector: cada línea va al comando en curso o a la cola de URC */
+    modem_line_t l;
+    while (true) {
+        if (!ml_next(&l, 30000)) continue;
+        if (at_activity_hook) at_activity_hook(false);
+        if (l.cont) {                        // resto de una línea larga ya entregada
+            ESP_LOGW(MODEM_TAG, "<< (cont) %s", l.text);
+            continue;
+        }
+        if (modem_trace_level >= MT_LEVEL_LOG) ESP_LOGI(MODEM_TAG, "<< %s", l.text);
+        if (urc_take_body(l.text)) continue;
+        int id = urc_lookup(l.text, l.len);
+        if (at_on_line(&l, id >= 0)) continue;
+        if (id >= 0) urc_feed(id, l.text, l.t_us);
     }
 }
 
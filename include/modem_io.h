@@ -0,0 +1,288 @@
+#ifndef MODEM_IO_H
+#define MODEM_IO_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/*
+ * Transporte del enlace con el módem.
+ *
+ * El ensamblador de líneas y el motor AT solo hablan con el módem a través
+ * de modem_io (esperar, ver cuánto hay, leer, escribir). Por defecto es el
+ * UART1 con su cola de eventos; mio_use_replay() lo cambia por una
+ * reproducción de una transcripción capturada con modem_trace_dump(),
+ * respetando los tiempos originales, para repetir una sesión real sin
+ * SIM800 ni red.
+ */
+
+extern const uart_port_t MODEM_UART;
+
+static const char *MIO_TAG = "MODEM_IO";
+
+typedef enum {
+    MIO_TIMEOUT = 0,
+    MIO_DATA,          // hay bytes (o puede haberlos) para leer
+    MIO_LOST,          // se han perdido bytes; descartar la línea a medias
+} mio_event_t;
+
+typedef struct {
+    const char  *name;
+    mio_event_t (*wait)(TickType_t ticks);
+    size_t      (*available)(void);
+    int         (*read)(uint8_t *dst, size_t n);
+    void        (*write)(const void *src, size_t n);
+} modem_io_t;
+
+/* ─────────────────────────── UART ─────────────────────────── */
+#define MIO_EVENT_QUEUE_LEN  20
+
+// Cola de eventos que rellena uart_driver_install() en modem_init()
+static QueueHandle_t g_modem_uart_queue = NULL;
+static uint32_t mio_uart_buffer_full = 0;
+
+static mio_event_t mio_uart_wait(TickType_t ticks)
+{
+    uart_event_t ev;
+    if (xQueueReceive(g_modem_uart_queue, &ev, ticks) != pdTRUE) return MIO_TIMEOUT;
+    if (ev.type == UART_FIFO_OVF) {
+        ESP_LOGW(MIO_TAG, "FIFO UART desbordada, se descarta la entrada");
+        uart_flush_input(MODEM_UART);
+        xQueueReset(g_modem_uart_queue);
+        return MIO_LOST;
+    }
+    if (ev.type == UART_BUFFER_FULL) mio_uart_buffer_full++;
+    return MIO_DATA;
+}
+
+static size_t mio_uart_available(void)
+{
+    size_t n = 0;
+    uart_get_buffered_data_len(MODEM_UART, &n);
+    return n;
+}
+
+static int mio_uart_read(uint8_t *dst, size_t n)
+{
+    return uart_read_bytes(MODEM_UART, dst, n, 0);
+}
+
+static void mio_uart_write(const void *src, size_t n)
+{
+    uart_write_bytes(MODEM_UART, src, n);
+}
+
+static const modem_io_t MIO_UART = {
+    .name = "uart", .wait = mio_uart_wait, .available = mio_uart_available,
+    .read = mio_uart_read, .write = mio_uart_write,
+};
+
+/* ─────────────────────── reproducción ───────────────────────
+ * Entrada: el texto de modem_trace_dump(), una línea por registro:
+ *   [    12.345] RX +CMTI: "ME",3\r\n
+ * Solo se reproducen los RX; lo que escribe el firmware se descarta (queda
+ * en la traza para compararlo con la sesión original). Cada RX se entrega
+ * cuando el firmware ha hecho tantas escrituras como TX lo precedían en
+ * la transcripción, con el mismo retraso tras la última: las respuestas
+ * siguen a su comando aunque este firmware vaya más lento o más rápido
+ * que el grabado. Lo anterior al primer TX sale con sus tiempos desde la
+ * primera espera.
+ */
+#define MIO_REPLAY_CHUNK   256
+#define MIO_REPLAY_WRITES  16         // instantes de escritura que se recuerdan
+#define MIO_TRACE_CHUNK    255        // trozo máximo de modem_trace: sigue en el registro siguiente
+
+static struct {
+    const char *p, *end;
+    // Transcripción, hasta el registro preparado
+    uint32_t    tx_seen;      // escrituras del firmware grabado
+    int64_t     tx_ms;        // cuándo fue la última
+    bool        tx_cont;      // el último TX era un trozo lleno
+    int64_t     first_ms;     // primer registro
+    bool        any;
+    // Este firmware
+    uint32_t    writes;
+    int64_t     write_us[MIO_REPLAY_WRITES];
+    int64_t     t0_us;        // primera espera
+    // Registro preparado
+    uint32_t    need;         // escrituras que lo preceden
+    int64_t     after_ms;     // retraso tras la última (o desde el principio)
+    int64_t     prev_due_us;  // el anterior: no se adelanta a él
+    uint8_t     chunk[MIO_REPLAY_CHUNK];
+    size_t      len, pos;
+    bool        ready;        // chunk preparado
+} mio_rp;
+
+// Registro "[  s.ms] dir datos": posición de los datos y su tiempo; 0 si no lo es
+static int mio_replay_record(const char *line, const char *dir, int64_t *t_ms)
+{
+    unsigned sec, ms;
+    char d[3];
+    int off = 0;
+    if (line[0] != '[' || sscanf(line, "[%u.%u] %2s%n", &sec, &ms, d, &off) != 3 || off == 0) return 0;
+    if (strcmp(d, dir) != 0) return 0;
+    *t_ms = (int64_t)sec * 1000 + ms;
+    return off + 1;                      // un espacio antes de los datos
+}
+
+// Deshace el escapado de modem_trace_dump() en mio_rp.chunk; devuelve los bytes
+static size_t mio_replay_unescape(const char *q, const char *eol)
+{
+    size_t n = 0;
+    for (; q < eol && n < sizeof mio_rp.chunk; q++) {
+        if (*q != '\\' || q + 1 >= eol) { mio_rp.chunk[n++] = *q; continue; }
+        q++;
+        if (*q == 'r')       mio_rp.chunk[n++] = '\r';
+        else if (*q == 'n')  mio_rp.chunk[n++] = '\n';
+        else if (*q == 'x' && q + 2 < eol) {
+            char hex[3] = { q[1], q[2], 0 };
+            mio_rp.chunk[n++] = (uint8_t)strtoul(hex, NULL, 16);
+            q += 2;
+        } else               mio_rp.chunk[n++] = *q;   // "\\\\"
+    }
+    return n;
+}
+
+// Decodifica el siguiente registro RX; false al final del texto
+static bool mio_replay_parse(void)
+{
+    while (mio_rp.p < mio_rp.end) {
+        const char *line = mio_rp.p;
+        const char *eol = memchr(line, '\n', mio_rp.end - line);
+        if (!eol) eol = mio_rp.end;
+        mio_rp.p = eol < mio_rp.end ? eol + 1 : eol;
+
+        int64_t t_ms;
+        int off = mio_replay_record(line, "RX", &t_ms);
+        bool tx = !off && (off = mio_replay_record(line, "TX", &t_ms)) != 0;
+        if (!off) continue;              // cabeceras del volcado u otras líneas
+        if (!mio_rp.any) {
+            mio_rp.any = true;
+            mio_rp.first_ms = t_ms;
+        }
+        size_t n = mio_replay_unescape(line + off, eol);
+        if (tx) {
+            if (!mio_rp.tx_cont) mio_rp.tx_seen++;
+            mio_rp.tx_ms = t_ms;
+            mio_rp.tx_cont = n == MIO_TRACE_CHUNK;
+            continue;
+        }
+        mio_rp.need = mio_rp.tx_seen;
+        mio_rp.after_ms = t_ms - (mio_rp.tx_seen ? mio_rp.tx_ms : mio_rp.first_ms);
+        mio_rp.len = n;
+        mio_rp.pos = 0;
+        mio_rp.ready = true;
+        return true;
+    }
+    return false;
+}
+
+// Cuándo toca el registro preparado; INT64_MAX si aún falta alguna escritura
+static int64_t mio_replay_due_us(void)
+{
+    uint32_t w = __atomic_load_n(&mio_rp.writes, __ATOMIC_ACQUIRE);
+    int64_t base;
+    if (mio_rp.need == 0)                         base = mio_rp.t0_us;
+    else if (w < mio_rp.need)                     return INT64_MAX;
+    else if (w - mio_rp.need >= MIO_REPLAY_WRITES) base = mio_rp.write_us[(w - 1) % MIO_REPLAY_WRITES];
+    else                                          base = mio_rp.write_us[(mio_rp.need - 1) % MIO_REPLAY_WRITES];
+    int64_t due = base + mio_rp.after_ms * 1000;
+    return due > mio_rp.prev_due_us ? due : mio_rp.prev_due_us;
+}
+
+static mio_event_t mio_replay_wait(TickType_t ticks)
+{
+    if (!mio_rp.t0_us) mio_rp.t0_us = esp_timer_get_time();
+    if (!mio_rp.ready && !mio_replay_parse()) {
+        vTaskDelay(ticks);
+        return MIO_TIMEOUT;
+    }
+    for (;;) {
+        int64_t due = mio_replay_due_us(), now = esp_timer_get_time();
+        if (due <= now) return MIO_DATA;
+        if (ticks == 0) return MIO_TIMEOUT;
+        // Sin la escritura que lo provoca, se mira en cada tick
+        TickType_t t = due == INT64_MAX ? 1 : pdMS_TO_TICKS((due - now) / 1000) + 1;
+        if (t > ticks) t = ticks;
+        vTaskDelay(t);
+        if (ticks != portMAX_DELAY) ticks -= t;
+    }
+}
+
+static size_t mio_replay_available(void)
+{
+    if (!mio_rp.ready || mio_replay_due_us() > esp_timer_get_time()) return 0;
+    return mio_rp.len - mio_rp.pos;
+}
+
+static int mio_replay_read(uint8_t *dst, size_t n)
+{
+    size_t left = mio_replay_available();
+    if (n > left) n = left;
+    if (n && mio_rp.pos == 0) mio_rp.prev_due_us = mio_replay_due_us();
+    memcpy(dst, mio_rp.chunk + mio_rp.pos, n);
+    mio_rp.pos += n;
+    if (mio_rp.pos >= mio_rp.len) {
+        mio_rp.ready = false;
+        if (mio_rp.p >= mio_rp.end) ESP_LOGI(MIO_TAG, "Reproducción terminada");
+    }
+    return n;
+}
+
+static void mio_replay_write(const void *src, size_t n)
+{
+    (void)src; (void)n;
+    uint32_t w = mio_rp.writes;            // solo escribe at_task
+    mio_rp.write_us[w % MIO_REPLAY_WRITES] = esp_timer_get_time();
+    __atomic_store_n(&mio_rp.writes, w + 1, __ATOMIC_RELEASE);
+}
+
+static const modem_io_t MIO_REPLAY = {
+    .name = "replay", .wait = mio_replay_wait, .available = mio_replay_available,
+    .read = mio_replay_read, .write = mio_replay_write,
+};
+
+/* ─────────────────────────── selección ─────────────────────────── */
+static const modem_io_t *modem_io = &MIO_UART;
+
+// Cambia el enlace por la transcripción; debe llamarse antes de modem_init()
+static void mio_use_replay(const char *transcript, size_t len)
+{
+    memset(&mio_rp, 0, sizeof mio_rp);
+    mio_rp.p = transcript;
+    mio_rp.end = transcript + len;
+    modem_io = &MIO_REPLAY;
+    ESP_LOGW(MIO_TAG, "Enlace del módem: reproducción de %u bytes de traza", (unsigned)len);
+}
+
+// Carga la transcripción de un fichero (p.ej. de la SD) y la reproduce; false si no se pudo
+static bool mio_replay_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGE(MIO_TAG, "No puedo abrir %s: sigue el UART", path);
+        return false;
+    }
+    long len = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    char *text = len > 0 ? malloc(len + 1) : NULL;   // se queda mientras dure la reproducción
+    bool ok = text && fseek(f, 0, SEEK_SET) == 0 && fread(text, 1, len, f) == (size_t)len;
+    if (ok) text[len] = '\0';                        // sscanf no se sale en la última línea
+    fclose(f);
+    if (!ok) {
+        ESP_LOGE(MIO_TAG, "%s: no se pudo leer (%ld bytes): sigue el UART", path, len);
+        free(text);
+        return false;
+    }
+    mio_use_replay(text, len);
+    return true;
+}
+
+#endif // MODEM_IO_H
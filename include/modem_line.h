@@ -0,0 +1,191 @@
+#ifndef MODEM_LINE_H
+#define MODEM_LINE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "modem_trace.h"
+#include "modem_io.h"
+
+/*
+ * Ensamblador de líneas del módem.
+ *
+ * El driver UART avisa por su cola de eventos (detección de patrón '\n' o
+ * timeout de RX) y aquí se lee de una vez todo lo pendiente en un único
+ * buffer. Las líneas se entregan como puntero dentro de ese buffer, sin
+ * copiar; siguen siendo válidas hasta la siguiente llamada a ml_next().
+ * Una línea más larga que ML_BUF_LEN se entrega por trozos marcados
+ * (partial / cont) en vez de cortarse en silencio. Los bytes llegan por
+ * modem_io (UART o reproducción de una traza).
+ */
+
+extern const uart_port_t MODEM_UART;
+
+static const char *ML_TAG = "MODEM_LINE";
+
+#ifndef ML_BUF_LEN
+#define ML_BUF_LEN        1024
+#endif
+#define ML_STATS_EVERY      100   // cada cuántas líneas se vuelcan estadísticas
+
+typedef struct {
+    char    *text;      // línea sin "\r\n", terminada en '\0'
+    int      len;
+    bool     partial;   // la línea sigue en la siguiente entrega
+    bool     cont;      // este trozo continúa una línea anterior
+    int64_t  t_us;      // instante en que se completó
+} modem_line_t;
+
+typedef struct {
+    uint32_t lines;
+    uint32_t driver_calls;   // uart_get_buffered_data_len + uart_read_bytes
+    uint32_t long_lines;
+    uint32_t overflows;      // FIFO/buffer del driver desbordado
+    int64_t  busy_us;        // CPU fuera de la espera en la cola
+} ml_stats_t;
+
+// Lo activa el motor AT mientras espera el '>' de AT+CMGS, que llega sin '\n'
+static volatile bool ml_prompt_armed = false;
+static char ml_prompt_text[] = ">";
+
+static struct {
+    char       buf[ML_BUF_LEN + 1];
+    int        len;        // bytes válidos
+    int        consumed;   // bytes ya entregados, se compactan al volver
+    size_t     pending;    // bytes que quedaron en el driver sin caber aquí
+    bool       in_long;    // entregando los trozos de una línea larga
+    ml_stats_t stats;
+} ml;
+
+static void ml_init(void)
+{
+    uart_enable_pattern_det_baud_intr(MODEM_UART, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(MODEM_UART, MIO_EVENT_QUEUE_LEN);
+    memset(&ml, 0, sizeof ml);
+}
+
+static void ml_stats_log(void)
+{
+    uint32_t n = ml.stats.lines ? ml.stats.lines : 1;
+    ESP_LOGI(ML_TAG, "%u líneas: %u.%02u llamadas driver/línea, %lld us CPU/línea, "
+             "%u largas, %u desbordes",
+             (unsigned)ml.stats.lines,
+             (unsigned)(ml.stats.driver_calls / n),
+             (unsigned)((ml.stats.driver_calls % n) * 100 / n),
+             (long long)(ml.stats.busy_us / n),
+             (unsigned)ml.stats.long_lines, (unsigned)ml.stats.overflows);
+}
+
+static void ml_compact(void)
+{
+    if (ml.consumed == 0) return;
+    ml.len -= ml.consumed;
+    if (ml.len > 0) memmove(ml.buf, ml.buf + ml.consumed, ml.len);
+    ml.consumed = 0;
+}
+
+// Vuelca al buffer lo que tenga el driver; espera un evento si no hay nada
+static bool ml_fill(TickType_t wait, int64_t *t_wake)
+{
+    if (ml.pending == 0) {
+        mio_event_t ev = modem_io->wait(wait);
+        if (ev == MIO_TIMEOUT) return false;
+        *t_wake = esp_timer_get_time();
+        if (ev == MIO_LOST) {
+            // Se han perdido bytes: la línea a medias ya no es fiable
+            ml.stats.overflows++;
+            ml.len = ml.consumed = 0;
+            ml.in_long = false;
+            return true;
+        }
+        ml.stats.driver_calls++;
+        ml.pending = modem_io->available();
+    } else {
+        *t_wake = esp_timer_get_time();
+    }
+    size_t room = ML_BUF_LEN - ml.len;
+    size_t want = ml.pending < room ? ml.pending : room;
+    if (want == 0) return true;
+    int rd = modem_io->read((uint8_t *)ml.buf + ml.len, want);
+    ml.stats.driver_calls++;
+    if (rd > 0) {
+        modem_trace(MT_RX, ml.buf + ml.len, rd);
+        ml.len += rd;
+    }
+    ml.pending = (rd > 0 && (size_t)rd < ml.pending) ? ml.pending - rd : 0;
+    return true;
+}
+
+static void ml_deliver(modem_line_t *out, int n, bool partial)
+{
+    out->text    = ml.buf;
+    out->len     = n;
+    out->partial = partial;
+    out->cont    = ml.in_long;
+    out->t_us    = esp_timer_get_time();
+    ml.in_long   = partial;
+    if (++ml.stats.lines % ML_STATS_EVERY == 0) ml_stats_log();
+}
+
+/*
+ * Siguiente línea no vacía del módem. Devuelve false si vence timeout_ms.
+ */
+static bool ml_next(modem_line_t *out, int timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int64_t t_busy = esp_timer_get_time();
+
+    ml_compact();
+    for (;;) {
+        if (ml_prompt_armed && ml.len > 0 && ml.buf[0] == '>') {
+            ml_prompt_armed = false;
+            ml.consumed = (ml.len > 1 && ml.buf[1] == ' ') ? 2 : 1;
+            out->text = ml_prompt_text;
+            out->len = 1;
+            out->partial = out->cont = false;
+            out->t_us = esp_timer_get_time();
+            return true;
+        }
+        char *nl = ml.len > 0 ? memchr(ml.buf, '\n', ml.len) : NULL;
+        if (nl) {
+            int n = nl - ml.buf;
+            ml.consumed = n + 1;
+            while (n > 0 && ml.buf[n - 1] == '\r') n--;   // el eco del SIM800 deja "AT\r\r\n"
+            ml.buf[n] = '\0';
+            if (n > 0 || ml.in_long) {
+                ml_deliver(out, n, false);
+                ml.stats.busy_us += esp_timer_get_time() - t_busy;
+                return true;
+            }
+            ml_compact();   // línea vacía ("\r\n" entre URCs)
+            continue;
+        }
+        if (ml.len == ML_BUF_LEN) {
+            if (!ml.in_long) {
+                ml.stats.long_lines++;
+                ESP_LOGW(ML_TAG, "Línea de más de %d bytes, se entrega por trozos", ML_BUF_LEN);
+            }
+            ml.consumed = ml.len;
+            ml.buf[ml.len] = '\0';
+            ml_deliver(out, ml.len, true);
+            ml.stats.busy_us += esp_timer_get_time() - t_busy;
+            return true;
+        }
+
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) break;
+        ml.stats.busy_us += esp_timer_get_time() - t_busy;
+        if (!ml_fill(pdMS_TO_TICKS(left_us / 1000) + 1, &t_busy)) return false;
+    }
+    ml.stats.busy_us += esp_timer_get_time() - t_busy;
+    return false;
+}
+
+#endif // MODEM_LINE_H
@@ -0,0 +1,144 @@
+#ifndef MODEM_LINK_H
+#define MODEM_LINK_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "at_engine.h"
+
+/*
+ * Puesta en marcha del enlace UART con el SIM800.
+ *
+ * Busca la velocidad a la que responde el módem, sube a la más alta de
+ * MODEM_BAUD_CANDIDATES que supere MODEM_LINK_CHECKS intercambios "AT"
+ * seguidos y, si algo falla, vuelve a la anterior. Con MODEM_HW_FLOWCTRL
+ * activa RTS/CTS en ambos extremos para no perder ráfagas mientras las
+ * tareas están ocupadas.
+ */
+
+extern const uart_port_t MODEM_UART;
+
+static const char *LINK_TAG = "MODEM_LINK";
+
+#ifndef MODEM_BAUD
+#define MODEM_BAUD          115200     // velocidad de arranque
+#endif
+#ifndef MODEM_HW_FLOWCTRL
+#define MODEM_HW_FLOWCTRL   0          // 1 = RTS/CTS (requiere cablear los pines)
+#endif
+#define MODEM_RTS_PIN       GPIO_NUM_0
+#define MODEM_CTS_PIN       GPIO_NUM_1
+#define MODEM_LINK_CHECKS   3
+#define MODEM_LINK_AT_MS    300
+#define MODEM_LINK_BACK_TRIES 20       // para devolver al módem a la velocidad anterior
+#define MODEM_RX_FLOW_THRESH 100       // bytes en la FIFO antes de bajar RTS
+
+static const uint32_t MODEM_BAUD_CANDIDATES[] = { 460800, 230400, 115200 };
+
+static uint32_t modem_link_baud = MODEM_BAUD;
+
+static void link_set_baud(uint32_t baud)
+{
+    uart_wait_tx_done(MODEM_UART, pdMS_TO_TICKS(100));
+    uart_set_baudrate(MODEM_UART, baud);
+    modem_link_baud = baud;
+    vTaskDelay(pdMS_TO_TICKS(20));   // el SIM800 tarda en cambiar
+}
+
+// n intercambios "AT" seguidos sin fallo
+static bool link_check(int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (at_cmd("AT", MODEM_LINK_AT_MS) != AT_RES_OK) return false;
+    }
+    return true;
+}
+
+// Encuentra la velocidad actual del módem (p.ej. tras un reinicio solo del ESP32)
+static bool modem_link_probe(void)
+{
+    if (link_check(2)) return true;
+    for (size_t i = 0; i < sizeof MODEM_BAUD_CANDIDATES / sizeof MODEM_BAUD_CANDIDATES[0]; i++) {
+        if (MODEM_BAUD_CANDIDATES[i] == modem_link_baud) continue;
+        link_set_baud(MODEM_BAUD_CANDIDATES[i]);
+        if (link_check(2)) {
+            ESP_LOGW(LINK_TAG, "Módem encontrado a %u baudios", (unsigned)modem_link_baud);
+            return true;
+        }
+    }
+    link_set_baud(MODEM_BAUD);
+    ESP_LOGE(LINK_TAG, "El módem no responde a ninguna velocidad");
+    return false;
+}
+
+static bool link_try_baud(uint32_t baud)
+{
+    uint32_t prev = modem_link_baud;
+    char cmd[24];
+    snprintf(cmd, sizeof cmd, "AT+IPR=%u", (unsigned)baud);
+    if (at_cmd(cmd, 1000) != AT_RES_OK) return false;
+
+    link_set_baud(baud);
+    if (link_check(MODEM_LINK_CHECKS)) return true;
+
+    // ¿Ha cambiado el módem? Si responde a la velocidad anterior, no lo hizo
+    link_set_baud(prev);
+    if (link_check(1)) return false;
+
+    // Cambió pero el enlace no aguanta: se le devuelve a la anterior. El
+    // AT+IPR tiene que cruzar el enlace malo, así que se insiste
+    snprintf(cmd, sizeof cmd, "AT+IPR=%u", (unsigned)prev);
+    for (int i = 0; i < MODEM_LINK_BACK_TRIES; i++) {
+        link_set_baud(baud);
+        at_cmd(cmd, MODEM_LINK_AT_MS);
+        link_set_baud(prev);
+        if (link_check(1)) return false;
+    }
+    ESP_LOGE(LINK_TAG, "Sin enlace tras volver a %u, se busca al módem", (unsigned)prev);
+    modem_link_probe();
+    return false;
+}
+
+static void modem_link_flowctrl(void)
+{
+#if MODEM_HW_FLOWCTRL
+    if (at_cmd("AT+IFC=2,2", 1000) == AT_RES_OK) {
+        uart_wait_tx_done(MODEM_UART, pdMS_TO_TICKS(100));
+        uart_set_pin(MODEM_UART, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE,
+                     MODEM_RTS_PIN, MODEM_CTS_PIN);
+        uart_set_hw_flow_ctrl(MODEM_UART, UART_HW_FLOWCTRL_CTS_RTS, MODEM_RX_FLOW_THRESH);
+        if (link_check(1)) {
+            ESP_LOGI(LINK_TAG, "Control de flujo RTS/CTS activo");
+            return;
+        }
+        uart_set_hw_flow_ctrl(MODEM_UART, UART_HW_FLOWCTRL_DISABLE, 0);
+        ESP_LOGW(LINK_TAG, "RTS/CTS no responde, se desactiva");
+    }
+#endif
+    at_cmd("AT+IFC=0,0", 1000);   // sin RTS/CTS
+}
+
+// Velocidad más alta que aguante el enlace; devuelve la elegida
+static uint32_t modem_link_negotiate(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    for (size_t i = 0; i < sizeof MODEM_BAUD_CANDIDATES / sizeof MODEM_BAUD_CANDIDATES[0]; i++) {
+        uint32_t b = MODEM_BAUD_CANDIDATES[i];
+        if (b == modem_link_baud) break;   // las siguientes son más lentas
+        if (link_try_baud(b)) break;
+        ESP_LOGW(LINK_TAG, "%u baudios no superan la prueba", (unsigned)b);
+    }
+    ESP_LOGI(LINK_TAG, "Enlace a %u baudios (negociado en %lld ms, %u desbordes RX)",
+             (unsigned)modem_link_baud, (long long)((esp_timer_get_time() - t0) / 1000),
+             (unsigned)ml.stats.overflows);
+    return modem_link_baud;
+}
+
+#endif // MODEM_LINK_H
@@ -0,0 +1,134 @@
+#ifndef MODEM_TRACE_H
+#define MODEM_TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Traza binaria del tráfico con el módem.
+ *
+ * Cada trozo TX/RX se guarda en un anillo en RAM como registro
+ * [t_ms:4][dir:1][len:1][datos], pisando los más antiguos. Registrar es
+ * una copia de memoria bajo un spinlock; no se formatea ni se imprime
+ * nada hasta que se pide el volcado.
+ */
+
+#define MT_RING_SIZE   8192          // potencia de 2
+#define MT_HDR         6
+#define MT_CHUNK_MAX   255
+
+typedef enum { MT_RX = 0, MT_TX = 1 } mt_dir_t;
+
+typedef enum {
+    MT_LEVEL_OFF  = 0,   // no se registra nada
+    MT_LEVEL_RING = 1,   // solo el anillo (por defecto)
+    MT_LEVEL_LOG  = 2,   // anillo + ESP_LOGI de cada línea y comando
+} mt_level_t;
+
+static volatile uint8_t modem_trace_level = MT_LEVEL_RING;
+
+static portMUX_TYPE mt_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static struct {
+    uint8_t  buf[MT_RING_SIZE];
+    uint32_t head, tail;       // contadores libres; posición = & (MT_RING_SIZE-1)
+    uint32_t records;
+    uint32_t overwritten;      // registros pisados por falta de sitio
+    uint32_t bytes[2];         // RX, TX
+} mt;
+
+static void mt_copy_in(uint32_t pos, const void *src, uint32_t n)
+{
+    uint32_t off = pos & (MT_RING_SIZE - 1);
+    uint32_t first = MT_RING_SIZE - off < n ? MT_RING_SIZE - off : n;
+    memcpy(mt.buf + off, src, first);
+    memcpy(mt.buf, (const uint8_t *)src + first, n - first);
+}
+
+static void mt_copy_out(uint32_t pos, void *dst, uint32_t n)
+{
+    uint32_t off = pos & (MT_RING_SIZE - 1);
+    uint32_t first = MT_RING_SIZE - off < n ? MT_RING_SIZE - off : n;
+    memcpy(dst, mt.buf + off, first);
+    memcpy((uint8_t *)dst + first, mt.buf, n - first);
+}
+
+static void modem_trace(mt_dir_t dir, const void *data, int len)
+{
+    if (modem_trace_level == MT_LEVEL_OFF || len <= 0) return;
+    uint32_t t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    const uint8_t *p = data;
+    while (len > 0) {
+        uint8_t n = len > MT_CHUNK_MAX ? MT_CHUNK_MAX : len;
+        uint8_t hdr[MT_HDR] = { t_ms, t_ms >> 8, t_ms >> 16, t_ms >> 24, dir, n };
+        portENTER_CRITICAL(&mt_mux);
+        while (mt.head - mt.tail + MT_HDR + n > MT_RING_SIZE) {
+            uint8_t old_len = mt.buf[(mt.tail + 5) & (MT_RING_SIZE - 1)];
+            mt.tail += MT_HDR + old_len;
+            mt.overwritten++;
+        }
+        mt_copy_in(mt.head, hdr, MT_HDR);
+        mt_copy_in(mt.head + MT_HDR, p, n);
+        mt.head += MT_HDR + n;
+        mt.records++;
+        mt.bytes[dir] += n;
+        portEXIT_CRITICAL(&mt_mux);
+        p += n;
+        len -= n;
+    }
+}
+
+// Volcado legible por la consola serie: "[   12.345] TX AT+CMGF=1\r"
+static void modem_trace_dump(void)
+{
+    uint8_t hdr[MT_HDR], data[MT_CHUNK_MAX];
+    uint32_t pos, head;
+    portENTER_CRITICAL(&mt_mux);
+    pos = mt.tail;
+    head = mt.head;
+    portEXIT_CRITICAL(&mt_mux);
+
+    printf("---- traza módem: %u registros, %u pisados ----\n",
+           (unsigned)mt.records, (unsigned)mt.overwritten);
+    while (pos != head) {
+        portENTER_CRITICAL(&mt_mux);
+        if ((int32_t)(pos - mt.tail) < 0) pos = mt.tail;   // lo han pisado mientras tanto
+        mt_copy_out(pos, hdr, MT_HDR);
+        mt_copy_out(pos + MT_HDR, data, hdr[5]);
+        portEXIT_CRITICAL(&mt_mux);
+        pos += MT_HDR + hdr[5];
+
+        uint32_t t = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (uint32_t)hdr[3] << 24;
+        printf("[%6u.%03u] %s ", (unsigned)(t / 1000), (unsigned)(t % 1000), hdr[4] == MT_TX ? "TX" : "RX");
+        for (int i = 0; i < hdr[5]; i++) {
+            uint8_t c = data[i];
+            if (c == '\\')     printf("\\\\");
+            else if (c == '\r') printf("\\r");
+            else if (c == '\n') printf("\\n");
+            else if (isprint(c)) putchar(c);
+            else                printf("\\x%02X", c);
+        }
+        putchar('\n');
+    }
+    printf("---- fin traza ----\n");
+}
+
+// Resumen corto (cabe en un SMS)
+static int modem_trace_summary(char *out, size_t len)
+{
+    portENTER_CRITICAL(&mt_mux);
+    uint32_t used = mt.head - mt.tail, rec = mt.records, lost = mt.overwritten;
+    uint32_t rx = mt.bytes[MT_RX], tx = mt.bytes[MT_TX];
+    portEXIT_CRITICAL(&mt_mux);
+    return snprintf(out, len, "Traza nivel %u: %u reg, RX %u B, TX %u B, %u pisados, anillo %u/%u B",
+                    (unsigned)modem_trace_level, (unsigned)rec, (unsigned)rx, (unsigned)tx,
+                    (unsigned)lost, (unsigned)used, (unsigned)MT_RING_SIZE);
+}
+
+#endif // MODEM_TRACE_H
@@ -0,0 +1,223 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "at_engine.h"
+#include "modem.h"
+
+/*
+ * Ahorro de energía: light sleep automático (esp_pm + tickless idle) y
+ * sueño del SIM800 por DTR (AT+CSCLK=1).
+ *
+ * El chip duerme solo cuando ninguna tarea tiene trabajo y nadie sostiene
+ * un bloqueo de esp_pm. Le despiertan:
+ *   - sensor, botón y lector, por nivel (ext1: son pines LP). El flanco lo
+ *     sigue atendiendo su ISR normal al despertar.
+ *   - RI del módem (llamada, SMS y, con AT+CFGRI=1, los URC) y el propio
+ *     RX del UART.
+ * Mientras el enlace con el módem está "despierto" (DTR bajo) se sostiene
+ * un bloqueo NO_LIGHT_SLEEP; caduca POWER_MODEM_IDLE_MS después de la
+ * última línea o comando, salvo que at_task siga ocupado o haya llamada.
+ */
+
+extern const uart_port_t MODEM_UART;
+
+static const char *PWR_TAG = "POWER";
+
+// RI en GPIO13, el D+ del USB-Serial-JTAG: el 14 no sale a los conectores de
+// la ESP32-C6-DevKitC-1 y no queda otro libre. Por eso el sdkconfig apaga el
+// USB-Serial-JTAG (CONFIG_USJ_ENABLE_USB_SERIAL_JTAG y la consola secundaria);
+// la consola y la grabación van por UART0
+#define MODEM_RI_PIN          GPIO_NUM_13   // RI del SIM800 (activo bajo)
+#define MODEM_DTR_PIN         GPIO_NUM_15   // DTR del SIM800: alto = puede dormir
+#define POWER_CPU_MAX_MHZ     160
+#define POWER_CPU_MIN_MHZ     40
+#define POWER_MODEM_IDLE_MS   1000          // sin tráfico → DTR alto y a dormir
+#define POWER_DTR_WAKE_MS     50            // el SIM800 atiende ~50 ms tras bajar DTR
+#define POWER_UART_WAKE_EDGES 3             // caben en el "\r\n" que abre cada URC
+
+typedef struct {
+    uint32_t modem_wakeups;   // enlace dormido → despierto
+    uint32_t ri_wakeups;
+    int64_t  awake_us;        // tiempo total con el enlace despierto
+} power_stats_t;
+
+static struct {
+    esp_pm_lock_handle_t lock;      // NO_LIGHT_SLEEP mientras el enlace está despierto
+    TimerHandle_t        idle;
+    portMUX_TYPE         mux;
+    volatile bool        awake;
+    int64_t              t_wake_us;
+    uint64_t             ext1_high;
+    bool                 enabled;
+    power_stats_t        stats;
+} s_power = { .mux = portMUX_INITIALIZER_UNLOCKED };
+
+/*
+ * Marca actividad en el enlace con el módem. Si estaba dormido baja DTR y
+ * toma el bloqueo; en todo caso reinicia la cuenta de inactividad.
+ * Devuelve true si lo ha despertado. Vale desde una ISR.
+ */
+static bool power_modem_touch(void)
+{
+    if (!s_power.enabled) return false;
+    bool woke = false;
+    portENTER_CRITICAL_SAFE(&s_power.mux);
+    if (!s_power.awake) {
+        s_power.awake = true;
+        s_power.t_wake_us = esp_timer_get_time();
+        s_power.stats.modem_wakeups++;
+        esp_pm_lock_acquire(s_power.lock);
+        gpio_set_level(MODEM_DTR_PIN, 0);
+        woke = true;
+    }
+    portEXIT_CRITICAL_SAFE(&s_power.mux);
+
+    if (xPortInIsrContext()) {
+        BaseType_t hpw = pdFALSE;
+        xTimerResetFromISR(s_power.idle, &hpw);
+        if (hpw) portYIELD_FROM_ISR();
+    } else {
+        xTimerReset(s_power.idle, 0);
+    }
+    return woke;
+}
+
+// Gancho del motor AT: antes de enviar (at_task) o al recibir una línea (modem_task)
+static void power_at_activity(bool tx)
+{
+    bool woke = power_modem_touch();
+    if (woke && tx) vTaskDelay(pdMS_TO_TICKS(POWER_DTR_WAKE_MS));   // el primero tras dormir espera
+}
+
+static void power_idle_timeout(TimerHandle_t t)
+{
+    if (!at_idle() || modem_call_active()) {
+        xTimerReset(t, 0);
+        return;
+    }
+    portENTER_CRITICAL(&s_power.mux);
+    bool was = s_power.awake;
+    if (was) {
+        s_power.awake = false;
+        s_power.stats.awake_us += esp_timer_get_time() - s_power.t_wake_us;
+        gpio_set_level(MODEM_DTR_PIN, 1);
+        esp_pm_lock_release(s_power.lock);
+    }
+    portEXIT_CRITICAL(&s_power.mux);
+
+    // RI vuelve a avisar cuando ya ha soltado la línea
+    if (gpio_get_level(MODEM_RI_PIN)) gpio_intr_enable(MODEM_RI_PIN);
+    else xTimerReset(t, 0);
+}
+
+// RI baja con cada llamada y SMS, y con los demás URC por AT+CFGRI=1 (arranque
+// en modem.h): se despierta el enlace antes de que llegue el texto
+static void IRAM_ATTR power_isr_ri(void *arg)
+{
+    (void)arg;
+    gpio_intr_disable(MODEM_RI_PIN);   // el nivel de despertar la dejaría disparando
+    s_power.stats.ri_wakeups++;
+    power_modem_touch();
+}
+
+/*
+ * Despertar por el nivel de un pin LP (0..7). Se puede volver a llamar
+ * para cambiar el nivel, p.ej. el lector despierta con el contrario al
+ * aceptado.
+ */
+static esp_err_t power_wake_on_level(gpio_num_t pin, bool high)
+{
+    uint64_t bit = 1ULL << pin;
+    if (high) s_power.ext1_high |= bit;
+    else      s_power.ext1_high &= ~bit;
+    if (!s_power.enabled) return ESP_OK;
+    esp_sleep_disable_ext1_wakeup_io(bit);
+    return esp_sleep_enable_ext1_wakeup_with_level_mask(bit, s_power.ext1_high & bit);
+}
+
+static void power_stats_log(void)
+{
+    if (!s_power.enabled) return;
+    int64_t up_s = esp_timer_get_time() / 1000000;
+    int64_t awake = s_power.stats.awake_us;
+    if (s_power.awake) awake += esp_timer_get_time() - s_power.t_wake_us;
+    ESP_LOGI(PWR_TAG, "Enlace módem: %u despertares (%u por RI, %lld/h), despierto %lld s de %lld s",
+             (unsigned)s_power.stats.modem_wakeups, (unsigned)s_power.stats.ri_wakeups,
+             (long long)(up_s ? (int64_t)s_power.stats.modem_wakeups * 3600 / up_s : 0),
+             (long long)(awake / 1000000), (long long)up_s);
+}
+
+/*
+ * Activa DFS + light sleep automático, DTR y RI. Antes de modem_init() (el
+ * arranque del módem solo pide AT+CSCLK=1 si DTR está gobernado) y tras
+ * gpio_install_isr_service(). Los pines de alerta se añaden después con
+ * power_wake_on_level() y el RX del módem con power_uart_wake_init().
+ */
+static esp_err_t power_init(void)
+{
+    esp_pm_config_t pm = {
+        .max_freq_mhz       = POWER_CPU_MAX_MHZ,
+        .min_freq_mhz       = POWER_CPU_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(PWR_TAG, "Sin gestión de energía (%s): ¿CONFIG_PM_ENABLE?", esp_err_to_name(err));
+        return err;
+    }
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "modem_link", &s_power.lock));
+    s_power.idle = xTimerCreate("pwr_idle", pdMS_TO_TICKS(POWER_MODEM_IDLE_MS), pdFALSE, NULL,
+                                power_idle_timeout);
+
+    // DTR: arranca bajo (módem atento) hasta el primer periodo sin tráfico
+    gpio_config_t dtr = { .pin_bit_mask = 1ULL << MODEM_DTR_PIN, .mode = GPIO_MODE_OUTPUT };
+    gpio_config(&dtr);
+    gpio_set_level(MODEM_DTR_PIN, 0);
+    s_power.awake = true;
+    s_power.t_wake_us = esp_timer_get_time();
+    esp_pm_lock_acquire(s_power.lock);
+    s_power.enabled = true;
+    xTimerStart(s_power.idle, 0);
+
+    gpio_config_t ri = {
+        .pin_bit_mask = 1ULL << MODEM_RI_PIN,
+        .mode         = GPIO_MODE_INPUT,
+        .pull_up_en   = GPIO_PULLUP_ENABLE,
+        .intr_type    = GPIO_INTR_NEGEDGE,
+    };
+    gpio_config(&ri);
+    gpio_wakeup_enable(MODEM_RI_PIN, GPIO_INTR_LOW_LEVEL);
+    gpio_isr_handler_add(MODEM_RI_PIN, power_isr_ri, NULL);
+    esp_sleep_enable_gpio_wakeup();
+
+    at_activity_hook = power_at_activity;
+    ESP_LOGI(PWR_TAG, "Light sleep automático (%d-%d MHz), módem duerme tras %d ms sin tráfico",
+             POWER_CPU_MIN_MHZ, POWER_CPU_MAX_MHZ, POWER_MODEM_IDLE_MS);
+    return ESP_OK;
+}
+
+// Tras modem_init(): el UART ya tiene reloj y configuración
+static void power_uart_wake_init(void)
+{
+    if (!s_power.enabled) return;
+    if (uart_set_wakeup_threshold(MODEM_UART, POWER_UART_WAKE_EDGES) != ESP_OK ||
+        esp_sleep_enable_uart_wakeup(MODEM_UART) != ESP_OK) {
+        ESP_LOGW(PWR_TAG, "El UART del módem no despierta al chip; solo RI");
+    }
+}
+
+#endif // POWER_H
@@ -0,0 +1,115 @@
+#ifndef PROMPT_BUNDLE_H
+#define PROMPT_BUNDLE_H
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Paquete de locuciones grabado en la partición "prompts".
+ *
+ *   cabecera (16 B) | índice: count x pb_entry_t (44 B) | audio, cada uno alineado a 4
+ *
+ * El audio va sin cabecera WAV: PCM tal cual lo reproduce el I2S, o
+ * bloques IMA-ADPCM que audio_out decodifica al vuelo. Con la partición
+ * mapeada en memoria se entrega directamente desde la flash. El CRC
+ * cubre el índice; el audio no se recorre al arrancar. Lo genera
+ * tools/pack_prompts.py. No depende de ESP-IDF.
+ */
+
+#define PB_MAGIC        0x314D5250u    // "PRM1"
+#define PB_VERSION      2              // 2: block_align en la entrada (ADPCM)
+#define PB_NAME_MAX     24
+#define PB_MAX_COUNT    64
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t total;         // bytes del paquete entero (cabecera incluida)
+    uint32_t crc;           // CRC-32 del índice
+} pb_header_t;
+
+typedef struct {
+    char     name[PB_NAME_MAX];   // nombre de fichero ("menu.wav"), terminado en '\0'
+    uint32_t off;                 // desde el principio del paquete
+    uint32_t len;                 // bytes de audio
+    uint32_t rate;
+    uint16_t channels;
+    uint16_t format;              // WAV_FMT_* (wav.h)
+    uint16_t block_align;         // PCM: bytes por trama; ADPCM: bytes por bloque
+    uint16_t reserved;
+} pb_entry_t;
+
+_Static_assert(sizeof(pb_header_t) == 16, "cabecera de 16 bytes");
+_Static_assert(sizeof(pb_entry_t) == 44, "entrada de 44 bytes");
+
+typedef enum {
+    PB_OK = 0,
+    PB_ERR_MAGIC,           // partición vacía o de otra cosa
+    PB_ERR_VERSION,
+    PB_ERR_SIZE,            // no cabe en la partición
+    PB_ERR_CRC,
+    PB_ERR_ENTRY,           // una entrada se sale del paquete
+} pb_status_t;
+
+static const char *const PB_STATUS_NAME[] = { "ok", "magic", "versión", "tamaño", "crc", "entrada" };
+
+// CRC-32 (IEEE 802.3, reflejado), igual que el de pack_prompts.py (zlib.crc32)
+static uint32_t pb_crc32(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static const pb_entry_t *pb_index(const void *base)
+{
+    return (const pb_entry_t *)((const uint8_t *)base + sizeof(pb_header_t));
+}
+
+/*
+ * Valida cabecera e índice de un paquete de como mucho avail bytes
+ * (basta con la cabecera para saber cuánto hay que mapear: hdr->total).
+ */
+static pb_status_t pb_check(const void *base, size_t avail)
+{
+    const pb_header_t *h = (const pb_header_t *)base;
+    if (avail < sizeof *h || h->magic != PB_MAGIC) return PB_ERR_MAGIC;
+    if (h->version != PB_VERSION) return PB_ERR_VERSION;
+    size_t index_len = (size_t)h->count * sizeof(pb_entry_t);
+    if (h->count > PB_MAX_COUNT || h->total > avail || sizeof *h + index_len > h->total) return PB_ERR_SIZE;
+    if (pb_crc32(pb_index(base), index_len) != h->crc) return PB_ERR_CRC;
+    for (uint16_t i = 0; i < h->count; i++) {
+        const pb_entry_t *e = &pb_index(base)[i];
+        if (memchr(e->name, '\0', sizeof e->name) == NULL) return PB_ERR_ENTRY;
+        if (e->off > h->total || e->len > h->total - e->off || (e->off & 3)) return PB_ERR_ENTRY;
+    }
+    return PB_OK;
+}
+
+// Busca por nombre (sin distinguir mayúsculas, como FAT); NULL si no está
+static const pb_entry_t *pb_find(const void *base, const char *name)
+{
+    const pb_header_t *h = (const pb_header_t *)base;
+    for (uint16_t i = 0; i < h->count; i++) {
+        const pb_entry_t *e = &pb_index(base)[i];
+        const char *a = e->name, *b = name;
+        while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) a++, b++;
+        if (*a == '\0' && *b == '\0') return e;
+    }
+    return NULL;
+}
+
+static inline const uint8_t *pb_data(const void *base, const pb_entry_t *e)
+{
+    return (const uint8_t *)base + e->off;
+}
+
+#endif // PROMPT_BUNDLE_H
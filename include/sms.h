@@ -11,6 +11,12 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 #include "secrets.h"
+#include "at_engine.h"
+#include "config_store.h"
+#include "event_log.h"
+#include "sms_outbox.h"
+#include "sms_pdu.h"
+#include "urc.h"
 
 // === Hook: prueba de sistema ( en main.c) ===
 #include <stdint.h>
@@ -47,32 +53,14 @@ static const char *SMS_TAG = "SIM800_SMS";
 //#define MODEM_UART   UART_NUM_1
 #define UART_BUF_LEN 512
 
-// Clave actual para comandos SMS
-static char current_key[16] = "0000";
-
-// Envía un comando AT + CR
-static void at_send_sms(const char *cmd) {
-    ESP_LOGI(SMS_TAG, "AT> %s", cmd);
-    uart_write_bytes(MODEM_UART, cmd, strlen(cmd));
-    uart_write_bytes(MODEM_UART, "\r", 1);
-    vTaskDelay(pdMS_TO_TICKS(200));
+// Envía un comando AT y espera OK/ERROR
+static at_result_t at_send_sms(const char *cmd) {
+    return at_cmd(cmd, AT_TIMEOUT_MS);
 }
 
-// Envía un SMS de texto al número `num`
-static void send_sms_to(const char *num, const char *txt) {
-    char cmd[64];
-    at_send_sms("AT+CMGF=1");
-    snprintf(cmd, sizeof(cmd), "AT+CMGS=\"%s\"", num);
-    at_send_sms(cmd);
-    // Espera prompt '>'
-    char c;
-    while (uart_read_bytes(MODEM_UART, (uint8_t*)&c, 1, pdMS_TO_TICKS(500)) > 0) {
-        if (c == '>') break;
-    }
-    uart_write_bytes(MODEM_UART, txt, strlen(txt));
-    uart_write_bytes(MODEM_UART, "\x1A", 1); // Ctrl+Z
-    ESP_LOGI(SMS_TAG, "SMS enviado a %s: %s", num, txt);
-    vTaskDelay(pdMS_TO_TICKS(1000));
+// Encola un SMS de texto al número `num`; el envío lo hace la bandeja de salida
+static bool send_sms_to(const char *num, const char *txt) {
+    return sms_outbox_put(num, txt);
 }
 
 // Comprueba remitente válido contra NUM1 y NUM2
@@ -86,42 +74,52 @@ static void procesar_sms(const char *msg, const char *from) {
         ESP_LOGW(SMS_TAG, "Unauthorized sender: %s", from);
         return;
     }
-    size_t key_len = strlen(current_key);
-    if (strncmp(msg, current_key, key_len) != 0) {
+    const char *key = cfg()->key;   // clave en vigor (config_store.h)
+    size_t key_len = strlen(key);
+    if (strncmp(msg, key, key_len) != 0) {
         ESP_LOGW(SMS_TAG, "Invalid key: %.*s", (int)key_len, msg);
         return;
     }
     const char *p = msg + key_len;
     while (*p == ' ') p++;
     int cmd = atoi(p);
+    event_log(JR_EV_SMS, EVLOG_NO_CH, (uint16_t)cmd);
 
-    char resp[256] = {0};
+    char resp[SMS_TEXT_MAX] = {0};   // la bandeja la parte en varios SMS si hace falta
     switch (cmd) {
         case 1:
             snprintf(resp, sizeof(resp),
                 "1: Listar comandos\n"
                 "2: Cambiar clave\n"
-                "3: Mostrar alertas\n" // No hay alertas en esta versión
+                "3: Ultimos eventos [n]\n"
                 "4: Probar llamadas\n"
                 "5: Probar SMS\n"
                 "6: Cancelar alerta\n"
                 "7: Reiniciar dispositivo\n"
                 "8: Prueba sistema\n"
-                "9: Estado del sistema");
+                "9: Estado del sistema\n"
+                "10: Ver configuracion\n"
+                "11: Cambiar parametro\n"
+                "12: Configuracion de fabrica");
             break;
         case 2: {
             const char *nuev = strchr(p, ' ');
-            if (nuev && strlen(nuev+1) < sizeof(current_key)) {
-                strcpy(current_key, nuev+1);
-                snprintf(resp, sizeof(resp), "Clave cambiada a %s", current_key);
+            app_config_t c = *cfg();
+            if (nuev && cfg_set_key(&c, nuev+1) == NULL) {
+                bool saved = config_commit(&c) == ESP_OK;
+                snprintf(resp, sizeof(resp), saved ? "Clave cambiada a %s" : "Error guardando la clave (sigue %s)",
+                         cfg()->key);
             } else {
-                snprintf(resp, sizeof(resp), "Uso: %s 2 <nueva_clave>", current_key);
+                snprintf(resp, sizeof(resp), "Uso: %s 2 <nueva_clave>", key);
             }
             break;
         }
-        case 3:
-            snprintf(resp, sizeof(resp), "Alertas: ninguna");
+        case 3: { // Últimos eventos del diario: 3 [n]
+            const char *arg = strchr(p, ' ');
+            int n = arg ? atoi(arg + 1) : 5;
+            event_log_tail(n > 0 ? n : 5, resp, sizeof(resp));
             break;
+        }
         case 4:
             snprintf(resp, sizeof(resp), "Probando llamada...");
             
@@ -134,7 +132,7 @@ static void procesar_sms(const char *msg, const char *from) {
             break;
         case 7:
             send_sms_to(from, "Reiniciando...");
-            vTaskDelay(pdMS_TO_TICKS(500));
+            sms_outbox_flush(SMS_SEND_TIMEOUT_MS);
             esp_restart();
             return;
         case 8:  // Prueba sistema
@@ -168,7 +166,7 @@ static void procesar_sms(const char *msg, const char *from) {
             set_relay_polarity(ah);
             snprintf(resp, sizeof(resp), "Polaridad: %s", ah ? "ACTIVO-ALTO" : "ACTIVO-BAJO");
         } else {
-            snprintf(resp, sizeof(resp), "Uso: %s 90 <0|1>", current_key);
+            snprintf(resp, sizeof(resp), "Uso: %s 90 <0|1>", key);
         }
         break;
     }
@@ -176,6 +174,45 @@ static void procesar_sms(const char *msg, const char *from) {
         snprintf(resp, sizeof(resp), "Polaridad actual: %s",
                 get_relay_polarity() ? "ACTIVO-ALTO" : "ACTIVO-BAJO");
         break;
+    case 92: // Traza del módem: resumen por SMS y volcado por consola
+        modem_trace_summary(resp, sizeof(resp));
+        modem_trace_dump();
+        break;
+    case 93: { // Nivel de traza: 0=off, 1=anillo, 2=anillo+log
+        const char *arg = strchr(p, ' ');
+        int lvl = (arg ? atoi(arg+1) : -1);
+        if (lvl >= MT_LEVEL_OFF && lvl <= MT_LEVEL_LOG) {
+            modem_trace_level = lvl;
+            snprintf(resp, sizeof(resp), "Traza nivel %d", lvl);
+        } else {
+            snprintf(resp, sizeof(resp), "Uso: %s 93 <0|1|2>", key);
+        }
+        break;
+    }
+    case 10: // Configuración en vigor
+        cfg_format(cfg(), resp, sizeof(resp));
+        break;
+    case 11: { // Cambiar un parámetro: 11 <nombre> <valor>
+        char name[16] = {0}, value[16] = {0};
+        const char *arg = strchr(p, ' ');
+        if (arg && sscanf(arg + 1, "%15s %15s", name, value) == 2) {
+            app_config_t c = *cfg();
+            const char *why = cfg_set_field(&c, name, value);
+            if (!why && config_commit(&c) != ESP_OK) why = "no se pudo guardar";
+            if (why) snprintf(resp, sizeof(resp), "%s: %s", name, why);
+            else     snprintf(resp, sizeof(resp), "%s=%s guardado", name, value);
+        } else {
+            snprintf(resp, sizeof(resp), "Uso: %s 11 <ventana|umbral|atender|llamada|lampara|polaridad|modo|confianza> <valor>", key);
+        }
+        break;
+    }
+    case 12: { // Valores de fábrica (la clave vuelve a la de fábrica)
+        app_config_t c;
+        cfg_defaults(&c);
+        snprintf(resp, sizeof(resp), config_commit(&c) == ESP_OK ? "Configuracion de fabrica restaurada"
+                                                                 : "Error guardando la configuracion");
+        break;
+    }
         default:
             snprintf(resp, sizeof(resp), "Comando desconocido. Envía '1' para ayuda.");
             break;
@@ -184,56 +221,255 @@ static void procesar_sms(const char *msg, const char *from) {
     send_sms_to(from, resp);
 }
 
-// Lee SMS en índice 'idx', parsea y procesa
-static void read_sms(int idx) {
-    at_send_sms("AT+CMGF=1"); // Fuerza modo texto antes de leer
-    at_send_sms("AT+CPMS=\"ME\",\"ME\",\"ME\""); // Fuerza almacenamiento en memoria interna
-    char cmd[32];
-    snprintf(cmd, sizeof(cmd), "AT+CMGR=%d", idx);
-    at_send_sms(cmd);
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Aumenta el tiempo de espera
-
-    char buf[UART_BUF_LEN*4] = {0}; // Buffer más grande
-    int pos = 0, len;
-    while ((len = uart_read_bytes(MODEM_UART,
-                                  (uint8_t*)buf + pos,
-                                  sizeof(buf) - pos - 1,
-                                  pdMS_TO_TICKS(200))) > 0) {
-        ESP_LOGI(SMS_TAG, "[CMGR] Recibidos %d bytes", len);
-        for (int i = 0; i < len; ++i) {
-            ESP_LOGI(SMS_TAG, "[CMGR] Byte %d: 0x%02X (%c)", i, (unsigned char)buf[pos+i],
-                     isprint((unsigned char)buf[pos+i]) ? buf[pos+i] : '.');
+/* ───────────────────── recepción en modo PDU ─────────────────────
+ * Los SMS llegan como SMS-DELIVER en hex (tras +CMT, +CMGR o +CMGL). Los
+ * concatenados se guardan por (remitente, referencia) hasta tener todas
+ * las partes y se procesan como un único mensaje.
+ */
+#define SMS_RX_SLOTS     2       // mensajes largos a medio recibir
+#define SMS_RX_PARTS     4       // partes por mensaje (los comandos son cortos)
+#define SMS_RX_TTL_MS    (10 * 60 * 1000)
+
+typedef struct {
+    bool     used;
+    char     from[PDU_ADDR_MAX];
+    uint16_t ref;
+    uint8_t  total;
+    uint8_t  have;               // máscara de partes recibidas
+    int64_t  t_first;
+    char     part[SMS_RX_PARTS][PDU_PART_TEXT + 1];
+} sms_concat_t;
+
+static sms_concat_t s_concat[SMS_RX_SLOTS];
+
+// Entrega un mensaje (o una parte) ya decodificado a procesar_sms()
+static void sms_deliver(const pdu_deliver_t *d) {
+    if (d->total <= 1) {
+        procesar_sms(d->text, d->from);
+        return;
+    }
+    if (d->total > SMS_RX_PARTS) {
+        ESP_LOGW(SMS_TAG, "SMS de %s en %u partes, máximo %d: descartado", d->from, d->total, SMS_RX_PARTS);
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    sms_concat_t *slot = NULL, *oldest = &s_concat[0];
+    for (int i = 0; i < SMS_RX_SLOTS; i++) {
+        sms_concat_t *c = &s_concat[i];
+        if (c->used && now - c->t_first > (int64_t)SMS_RX_TTL_MS * 1000) {
+            ESP_LOGW(SMS_TAG, "SMS incompleto de %s caducado", c->from);
+            c->used = false;
         }
-        pos += len;
-    }
-    buf[pos] = '\0';
-    ESP_LOGI(SMS_TAG, "CMGR>> %s", buf);
-
-    // Extraer remitente y mensaje
-    char from[32] = {0};
-    char *p = strstr(buf, "+CMGR:");
-    if (p) {
-        char *q1 = strchr(p, '"');
-        char *q2 = q1 ? strchr(q1+1, '"') : NULL;
-        char *q3 = q2 ? strchr(q2+1, '"') : NULL;
-        char *q4 = q3 ? strchr(q3+1, '"') : NULL;
-        if (q3 && q4) {
-            int nlen = q4 - (q3+1);
-            if (nlen > sizeof(from)-1) nlen = sizeof(from)-1;
-            memcpy(from, q3+1, nlen);
-            from[nlen] = '\0';
-            char *msg = strstr(q4+1, "\r\n");
-            if (msg) {
-                msg += 2;
-                char *e = strstr(msg, "\r\n");
-                if (e) *e = '\0';
-                procesar_sms(msg, from);
-            }
+        if (c->used && c->ref == d->ref && c->total == d->total && strcmp(c->from, d->from) == 0) {
+            slot = c;
+            break;
         }
+        if (!c->used || (oldest->used && c->t_first < oldest->t_first)) oldest = c;
+    }
+    if (!slot) {
+        slot = oldest;
+        if (slot->used) ESP_LOGW(SMS_TAG, "SMS incompleto de %s descartado", slot->from);
+        memset(slot, 0, sizeof *slot);
+        slot->used = true;
+        snprintf(slot->from, sizeof slot->from, "%s", d->from);
+        slot->ref = d->ref;
+        slot->total = d->total;
+        slot->t_first = now;
     }
+    snprintf(slot->part[d->seq - 1], sizeof slot->part[0], "%s", d->text);
+    slot->have |= 1u << (d->seq - 1);
+    if (slot->have != (1u << slot->total) - 1) return;
+
+    static char joined[SMS_RX_PARTS * PDU_PART_TEXT + 1];
+    size_t n = 0;
+    for (int i = 0; i < slot->total; i++) {
+        n += snprintf(joined + n, sizeof joined - n, "%s", slot->part[i]);
+    }
+    slot->used = false;
+    ESP_LOGI(SMS_TAG, "SMS de %s reconstruido (%u partes, %u bytes)", slot->from, slot->total, (unsigned)n);
+    procesar_sms(joined, slot->from);
+}
+
+// Decodifica un SMS-DELIVER en hex y lo entrega
+static void sms_on_pdu(const char *hex) {
+    static pdu_deliver_t d;
+    if (!pdu_decode_deliver(hex, &d)) {
+        ESP_LOGW(SMS_TAG, "PDU no válida: %.40s", hex);
+        return;
+    }
+    ESP_LOGI(SMS_TAG, "SMS %u/%u de %s: %s", d.seq, d.total, d.from, d.text);
+    sms_deliver(&d);
+}
+
+// Respuesta de AT+CMGR: cabecera "+CMGR: <stat>,,<len>" seguida de la PDU
+typedef struct {
+    char msg[UART_BUF_LEN];
+    bool header;
+} sms_read_ctx_t;
+
+static void sms_cmgr_line(const char *line, void *ctx) {
+    sms_read_ctx_t *r = ctx;
+    if (strncmp(line, "+CMGR:", 6) == 0) {
+        r->header = true;
+    } else if (r->header && !r->msg[0]) {
+        snprintf(r->msg, sizeof(r->msg), "%s", line);
+    }
+}
+
+// Lee SMS en índice 'idx', lo decodifica y procesa (modo PDU y CPMS ya fijados al arrancar)
+static void read_sms(int idx) {
+    static sms_read_ctx_t r;
+    memset(&r, 0, sizeof(r));
+    at_cmd_t c = { .on_line = sms_cmgr_line, .ctx = &r, .timeout_ms = 5000 };
+    snprintf(c.cmd, sizeof(c.cmd), "AT+CMGR=%d", idx);
+    if (at_exec(&c) == AT_RES_OK && r.msg[0]) {
+        sms_on_pdu(r.msg);
+    }
+
     // Borrar SMS
+    char cmd[32];
     snprintf(cmd, sizeof(cmd), "AT+CMGD=%d", idx);
     at_send_sms(cmd);
 }
 
+/* ───────────────────── vaciado de la bandeja de entrada ─────────────────────
+ * Un solo AT+CMGL lista todos los no leídos (y los marca como leídos); se
+ * decodifican al llegar, se procesan en orden y se borran con un único
+ * AT+CMGDA. Los +CMTI que llegan en ráfaga se agrupan en un solo vaciado.
+ */
+#define SMS_DRAIN_MAX        64      // mensajes por pasada
+#define SMS_INDEX_MAX        256     // índices de almacenamiento que se siguen
+#define SMS_DRAIN_ARENA      4096    // remitentes + cuerpos
+#define SMS_DRAIN_SETTLE_MS  300     // deja llegar el resto de la ráfaga
+#define SMS_DRAIN_TIMEOUT_MS 20000
+
+typedef struct {
+    uint16_t idx;
+    uint16_t from;    // desplazamientos en arena
+    uint16_t body;
+    uint16_t ref;     // concatenación (total = 1 si es suelto)
+    uint8_t  total;
+    uint8_t  seq;
+} sms_entry_t;
+
+static struct {
+    sms_entry_t msg[SMS_DRAIN_MAX];
+    int         count;
+    uint8_t     overflow[SMS_INDEX_MAX / 8];   // índices que no cupieron (bit a bit)
+    int         n_overflow;
+    int         n_lost;                        // índices por encima de SMS_INDEX_MAX
+    char        arena[SMS_DRAIN_ARENA];
+    int         used;
+    int         pending;                   // índice cuya PDU es la línea siguiente, -1 si ninguno
+} s_inbox;
+
+static volatile bool s_drain_queued = false;
+
+static int inbox_store(const char *txt, int len) {
+    if (s_inbox.used + len + 1 > SMS_DRAIN_ARENA) return -1;
+    int off = s_inbox.used;
+    memcpy(s_inbox.arena + off, txt, len);
+    s_inbox.arena[off + len] = '\0';
+    s_inbox.used += len + 1;
+    return off;
+}
+
+/*
+ * AT+CMGL ya los ha marcado como leídos y AT+CMGDA los borraría: hay que
+ * recordarlos todos, no solo los que quepan en una lista.
+ */
+static void inbox_overflow(int idx) {
+    if (idx < 0 || idx >= SMS_INDEX_MAX) {
+        s_inbox.n_lost++;
+        return;
+    }
+    uint8_t bit = 1u << (idx & 7);
+    if (s_inbox.overflow[idx >> 3] & bit) return;
+    s_inbox.overflow[idx >> 3] |= bit;
+    s_inbox.n_overflow++;
+}
+
+// +CMGL: <idx>,<stat>,,<len>  seguido de la PDU en hex
+static void sms_cmgl_line(const char *line, void *ctx) {
+    (void)ctx;
+    if (strncmp(line, "+CMGL:", 6) == 0) {
+        s_inbox.pending = atoi(line + 6);
+        return;
+    }
+    if (s_inbox.pending < 0) return;
+    int idx = s_inbox.pending;
+    s_inbox.pending = -1;
+
+    static pdu_deliver_t d;          // solo lo usa modem_task
+    if (!pdu_decode_deliver(line, &d)) {
+        ESP_LOGW(SMS_TAG, "PDU no válida en %d", idx);
+        return;
+    }
+    int from = -1, body = -1;
+    if (s_inbox.count < SMS_DRAIN_MAX) {
+        from = inbox_store(d.from, strlen(d.from));
+        body = inbox_store(d.text, strlen(d.text));
+    }
+    if (from < 0 || body < 0) {
+        inbox_overflow(idx);
+        return;
+    }
+    sms_entry_t *e = &s_inbox.msg[s_inbox.count++];
+    e->idx   = idx;
+    e->from  = from;
+    e->body  = body;
+    e->ref   = d.ref;
+    e->total = d.total;
+    e->seq   = d.seq;
+}
+
+static void sms_inbox_drain(void) {
+    s_drain_queued = false;
+    vTaskDelay(pdMS_TO_TICKS(SMS_DRAIN_SETTLE_MS));
+
+    memset(&s_inbox, 0, sizeof(s_inbox));
+    s_inbox.pending = -1;
+    int64_t t0 = esp_timer_get_time();
+    at_cmd_t c = { .on_line = sms_cmgl_line, .timeout_ms = SMS_DRAIN_TIMEOUT_MS };
+    snprintf(c.cmd, sizeof(c.cmd), "AT+CMGL=0");   // REC UNREAD en modo PDU
+    if (at_exec(&c) != AT_RES_OK) {
+        ESP_LOGW(SMS_TAG, "AT+CMGL falló");
+        return;
+    }
+    int total = s_inbox.count + s_inbox.n_overflow + s_inbox.n_lost;
+    if (total == 0) return;
+
+    static pdu_deliver_t d;
+    for (int i = 0; i < s_inbox.count; i++) {
+        const sms_entry_t *e = &s_inbox.msg[i];
+        ESP_LOGI(SMS_TAG, "SMS %u (%u/%u) de %s: %s", e->idx, e->seq, e->total,
+                 s_inbox.arena + e->from, s_inbox.arena + e->body);
+        snprintf(d.from, sizeof d.from, "%s", s_inbox.arena + e->from);
+        snprintf(d.text, sizeof d.text, "%s", s_inbox.arena + e->body);
+        d.ref = e->ref;
+        d.total = e->total;
+        d.seq = e->seq;
+        sms_deliver(&d);
+    }
+    // Los que no cupieron se leen uno a uno (read_sms los borra)
+    for (int idx = 0; idx < SMS_INDEX_MAX; idx++) {
+        if (s_inbox.overflow[idx >> 3] & (1u << (idx & 7))) read_sms(idx);
+    }
+
+    // Con índices sin seguir no se borra en bloque: se quedan como leídos
+    if (s_inbox.n_lost) ESP_LOGE(SMS_TAG, "%d SMS fuera de los %d índices: sin borrar", s_inbox.n_lost, SMS_INDEX_MAX);
+    else at_cmd("AT+CMGDA=1", 10000);   // "DEL READ" en modo PDU
+    int64_t dt = esp_timer_get_time() - t0;
+    ESP_LOGI(SMS_TAG, "Bandeja vaciada: %d SMS (%d por separado) en %lld ms, %lld SMS/s",
+             total, s_inbox.n_overflow, (long long)(dt / 1000),
+             (long long)(dt > 0 ? (int64_t)total * 1000000 / dt : 0));
+}
+
+// Pide un vaciado; varias peticiones seguidas producen uno solo
+static void sms_inbox_request(void) {
+    if (s_drain_queued) return;
+    s_drain_queued = true;
+    if (!urc_call(sms_inbox_drain)) s_drain_queued = false;
+}
+
 #endif // SMS_H
@@ -0,0 +1,179 @@
+#ifndef SMS_OUTBOX_H
+#define SMS_OUTBOX_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "at_engine.h"
+#include "sms_pdu.h"
+
+/*
+ * Bandeja de salida de SMS.
+ *
+ * sms_outbox_put() copia el mensaje a una cola acotada y vuelve enseguida.
+ * sms_outbox_task la vacía en modo PDU: codifica el texto (GSM-7 o UCS-2,
+ * en varias partes concatenadas si hace falta) y por cada parte espera el
+ * '>' real, el "+CMGS: <ref>" y el OK, reintentando con espera creciente si
+ * el módem contesta ERROR.
+ */
+
+static const char *OUTBOX_TAG = "SMS_OUT";
+
+#define SMS_OUTBOX_LEN        6
+#define SMS_TO_MAX            24
+#define SMS_TEXT_MAX          512
+#define SMS_SEND_TIMEOUT_MS   60000   // la red puede tardar en confirmar +CMGS
+#define SMS_MAX_TRIES         3
+#define SMS_RETRY_BASE_MS     2000    // 2 s, 4 s, ...
+#define SMS_OUTBOX_STACK      4096
+
+typedef struct {
+    char    to[SMS_TO_MAX];
+    char    text[SMS_TEXT_MAX];
+    int64_t t_enq;
+} sms_out_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t parts;      // SMS de red (partes) enviados
+    uint32_t failed;
+    uint32_t retries;
+    int64_t  sum_us;     // encolado → +CMGS
+    int64_t  max_us;
+} sms_outbox_stats_t;
+
+static portMUX_TYPE s_outbox_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static struct {
+    QueueHandle_t      queue;
+    volatile int       busy;      // mensajes encolados o en envío
+    sms_outbox_stats_t stats;
+} outbox;
+
+static bool sms_outbox_put(const char *to, const char *text)
+{
+    sms_out_t m;
+    snprintf(m.to, sizeof m.to, "%s", to);
+    size_t n = strlen(text);
+    if (n >= sizeof m.text) {
+        ESP_LOGW(OUTBOX_TAG, "Texto de %u bytes recortado a %u", (unsigned)n, (unsigned)sizeof m.text - 1);
+    }
+    snprintf(m.text, sizeof m.text, "%s", text);
+    m.t_enq = esp_timer_get_time();
+    portENTER_CRITICAL(&s_outbox_mux);
+    outbox.busy++;
+    portEXIT_CRITICAL(&s_outbox_mux);
+    if (xQueueSend(outbox.queue, &m, 0) != pdTRUE) {
+        portENTER_CRITICAL(&s_outbox_mux);
+        outbox.busy--;
+        portEXIT_CRITICAL(&s_outbox_mux);
+        ESP_LOGE(OUTBOX_TAG, "Bandeja llena, SMS a %s descartado", to);
+        return false;
+    }
+    return true;
+}
+
+// Espera a que la bandeja se vacíe (p.ej. antes de reiniciar)
+static bool sms_outbox_flush(uint32_t timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (outbox.busy > 0) {
+        if (esp_timer_get_time() > deadline) return false;
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    return true;
+}
+
+static void sms_cmgs_line(const char *line, void *ctx)
+{
+    int *ref = ctx;
+    if (strncmp(line, "+CMGS:", 6) == 0) *ref = atoi(line + 6);
+}
+
+// Envía la parte i con reintentos; devuelve la referencia +CMGS o -1
+static int sms_outbox_send_part(const pdu_msg_t *pm, const char *to, int i)
+{
+    static char hex[PDU_HEX_MAX];
+    int tpdu_len = pdu_msg_part(pm, to, i, hex, sizeof hex);
+    if (tpdu_len < 0) return -1;
+
+    for (int attempt = 0; attempt < SMS_MAX_TRIES; attempt++) {
+        if (attempt) {
+            uint32_t wait = SMS_RETRY_BASE_MS << (attempt - 1);
+            ESP_LOGW(OUTBOX_TAG, "Reintento %d a %s (parte %d/%d) en %u ms",
+                     attempt, to, i + 1, pm->parts, (unsigned)wait);
+            outbox.stats.retries++;
+            vTaskDelay(pdMS_TO_TICKS(wait));
+        }
+        int ref = -1;
+        at_cmd_t c = {
+            .payload = hex, .timeout_ms = SMS_SEND_TIMEOUT_MS,
+            .on_line = sms_cmgs_line, .ctx = &ref,
+        };
+        snprintf(c.cmd, sizeof c.cmd, "AT+CMGS=%d", tpdu_len);
+        if (at_exec(&c) == AT_RES_OK && ref >= 0) return ref;
+    }
+    return -1;
+}
+
+static void sms_outbox_task(void *arg)
+{
+    (void)arg;
+    static sms_out_t m;
+    static pdu_msg_t pm;
+    static uint8_t concat_ref;
+    for (;;) {
+        if (xQueueReceive(outbox.queue, &m, portMAX_DELAY) != pdTRUE) continue;
+
+        int parts = pdu_msg_prepare(&pm, m.text, ++concat_ref);
+        if (pm.truncated) {
+            ESP_LOGW(OUTBOX_TAG, "Texto a %s recortado a %d partes", m.to, PDU_MAX_PARTS);
+        }
+        int ref = -1, sent = 0;
+        for (int i = 0; i < parts; i++) {
+            ref = sms_outbox_send_part(&pm, m.to, i);
+            if (ref < 0) break;
+            sent++;
+        }
+        outbox.stats.parts += sent;
+
+        int64_t dt = esp_timer_get_time() - m.t_enq;
+        if (sent == parts) {
+            outbox.stats.sent++;
+            outbox.stats.sum_us += dt;
+            if (dt > outbox.stats.max_us) outbox.stats.max_us = dt;
+            ESP_LOGI(OUTBOX_TAG, "SMS a %s (%d parte%s %s) ref %d en %lld ms (media %lld ms)",
+                     m.to, parts, parts > 1 ? "s" : "", pm.ucs2 ? "UCS-2" : "GSM-7", ref,
+                     (long long)(dt / 1000),
+                     (long long)(outbox.stats.sum_us / outbox.stats.sent / 1000));
+        } else {
+            outbox.stats.failed++;
+            ESP_LOGE(OUTBOX_TAG, "SMS a %s fallido en la parte %d/%d tras %d intentos",
+                     m.to, sent + 1, parts, SMS_MAX_TRIES);
+        }
+        portENTER_CRITICAL(&s_outbox_mux);
+        outbox.busy--;
+        portEXIT_CRITICAL(&s_outbox_mux);
+    }
+}
+
+static esp_err_t sms_outbox_start(void)
+{
+    outbox.queue = xQueueCreate(SMS_OUTBOX_LEN, sizeof(sms_out_t));
+    if (!outbox.queue ||
+        xTaskCreate(sms_outbox_task, "sms_outbox", SMS_OUTBOX_STACK, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(OUTBOX_TAG, "No pude crear la bandeja de salida");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+#endif // SMS_OUTBOX_H
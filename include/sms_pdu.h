@@ -0,0 +1,406 @@
+#ifndef SMS_PDU_H
+#define SMS_PDU_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Codificador/decodificador de SMS en modo PDU (3GPP TS 23.040).
+ *
+ * - Envío (SMS-SUBMIT): el texto UTF-8 va en GSM-7 si todos sus caracteres
+ *   caben en el alfabeto por defecto (más la tabla de extensión), si no en
+ *   UCS-2 ("Opción" → UCS-2, "Opcion" → GSM-7). Si no cabe en un SMS se
+ *   parte con cabecera de concatenación (IEI 00, referencia de 8 bits):
+ *   153 septetos o 67 caracteres UCS-2 por parte.
+ * - Recepción (SMS-DELIVER): remitente, texto en UTF-8 y datos de
+ *   concatenación (IEI 00 y 08) para que el llamador junte las partes.
+ *
+ * No depende de ESP-IDF: solo memoria del llamador, sin reservas.
+ */
+
+#define PDU_TEXT_MAX     512    // caracteres por mensaje a enviar
+#define PDU_MAX_PARTS    8
+#define PDU_ADDR_MAX     24     // "+34600111222" o remitente alfanumérico
+#define PDU_PART_TEXT    480    // UTF-8 de una parte recibida (160 × 3 bytes)
+#define PDU_HEX_MAX      (2 * (1 + 176) + 1)   // SCA "00" + TPDU máximo, en hex
+
+#define PDU_GSM7_SINGLE  160
+#define PDU_GSM7_MULTI   153
+#define PDU_UCS2_SINGLE  70
+#define PDU_UCS2_MULTI   67
+
+#define PDU_ESC          0x1B
+
+/* ───────────────────────── alfabeto GSM-7 ───────────────────────── */
+static const uint16_t PDU_GSM7[128] = {
+    '@',  0xA3, '$',  0xA5, 0xE8, 0xE9, 0xF9, 0xEC, 0xF2, 0xC7, '\n', 0xD8, 0xF8, '\r', 0xC5, 0xE5,
+    0x394,'_',  0x3A6,0x393,0x39B,0x3A9,0x3A0,0x3A8,0x3A3,0x398,0x39E,0xA0, 0xC6, 0xE6, 0xDF, 0xC9,
+    ' ',  '!',  '"',  '#',  0xA4, '%',  '&',  '\'', '(',  ')',  '*',  '+',  ',',  '-',  '.',  '/',
+    '0',  '1',  '2',  '3',  '4',  '5',  '6',  '7',  '8',  '9',  ':',  ';',  '<',  '=',  '>',  '?',
+    0xA1, 'A',  'B',  'C',  'D',  'E',  'F',  'G',  'H',  'I',  'J',  'K',  'L',  'M',  'N',  'O',
+    'P',  'Q',  'R',  'S',  'T',  'U',  'V',  'W',  'X',  'Y',  'Z',  0xC4, 0xD6, 0xD1, 0xDC, 0xA7,
+    0xBF, 'a',  'b',  'c',  'd',  'e',  'f',  'g',  'h',  'i',  'j',  'k',  'l',  'm',  'n',  'o',
+    'p',  'q',  'r',  's',  't',  'u',  'v',  'w',  'x',  'y',  'z',  0xE4, 0xF6, 0xF1, 0xFC, 0xE0,
+};
+
+// Tabla de extensión: ESC + código
+static const struct { uint8_t code; uint16_t ch; } PDU_GSM7_EXT[] = {
+    { 0x0A, 0x0C }, { 0x14, '^' }, { 0x28, '{' }, { 0x29, '}' }, { 0x2F, '\\' },
+    { 0x3C, '[' },  { 0x3D, '~' }, { 0x3E, ']' }, { 0x40, '|' }, { 0x65, 0x20AC },
+};
+
+// Septetos que ocupa ch en GSM-7 (1, 2 con escape) o 0 si no existe
+static int pdu_gsm7_lookup(uint16_t ch, uint8_t *code)
+{
+    if (ch != 0xA0) {   // 0x1B es el escape, no un carácter
+        for (int i = 0; i < 128; i++) {
+            if (PDU_GSM7[i] == ch) { *code = i; return 1; }
+        }
+    }
+    for (size_t i = 0; i < sizeof PDU_GSM7_EXT / sizeof PDU_GSM7_EXT[0]; i++) {
+        if (PDU_GSM7_EXT[i].ch == ch) { *code = PDU_GSM7_EXT[i].code; return 2; }
+    }
+    return 0;
+}
+
+/* ───────────────────────── UTF-8 ───────────────────────── */
+// Siguiente carácter de *s; fuera del plano básico o mal formado → '?'
+static uint16_t pdu_utf8_next(const char **s)
+{
+    const uint8_t *p = (const uint8_t *)*s;
+    uint32_t c = *p++;
+    int more = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+    if (more < 0) { *s = (const char *)p; return '?'; }
+    c &= 0x7F >> more;
+    for (int i = 0; i < more; i++) {
+        if ((*p & 0xC0) != 0x80) { *s = (const char *)p; return '?'; }
+        c = c << 6 | (*p++ & 0x3F);
+    }
+    *s = (const char *)p;
+    return c > 0xFFFF ? '?' : (uint16_t)c;
+}
+
+// Escribe c en UTF-8; false si no cabe (deja *pos sin tocar)
+static bool pdu_utf8_put(char *out, size_t len, size_t *pos, uint32_t c)
+{
+    uint8_t b[4];
+    int n;
+    if (c < 0x80)         { b[0] = c; n = 1; }
+    else if (c < 0x800)   { b[0] = 0xC0 | c >> 6;  b[1] = 0x80 | (c & 0x3F); n = 2; }
+    else if (c < 0x10000) { b[0] = 0xE0 | c >> 12; b[1] = 0x80 | (c >> 6 & 0x3F); b[2] = 0x80 | (c & 0x3F); n = 3; }
+    else { b[0] = 0xF0 | c >> 18; b[1] = 0x80 | (c >> 12 & 0x3F); b[2] = 0x80 | (c >> 6 & 0x3F); b[3] = 0x80 | (c & 0x3F); n = 4; }
+    if (*pos + n >= len) return false;
+    memcpy(out + *pos, b, n);
+    *pos += n;
+    out[*pos] = '\0';
+    return true;
+}
+
+/* ───────────────────────── hex y septetos ───────────────────────── */
+static const char PDU_HEX[] = "0123456789ABCDEF";
+
+static int pdu_hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Hex → bytes; devuelve los bytes escritos o -1 si no es hex válido
+static int pdu_unhex(const char *hex, uint8_t *out, int max)
+{
+    int n = 0;
+    while (hex[0] && hex[1] && hex[0] != '\r' && n < max) {
+        int hi = pdu_hex_nibble(hex[0]), lo = pdu_hex_nibble(hex[1]);
+        if (hi < 0 || lo < 0) return -1;
+        out[n++] = hi << 4 | lo;
+        hex += 2;
+    }
+    return n;
+}
+
+static void pdu_put_septet(uint8_t *ud, int idx, uint8_t v)
+{
+    int bit = idx * 7;
+    ud[bit / 8] |= v << (bit % 8);
+    if (bit % 8 > 1) ud[bit / 8 + 1] |= v >> (8 - bit % 8);
+}
+
+static uint8_t pdu_get_septet(const uint8_t *ud, int idx)
+{
+    int bit = idx * 7;
+    uint16_t w = ud[bit / 8];
+    if (bit % 8 > 1) w |= ud[bit / 8 + 1] << 8;
+    return (w >> (bit % 8)) & 0x7F;
+}
+
+/* ───────────────────────── envío ───────────────────────── */
+typedef struct {
+    uint16_t ch[PDU_TEXT_MAX];
+    uint8_t  cost[PDU_TEXT_MAX];          // septetos (GSM-7) por carácter
+    int      n;
+    bool     ucs2;
+    bool     truncated;                   // no cabía en PDU_MAX_PARTS
+    uint8_t  ref;                         // referencia de concatenación
+    int      parts;
+    int      start[PDU_MAX_PARTS + 1];    // primer carácter de cada parte
+} pdu_msg_t;
+
+/*
+ * Prepara utf8 para el envío: elige alfabeto y reparte en partes.
+ * Devuelve el número de partes.
+ */
+static int pdu_msg_prepare(pdu_msg_t *m, const char *utf8, uint8_t ref)
+{
+    m->n = 0;
+    m->ucs2 = false;
+    m->truncated = false;
+    m->ref = ref;
+    while (*utf8 && m->n < PDU_TEXT_MAX) {
+        uint16_t c = pdu_utf8_next(&utf8);
+        uint8_t code;
+        int cost = pdu_gsm7_lookup(c, &code);
+        if (!cost) m->ucs2 = true;
+        m->ch[m->n] = c;
+        m->cost[m->n] = cost;
+        m->n++;
+    }
+    if (*utf8) m->truncated = true;
+
+    int total = 0;
+    for (int i = 0; i < m->n; i++) total += m->ucs2 ? 1 : m->cost[i];
+    int single = m->ucs2 ? PDU_UCS2_SINGLE : PDU_GSM7_SINGLE;
+    int multi  = m->ucs2 ? PDU_UCS2_MULTI  : PDU_GSM7_MULTI;
+
+    m->start[0] = 0;
+    if (total <= single) {
+        m->parts = 1;
+        m->start[1] = m->n;
+        return 1;
+    }
+    m->parts = 0;
+    int i = 0;
+    while (i < m->n && m->parts < PDU_MAX_PARTS) {
+        int used = 0;
+        m->start[m->parts] = i;
+        // un escape y su código nunca se separan
+        while (i < m->n) {
+            int cost = m->ucs2 ? 1 : m->cost[i];
+            if (used + cost > multi) break;
+            used += cost;
+            i++;
+        }
+        m->parts++;
+    }
+    if (i < m->n) {
+        m->truncated = true;
+        m->n = i;
+    }
+    m->start[m->parts] = m->n;
+    return m->parts;
+}
+
+// Número en semi-octetos: "+34600111222" → len, TON 0x91, "4306..."
+static int pdu_put_addr(uint8_t *out, const char *num)
+{
+    uint8_t ton = 0x81;
+    if (*num == '+') { ton = 0x91; num++; }
+    int digits = 0;
+    for (const char *q = num; *q; q++) if (*q >= '0' && *q <= '9') digits++;
+    out[0] = digits;
+    out[1] = ton;
+    int n = 2, k = 0;
+    for (const char *q = num; *q; q++) {
+        if (*q < '0' || *q > '9') continue;
+        if (k % 2 == 0) out[n] = 0xF0 | (*q - '0');
+        else {
+            out[n] = (out[n] & 0x0F) | (*q - '0') << 4;
+            n++;
+        }
+        k++;
+    }
+    if (k % 2) n++;
+    return n;
+}
+
+/*
+ * Parte i (0..parts-1) en hex, lista para "AT+CMGS=<len>" + payload.
+ * Devuelve <len> (octetos del TPDU, sin el SCA) o -1 si no cabe en hex.
+ */
+static int pdu_msg_part(const pdu_msg_t *m, const char *to, int i, char *hex, size_t hexlen)
+{
+    uint8_t tp[176];
+    int n = 0;
+    bool udh = m->parts > 1;
+
+    memset(tp, 0, sizeof tp);
+    tp[n++] = 0x11 | (udh ? 0x40 : 0);   // SMS-SUBMIT, VP relativo, UDHI
+    tp[n++] = 0x00;                      // MR: lo pone el módem
+    n += pdu_put_addr(tp + n, to);
+    tp[n++] = 0x00;                      // PID
+    tp[n++] = m->ucs2 ? 0x08 : 0x00;     // DCS
+    tp[n++] = 0xA7;                      // validez 24 h
+    int udl_at = n++;
+    uint8_t *ud = tp + n;
+
+    int hdr = 0;
+    if (udh) {
+        const uint8_t h[6] = { 0x05, 0x00, 0x03, m->ref, (uint8_t)m->parts, (uint8_t)(i + 1) };
+        memcpy(ud, h, sizeof h);
+        hdr = sizeof h;
+    }
+    int from = m->start[i], to_ch = m->start[i + 1];
+    int ud_len;
+    if (m->ucs2) {
+        ud_len = hdr;
+        for (int k = from; k < to_ch; k++) {
+            ud[ud_len++] = m->ch[k] >> 8;
+            ud[ud_len++] = m->ch[k] & 0xFF;
+        }
+        tp[udl_at] = ud_len;
+    } else {
+        int sep = hdr ? (hdr * 8 + 6) / 7 : 0;   // cabecera + relleno en septetos
+        for (int k = from; k < to_ch; k++) {
+            uint8_t code;
+            if (pdu_gsm7_lookup(m->ch[k], &code) == 2) pdu_put_septet(ud, sep++, PDU_ESC);
+            pdu_put_septet(ud, sep++, code);
+        }
+        tp[udl_at] = sep;
+        ud_len = (sep * 7 + 7) / 8;
+    }
+    n += ud_len;
+
+    if (hexlen < (size_t)(2 + 2 * n + 1)) return -1;
+    hex[0] = '0'; hex[1] = '0';          // SCA: el de la SIM
+    for (int k = 0; k < n; k++) {
+        hex[2 + 2 * k]     = PDU_HEX[tp[k] >> 4];
+        hex[2 + 2 * k + 1] = PDU_HEX[tp[k] & 0x0F];
+    }
+    hex[2 + 2 * n] = '\0';
+    return n;
+}
+
+/* ───────────────────────── recepción ───────────────────────── */
+typedef struct {
+    char     from[PDU_ADDR_MAX];
+    char     text[PDU_PART_TEXT + 1];
+    uint16_t ref;          // concatenación; total = 1 si es un SMS suelto
+    uint8_t  total;
+    uint8_t  seq;
+    bool     ucs2;
+} pdu_deliver_t;
+
+static void pdu_gsm7_decode(const uint8_t *ud, int first, int count, char *out, size_t len)
+{
+    size_t pos = 0;
+    out[0] = '\0';
+    for (int k = first; k < count; k++) {
+        uint8_t s = pdu_get_septet(ud, k);
+        uint16_t c = PDU_GSM7[s];
+        if (s == PDU_ESC && k + 1 < count) {
+            uint8_t e = pdu_get_septet(ud, ++k);
+            c = ' ';
+            for (size_t i = 0; i < sizeof PDU_GSM7_EXT / sizeof PDU_GSM7_EXT[0]; i++) {
+                if (PDU_GSM7_EXT[i].code == e) { c = PDU_GSM7_EXT[i].ch; break; }
+            }
+        }
+        if (!pdu_utf8_put(out, len, &pos, c)) return;
+    }
+}
+
+/*
+ * Decodifica un SMS-DELIVER en hex (la línea tras "+CMT:", "+CMGR:" o
+ * "+CMGL:"), con el SCA delante tal como lo da el módem.
+ */
+static bool pdu_decode_deliver(const char *hex, pdu_deliver_t *out)
+{
+    uint8_t b[200];
+    int len = pdu_unhex(hex, b, sizeof b);
+    memset(out, 0, sizeof *out);
+    out->total = 1;
+    out->seq = 1;
+    if (len < 2) return false;
+
+    int p = 1 + b[0];                        // salta el SCA
+    if (p + 2 > len) return false;
+    uint8_t fo = b[p++];
+    if ((fo & 0x03) != 0x00) return false;   // no es SMS-DELIVER
+
+    // Remitente
+    int digits = b[p++];
+    uint8_t toa = b[p++];
+    int alen = (digits + 1) / 2;
+    if (p + alen + 10 > len) return false;
+    if ((toa & 0x70) == 0x50) {              // alfanumérico, GSM-7 empaquetado
+        pdu_gsm7_decode(b + p, 0, digits * 4 / 7, out->from, sizeof out->from);
+    } else {
+        int k = 0;
+        if ((toa & 0x70) == 0x10) out->from[k++] = '+';
+        for (int i = 0; i < digits && k < PDU_ADDR_MAX - 1; i++) {
+            uint8_t d = (b[p + i / 2] >> (i % 2 ? 4 : 0)) & 0x0F;
+            if (d > 9) break;
+            out->from[k++] = '0' + d;
+        }
+        out->from[k] = '\0';
+    }
+    p += alen;
+
+    p++;                                     // PID
+    uint8_t dcs = b[p++];
+    p += 7;                                  // SCTS
+    int udl = b[p++];
+    const uint8_t *ud = b + p;
+    int ud_bytes = len - p;
+
+    int alphabet = 0;                        // 0 GSM-7, 1 8 bits, 2 UCS-2
+    if ((dcs & 0xC0) == 0x00)      alphabet = (dcs >> 2) & 0x03;
+    else if ((dcs & 0xF0) == 0xF0) alphabet = (dcs & 0x04) ? 1 : 0;
+    else if ((dcs & 0xF0) == 0xE0) alphabet = 2;
+    out->ucs2 = alphabet == 2;
+
+    int hdr = 0;                             // octetos de cabecera (con UDHL)
+    if ((fo & 0x40) && ud_bytes > 0) {
+        hdr = 1 + ud[0];
+        if (hdr > ud_bytes) return false;
+        for (int i = 1; i + 1 < hdr; i += 2 + ud[i + 1]) {
+            const uint8_t *ie = ud + i;
+            if (ie[0] == 0x00 && ie[1] == 3 && i + 5 <= hdr) {
+                out->ref = ie[2]; out->total = ie[3]; out->seq = ie[4];
+            } else if (ie[0] == 0x08 && ie[1] == 4 && i + 6 <= hdr) {
+                out->ref = ie[2] << 8 | ie[3]; out->total = ie[4]; out->seq = ie[5];
+            }
+        }
+        if (out->total == 0 || out->seq == 0 || out->seq > out->total) {
+            out->total = out->seq = 1;
+        }
+    }
+
+    size_t pos = 0;
+    if (alphabet == 0) {
+        int max_sep = ud_bytes * 8 / 7;
+        if (udl > max_sep) udl = max_sep;
+        pdu_gsm7_decode(ud, (hdr * 8 + 6) / 7, udl, out->text, sizeof out->text);
+    } else if (alphabet == 2) {
+        if (udl > ud_bytes) udl = ud_bytes;
+        for (int i = hdr; i + 1 < udl; i += 2) {
+            uint32_t c = ud[i] << 8 | ud[i + 1];
+            if (c >= 0xD800 && c < 0xDC00 && i + 3 < udl) {   // par sustituto
+                uint32_t lo = ud[i + 2] << 8 | ud[i + 3];
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+            if (!pdu_utf8_put(out->text, sizeof out->text, &pos, c)) break;
+        }
+    } else {                                 // 8 bits: como Latin-1
+        if (udl > ud_bytes) udl = ud_bytes;
+        for (int i = hdr; i < udl; i++) {
+            if (!pdu_utf8_put(out->text, sizeof out->text, &pos, ud[i])) break;
+        }
+    }
+    return true;
+}
+
+#endif // SMS_PDU_H
@@ -0,0 +1,222 @@
+#ifndef URC_H
+#define URC_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/*
+ * Despachador de URC (mensajes no solicitados del SIM800).
+ *
+ * La tabla de prefijos es fija en compilación. Solo se mira el inicio de la
+ * línea: la clave es el texto hasta ':' inclusive ("+CMTI:") o la línea
+ * entera para los códigos sin parámetros ("RING", "NO CARRIER"). La clave
+ * se busca en un índice hash que se construye una vez en urc_init(), así
+ * que el coste no depende de cuántos URC haya registrados.
+ *
+ * modem_task solo clasifica (urc_feed) y encola; los manejadores corren en
+ * urc_task, de modo que pueden esperar comandos AT sin bloquear la lectura.
+ */
+
+static const char *URC_TAG = "URC";
+
+typedef enum {
+    URC_CMT = 0,      // SMS entregado directamente (cabecera + cuerpo)
+    URC_CMTI,         // SMS guardado en memoria
+    URC_CMGS,         // referencia de SMS enviado
+    URC_CLIP,         // identificación de llamante
+    URC_DTMF,
+    URC_RING,
+    URC_NO_CARRIER,
+    URC_BUSY,
+    URC_NO_ANSWER,
+    URC_NO_DIALTONE,
+    URC_COLP,
+    URC_CLCC,
+    URC_CPIN,
+    URC_CALL_READY,
+    URC_SMS_READY,
+    URC_UNDER_VOLTAGE,
+    URC_OVER_VOLTAGE,
+    URC_COUNT
+} urc_id_t;
+
+#define URC_F_BODY   0x01   // el URC ocupa dos líneas (cabecera + cuerpo)
+
+typedef struct {
+    const char *key;
+    uint8_t     len;
+    uint8_t     flags;
+} urc_def_t;
+
+#define URC_DEF(k, f) { k, sizeof(k) - 1, f }
+
+static const urc_def_t URC_TABLE[URC_COUNT] = {
+    [URC_CMT]           = URC_DEF("+CMT:", URC_F_BODY),
+    [URC_CMTI]          = URC_DEF("+CMTI:", 0),
+    [URC_CMGS]          = URC_DEF("+CMGS:", 0),
+    [URC_CLIP]          = URC_DEF("+CLIP:", 0),
+    [URC_DTMF]          = URC_DEF("+DTMF:", 0),
+    [URC_RING]          = URC_DEF("RING", 0),
+    [URC_NO_CARRIER]    = URC_DEF("NO CARRIER", 0),
+    [URC_BUSY]          = URC_DEF("BUSY", 0),
+    [URC_NO_ANSWER]     = URC_DEF("NO ANSWER", 0),
+    [URC_NO_DIALTONE]   = URC_DEF("NO DIALTONE", 0),
+    [URC_COLP]          = URC_DEF("+COLP:", 0),
+    [URC_CLCC]          = URC_DEF("+CLCC:", 0),
+    [URC_CPIN]          = URC_DEF("+CPIN:", 0),
+    [URC_CALL_READY]    = URC_DEF("Call Ready", 0),
+    [URC_SMS_READY]     = URC_DEF("SMS Ready", 0),
+    [URC_UNDER_VOLTAGE] = URC_DEF("UNDER-VOLTAGE WARNNING", 0),
+    [URC_OVER_VOLTAGE]  = URC_DEF("OVER-VOLTAGE WARNNING", 0),
+};
+
+#define URC_KEY_MAX     24   // ninguna clave es más larga
+#define URC_HASH_SIZE   64   // potencia de 2, > 2 * URC_COUNT
+#define URC_ITEM_MAX    512  // cabecera + cuerpo
+#define URC_QUEUE_LEN   8
+#define URC_TASK_STACK  8192
+
+// body es NULL salvo en los URC con URC_F_BODY
+typedef void (*urc_handler_t)(const char *line, const char *body);
+
+typedef void (*urc_call_t)(void);
+
+typedef struct {
+    uint8_t    id;
+    uint16_t   body;                 // desplazamiento del cuerpo en text, 0 si no hay
+    int64_t    t_us;                 // llegada de la línea
+    urc_call_t call;                 // trabajo diferido (urc_call), sin línea
+    char       text[URC_ITEM_MAX];   // "cabecera\0cuerpo\0"
+} urc_item_t;
+
+static struct {
+    urc_handler_t handler[URC_COUNT];
+    uint32_t      hits[URC_COUNT];
+    uint32_t      dropped;
+    uint8_t       index[URC_HASH_SIZE];   // id + 1; 0 = hueco
+    bool          pending;                // item espera su cuerpo
+    urc_item_t    item;
+    QueueHandle_t queue;
+} urc;
+
+static uint32_t urc_hash(const char *s, int len)
+{
+    uint32_t h = 2166136261u;              // FNV-1a
+    for (int i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+static void urc_init(void)
+{
+    memset(urc.index, 0, sizeof urc.index);
+    for (int id = 0; id < URC_COUNT; id++) {
+        uint32_t slot = urc_hash(URC_TABLE[id].key, URC_TABLE[id].len) & (URC_HASH_SIZE - 1);
+        while (urc.index[slot]) slot = (slot + 1) & (URC_HASH_SIZE - 1);
+        urc.index[slot] = id + 1;
+    }
+    urc.pending = false;
+    if (!urc.queue) urc.queue = xQueueCreate(URC_QUEUE_LEN, sizeof(urc_item_t));
+}
+
+static void urc_register(urc_id_t id, urc_handler_t h)
+{
+    if (id < URC_COUNT) urc.handler[id] = h;
+}
+
+// Identifica el URC por el inicio de la línea; -1 si no es ninguno
+static int urc_lookup(const char *line, int len)
+{
+    int klen;
+    if (line[0] == '+') {
+        const char *colon = memchr(line, ':', len < URC_KEY_MAX ? len : URC_KEY_MAX);
+        if (!colon) return -1;
+        klen = colon - line + 1;
+    } else {
+        if (len > URC_KEY_MAX) return -1;
+        klen = len;
+    }
+    uint32_t slot = urc_hash(line, klen) & (URC_HASH_SIZE - 1);
+    while (urc.index[slot]) {
+        const urc_def_t *d = &URC_TABLE[urc.index[slot] - 1];
+        if (d->len == klen && memcmp(d->key, line, klen) == 0) return urc.index[slot] - 1;
+        slot = (slot + 1) & (URC_HASH_SIZE - 1);
+    }
+    return -1;
+}
+
+static void urc_post(void)
+{
+    if (xQueueSend(urc.queue, &urc.item, pdMS_TO_TICKS(100)) != pdTRUE) {
+        urc.dropped++;
+        ESP_LOGW(URC_TAG, "Cola URC llena, se pierde: %s", urc.item.text);
+    }
+}
+
+/*
+ * Lado lector: devuelve true si la línea era el cuerpo de un URC de dos
+ * líneas recibido justo antes. Debe consultarse antes que el motor AT.
+ */
+static bool urc_take_body(const char *line)
+{
+    if (!urc.pending) return false;
+    urc.pending = false;
+    size_t off = strlen(urc.item.text) + 1;
+    snprintf(urc.item.text + off, sizeof urc.item.text - off, "%s", line);
+    urc.item.body = off;
+    urc_post();
+    return true;
+}
+
+// Lado lector: encola un URC ya identificado con urc_lookup()
+static void urc_feed(int id, const char *line, int64_t t_us)
+{
+    urc.hits[id]++;
+    urc.item.id = id;
+    urc.item.call = NULL;
+    urc.item.body = 0;
+    urc.item.t_us = t_us;
+    snprintf(urc.item.text, sizeof urc.item.text, "%.*s", (int)sizeof urc.item.text - 1, line);   // recortada a propósito
+    if (URC_TABLE[id].flags & URC_F_BODY) {
+        urc.pending = true;              // se encola al llegar el cuerpo
+        return;
+    }
+    urc_post();
+}
+
+/*
+ * Ejecuta fn en el contexto de urc_task, detrás de los URC ya encolados.
+ * Sirve para trabajo que necesita comandos AT síncronos y se pide desde
+ * otro sitio (p.ej. el callback de fin de arranque).
+ */
+static bool urc_call(urc_call_t fn)
+{
+    urc_item_t it = { .call = fn };
+    return xQueueSend(urc.queue, &it, pdMS_TO_TICKS(100)) == pdTRUE;
+}
+
+static void urc_task(void *arg)
+{
+    (void)arg;
+    static urc_item_t it;
+    for (;;) {
+        if (xQueueReceive(urc.queue, &it, portMAX_DELAY) != pdTRUE) continue;
+        if (it.call) {
+            it.call();
+            continue;
+        }
+        urc_handler_t h = urc.handler[it.id];
+        if (!h) {
+            ESP_LOGD(URC_TAG, "Sin manejador: %s", it.text);
+            continue;
+        }
+        h(it.text, it.body ? it.text + it.body : NULL);
+    }
+}
+
+#endif // URC_H
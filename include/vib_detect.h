@@ -0,0 +1,48 @@
+#ifndef VIB_DETECT_H
+#define VIB_DETECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Detector de vibración "N ráfagas en T ms".
+ *
+ * Guarda el instante de las últimas ráfagas (flancos ya filtrados y sin
+ * rebotes) en un anillo y dispara cuando la más reciente y la N-ésima
+ * anterior caben en la ventana. Las marcas viejas caducan solas al
+ * compararlas: no hace falta temporizador de ventana ni reiniciar nada.
+ * No depende de ESP-IDF.
+ */
+
+#define VIB_RING_LEN   8              // potencia de 2, >= umbral máximo
+
+typedef struct {
+    int64_t  t_us[VIB_RING_LEN];
+    uint32_t n;             // ráfagas desde el último disparo o reinicio
+    uint32_t bursts;        // totales (estadística)
+    uint32_t detections;
+} vib_detect_t;
+
+static inline void vib_detect_reset(vib_detect_t *d)
+{
+    d->n = 0;
+}
+
+/*
+ * Registra una ráfaga en t_us. Devuelve true si con ella hay `need`
+ * ráfagas dentro de window_us (y empieza a contar de cero).
+ */
+static bool vib_detect_feed(vib_detect_t *d, int64_t t_us, uint32_t need, int64_t window_us)
+{
+    d->t_us[d->n & (VIB_RING_LEN - 1)] = t_us;
+    d->n++;
+    d->bursts++;
+    if (need < 1 || need > VIB_RING_LEN || d->n < need) return false;
+    int64_t oldest = d->t_us[(d->n - need) & (VIB_RING_LEN - 1)];
+    if (t_us - oldest > window_us) return false;
+    d->n = 0;
+    d->detections++;
+    return true;
+}
+
+#endif // VIB_DETECT_H
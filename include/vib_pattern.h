@@ -0,0 +1,99 @@
+#ifndef VIB_PATTERN_H
+#define VIB_PATTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Clasificador de patrones de vibración sobre el sensor muestreado.
+ *
+ * Las muestras (0/1) se agrupan en bins de VP_BIN_MS con su "energía"
+ * (muestras activas en el bin). Para cada patrón se mide la periodicidad
+ * de esa señal con la autocorrelación: un avisador que vibra a pulsos con
+ * periodo P se parece mucho a sí mismo desplazado P y poco desplazado
+ * P/2; un golpe en la mesilla o un traqueteo irregular no. Todo en
+ * enteros. No depende de ESP-IDF.
+ *
+ *   confianza = (R(P)/(n-P) - R(P/2)/(n-P/2)) / (R(0)/n)     en Q8, 0..256
+ *
+ * con P el mejor retardo dentro de periodo ± tolerancia.
+ */
+
+#define VP_BIN_MS        20
+#define VP_MAX_BINS      160      // 3,2 s de ventana como mucho
+#define VP_MAX_PATTERNS  4
+#define VP_MIN_CYCLES    2        // la ventana debe abarcar al menos 2 periodos
+#define VP_MIN_ACTIVE    3        // bins con actividad por debajo: ni se evalúa
+
+typedef struct {
+    const char *name;
+    uint16_t    period_ms;   // cadencia del aviso
+    uint16_t    tol_ms;      // margen del periodo (cristal, temperatura, motor)
+} vp_pattern_t;
+
+typedef struct {
+    uint8_t  bins[VP_MAX_BINS];
+    uint16_t n;
+} vp_window_t;
+
+typedef struct {
+    int      best;                       // índice del patrón ganador, -1 si ninguno
+    uint16_t conf[VP_MAX_PATTERNS];      // Q8 por patrón
+    uint16_t period_ms[VP_MAX_PATTERNS]; // retardo elegido por patrón
+    uint16_t active_bins;
+} vp_result_t;
+
+// Σ x[i]·x[i+lag]
+static uint32_t vp_autocorr(const uint8_t *x, int n, int lag)
+{
+    uint32_t r = 0;
+    for (int i = 0; i + lag < n; i++) r += (uint32_t)x[i] * x[i + lag];
+    return r;
+}
+
+// Confianza Q8 de que la ventana tenga periodo `lag` bins
+static uint16_t vp_conf_at(const uint8_t *x, int n, int lag, uint32_t r0)
+{
+    int half = lag / 2;
+    if (lag < 2 || n < VP_MIN_CYCLES * lag || r0 == 0) return 0;
+    int64_t rp = vp_autocorr(x, n, lag);
+    int64_t rh = vp_autocorr(x, n, half);
+    // (rp/(n-lag) - rh/(n-half)) / (r0/n), sin divisiones intermedias
+    int64_t num = (rp * (n - half) - rh * (n - lag)) * n * 256;
+    int64_t den = (int64_t)r0 * (n - lag) * (n - half);
+    if (num <= 0) return 0;
+    int64_t q = num / den;
+    return q > 256 ? 256 : (uint16_t)q;
+}
+
+static void vp_classify(const vp_window_t *w, const vp_pattern_t *pats, int npats, vp_result_t *out)
+{
+    const uint8_t *x = w->bins;
+    int n = w->n;
+    out->best = -1;
+    out->active_bins = 0;
+    for (int i = 0; i < n; i++) if (x[i]) out->active_bins++;
+    uint32_t r0 = vp_autocorr(x, n, 0);
+
+    uint16_t best_conf = 0;
+    for (int p = 0; p < npats && p < VP_MAX_PATTERNS; p++) {
+        out->conf[p] = 0;
+        out->period_ms[p] = 0;
+        if (out->active_bins < VP_MIN_ACTIVE) continue;
+        int lo = (pats[p].period_ms - pats[p].tol_ms) / VP_BIN_MS;
+        int hi = (pats[p].period_ms + pats[p].tol_ms + VP_BIN_MS - 1) / VP_BIN_MS;
+        for (int lag = lo; lag <= hi; lag++) {
+            uint16_t c = vp_conf_at(x, n, lag, r0);
+            if (c > out->conf[p]) {
+                out->conf[p] = c;
+                out->period_ms[p] = (uint16_t)(lag * VP_BIN_MS);
+            }
+        }
+        if (out->conf[p] > best_conf) {
+            best_conf = out->conf[p];
+            out->best = p;
+        }
+    }
+}
+
+#endif // VIB_PATTERN_H
@@ -0,0 +1,129 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "adpcm.h"
+
+/*
+ * Cabecera RIFF/WAVE: recorre los chunks hasta encontrar "fmt " y "data".
+ *
+ * No se supone la cabecera de 44 bytes: los WAV exportados por muchos
+ * editores llevan LIST/fact/... entre fmt y data, y saltarse solo 44
+ * bytes mete la cabecera en el audio (el "clic" del principio). Se leen
+ * 12 bytes de cabecera, 8 por chunk y el cuerpo de fmt; nada más.
+ *
+ * Además de PCM de 16 bits se admite IMA-ADPCM (adpcm.h), que ocupa la
+ * cuarta parte y se decodifica al vuelo en audio_out.
+ *
+ * El fichero se lee a través de wav_read_fn (FILE, partición, memoria...).
+ * No depende de ESP-IDF.
+ */
+
+#define WAV_FMT_PCM          0x0001
+#define WAV_FMT_IMA_ADPCM    0x0011
+#define WAV_FMT_EXTENSIBLE   0xFFFE
+#define WAV_MIN_RATE         8000
+#define WAV_MAX_RATE         48000
+#define WAV_MAX_CHUNKS       16       // un fichero con más no es de los nuestros
+
+// Lee n bytes en off; devuelve 0 si los ha leído todos
+typedef int (*wav_read_fn)(void *ctx, uint32_t off, void *dst, size_t n);
+
+typedef struct {
+    uint16_t format;        // WAV_FMT_* (el de verdad, también en EXTENSIBLE)
+    uint16_t channels;
+    uint32_t rate;
+    uint16_t bits;
+    uint16_t block_align;   // PCM: bytes por trama; ADPCM: bytes por bloque
+    uint32_t data_off;      // primer byte de audio
+    uint32_t data_len;      // bytes de audio (PCM: múltiplo de block_align)
+    uint16_t chunks;        // chunks recorridos (estadística)
+} wav_info_t;
+
+typedef enum {
+    WAV_OK = 0,
+    WAV_ERR_IO,
+    WAV_ERR_RIFF,           // no empieza por RIFF....WAVE
+    WAV_ERR_NO_FMT,
+    WAV_ERR_FORMAT,         // códec, bits, canales o frecuencia no soportados
+    WAV_ERR_NO_DATA,
+} wav_status_t;
+
+static const char *const WAV_STATUS_NAME[] = {
+    "ok", "lectura", "no es RIFF/WAVE", "sin fmt", "formato no soportado", "sin data",
+};
+
+static inline uint16_t wav_le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static inline uint32_t wav_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Lo que sabe reproducir el I2S tal como está configurado (audio.h)
+static bool wav_supported(const wav_info_t *w)
+{
+    if (w->channels < 1 || w->channels > 2) return false;
+    if (w->rate < WAV_MIN_RATE || w->rate > WAV_MAX_RATE) return false;
+    if (w->format == WAV_FMT_IMA_ADPCM) {
+        // Bloques enteros de grupos de 4 bytes por canal, y que quepan en el búfer de audio_out
+        return w->bits == 4 && w->block_align > 4 * w->channels && w->block_align <= ADPCM_MAX_BLOCK &&
+               w->block_align % (4 * w->channels) == 0;
+    }
+    return w->format == WAV_FMT_PCM && w->bits == 16 && w->block_align == w->channels * 2;
+}
+
+/*
+ * Rellena w con el formato y la posición del audio. Un formato no
+ * soportado se rechaza en cuanto se lee fmt, sin seguir buscando data.
+ */
+static wav_status_t wav_parse(wav_read_fn rd, void *ctx, wav_info_t *w)
+{
+    uint8_t b[26];
+    memset(w, 0, sizeof *w);
+    if (rd(ctx, 0, b, 12) != 0) return WAV_ERR_IO;
+    if (memcmp(b, "RIFF", 4) != 0 || memcmp(b + 8, "WAVE", 4) != 0) return WAV_ERR_RIFF;
+    uint32_t riff = wav_le32(b + 4);
+    uint32_t end  = (riff < 4 || riff > UINT32_MAX - 8) ? UINT32_MAX : riff + 8;   // 0: sin cerrar
+
+    bool have_fmt = false;
+    uint32_t off = 12;
+    while (w->chunks < WAV_MAX_CHUNKS && off < end && end - off >= 8) {
+        if (rd(ctx, off, b, 8) != 0) break;                  // truncado
+        uint32_t size = wav_le32(b + 4);
+        uint32_t body = off + 8;
+        w->chunks++;
+
+        if (memcmp(b, "fmt ", 4) == 0) {
+            if (size < 16) return WAV_ERR_FORMAT;
+            size_t n = size >= 26 ? 26 : 16;                 // EXTENSIBLE: hasta el subformato
+            if (rd(ctx, body, b, n) != 0) return WAV_ERR_IO;
+            w->format      = wav_le16(b);
+            w->channels    = wav_le16(b + 2);
+            w->rate        = wav_le32(b + 4);
+            w->block_align = wav_le16(b + 12);
+            w->bits        = wav_le16(b + 14);
+            if (w->format == WAV_FMT_EXTENSIBLE && n == 26) w->format = wav_le16(b + 24);
+            if (!wav_supported(w)) return WAV_ERR_FORMAT;
+            have_fmt = true;
+        } else if (memcmp(b, "data", 4) == 0) {
+            if (!have_fmt) return WAV_ERR_NO_FMT;
+            // Tamaño 0 o 0xFFFFFFFF de grabaciones sin cerrar: hasta el final del RIFF
+            uint32_t avail = end - body;
+            uint32_t len = (size == 0 || size > avail) ? avail : size;
+            w->data_off = body;
+            // ADPCM: el último bloque puede venir corto y se decodifica igual
+            w->data_len = w->format == WAV_FMT_IMA_ADPCM ? len : len - len % w->block_align;
+            return w->data_len ? WAV_OK : WAV_ERR_NO_DATA;
+        }
+        if (size > end - body) break;
+        off = body + size + (size & 1);                      // los chunks van alineados a 2
+        if (off < body) break;
+    }
+    return have_fmt ? WAV_ERR_NO_DATA : WAV_ERR_NO_FMT;
+}
+
+#endif // WAV_H
@@ -4,16 +4,32 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "driver/gpio_filter.h"
 #include "driver/uart.h"
 #include "driver/i2s.h"   
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_cpu.h"
+#include "soc/soc_caps.h"
 
 #include "audio.h"
+#include "config_store.h"
+#include "event_log.h"
 #include "modem.h"
+#include "power.h"
+#include "isr_ring.h"
+#include "vib_detect.h"
+#include "vib_pattern.h"
 #include "secrets.h"
 
+// Mensajes del motor de alerta, con la misma etiqueta que el resto
+#define AC_LOGI(...)  ESP_LOGI("ALERT", __VA_ARGS__)
+#define AC_LOGW(...)  ESP_LOGW("ALERT", __VA_ARGS__)
+#define AC_LOGE(...)  ESP_LOGE("ALERT", __VA_ARGS__)
+#include "alert_core.h"
+
 // ==================== PINES / CONFIG ====================
 static const char *ALERT_TAG = "ALERT";
 static const char *MAIN_TAG  = "MAIN";
@@ -26,32 +42,55 @@ static const char *MAIN_TAG  = "MAIN";
 #define PIN_RELAY_VIB2    GPIO_NUM_10   // Vibrador 2
 #define PIN_RELAY_LIGHT   GPIO_NUM_11   // Lamparita (luz)
 
-// Futuro relé (reservado) 
+// Futuro relé (reservado)
 #define PIN_RELAY_EXTRA   GPIO_NUM_12
 
+// Relés como máscara: cada canal pide los suyos y relays_refresh() los combina
+#define RELAY_VIB1        (1u << 0)
+#define RELAY_VIB2        (1u << 1)
+#define RELAY_LIGHT       (1u << 2)
+#define RELAY_ALL         (RELAY_VIB1 | RELAY_VIB2 | RELAY_LIGHT)
+static const gpio_num_t RELAY_PINS[] = { PIN_RELAY_VIB1, PIN_RELAY_VIB2, PIN_RELAY_LIGHT };
+
 // Otros pines
 #define PIN_BTN_RESET     GPIO_NUM_4    // botón (pull-up, activo a GND)
 #define PIN_ARM_SENSE     GPIO_NUM_3    // lector puentea a GND (activo-bajo)
 
 // Lógicas
-#define RELAY_ACTIVE_HIGH_DEFAULT  0    // 0 = activo-bajo (LOW=ON), 1 = activo-alto
 #define SENSOR_ACTIVE_HIGH         1
 #define BTN_ACTIVE_LOW             1
 #define ARM_ACTIVE_WHEN_HIGH       0
 
-// Antirruido del sensor
-#define VIB_WINDOW_MS           800
-#define VIB_THRESHOLD           3
+// Histéresis del lector (ARM_INSERT_MS / ARM_REMOVE_MS): alert_core.h
+
+// Antirruido del sensor: cfg()->vib_threshold ráfagas en cfg()->vib_window_ms.
+// Tras cada flanco la interrupción queda muda VIB_DEBOUNCE_MS (una ráfaga = un evento)
+#define VIB_DEBOUNCE_MS         20
+#define VIB_GLITCH_NS           600     // filtro hardware de pulsos cortos
+
+// Modo patrón (cfg()->vib_mode = 1): la primera ráfaga con el lector puesto
+// abre una ventana en la que se muestrea el sensor a ritmo fijo; al cerrarla
+// vib_pattern.h decide si es el aviso del lector o un golpe
+#define VIB_SAMPLE_US           5000    // 200 Hz
+#define VIB_SAMPLES_PER_BIN     (VP_BIN_MS * 1000 / VIB_SAMPLE_US)
+#define VIB_PATTERN_WINDOW_MS   3000
+#define VIB_PATTERN_BINS        (VIB_PATTERN_WINDOW_MS / VP_BIN_MS)
+_Static_assert(VIB_PATTERN_BINS <= VP_MAX_BINS, "ventana de patrón demasiado larga");
 
-// Tiempos
-#define ATTEND_TIMEOUT_MS       30000
-#define CALL_PLAY_MS            12000
-#define LAMP_ON_MS              30000
+// Cadencias de aviso de los lectores. Medidas con el sensor sobre el lector
+// sonando; añadir aquí otros modelos
+static const vp_pattern_t VIB_PATTERNS[] = {
+    { "lector_alarma", 500,  60  },   // pulsos de ~200 ms cada 500 ms
+    { "lector_aviso",  1000, 100 },
+};
+#define VIB_PATTERN_COUNT  (sizeof VIB_PATTERNS / sizeof VIB_PATTERNS[0])
+
+// Umbrales, tiempos (atender, llamada, lámpara) y polaridad de relés: config_store.h
 
 // Módem (UART1)
 #define MODEM_TX_PIN  GPIO_NUM_6
- 
-#define MODEM_BAUD    115200
+#define MODEM_RX_PIN  GPIO_NUM_7
+// MODEM_BAUD, RTS/CTS y velocidades candidatas: modem_link.h
 const uart_port_t MODEM_UART = UART_NUM_1;
 
 // I2S (audio.h usa legacy)
@@ -59,181 +98,585 @@ const uart_port_t MODEM_UART = UART_NUM_1;
 #define I2S_NUM I2S_NUM_0
 #endif
 
+// ==================== CANALES ====================
+/*
+ * Un canal = un lector vigilado: su sensor, su pin de "lector puesto", los
+ * relés que enciende su alarma y a quién se llama. Añadir uno es añadir
+ * una fila. Cada ISR recibe el índice de su canal como argumento, así que
+ * un flanco cuesta lo mismo con uno que con muchos canales. Los pines que
+ * deban despertar del light sleep tienen que ser LP (0..7).
+ */
+#define ESC_CONTACTS    2
+
+typedef struct {
+    const char *name;
+    gpio_num_t  sensor_pin;
+    gpio_num_t  arm_pin;
+    uint8_t     relays;                    // RELAY_* que enciende la alarma
+    const char *contacts[ESC_CONTACTS];    // por orden; NULL = sin más
+} alert_channel_desc_t;
+
+static const alert_channel_desc_t CHANNELS[] = {
+    { "cama1", PIN_VIB_SENSOR, PIN_ARM_SENSE, RELAY_ALL, { NUM1, NUM2 } },
+    // { "cama2", <sensor>, <lector>, RELAY_VIB2 | RELAY_LIGHT, { NUM2, NUM1 } },
+};
+#define CH_COUNT   (sizeof CHANNELS / sizeof CHANNELS[0])
+#define CH_MAX     AC_CH_MAX               // máscaras de 32 bits; potencia de 2
+_Static_assert(CH_COUNT <= CH_MAX, "demasiados canales");
+
 // ==================== ESTADO / GLOBALES ====================
-typedef enum { ST_IDLE=0, ST_ARMED, ST_ALARM, ST_CALLING } alert_state_t;
-static volatile alert_state_t g_state = ST_IDLE;
+// La máquina de estados de los canales vive en alert_core.h (g_core);
+// aquí queda lo que es del hardware. Solo lo toca alert_task
+typedef struct {
+    int64_t       vib_rearm_us;     // cuándo reactivar la interrupción del sensor
+    vp_window_t   win;              // modo patrón: lo llena el muestreador
+    uint8_t       acc, acc_n;       // bin en curso (muestras activas / tomadas)
+    TimerHandle_t timer_alarm;      // sin atender → llamadas
+    TimerHandle_t timer_arm;        // histéresis del lector
+} alert_channel_t;
+static alert_channel_t g_ch[CH_COUNT];
+
+// Canales cuyo sensor espera reactivación, en orden de vencimiento: todos
+// vencen VIB_DEBOUNCE_MS después de su evento, así que basta una FIFO
+static uint8_t  g_rearm_q[CH_MAX];
+static uint32_t g_rearm_head, g_rearm_tail;
+
+// Máscaras por canal que dejan los temporizadores y el escalado para alert_task
+static uint32_t g_attend_mask;      // venció el tiempo para atender
+static uint32_t g_arm_mask;         // lector estable tras la histéresis
+static uint32_t g_called_mask;      // escalado terminado sin cancelar
+static uint32_t g_sampled_mask;     // ventana de patrón completa
+
+// Muestreador del modo patrón: un esp_timer periódico mientras algún canal muestrea
+static esp_timer_handle_t g_vib_sampler = NULL;
+static uint32_t g_sampling_mask;    // canales muestreando (el muestreador borra su bit al acabar)
+static bool     g_sampler_running;  // alert_task
+
+typedef struct {
+    uint32_t windows;
+    uint32_t matches;
+    uint64_t sum_cycles;     // clasificación
+    uint32_t max_cycles;
+    uint64_t bins;
+} vp_stats_t;
+static vp_stats_t g_vp_stats;
 
-static TimerHandle_t g_timer_alarm      = NULL;
 static TimerHandle_t g_timer_lamp       = NULL;
-static TimerHandle_t g_timer_vib_window = NULL;
 static TimerHandle_t g_timer_test       = NULL;
 
-static volatile uint16_t g_vib_count = 0;
-static volatile bool g_test_active   = false;
-
-// Polaridad runtime (0=activo-bajo, 1=activo-alto)
-static volatile int g_relay_active_high = RELAY_ACTIVE_HIGH_DEFAULT;
+// Escalado (llamadas): su propia tarea, guiada por una cola de eventos
+typedef enum { ESC_EV_START = 0, ESC_EV_CANCEL, ESC_EV_CALL_DONE } esc_event_type_t;
+typedef struct {
+    uint8_t       type;
+    uint8_t       ch;         // ESC_EV_START
+    call_result_t result;     // ESC_EV_CALL_DONE
+} esc_event_t;
+#define ESC_QUEUE_LEN    8
+#define ESC_TASK_STACK   4096
+static QueueHandle_t g_esc_queue = NULL;
+static uint32_t      g_esc_pending;          // canales esperando turno (escalation_task)
+static volatile bool g_esc_running = false;
+
+// Retraso de disparo de los temporizadores (comprueba que nada bloquea el daemon)
+typedef struct {
+    volatile int64_t due_us;
+    int64_t  max_late_us;
+    int64_t  sum_late_us;
+    uint32_t fired;
+} timer_jitter_t;
+static timer_jitter_t g_jit_lamp, g_jit_test;
+
+// Motor de alerta: las ISR solo encolan; alert_task hace todo lo demás
+typedef enum { ISR_EV_BTN = 0, ISR_EV_SENSOR, ISR_EV_ARM, ISR_EV_COUNT } isr_ev_type_t;
+static const char *const ISR_EV_NAME[ISR_EV_COUNT] = { "botón", "sensor", "lector" };
+
+#define ALERT_TASK_STACK   4096
+#define ALERT_STATS_EVERY  50        // eventos entre resúmenes de latencia
+// Bits de notificación de alert_task
+#define ALERT_N_RING       (1u << 0) // hay eventos en g_isr_ring
+#define ALERT_N_ARM        (1u << 1) // g_arm_mask
+#define ALERT_N_ATTEND     (1u << 2) // g_attend_mask
+#define ALERT_N_LAMP       (1u << 3)
+#define ALERT_N_TEST       (1u << 4)
+#define ALERT_N_CALLED     (1u << 5) // g_called_mask
+#define ALERT_N_SAMPLED    (1u << 6) // g_sampled_mask
+#define ALERT_N_FORCE      (1u << 7) // g_force_req
+
+static isr_ring_t   g_isr_ring;
+static TaskHandle_t g_alert_task = NULL;
+
+typedef struct {
+    uint32_t n;
+    uint32_t max_cycles;     // duración de la ISR
+    uint64_t sum_cycles;
+    int64_t  max_lat_us;     // interrupción → acción hecha en alert_task
+    int64_t  sum_lat_us;
+    uint32_t handled;
+} isr_stats_t;
+static isr_stats_t g_isr_stats[ISR_EV_COUNT];
+
+static uint32_t g_alert_wakeups = 0;
+
+// Motor de alerta (alert_core.h). Solo lo toca alert_task
+static const alert_hal_t g_alert_hal;
+static alert_core_t g_core = { .hal = &g_alert_hal, .light = RELAY_LIGHT };
+
+// Prueba/forzado por SMS (urc_task): pendiente en bit 31, relés en 24..30 y
+// ms en 0..23. Lo aplica alert_task; si aún no existe, al arrancar
+#define FORCE_PENDING  (1u << 31)
+#define FORCE_MS_MAX   0xFFFFFFu
+static uint32_t g_force_req;
 
 // ==================== PROTOTIPOS NECESARIOS (callbacks y exports) ====================
-static void vTimerVibWindowTimeout(TimerHandle_t xTimer);
 static void vTimerAlarmTimeout(TimerHandle_t xTimer);
 static void vTimerLampTimeout(TimerHandle_t xTimer);
 static void vTimerTestTimeout(TimerHandle_t xTimer);
+static void vTimerArmDebounce(TimerHandle_t xTimer);
+static void vib_sampling_start(int ch);
 
 // Exportadas para SMS (8/41/42/43/44/90/91)
 void alert_test_start(uint32_t ms);
 void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms);
 void set_relay_polarity(int active_high);
-int  get_relay_polarity(void) { return g_relay_active_high; }
+int  get_relay_polarity(void) { return cfg()->relay_active_high; }
 
 // Módem / audio
 void      modem_task(void *arg);
 esp_err_t modem_init(void);
-esp_err_t modem_dial(const char *number);
 void      modem_hangup(void);
-void      audio_play_wav(const char *path);
 
 // ==================== HELPERS GPIO ====================
 static inline void relay_write(gpio_num_t pin, bool on) {
-    int level = g_relay_active_high ? (on ? 1 : 0) : (on ? 0 : 1);
+    int level = cfg()->relay_active_high ? (on ? 1 : 0) : (on ? 0 : 1);
     gpio_set_level(pin, level);
 }
-static inline void relays_set(bool vib1, bool vib2, bool lamp) {
-    relay_write(PIN_RELAY_VIB1, vib1);
-    relay_write(PIN_RELAY_VIB2, vib2);
-    relay_write(PIN_RELAY_LIGHT, lamp);
-}
-static inline void lamp_set(bool on) { relay_write(PIN_RELAY_LIGHT, on); }
 
-static inline bool read_sensor_active(void) {
-    int v = gpio_get_level(PIN_VIB_SENSOR);
-    return SENSOR_ACTIVE_HIGH ? (v==1) : (v==0);
-}
-static inline bool read_button_pressed(void) {
-    int v = gpio_get_level(PIN_BTN_RESET);
-    return BTN_ACTIVE_LOW ? (v==0) : (v==1);
-}
-static inline bool read_arm_present(void) {
-    int v = gpio_get_level(PIN_ARM_SENSE);
+static inline bool read_arm_present(int ch) {
+    int v = gpio_get_level(CHANNELS[ch].arm_pin);
     return ARM_ACTIVE_WHEN_HIGH ? (v==1) : (v==0);
 }
 
-// ==================== ESTADOS ====================
-static void enter_idle(void) {
-    g_state = ST_IDLE;
-    if (g_timer_alarm) xTimerStop(g_timer_alarm, 0);
-    if (!g_test_active) relays_set(false,false,false);
-    ESP_LOGI(ALERT_TAG, "Estado: IDLE (lector ausente)");
-}
-static void enter_armed(void) {
-    g_state = ST_ARMED;
-    if (g_timer_alarm) xTimerStop(g_timer_alarm, 0);
-    if (!g_test_active) relays_set(false,false,false);
-    ESP_LOGI(ALERT_TAG, "Estado: ARMED (lector presente)");
+// Recorre los bits de una máscara de canales
+#define FOR_EACH_CH(mask, ch) \
+    for (uint32_t _m = (mask), ch; _m && ((ch = __builtin_ctz(_m)), 1); _m &= _m - 1)
+
+// Deja una máscara para alert_task y la despierta (contexto de tarea)
+static inline void alert_post(uint32_t *mask, int ch, uint32_t bit) {
+    __atomic_fetch_or(mask, 1u << ch, __ATOMIC_RELEASE);
+    xTaskNotify(g_alert_task, bit, eSetBits);
 }
 
 // ==================== TIMERS ====================
-static void vTimerVibWindowTimeout(TimerHandle_t xTimer) {
-    g_vib_count = 0;
+// Los callbacks solo avisan a alert_task (el lamp/test miden además su retraso)
+static inline void jitter_arm(timer_jitter_t *j, uint32_t ms) {
+    j->due_us = esp_timer_get_time() + (int64_t)ms * 1000;
+}
+static void jitter_fire(timer_jitter_t *j, const char *name) {
+    int64_t late = esp_timer_get_time() - j->due_us;
+    j->fired++;
+    j->sum_late_us += late;
+    if (late > j->max_late_us) j->max_late_us = late;
+    ESP_LOGI(ALERT_TAG, "%s: disparo con %lld ms de retraso (media %lld, máx %lld)%s", name,
+             (long long)(late / 1000), (long long)(j->sum_late_us / j->fired / 1000),
+             (long long)(j->max_late_us / 1000), g_esc_running ? " [en llamada]" : "");
 }
+
+// Los de canal llevan su índice como ID
 static void vTimerAlarmTimeout(TimerHandle_t xTimer) {
-    if (g_state != ST_ALARM) return;
-    ESP_LOGW(ALERT_TAG, "No atendida en 30s → llamadas");
-    g_state = ST_CALLING;
-
-    const char *numbers[] = { NUM1, NUM2 };
-    for (int i=0; i<2; i++) {
-        ESP_LOGI(ALERT_TAG, "Llamando a %s …", numbers[i]);
-        if (modem_dial(numbers[i]) == ESP_OK) {
-            vTaskDelay(pdMS_TO_TICKS(2500));
-            audio_play_wav("/sdcard/alert.wav");
-            vTaskDelay(pdMS_TO_TICKS(CALL_PLAY_MS));
-            modem_hangup();
-        }
-        vTaskDelay(pdMS_TO_TICKS(800));
-    }
-    relays_set(false,false,true);  // vib OFF, lámpara ON fija
+    alert_post(&g_attend_mask, (int)(intptr_t)pvTimerGetTimerID(xTimer), ALERT_N_ATTEND);
 }
 static void vTimerLampTimeout(TimerHandle_t xTimer) {
-    lamp_set(false);
-    ESP_LOGI(ALERT_TAG, "Lamparita OFF (timeout)");
+    jitter_fire(&g_jit_lamp, "lamp_tmo");
+    xTaskNotify(g_alert_task, ALERT_N_LAMP, eSetBits);
 }
 static void vTimerTestTimeout(TimerHandle_t xTimer) {
-    g_test_active = false;
-    relays_set(false,false,false);
-    ESP_LOGI(ALERT_TAG, "TEST/FORCE: FIN (relés OFF)");
+    jitter_fire(&g_jit_test, "test_tmo");
+    xTaskNotify(g_alert_task, ALERT_N_TEST, eSetBits);
+}
+static void vTimerArmDebounce(TimerHandle_t xTimer) {
+    alert_post(&g_arm_mask, (int)(intptr_t)pvTimerGetTimerID(xTimer), ALERT_N_ARM);
+}
+
+// ==================== HAL DEL MOTOR ====================
+// Lo que alert_core.h pide al hardware: pines, FreeRTOS, escalado y diario
+static int64_t hal_now_us(void *ctx) { return esp_timer_get_time(); }
+static const app_config_t *hal_cfg(void *ctx) { return cfg(); }
+static bool hal_arm_present(void *ctx, int ch) { return read_arm_present(ch); }
+
+static void hal_relays(void *ctx, uint8_t out) {
+    for (size_t i = 0; i < sizeof RELAY_PINS / sizeof RELAY_PINS[0]; i++) {
+        relay_write(RELAY_PINS[i], out & (1u << i));
+    }
+}
+
+static TimerHandle_t hal_timer(ac_timer_t t, int ch) {
+    switch (t) {
+    case AC_T_ATTEND: return g_ch[ch].timer_alarm;
+    case AC_T_ARM:    return g_ch[ch].timer_arm;
+    case AC_T_LAMP:   return g_timer_lamp;
+    case AC_T_TEST:   return g_timer_test;
+    default:          return NULL;
+    }
+}
+static void hal_timer_start(void *ctx, ac_timer_t t, int ch, uint32_t ms) {
+    TimerHandle_t h = hal_timer(t, ch);
+    if (!h) return;
+    xTimerChangePeriod(h, pdMS_TO_TICKS(ms), 0);   // también lo (re)arranca
+    if (t == AC_T_LAMP) jitter_arm(&g_jit_lamp, ms);
+    if (t == AC_T_TEST) jitter_arm(&g_jit_test, ms);
+}
+static void hal_timer_stop(void *ctx, ac_timer_t t, int ch) {
+    TimerHandle_t h = hal_timer(t, ch);
+    if (h) xTimerStop(h, 0);
+}
+
+static void hal_escalate(void *ctx, int ch) {
+    esc_event_t ev = { .type = ESC_EV_START, .ch = (uint8_t)ch };
+    xQueueSend(g_esc_queue, &ev, 0);
+}
+static void hal_cancel(void *ctx) {
+    esc_event_t ev = { .type = ESC_EV_CANCEL };
+    xQueueSend(g_esc_queue, &ev, 0);
 }
+static void hal_sample(void *ctx, int ch) { vib_sampling_start(ch); }
+
+// Despierta del light sleep cuando el lector cambie respecto a lo aceptado
+static void hal_arm_changed(void *ctx, int ch, bool present) {
+    int level = ARM_ACTIVE_WHEN_HIGH ? present : !present;   // nivel aceptado, no el de ahora (puede rebotar)
+    power_wake_on_level(CHANNELS[ch].arm_pin, !level);
+}
+static void hal_note(void *ctx, jr_event_t type, int ch, uint16_t arg) {
+    event_log(type, (uint8_t)ch, arg);
+}
+
+static const alert_hal_t g_alert_hal = {
+    .now_us      = hal_now_us,
+    .cfg         = hal_cfg,
+    .arm_present = hal_arm_present,
+    .relays      = hal_relays,
+    .timer_start = hal_timer_start,
+    .timer_stop  = hal_timer_stop,
+    .escalate    = hal_escalate,
+    .cancel      = hal_cancel,
+    .sample      = hal_sample,
+    .arm_changed = hal_arm_changed,
+    .note        = hal_note,
+};
 
 // ==================== ISR ====================
-static void IRAM_ATTR isr_btn(void *arg) {
-    if (g_test_active) { // cancelar test/forzado si estaba activo
-        BaseType_t hpw2 = pdFALSE;
-        relays_set(false,false,false);
-        if (g_timer_test) xTimerStopFromISR(g_timer_test, &hpw2);
-        g_test_active = false;
-        if (hpw2) portYIELD_FROM_ISR();
+// Solo registran el evento con su canal e instante y despiertan a alert_task
+static void IRAM_ATTR isr_notify(uint8_t type, uint32_t c0) {
+    BaseType_t hpw = pdFALSE;
+    xTaskNotifyFromISR(g_alert_task, ALERT_N_RING, eSetBits, &hpw);
+    isr_stats_t *st = &g_isr_stats[type];
+    uint32_t dc = esp_cpu_get_cycle_count() - c0;
+    st->n++;
+    st->sum_cycles += dc;
+    if (dc > st->max_cycles) st->max_cycles = dc;
+    if (hpw) portYIELD_FROM_ISR();
+}
+
+static void IRAM_ATTR isr_push(uint8_t type, uint8_t ch, gpio_num_t pin) {
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    isr_ring_push(&g_isr_ring, type, ch, gpio_get_level(pin));
+    isr_notify(type, c0);
+}
+
+static void IRAM_ATTR isr_btn(void *arg) { isr_push(ISR_EV_BTN, 0, PIN_BTN_RESET); }
+static void IRAM_ATTR isr_arm(void *arg) {
+    uint8_t ch = (uint8_t)(uintptr_t)arg;
+    isr_push(ISR_EV_ARM, ch, CHANNELS[ch].arm_pin);
+}
+static void IRAM_ATTR isr_sensor(void *arg) {
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    uint8_t ch = (uint8_t)(uintptr_t)arg;
+    // Se calla hasta que on_sensor la reactive; con el anillo lleno sigue activa
+    isr_ring_push_mute(&g_isr_ring, ISR_EV_SENSOR, ch, CHANNELS[ch].sensor_pin);
+    isr_notify(ISR_EV_SENSOR, c0);
+}
+
+// Muestreo del modo patrón (tarea de esp_timer): un bin cada VIB_SAMPLES_PER_BIN muestras
+static void vib_sampler_cb(void *arg) {
+    uint32_t mask = __atomic_load_n(&g_sampling_mask, __ATOMIC_ACQUIRE);
+    FOR_EACH_CH(mask, ch) {
+        alert_channel_t *c = &g_ch[ch];
+        int v = gpio_get_level(CHANNELS[ch].sensor_pin);
+        c->acc += SENSOR_ACTIVE_HIGH ? (v == 1) : (v == 0);
+        if (++c->acc_n < VIB_SAMPLES_PER_BIN) continue;
+        c->win.bins[c->win.n++] = c->acc;
+        c->acc = c->acc_n = 0;
+        if (c->win.n < VIB_PATTERN_BINS) continue;
+        __atomic_fetch_and(&g_sampling_mask, ~(1u << ch), __ATOMIC_RELEASE);
+        alert_post(&g_sampled_mask, ch, ALERT_N_SAMPLED);
+    }
+}
+
+// ==================== MOTOR DE ALERTA ====================
+static void vib_sampling_start(int ch) {
+    alert_channel_t *c = &g_ch[ch];
+    if (__atomic_load_n(&g_sampling_mask, __ATOMIC_ACQUIRE) & (1u << ch)) return;   // ya muestrea
+    c->win.n = 0;
+    c->acc = c->acc_n = 0;
+    __atomic_fetch_or(&g_sampling_mask, 1u << ch, __ATOMIC_RELEASE);
+    if (!g_sampler_running) {
+        g_sampler_running = esp_timer_start_periodic(g_vib_sampler, VIB_SAMPLE_US) == ESP_OK;
+    }
+}
+
+// Ventana completa: clasificar
+static void on_sampled(int ch) {
+    alert_channel_t *c = &g_ch[ch];
+    if (g_sampler_running && !__atomic_load_n(&g_sampling_mask, __ATOMIC_ACQUIRE)) {
+        esp_timer_stop(g_vib_sampler);   // solo alert_task pone bits: nadie más lo necesita
+        g_sampler_running = false;
+    }
+    vp_result_t r;
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    vp_classify(&c->win, VIB_PATTERNS, VIB_PATTERN_COUNT, &r);
+    uint32_t dc = esp_cpu_get_cycle_count() - c0;
+    g_vp_stats.windows++;
+    g_vp_stats.bins += c->win.n;
+    g_vp_stats.sum_cycles += dc;
+    if (dc > g_vp_stats.max_cycles) g_vp_stats.max_cycles = dc;
+
+    char conf[64];
+    int n = 0;
+    for (size_t p = 0; p < VIB_PATTERN_COUNT && n < (int)sizeof conf; p++) {
+        n += snprintf(conf + n, sizeof conf - n, " %s=%u/256@%ums", VIB_PATTERNS[p].name,
+                      (unsigned)r.conf[p], (unsigned)r.period_ms[p]);
+    }
+    ESP_LOGI(ALERT_TAG, "%s: patrón (%u bins activos, %u ciclos):%s", CHANNELS[ch].name,
+             (unsigned)r.active_bins, (unsigned)dc, conf);
+
+    if (alert_core_pattern(&g_core, ch, &r, VIB_PATTERNS)) g_vp_stats.matches++;
+}
+
+// Rearma la interrupción del sensor tras el antirrebote y pasa la ráfaga al motor
+static void on_sensor(const isr_event_t *e) {
+    alert_channel_t *c = &g_ch[e->ch];
+    c->vib_rearm_us = e->t_us + (int64_t)VIB_DEBOUNCE_MS * 1000;
+    g_rearm_q[g_rearm_head++ & (CH_MAX - 1)] = e->ch;   // como mucho una vez por canal
+    alert_core_sensor(&g_core, e->ch, e->t_us);
+}
+
+static void isr_stats_log(void) {
+    for (int t = 0; t < ISR_EV_COUNT; t++) {
+        const isr_stats_t *st = &g_isr_stats[t];
+        if (!st->handled) continue;
+        ESP_LOGI(ALERT_TAG, "ISR %s: %u eventos, %u/%u ciclos (media/máx), acción a %lld/%lld us",
+                 ISR_EV_NAME[t], (unsigned)st->n,
+                 (unsigned)(st->sum_cycles / (st->n ? st->n : 1)), (unsigned)st->max_cycles,
+                 (long long)(st->sum_lat_us / st->handled), (long long)st->max_lat_us);
     }
-    if (read_button_pressed()) {
-        BaseType_t hpw = pdFALSE;
-        lamp_set(true);
-        if (g_timer_lamp) {
-            xTimerStopFromISR(g_timer_lamp, &hpw);
-            xTimerStartFromISR(g_timer_lamp, &hpw);
+    for (size_t ch = 0; ch < CH_COUNT; ch++) {
+        const vib_detect_t *v = &g_core.ch[ch].vib;
+        if (!v->bursts) continue;
+        ESP_LOGI(ALERT_TAG, "%s: %u ráfagas, %u alertas", CHANNELS[ch].name,
+                 (unsigned)v->bursts, (unsigned)v->detections);
+    }
+    if (g_vp_stats.windows) {
+        ESP_LOGI(ALERT_TAG, "Patrones: %u ventanas, %u alarmas, %llu/%u ciclos por ventana (media/máx), %llu ciclos/bin",
+                 (unsigned)g_vp_stats.windows, (unsigned)g_vp_stats.matches,
+                 (unsigned long long)(g_vp_stats.sum_cycles / g_vp_stats.windows), (unsigned)g_vp_stats.max_cycles,
+                 (unsigned long long)(g_vp_stats.bins ? g_vp_stats.sum_cycles / g_vp_stats.bins : 0));
+    }
+    if (g_isr_ring.dropped) ESP_LOGW(ALERT_TAG, "Anillo ISR: %u eventos perdidos", (unsigned)g_isr_ring.dropped);
+    int64_t up_s = esp_timer_get_time() / 1000000;
+    ESP_LOGI(ALERT_TAG, "alert_task: %u despertares en %lld s (%lld/h)", (unsigned)g_alert_wakeups,
+             (long long)up_s, (long long)(up_s ? (int64_t)g_alert_wakeups * 3600 / up_s : 0));
+    power_stats_log();
+}
+
+static void alert_handle_event(const isr_event_t *e) {
+    if (e->ch >= CH_COUNT) return;
+    if (e->type == ISR_EV_BTN) {
+        alert_core_button(&g_core, BTN_ACTIVE_LOW ? (e->level == 0) : (e->level == 1));
+    } else if (e->type == ISR_EV_SENSOR) {
+        on_sensor(e);
+    } else if (e->type == ISR_EV_ARM) {
+        alert_core_arm_edge(&g_core, e->ch, ARM_ACTIVE_WHEN_HIGH ? (e->level == 1) : (e->level == 0), e->t_us);
+    } else {
+        return;
+    }
+
+    isr_stats_t *st = &g_isr_stats[e->type];
+    int64_t lat = esp_timer_get_time() - e->t_us;
+    st->handled++;
+    st->sum_lat_us += lat;
+    if (lat > st->max_lat_us) st->max_lat_us = lat;
+    if (e->type == ISR_EV_BTN) {
+        ESP_LOGI(ALERT_TAG, "Botón atendido en %lld us desde la interrupción", (long long)lat);
+    }
+    static uint32_t total;
+    if (++total % ALERT_STATS_EVERY == 0) isr_stats_log();
+}
+
+// Reactiva los sensores ya vencidos; devuelve la espera hasta el siguiente
+static TickType_t alert_rearm_due(void) {
+    while (g_rearm_tail != g_rearm_head) {
+        uint8_t ch = g_rearm_q[g_rearm_tail & (CH_MAX - 1)];
+        int64_t left = g_ch[ch].vib_rearm_us - esp_timer_get_time();
+        if (left > 0) return pdMS_TO_TICKS(left / 1000) + 1;
+        g_rearm_tail++;
+        g_ch[ch].vib_rearm_us = 0;
+        gpio_intr_enable(CHANNELS[ch].sensor_pin);
+    }
+    return portMAX_DELAY;
+}
+
+static void alert_task(void *arg) {
+    TickType_t wait = portMAX_DELAY;
+    // Una prueba por SMS anterior a la tarea no tenía a quién avisar
+    __atomic_store_n(&g_alert_task, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+    xTaskNotify(g_alert_task, ALERT_N_FORCE, eSetBits);
+    for (;;) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+        g_alert_wakeups++;
+
+        // Primero lo que ya venció; luego los eventos nuevos del anillo
+        alert_rearm_due();
+        if (bits & ALERT_N_ARM) {
+            FOR_EACH_CH(__atomic_exchange_n(&g_arm_mask, 0, __ATOMIC_ACQUIRE), ch) alert_core_timeout(&g_core, AC_T_ARM, ch);
+        }
+        if (bits & ALERT_N_ATTEND) {
+            FOR_EACH_CH(__atomic_exchange_n(&g_attend_mask, 0, __ATOMIC_ACQUIRE), ch) alert_core_timeout(&g_core, AC_T_ATTEND, ch);
         }
-        if (g_state == ST_ALARM || g_state == ST_CALLING) {
-            relays_set(false,false,false);
-            if (g_timer_alarm) xTimerStopFromISR(g_timer_alarm, &hpw);
-            modem_hangup();
-            g_state = read_arm_present() ? ST_ARMED : ST_IDLE;
-            ESP_EARLY_LOGI(ALERT_TAG, "Atendido por botón. Lámpara ON %d ms.", LAMP_ON_MS);
+        if (bits & ALERT_N_SAMPLED) {
+            FOR_EACH_CH(__atomic_exchange_n(&g_sampled_mask, 0, __ATOMIC_ACQUIRE), ch) on_sampled(ch);
         }
-        if (hpw) portYIELD_FROM_ISR();
+        if (bits & ALERT_N_CALLED) {
+            FOR_EACH_CH(__atomic_exchange_n(&g_called_mask, 0, __ATOMIC_ACQUIRE), ch) alert_core_called(&g_core, ch);
+        }
+        if (bits & ALERT_N_LAMP) alert_core_timeout(&g_core, AC_T_LAMP, 0);
+        if (bits & ALERT_N_TEST) alert_core_timeout(&g_core, AC_T_TEST, 0);
+        if (bits & ALERT_N_FORCE) {
+            uint32_t r = __atomic_exchange_n(&g_force_req, 0, __ATOMIC_ACQUIRE);
+            if (r & FORCE_PENDING) alert_core_test(&g_core, (r >> 24) & 0x7F, r & FORCE_MS_MAX);
+        }
+        if (bits & ALERT_N_RING) {
+            isr_event_t e;
+            while (isr_ring_pop(&g_isr_ring, &e)) alert_handle_event(&e);
+        }
+        wait = alert_rearm_due();
     }
 }
 
-static void IRAM_ATTR isr_sensor(void *arg) {
-    if (g_test_active) return; // ignora durante test/forzado
-    if (g_state == ST_ARMED && read_arm_present()) {
-        uint16_t c = ++g_vib_count;
-        BaseType_t hpw = pdFALSE;
-        if (g_timer_vib_window) {
-            xTimerStopFromISR(g_timer_vib_window, &hpw);
-            xTimerStartFromISR(g_timer_vib_window, &hpw);
+// ==================== TAREAS ====================
+static void esc_call_done(call_result_t r, void *ctx) {
+    (void)ctx;
+    esc_event_t ev = { .type = ESC_EV_CALL_DONE, .result = r };
+    xQueueSend(g_esc_queue, &ev, portMAX_DELAY);
+}
+
+// Anota un evento que llega con el escalado en marcha; true si cancela
+static bool esc_note(const esc_event_t *ev) {
+    if (ev->type == ESC_EV_START && ev->ch < CH_COUNT) g_esc_pending |= 1u << ev->ch;
+    if (ev->type != ESC_EV_CANCEL) return false;
+    g_esc_pending = 0;   // el botón atiende todos los canales
+    return true;
+}
+
+static void escalation_run(int ch) {
+    const alert_channel_desc_t *d = &CHANNELS[ch];
+    int64_t t_start = esp_timer_get_time();
+    bool cancelled = false;
+    for (int i=0; i<ESC_CONTACTS && d->contacts[i] && !cancelled; i++) {
+        ESP_LOGI(ALERT_TAG, "%s: llamando a %s …", d->name, d->contacts[i]);
+        if (!modem_call_start(d->contacts[i], esc_call_done, NULL)) continue;
+
+        // Mientras suena se siguen atendiendo eventos: cancelar corta el ATD
+        esc_event_t ev;
+        call_result_t r = CALL_FAILED;
+        for (;;) {
+            xQueueReceive(g_esc_queue, &ev, portMAX_DELAY);
+            if (ev.type == ESC_EV_CALL_DONE) { r = ev.result; break; }
+            if (esc_note(&ev) && !cancelled) {
+                cancelled = true;
+                modem_call_abort();
+            }
         }
-        if (c >= VIB_THRESHOLD) {
-            g_vib_count = 0;
-            if (g_timer_vib_window) xTimerStopFromISR(g_timer_vib_window, &hpw);
-            g_state = ST_ALARM;
-            relays_set(true,true,true);
-            if (g_timer_alarm) {
-                xTimerStopFromISR(g_timer_alarm, &hpw);
-                xTimerStartFromISR(g_timer_alarm, &hpw);
+        event_log(JR_EV_CALL, ch, (uint16_t)((i << 8) | r));
+        if (cancelled || r != CALL_ANSWERED) continue;   // ocupado / sin respuesta: al siguiente ya
+
+        ESP_LOGW(ALERT_TAG, "%s: cuidador %d localizado en %lld ms", d->name, i + 1,
+                 (long long)((esp_timer_get_time() - t_start) / 1000));
+        int64_t end = esp_timer_get_time() + (int64_t)cfg()->call_play_ms * 1000;
+        audio_loop("alert.wav");
+        while (modem_call_active() && esp_timer_get_time() < end) {
+            if (xQueueReceive(g_esc_queue, &ev, pdMS_TO_TICKS(200)) == pdTRUE && esc_note(&ev)) {
+                cancelled = true;
+                break;
             }
-            ESP_EARLY_LOGE(ALERT_TAG, "ALERTA: %d vibraciones en %d ms",
-                           VIB_THRESHOLD, VIB_WINDOW_MS);
         }
-        if (hpw) portYIELD_FROM_ISR();
+        audio_stop();
+        if (modem_call_active() || cancelled) modem_hangup();
+        break;
+    }
+    if (cancelled) {
+        ESP_LOGI(ALERT_TAG, "Escalado cancelado tras %lld ms",
+                 (long long)((esp_timer_get_time() - t_start) / 1000));
+    } else {
+        alert_post(&g_called_mask, ch, ALERT_N_CALLED);
     }
 }
 
-// ==================== TAREAS ====================
-static void arm_monitor_task(void *arg) {
-    bool prev = read_arm_present();
-    ESP_LOGI(ALERT_TAG, "ARM monitor: start, present=%s", prev ? "YES" : "NO");
+// Un canal cada vez, por orden de índice
+static void escalation_task(void *arg) {
+    esc_event_t ev;
     for (;;) {
-        if (g_test_active) { vTaskDelay(pdMS_TO_TICKS(50)); continue; }
-        vTaskDelay(pdMS_TO_TICKS(100));
-        bool now = read_arm_present();
-        if (now != prev) {
-            if (now) enter_armed(); else enter_idle();
-            prev = now;
+        if (!g_esc_pending) {
+            if (xQueueReceive(g_esc_queue, &ev, portMAX_DELAY) != pdTRUE) continue;
+            esc_note(&ev);
+            continue;
         }
+        int ch = __builtin_ctz(g_esc_pending);
+        g_esc_pending &= ~(1u << ch);
+        g_esc_running = true;
+        escalation_run(ch);
+        g_esc_running = false;
     }
 }
 
 // ==================== INIT ====================
+// Filtro de glitches del C6: descarta en hardware los pulsos más cortos que
+// VIB_GLITCH_NS antes de que lleguen a generar interrupción
+static void vib_glitch_filter_init(gpio_num_t pin) {
+#if SOC_GPIO_FLEX_GLITCH_FILTER_NUM > 0
+    gpio_glitch_filter_handle_t filter = NULL;
+    gpio_flex_glitch_filter_config_t fcfg = {
+        .clk_src         = GLITCH_FILTER_CLK_SRC_DEFAULT,
+        .gpio_num        = pin,
+        .window_width_ns = VIB_GLITCH_NS,
+        .window_thres_ns = VIB_GLITCH_NS,
+    };
+    if (gpio_new_flex_glitch_filter(&fcfg, &filter) == ESP_OK &&
+        gpio_glitch_filter_enable(filter) == ESP_OK) {
+        ESP_LOGI(ALERT_TAG, "Filtro de glitches del sensor (GPIO%d): %d ns", (int)pin, VIB_GLITCH_NS);
+        return;
+    }
+    ESP_LOGW(ALERT_TAG, "Filtro de glitches no disponible; solo antirrebote por software");
+#endif
+}
+
 static void alert_system_start(void) {
-    gpio_install_isr_service(0);
+    // Timers y tareas antes que las ISR: alert_task debe existir al primer evento
+    g_timer_lamp       = xTimerCreate("lamp_tmo",   pdMS_TO_TICKS(cfg()->lamp_on_ms), pdFALSE, NULL, vTimerLampTimeout);
+    g_timer_test       = xTimerCreate("test_tmo",   pdMS_TO_TICKS(10000),            pdFALSE, NULL, vTimerTestTimeout);
+    for (size_t ch = 0; ch < CH_COUNT; ch++) {
+        void *id = (void *)(intptr_t)ch;
+        g_ch[ch].timer_alarm = xTimerCreate("attend_tmo", pdMS_TO_TICKS(cfg()->attend_timeout_ms), pdFALSE, id, vTimerAlarmTimeout);
+        g_ch[ch].timer_arm   = xTimerCreate("arm_deb",    pdMS_TO_TICKS(ARM_INSERT_MS),            pdFALSE, id, vTimerArmDebounce);
+    }
+
+    const esp_timer_create_args_t sampler = { .callback = vib_sampler_cb, .name = "vib_sample" };
+    esp_timer_create(&sampler, &g_vib_sampler);
+
+    for (size_t ch = 0; ch < CH_COUNT; ch++) alert_core_add_channel(&g_core, CHANNELS[ch].name, CHANNELS[ch].relays);
+
+    g_esc_queue = xQueueCreate(ESC_QUEUE_LEN, sizeof(esc_event_t));
+    xTaskCreate(escalation_task, "escalation", ESC_TASK_STACK, NULL, 6, NULL);
+    xTaskCreate(alert_task, "alert_task", ALERT_TASK_STACK, NULL, 8, &g_alert_task);
 
     // Salidas (3 relés) + extra reservado comentado
     gpio_config_t outcfg = {
@@ -244,18 +687,24 @@ static void alert_system_start(void) {
         .mode = GPIO_MODE_OUTPUT
     };
     gpio_config(&outcfg);
-    relays_set(false,false,false);
+    alert_core_refresh(&g_core);
+
+    // Sensores y lectores de todos los canales
+    uint64_t sensors = 0, arms = 0;
+    for (size_t ch = 0; ch < CH_COUNT; ch++) {
+        sensors |= 1ULL << CHANNELS[ch].sensor_pin;
+        arms    |= 1ULL << CHANNELS[ch].arm_pin;
+    }
 
     // Sensor vibración (PULL-DOWN para que no flote si no está)
     gpio_config_t incfg = {
-        .pin_bit_mask = (1ULL<<PIN_VIB_SENSOR),
+        .pin_bit_mask = sensors,
         .mode = GPIO_MODE_INPUT,
         .pull_up_en   = SENSOR_ACTIVE_HIGH ? GPIO_PULLUP_DISABLE  : GPIO_PULLUP_ENABLE,
         .pull_down_en = SENSOR_ACTIVE_HIGH ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
         .intr_type    = SENSOR_ACTIVE_HIGH ? GPIO_INTR_POSEDGE    : GPIO_INTR_NEGEDGE
     };
     gpio_config(&incfg);
-    gpio_isr_handler_add(PIN_VIB_SENSOR, isr_sensor, NULL);
 
     // Botón
     gpio_config_t btncfg = {
@@ -267,42 +716,30 @@ static void alert_system_start(void) {
     };
     gpio_config(&btncfg);
     gpio_isr_handler_add(PIN_BTN_RESET, isr_btn, NULL);
+    power_wake_on_level(PIN_BTN_RESET, !BTN_ACTIVE_LOW);
 
-    // ARM (lector a GND)
+    // ARM (lector a GND): cualquier flanco + histéresis por temporizador
     gpio_config_t armcfg = {
-        .pin_bit_mask = (1ULL<<PIN_ARM_SENSE),
+        .pin_bit_mask = arms,
         .mode = GPIO_MODE_INPUT,
         .pull_up_en   = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type    = GPIO_INTR_DISABLE
+        .intr_type    = GPIO_INTR_ANYEDGE
     };
     gpio_config(&armcfg);
 
-    // Timers
-    g_timer_alarm      = xTimerCreate("attend_tmo", pdMS_TO_TICKS(ATTEND_TIMEOUT_MS), pdFALSE, NULL, vTimerAlarmTimeout);
-    g_timer_lamp       = xTimerCreate("lamp_tmo",   pdMS_TO_TICKS(LAMP_ON_MS),       pdFALSE, NULL, vTimerLampTimeout);
-    g_timer_vib_window = xTimerCreate("vib_win",    pdMS_TO_TICKS(VIB_WINDOW_MS),    pdFALSE, NULL, vTimerVibWindowTimeout);
-    if (!g_timer_test)
-        g_timer_test   = xTimerCreate("test_tmo",   pdMS_TO_TICKS(10000),            pdFALSE, NULL, vTimerTestTimeout);
-
-    if (read_arm_present()) enter_armed(); else enter_idle();
-    xTaskCreate(arm_monitor_task, "arm_monitor", 2048, NULL, 5, NULL);
-
-    ESP_LOGI(ALERT_TAG, "Sistema de alerta listo.");
-}
+    for (size_t ch = 0; ch < CH_COUNT; ch++) {
+        const alert_channel_desc_t *d = &CHANNELS[ch];
+        void *arg = (void *)(uintptr_t)ch;
+        vib_glitch_filter_init(d->sensor_pin);
+        gpio_isr_handler_add(d->sensor_pin, isr_sensor, arg);
+        power_wake_on_level(d->sensor_pin, SENSOR_ACTIVE_HIGH);
 
-// ==================== AUDIO ====================
-void audio_play_wav(const char *path)
-{
-    FILE *f = fopen(path, "rb");
-    if (!f) { ESP_LOGE("AUDIO", "No puedo abrir %s", path); return; }
-    fseek(f, 44, SEEK_SET); // cabecera WAV
-    uint8_t buf[1024];
-    size_t rd, wr;
-    while ((rd = fread(buf, 1, sizeof buf, f)) > 0) {
-        i2s_write(I2S_NUM, buf, rd, &wr, portMAX_DELAY);
+        gpio_isr_handler_add(d->arm_pin, isr_arm, arg);
     }
-    fclose(f);
+    alert_core_start(&g_core);   // IDLE/ARMED según el lector y despertar al cambiar
+
+    ESP_LOGI(ALERT_TAG, "Sistema de alerta listo (%u canales).", (unsigned)CH_COUNT);
 }
 
 // ==================== MÓDEM ====================
@@ -325,67 +762,75 @@ esp_err_t modem_init(void)
     ESP_ERROR_CHECK(uart_param_config(MODEM_UART, &ucfg));
     ESP_ERROR_CHECK(uart_set_pin(MODEM_UART, MODEM_TX_PIN, MODEM_RX_PIN,
                                  UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    ESP_ERROR_CHECK(uart_driver_install(MODEM_UART, 1024, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(MODEM_UART, 1024, 0, MIO_EVENT_QUEUE_LEN,
+                                        &g_modem_uart_queue, 0));
+#ifdef MODEM_REPLAY
+    mio_replay_load(SD_MOUNT_POINT "/replay.txt");   // sesión grabada en lugar del SIM800
+#endif
+    ml_init();   // detección de '\n' → eventos a la cola
 
-    if (xTaskCreate(modem_task, "modem_task", 12288, NULL, 5, NULL) != pdPASS) {
+    urc_init();
+    if (at_engine_start() != ESP_OK) return ESP_FAIL;
+    if (sms_outbox_start() != ESP_OK) return ESP_FAIL;
+    if (xTaskCreate(urc_task, "urc_task", URC_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE("MODEM", "No pude crear urc_task");
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(modem_task, "modem_task", MODEM_TASK_STACK, NULL, 7, NULL) != pdPASS) {
         ESP_LOGE("MODEM", "No pude crear modem_task");
         return ESP_FAIL;
     }
-    ESP_LOGI(MAIN_TAG, "UART del módem listo a %d baudios", MODEM_BAUD);
-    return ESP_OK;
-}
-
-esp_err_t modem_dial(const char *number)
-{
-    if (!number || !*number) return ESP_ERR_INVALID_ARG;
-    char cmd[48];
-    int n = snprintf(cmd, sizeof cmd, "ATD%s;\r", number);
-    if (n <= 0 || n >= (int)sizeof cmd) return ESP_ERR_INVALID_ARG;
-    uart_write_bytes(MODEM_UART, cmd, n);
+    ESP_LOGI(MAIN_TAG, "UART del módem listo a %d baudios (se negocia al arrancar)", MODEM_BAUD);
     return ESP_OK;
 }
 
 void modem_hangup(void)
 {
-    static const char *cmd = "ATH\r";
-    uart_write_bytes(MODEM_UART, cmd, 4);
+    call_active = false;
+    at_cmd_async("ATH", AT_PRIO_HIGH);
 }
 
 // ==================== PRUEBAS / FORZADOS (para SMS) ====================
+// Desde urc_task: se lo pasa a alert_task (la última petición pisa a la anterior)
+static void alert_force(uint8_t relays, uint32_t ms) {
+    if (ms > FORCE_MS_MAX) ms = FORCE_MS_MAX;
+    __atomic_store_n(&g_force_req, FORCE_PENDING | (uint32_t)(relays & 0x7F) << 24 | ms, __ATOMIC_SEQ_CST);
+    TaskHandle_t t = __atomic_load_n(&g_alert_task, __ATOMIC_SEQ_CST);
+    if (t) xTaskNotify(t, ALERT_N_FORCE, eSetBits);
+}
+
 void alert_test_start(uint32_t ms) {
-    g_test_active = true;
-    relays_set(true,true,true);  // ON continuo durante 'ms'
-    if (!g_timer_test) g_timer_test = xTimerCreate("test_tmo", pdMS_TO_TICKS(ms), pdFALSE, NULL, vTimerTestTimeout);
-    xTimerStop(g_timer_test, 0);
-    xTimerChangePeriod(g_timer_test, pdMS_TO_TICKS(ms), 0);
-    xTimerStart(g_timer_test, 0);
+    alert_force(RELAY_ALL, ms);   // ON continuo durante 'ms'
     ESP_LOGI(ALERT_TAG, "TEST: relés ON por %u ms (sin llamadas)", (unsigned)ms);
 }
 
 void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) {
-    g_test_active = true;
-    relays_set(vib1, vib2, lamp);
-    if (!g_timer_test) g_timer_test = xTimerCreate("test_tmo", pdMS_TO_TICKS(ms), pdFALSE, NULL, vTimerTestTimeout);
-    xTimerStop(g_timer_test, 0);
-    xTimerChangePeriod(g_timer_test, pdMS_TO_TICKS(ms), 0);
-    xTimerStart(g_timer_test, 0);
+    alert_force((vib1 ? RELAY_VIB1 : 0) | (vib2 ? RELAY_VIB2 : 0) | (lamp ? RELAY_LIGHT : 0), ms);
     ESP_LOGI(ALERT_TAG, "FORCE: v1=%d v2=%d lamp=%d por %u ms",
              (int)vib1, (int)vib2, (int)lamp, (unsigned)ms);
 }
 
 void set_relay_polarity(int active_high) {
-    g_relay_active_high = active_high ? 1 : 0;
+    app_config_t c = *cfg();
+    c.relay_active_high = active_high ? 1 : 0;
+    cfg_seal(&c);
+    if (config_commit(&c) != ESP_OK) config_apply(&c);   // al menos hasta el próximo reinicio
     ESP_LOGW(ALERT_TAG, "Polaridad relés: %s",
-             g_relay_active_high ? "ACTIVO-ALTO (HIGH=ON)" : "ACTIVO-BAJO (LOW=ON)");
+             cfg()->relay_active_high ? "ACTIVO-ALTO (HIGH=ON)" : "ACTIVO-BAJO (LOW=ON)");
 }
 
 // ==================== MAIN ====================
 void app_main(void) {
+    config_init();         // NVS: umbrales, tiempos, polaridad y clave
+    event_log_init();      // diario en flash (apunta el arranque)
+    gpio_install_isr_service(0);
     audio_init();          // I2S + SD
     (void)dtmf_files;      // silenciar warning unused
+    power_init();          // light sleep + DTR/RI (antes del módem: decide AT+CSCLK)
     modem_init();          // UART + modem_task
+    power_uart_wake_init();
     alert_system_start();  // lógica de alerta
 
     ESP_LOGI(MAIN_TAG, "Sistema iniciado.");
-    for (;;) vTaskDelay(pdMS_TO_TICKS(1000));
+    vTaskDelete(NULL);     // todo lo demás va por tareas, eventos y temporizadores
 }
@@ -0,0 +1,147 @@
+#ifndef HOST_GPIO_H
+#define HOST_GPIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Números de pin, un nivel por pin, su interrupción (tipo, habilitada y
+// manejador) y el nivel que despierta del light sleep. La prueba mueve una
+// entrada con host_gpio_input(), que llama al manejador como una ISR
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0, GPIO_NUM_1,  GPIO_NUM_2,  GPIO_NUM_3,  GPIO_NUM_4,  GPIO_NUM_5,  GPIO_NUM_6,
+    GPIO_NUM_7,     GPIO_NUM_8,  GPIO_NUM_9,  GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12, GPIO_NUM_13,
+    GPIO_NUM_14,    GPIO_NUM_15, GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20,
+    GPIO_NUM_21,    GPIO_NUM_22, GPIO_NUM_23, GPIO_NUM_24, GPIO_NUM_25, GPIO_NUM_26, GPIO_NUM_27,
+    GPIO_NUM_28,    GPIO_NUM_29, GPIO_NUM_30,
+    GPIO_NUM_MAX,
+} gpio_num_t;
+
+static inline int *host_gpio_levels(void)
+{
+    static int level[GPIO_NUM_MAX];
+    return level;
+}
+
+static inline int gpio_get_level(gpio_num_t pin) { return host_gpio_levels()[pin]; }
+
+static inline esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    host_gpio_levels()[pin] = level != 0;
+    return ESP_OK;
+}
+
+typedef enum {
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT   = 1,
+    GPIO_MODE_OUTPUT  = 2,
+    GPIO_MODE_INPUT_OUTPUT = 3,
+} gpio_mode_t;
+
+typedef enum { GPIO_PULLUP_DISABLE = 0, GPIO_PULLUP_ENABLE = 1 } gpio_pullup_t;
+typedef enum { GPIO_PULLDOWN_DISABLE = 0, GPIO_PULLDOWN_ENABLE = 1 } gpio_pulldown_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE    = 0,
+    GPIO_INTR_POSEDGE    = 1,
+    GPIO_INTR_NEGEDGE    = 2,
+    GPIO_INTR_ANYEDGE    = 3,
+    GPIO_INTR_LOW_LEVEL  = 4,
+    GPIO_INTR_HIGH_LEVEL = 5,
+} gpio_int_type_t;
+
+typedef struct {
+    uint64_t        pin_bit_mask;
+    gpio_mode_t     mode;
+    gpio_pullup_t   pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+typedef struct {
+    gpio_int_type_t type;
+    gpio_isr_t      isr;
+    void           *arg;
+    gpio_int_type_t wakeup;          // GPIO_INTR_DISABLE = no despierta
+} host_gpio_pin_t;
+
+static inline host_gpio_pin_t *host_gpio_pins(void)
+{
+    static host_gpio_pin_t pin[GPIO_NUM_MAX];
+    return pin;
+}
+
+static inline bool *host_gpio_intr(void)
+{
+    static bool enabled[GPIO_NUM_MAX];
+    return enabled;
+}
+
+// Entradas con pull-up arrancan en alto; la interrupción queda habilitada si tiene tipo
+static inline esp_err_t gpio_config(const gpio_config_t *c)
+{
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (!(c->pin_bit_mask & (1ULL << pin))) continue;
+        host_gpio_pins()[pin].type = c->intr_type;
+        host_gpio_intr()[pin] = c->intr_type != GPIO_INTR_DISABLE;
+        if ((c->mode & GPIO_MODE_INPUT) && (c->pull_up_en || c->pull_down_en))
+            host_gpio_levels()[pin] = c->pull_up_en;
+    }
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg)
+{
+    host_gpio_pins()[pin].isr = isr;
+    host_gpio_pins()[pin].arg = arg;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type)
+{
+    host_gpio_pins()[pin].wakeup = type;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_intr_enable(gpio_num_t pin)
+{
+    host_gpio_intr()[pin] = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_intr_disable(gpio_num_t pin)
+{
+    host_gpio_intr()[pin] = false;
+    return ESP_OK;
+}
+
+/*
+ * Lo que ve el pin desde fuera. Si el cambio casa con su tipo de
+ * interrupción y está habilitada, llama al manejador marcado como ISR
+ * (xPortInIsrContext). Devuelve true si lo ha llamado.
+ */
+static inline bool host_gpio_input(gpio_num_t pin, int level)
+{
+    int old = host_gpio_levels()[pin];
+    level = level != 0;
+    host_gpio_levels()[pin] = level;
+    host_gpio_pin_t *p = &host_gpio_pins()[pin];
+    bool fire = p->type == GPIO_INTR_LOW_LEVEL  ? !level :
+                p->type == GPIO_INTR_HIGH_LEVEL ? level  :
+                old != level && (p->type == GPIO_INTR_ANYEDGE ||
+                                 (p->type == GPIO_INTR_POSEDGE && level) ||
+                                 (p->type == GPIO_INTR_NEGEDGE && !level));
+    if (!fire || !host_gpio_intr()[pin] || !p->isr) return false;
+    int *isr = host_isr_flag();
+    int was = *isr;
+    *isr = 1;
+    p->isr(p->arg);
+    *isr = was;
+    return true;
+}
+
+#endif // HOST_GPIO_H
@@ -0,0 +1,137 @@
+#ifndef HOST_I2S_H
+#define HOST_I2S_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "host_util.h"
+
+/*
+ * I2S "legacy" de salida sin hardware: un anillo de dma_buf_count
+ * búferes que se vacía al ritmo de la frecuencia de muestreo. i2s_write
+ * bloquea hasta que lo escrito cabe, como el driver; i2s_zero_dma_buffer
+ * calla en el acto lo que quedaba por sonar. host_i2s() dice cuándo
+ * termina de sonar lo último que no era silencio (sound_end_us), que es
+ * lo que oye quien está al teléfono.
+ */
+
+typedef int i2s_port_t;
+#define I2S_NUM_0 0
+
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16, I2S_BITS_PER_SAMPLE_32BIT = 32 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_MONO = 1, I2S_CHANNEL_STEREO = 2 } i2s_channel_t;
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT, I2S_CHANNEL_FMT_ALL_RIGHT, I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT, I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1, I2S_COMM_FORMAT_I2S = 1 } i2s_comm_format_t;
+typedef enum { I2S_MODE_MASTER = 1, I2S_MODE_SLAVE = 2, I2S_MODE_TX = 4, I2S_MODE_RX = 8 } i2s_mode_t;
+
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef struct {
+    int                   mode;
+    uint32_t              sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t     channel_format;
+    i2s_comm_format_t     communication_format;
+    int                   intr_alloc_flags;
+    int                   dma_buf_count;
+    int                   dma_buf_len;
+    bool                  use_apll;
+    bool                  tx_desc_auto_clear;
+} i2s_config_t;
+
+typedef struct {
+    int bck_io_num, ws_io_num, data_out_num, data_in_num;
+} i2s_pin_config_t;
+
+typedef struct {
+    bool     installed;
+    uint32_t rate;
+    int      channels;
+    int      buf_count, buf_len;
+    int64_t  play_end_us;        // cuándo termina de salir lo escrito
+    int64_t  sound_end_us;       // ... y lo último que no era silencio
+    uint64_t frames;
+    uint32_t writes, zeroes, reclocks;
+    bool     ignore_zero;        // la prueba imita un firmware que no vacía el DMA
+} host_i2s_t;
+
+static inline host_i2s_t *host_i2s(void)
+{
+    static host_i2s_t i;
+    return &i;
+}
+
+static inline esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *cfg, int queue_size, void *queue)
+{
+    (void)port; (void)queue_size; (void)queue;
+    host_i2s_t *i = host_i2s();
+    i->installed = true;
+    i->rate = cfg->sample_rate;
+    i->channels = cfg->channel_format == I2S_CHANNEL_FMT_RIGHT_LEFT ? 2 : 1;
+    i->buf_count = cfg->dma_buf_count;
+    i->buf_len = cfg->dma_buf_len;
+    return ESP_OK;
+}
+
+static inline esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins)
+{
+    (void)port; (void)pins;
+    return ESP_OK;
+}
+
+static inline esp_err_t i2s_set_clk(i2s_port_t port, uint32_t rate, uint32_t bits, i2s_channel_t ch)
+{
+    (void)port; (void)bits;
+    host_i2s_t *i = host_i2s();
+    if (rate < 8000 || rate > 48000) return ESP_ERR_INVALID_ARG;
+    i->rate = rate;
+    i->channels = ch;
+    i->reclocks++;
+    return ESP_OK;
+}
+
+static inline esp_err_t i2s_write(i2s_port_t port, const void *src, size_t size, size_t *written,
+                                  TickType_t ticks)
+{
+    (void)port; (void)ticks;
+    host_i2s_t *i = host_i2s();
+    if (!i->installed) return ESP_ERR_INVALID_STATE;
+    uint32_t frames = size / (2 * i->channels);
+    int64_t dur = (int64_t)frames * 1000000 / i->rate;
+    int64_t cap = (int64_t)i->buf_count * i->buf_len * 1000000 / i->rate;
+    int64_t now = host_now_us();
+    if (i->play_end_us < now) i->play_end_us = now;
+    host_sleep_us(i->play_end_us + dur - cap - now);     // hasta que quepa en el anillo
+    i->play_end_us += dur;
+    const int16_t *s = src;
+    for (size_t k = 0; k < size / 2; k++) {
+        if (s[k]) {
+            i->sound_end_us = i->play_end_us;
+            break;
+        }
+    }
+    i->frames += frames;
+    i->writes++;
+    *written = size;
+    return ESP_OK;
+}
+
+static inline esp_err_t i2s_zero_dma_buffer(i2s_port_t port)
+{
+    (void)port;
+    host_i2s_t *i = host_i2s();
+    i->zeroes++;
+    if (i->ignore_zero) return ESP_OK;
+    int64_t now = host_now_us();
+    if (i->play_end_us > now) i->play_end_us = now;
+    if (i->sound_end_us > now) i->sound_end_us = now;
+    return ESP_OK;
+}
+
+#endif // HOST_I2S_H
@@ -0,0 +1,14 @@
+#ifndef HOST_SDMMC_HOST_H
+#define HOST_SDMMC_HOST_H
+
+// Lo justo para que compile el montaje de la SD de audio.h (en el PC no hay tarjeta)
+typedef struct {
+    int slot;
+    int max_freq_khz;
+} sdmmc_host_t;
+
+typedef struct {
+    int host_id;
+} sdmmc_card_t;
+
+#endif // HOST_SDMMC_HOST_H
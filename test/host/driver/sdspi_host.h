@@ -0,0 +1,16 @@
+#ifndef HOST_SDSPI_HOST_H
+#define HOST_SDSPI_HOST_H
+
+#include "driver/sdmmc_host.h"
+
+#define SDSPI_DEFAULT_DMA 3
+
+typedef struct {
+    int host_id;
+    int gpio_cs;
+} sdspi_device_config_t;
+
+#define SDSPI_HOST_DEFAULT()          ((sdmmc_host_t){ .slot = 1, .max_freq_khz = 20000 })
+#define SDSPI_DEVICE_CONFIG_DEFAULT() ((sdspi_device_config_t){ .host_id = 1, .gpio_cs = -1 })
+
+#endif // HOST_SDSPI_HOST_H
@@ -0,0 +1,17 @@
+#ifndef HOST_SPI_COMMON_H
+#define HOST_SPI_COMMON_H
+
+#include "esp_err.h"
+
+typedef struct {
+    int mosi_io_num, miso_io_num, sclk_io_num, quadwp_io_num, quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+static inline esp_err_t spi_bus_initialize(int host, const spi_bus_config_t *cfg, int dma)
+{
+    (void)host; (void)cfg; (void)dma;
+    return ESP_OK;
+}
+
+#endif // HOST_SPI_COMMON_H
@@ -0,0 +1,315 @@
+#ifndef HOST_UART_H
+#define HOST_UART_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/*
+ * Driver UART de ESP-IDF sobre un pseudoterminal.
+ *
+ * uart_driver_install() abre un pty: el firmware usa el esclavo como si
+ * fuera el UART y el maestro queda para el otro extremo (sim800.h), que
+ * lo recoge con host_uart_peer(). Con HOST_UART<n>=/dev/ttyUSB0 en el
+ * entorno se abre ese dispositivo en su lugar (un SIM800 de verdad con
+ * un adaptador USB-serie).
+ *
+ * Un hilo lee del pty al búfer de recepción (del tamaño pedido, como el
+ * anillo del driver) y publica los mismos eventos que el driver: DATA,
+ * PATTERN_DET si el trozo trae el carácter de patrón, BUFFER_FULL al
+ * llenarse y FIFO_OVF si se pierden bytes. Con RTS/CTS activo no se
+ * pierde nada: sin sitio se deja de leer y el otro extremo se bloquea
+ * al escribir, como con CTS alto.
+ */
+
+typedef int uart_port_t;
+
+#define UART_NUM_0           0
+#define UART_NUM_1           1
+#define UART_NUM_2           2
+#define UART_NUM_MAX         3
+#define UART_PIN_NO_CHANGE   (-1)
+
+typedef enum { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0, UART_PARITY_EVEN = 2, UART_PARITY_ODD = 3 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum {
+    UART_HW_FLOWCTRL_DISABLE = 0,
+    UART_HW_FLOWCTRL_RTS,
+    UART_HW_FLOWCTRL_CTS,
+    UART_HW_FLOWCTRL_CTS_RTS,
+} uart_hw_flowcontrol_t;
+
+typedef struct {
+    int                   baud_rate;
+    uart_word_length_t    data_bits;
+    uart_parity_t         parity;
+    uart_stop_bits_t      stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t               rx_flow_ctrl_thresh;
+    int                   source_clk;
+} uart_config_t;
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t            size;
+    bool              timeout_flag;
+} uart_event_t;
+
+typedef struct {
+    bool            open;
+    int             fd;             // lado del firmware: esclavo del pty o tty real
+    int             peer;           // maestro del pty (-1 con un tty real)
+    char            name[64];
+    pthread_t       rx;
+    pthread_mutex_t m;
+    pthread_cond_t  data, room;
+    uint8_t        *ring;
+    size_t          cap, head, count;
+    QueueHandle_t   events;
+    uint32_t        baud;
+    bool            flowctrl;
+    bool            pattern;
+    char            pat_chr;
+    // Contadores para las pruebas
+    uint32_t        lost;           // bytes que no cupieron
+    uint32_t        rx_bytes, tx_bytes;
+    uint32_t        read_calls;     // uart_read_bytes
+    uint32_t        len_calls;      // uart_get_buffered_data_len
+} host_uart_t;
+
+static inline host_uart_t *host_uart(uart_port_t port)
+{
+    static host_uart_t u[UART_NUM_MAX];
+    return &u[port];
+}
+
+static inline void *host_uart_rx_main(void *arg)
+{
+    host_uart_t *u = arg;
+    uint8_t chunk[256];
+    for (;;) {
+        size_t want = sizeof chunk;
+        pthread_mutex_lock(&u->m);
+        while (u->flowctrl && u->count == u->cap) pthread_cond_wait(&u->room, &u->m);
+        if (u->flowctrl && u->cap - u->count < want) want = u->cap - u->count;
+        pthread_mutex_unlock(&u->m);
+
+        ssize_t n = read(u->fd, chunk, want);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NULL;
+
+        pthread_mutex_lock(&u->m);
+        size_t room = u->cap - u->count, keep = (size_t)n < room ? (size_t)n : room;
+        for (size_t i = 0; i < keep; i++) u->ring[(u->head + u->count + i) % u->cap] = chunk[i];
+        u->count += keep;
+        u->rx_bytes += keep;
+        u->lost += n - keep;
+        uart_event_t ev = { .type = UART_DATA, .size = keep };
+        if (keep < (size_t)n)                                    ev.type = UART_FIFO_OVF;
+        else if (u->count == u->cap)                             ev.type = UART_BUFFER_FULL;
+        else if (u->pattern && memchr(chunk, u->pat_chr, keep))  ev.type = UART_PATTERN_DET;
+        pthread_cond_broadcast(&u->data);
+        pthread_mutex_unlock(&u->m);
+        if (u->events) xQueueSend(u->events, &ev, 0);   // cola llena: se pierde, como en el driver
+    }
+}
+
+static inline void host_uart_raw(int fd)
+{
+    struct termios t;
+    if (tcgetattr(fd, &t) != 0) return;
+    cfmakeraw(&t);
+    tcsetattr(fd, TCSANOW, &t);
+}
+
+static inline esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_len,
+                                            QueueHandle_t *queue, int flags)
+{
+    (void)tx_size; (void)flags;
+    host_uart_t *u = host_uart(port);
+    if (u->open) return ESP_ERR_INVALID_STATE;
+    char env[16];
+    snprintf(env, sizeof env, "HOST_UART%d", port);
+    const char *dev = getenv(env);
+    u->peer = -1;
+    if (dev) {
+        snprintf(u->name, sizeof u->name, "%s", dev);
+        u->fd = open(dev, O_RDWR | O_NOCTTY);
+    } else {
+        u->peer = posix_openpt(O_RDWR | O_NOCTTY);
+        if (u->peer < 0 || grantpt(u->peer) != 0 || unlockpt(u->peer) != 0) return ESP_FAIL;
+        snprintf(u->name, sizeof u->name, "%s", ptsname(u->peer));
+        u->fd = open(u->name, O_RDWR | O_NOCTTY);
+        host_uart_raw(u->peer);
+    }
+    if (u->fd < 0) return ESP_FAIL;
+    host_uart_raw(u->fd);
+
+    pthread_mutex_init(&u->m, NULL);
+    host_cond_init(&u->data);
+    host_cond_init(&u->room);
+    u->cap = rx_size;
+    u->ring = malloc(u->cap);
+    if (!u->ring) return ESP_ERR_NO_MEM;
+    if (!u->baud) u->baud = 115200;
+    if (queue) *queue = u->events = xQueueCreate(queue_len, sizeof(uart_event_t));
+    u->open = true;
+    if (pthread_create(&u->rx, NULL, host_uart_rx_main, u) != 0) return ESP_FAIL;
+    pthread_detach(u->rx);
+    return ESP_OK;
+}
+
+// El otro extremo del enlace (maestro del pty)
+static inline int host_uart_peer(uart_port_t port) { return host_uart(port)->peer; }
+
+static inline esp_err_t uart_param_config(uart_port_t port, const uart_config_t *c)
+{
+    host_uart_t *u = host_uart(port);
+    u->baud = c->baud_rate;
+    u->flowctrl = c->flow_ctrl == UART_HW_FLOWCTRL_CTS_RTS;
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+    (void)port; (void)tx; (void)rx; (void)rts; (void)cts;
+    return ESP_OK;
+}
+
+// Solo se apunta: el otro extremo la consulta para saber si se entienden
+static inline esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud)
+{
+    host_uart(port)->baud = baud;
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud)
+{
+    *baud = host_uart(port)->baud;
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_set_hw_flow_ctrl(uart_port_t port, uart_hw_flowcontrol_t mode, uint8_t thresh)
+{
+    (void)thresh;
+    host_uart_t *u = host_uart(port);
+    pthread_mutex_lock(&u->m);
+    u->flowctrl = mode == UART_HW_FLOWCTRL_CTS_RTS;
+    pthread_cond_broadcast(&u->room);
+    pthread_mutex_unlock(&u->m);
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)
+{
+    (void)ticks;
+    tcdrain(host_uart(port)->fd);
+    return ESP_OK;
+}
+
+static inline int uart_write_bytes(uart_port_t port, const void *src, size_t len)
+{
+    host_uart_t *u = host_uart(port);
+    const uint8_t *p = src;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(u->fd, p + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    __atomic_fetch_add(&u->tx_bytes, done, __ATOMIC_RELAXED);
+    return (int)done;
+}
+
+// Hasta len bytes; espera como mucho ticks a que lleguen
+static inline int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks)
+{
+    host_uart_t *u = host_uart(port);
+    uint8_t *dst = buf;
+    uint32_t got = 0;
+    struct timespec ts;
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &ts);
+    pthread_mutex_lock(&u->m);
+    u->read_calls++;
+    for (;;) {
+        while (got < len && u->count) {
+            dst[got++] = u->ring[u->head];
+            u->head = (u->head + 1) % u->cap;
+            u->count--;
+        }
+        if (got == len || ticks == 0) break;
+        int rc = ticks == portMAX_DELAY ? pthread_cond_wait(&u->data, &u->m)
+                                        : pthread_cond_timedwait(&u->data, &u->m, &ts);
+        if (rc == ETIMEDOUT && !u->count) break;
+    }
+    pthread_cond_broadcast(&u->room);
+    pthread_mutex_unlock(&u->m);
+    return (int)got;
+}
+
+static inline esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size)
+{
+    host_uart_t *u = host_uart(port);
+    pthread_mutex_lock(&u->m);
+    u->len_calls++;
+    *size = u->count;
+    pthread_mutex_unlock(&u->m);
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_flush_input(uart_port_t port)
+{
+    host_uart_t *u = host_uart(port);
+    pthread_mutex_lock(&u->m);
+    u->head = u->count = 0;
+    pthread_cond_broadcast(&u->room);
+    pthread_mutex_unlock(&u->m);
+    return ESP_OK;
+}
+#define uart_flush(port)  uart_flush_input(port)
+
+static inline esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t port, char chr, uint8_t num,
+                                                          int gap, int post, int pre)
+{
+    (void)num; (void)gap; (void)post; (void)pre;
+    host_uart(port)->pat_chr = chr;
+    host_uart(port)->pattern = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_pattern_queue_reset(uart_port_t port, int len)
+{
+    (void)port; (void)len;
+    return ESP_OK;
+}
+
+static inline esp_err_t uart_set_wakeup_threshold(uart_port_t port, int edges)
+{
+    (void)port; (void)edges;
+    return ESP_OK;
+}
+
+#endif // HOST_UART_H
@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Ciclos de un reloj de 160 MHz de mentira (el del C6), a partir del monotónico
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec) * 4 / 25);
+}
+
+#endif // HOST_ESP_CPU_H
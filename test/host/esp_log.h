@@ -0,0 +1,55 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * ESP_LOGx por stdout con el mismo formato que en la consola del ESP32.
+ * Por defecto solo avisos y errores, para que la salida de las pruebas
+ * sea legible; esp_log_level_set("*", ESP_LOG_INFO) enseña el resto.
+ */
+typedef enum {
+    ESP_LOG_NONE = 0,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+static inline esp_log_level_t *host_log_level(void)
+{
+    static esp_log_level_t level = ESP_LOG_WARN;
+    return &level;
+}
+
+static inline void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;   // un solo nivel para todas las etiquetas
+    *host_log_level() = level;
+}
+
+__attribute__((format(printf, 3, 4)))
+static inline void host_log(char letter, const char *tag, const char *fmt, ...)
+{
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof line, fmt, ap);
+    va_end(ap);
+    printf("%c (%lld) %s: %s\n", letter, (long long)(host_now_us() / 1000), tag, line);
+    fflush(stdout);
+}
+
+#define HOST_LOG(level, letter, tag, fmt, ...) \
+    do { if (*host_log_level() >= (level)) host_log(letter, tag, fmt, ##__VA_ARGS__); } while (0)
+
+#define ESP_LOGE(tag, fmt, ...)  HOST_LOG(ESP_LOG_ERROR,   'E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)  HOST_LOG(ESP_LOG_WARN,    'W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)  HOST_LOG(ESP_LOG_INFO,    'I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)  HOST_LOG(ESP_LOG_DEBUG,   'D', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...)  HOST_LOG(ESP_LOG_VERBOSE, 'V', tag, fmt, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
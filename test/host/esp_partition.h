@@ -0,0 +1,137 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+
+/*
+ * Particiones en RAM con la semántica de la NOR: escribir solo baja bits
+ * (1 → 0), borrar deja 0xFF y va por sectores de 4 KB. La prueba las da
+ * de alta con host_partition_add() (o las carga de un fichero) antes de
+ * que el firmware las busque.
+ */
+
+#define HOST_PARTITIONS  4
+#define HOST_SECTOR      4096
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+typedef struct {
+    esp_partition_type_t    type;
+    esp_partition_subtype_t subtype;
+    uint32_t                address;
+    uint32_t                size;
+    uint32_t                erase_size;
+    char                    label[17];
+    bool                    encrypted;
+    bool                    readonly;
+    // Solo en el PC
+    uint8_t                *mem;
+    uint32_t                reads, writes, erases;
+    bool                    fail;       // todas las operaciones fallan
+} esp_partition_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+typedef enum { ESP_PARTITION_MMAP_DATA, ESP_PARTITION_MMAP_INST } esp_partition_mmap_memory_t;
+
+static inline esp_partition_t *host_partitions(int *count)
+{
+    static esp_partition_t p[HOST_PARTITIONS];
+    static int n;
+    if (count) *count = n;
+    return count ? p : (n < HOST_PARTITIONS ? &p[n++] : NULL);
+}
+
+static inline esp_partition_t *host_partition_add(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                  const char *label, uint32_t size)
+{
+    esp_partition_t *p = host_partitions(NULL);
+    if (!p) return NULL;
+    memset(p, 0, sizeof *p);
+    p->type = type;
+    p->subtype = subtype;
+    p->address = 0x400000;
+    p->size = size;
+    p->erase_size = HOST_SECTOR;
+    snprintf(p->label, sizeof p->label, "%s", label);
+    p->mem = malloc(size);
+    memset(p->mem, 0xFF, size);
+    return p;
+}
+
+// Contenido inicial desde un fichero (p.ej. un prompts.bin); false si no se pudo leer
+static inline bool host_partition_load(esp_partition_t *p, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    size_t n = fread(p->mem, 1, p->size, f);
+    fclose(f);
+    return n > 0;
+}
+
+static inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                              esp_partition_subtype_t subtype,
+                                                              const char *label)
+{
+    int n;
+    esp_partition_t *p = host_partitions(&n);
+    for (int i = 0; i < n; i++) {
+        if (p[i].type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p[i].subtype != subtype) continue;
+        if (label && strcmp(p[i].label, label) != 0) continue;
+        return &p[i];
+    }
+    return NULL;
+}
+
+static inline bool host_partition_range(const esp_partition_t *p, size_t off, size_t n)
+{
+    return p && !p->fail && off <= p->size && n <= p->size - off;
+}
+
+static inline esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t n)
+{
+    if (!host_partition_range(p, off, n)) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, p->mem + off, n);
+    ((esp_partition_t *)p)->reads++;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t n)
+{
+    if (!host_partition_range(p, off, n)) return ESP_ERR_INVALID_ARG;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < n; i++) p->mem[off + i] &= s[i];
+    ((esp_partition_t *)p)->writes++;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t n)
+{
+    if (!host_partition_range(p, off, n) || off % HOST_SECTOR || n % HOST_SECTOR) return ESP_ERR_INVALID_ARG;
+    memset(p->mem + off, 0xFF, n);
+    ((esp_partition_t *)p)->erases += n / HOST_SECTOR;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t off, size_t n,
+                                           esp_partition_mmap_memory_t memory,
+                                           const void **out, esp_partition_mmap_handle_t *handle)
+{
+    (void)memory;
+    if (!host_partition_range(p, off, n)) return ESP_ERR_INVALID_ARG;
+    *out = p->mem + off;
+    *handle = 1;
+    return ESP_OK;
+}
+
+static inline void esp_partition_munmap(esp_partition_mmap_handle_t handle) { (void)handle; }
+
+#endif // HOST_ESP_PARTITION_H
@@ -0,0 +1,80 @@
+#ifndef HOST_ESP_PM_H
+#define HOST_ESP_PM_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+
+// La configuración pedida y los bloqueos; se cuenta cuánto tiempo hay alguno NO_LIGHT_SLEEP tomado
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int  max_freq_mhz;
+    int  min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+typedef struct host_pm_lock {
+    esp_pm_lock_type_t type;
+    const char        *name;
+    int                count;
+} *esp_pm_lock_handle_t;
+
+typedef struct {
+    esp_pm_config_t cfg;
+    bool            configured;
+    int             no_sleep;          // bloqueos NO_LIGHT_SLEEP tomados ahora
+    int64_t         no_sleep_since;
+    int64_t         no_sleep_us;       // total sin poder dormir (sin contar el tramo en curso)
+    uint32_t        acquires;
+} host_pm_t;
+
+static inline host_pm_t *host_pm(void)
+{
+    static host_pm_t pm;
+    return &pm;
+}
+
+static inline esp_err_t esp_pm_configure(const void *config)
+{
+    host_pm()->cfg = *(const esp_pm_config_t *)config;
+    host_pm()->configured = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                                           esp_pm_lock_handle_t *out)
+{
+    (void)arg;
+    struct host_pm_lock *l = calloc(1, sizeof *l);
+    if (!l) return ESP_ERR_NO_MEM;
+    l->type = type;
+    l->name = name;
+    *out = l;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t l)
+{
+    host_pm_t *pm = host_pm();
+    pm->acquires++;
+    if (l->count++ == 0 && l->type == ESP_PM_NO_LIGHT_SLEEP && pm->no_sleep++ == 0)
+        pm->no_sleep_since = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t l)
+{
+    host_pm_t *pm = host_pm();
+    if (l->count == 0) return ESP_ERR_INVALID_STATE;
+    if (--l->count == 0 && l->type == ESP_PM_NO_LIGHT_SLEEP && --pm->no_sleep == 0)
+        pm->no_sleep_us += esp_timer_get_time() - pm->no_sleep_since;
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_PM_H
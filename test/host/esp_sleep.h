@@ -0,0 +1,57 @@
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Solo qué despertaría al chip: pines ext1 con su nivel, GPIO y UART
+typedef struct {
+    uint64_t ext1_mask;
+    uint64_t ext1_high;      // de ext1_mask, los que despiertan en alto
+    bool     gpio;
+    int      uart;           // -1 = ninguno
+} host_sleep_t;
+
+static inline host_sleep_t *host_sleep(void)
+{
+    static host_sleep_t s = { .uart = -1 };
+    return &s;
+}
+
+static inline esp_err_t esp_sleep_enable_ext1_wakeup_with_level_mask(uint64_t io_mask, uint64_t level_mask)
+{
+    host_sleep_t *s = host_sleep();
+    s->ext1_mask |= io_mask;
+    s->ext1_high = (s->ext1_high & ~io_mask) | (level_mask & io_mask);
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_sleep_disable_ext1_wakeup_io(uint64_t io_mask)
+{
+    host_sleep()->ext1_mask &= ~io_mask;
+    host_sleep()->ext1_high &= ~io_mask;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    host_sleep()->gpio = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_sleep_enable_uart_wakeup(int uart_num)
+{
+    host_sleep()->uart = uart_num;
+    return ESP_OK;
+}
+
+// ¿Despertaría este pin con este nivel?
+static inline bool host_sleep_ext1_wakes(int pin, int level)
+{
+    host_sleep_t *s = host_sleep();
+    uint64_t bit = 1ULL << pin;
+    return (s->ext1_mask & bit) && !!(s->ext1_high & bit) == !!level;
+}
+
+#endif // HOST_ESP_SLEEP_H
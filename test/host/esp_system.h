@@ -0,0 +1,29 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdio.h>
+
+typedef enum {
+    ESP_RST_UNKNOWN = 0,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+} esp_reset_reason_t;
+
+// En el PC no se reinicia: se cuenta, y la prueba decide qué hacer
+static inline unsigned *host_restarts(void)
+{
+    static unsigned n;
+    return &n;
+}
+
+static inline void esp_restart(void)
+{
+    (*host_restarts())++;
+    printf("esp_restart() (%u)\n", *host_restarts());
+}
+
+static inline esp_reset_reason_t esp_reset_reason(void) { return ESP_RST_POWERON; }
+
+#endif // HOST_ESP_SYSTEM_H
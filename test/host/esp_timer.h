@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// us desde el arranque del programa (monotónico)
+static inline int64_t esp_timer_get_time(void) { return host_now_us(); }
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,24 @@
+#ifndef HOST_ESP_VFS_FAT_H
+#define HOST_ESP_VFS_FAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/sdspi_host.h"
+
+typedef struct {
+    bool   format_if_mount_failed;
+    int    max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_mount_config_t;
+
+// Sin tarjeta: el firmware sigue con las locuciones de la flash
+static inline esp_err_t esp_vfs_fat_sdspi_mount(const char *base, const sdmmc_host_t *host,
+                                                const sdspi_device_config_t *dev,
+                                                const esp_vfs_fat_mount_config_t *cfg, sdmmc_card_t **card)
+{
+    (void)base; (void)host; (void)dev; (void)cfg; (void)card;
+    return ESP_ERR_NOT_FOUND;
+}
+
+#endif // HOST_ESP_VFS_FAT_H
@@ -0,0 +1,94 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * FreeRTOS sobre POSIX para las pruebas en el PC (env:native).
+ *
+ * Solo lo que usan las cabeceras de include/: tareas como hilos, colas y
+ * semáforos con mutex + condición, y secciones críticas como mutex. El
+ * tick es de 1 ms. Las prioridades no se respetan (el planificador es el
+ * del sistema), así que las latencias que se midan aquí son las del
+ * código, no las del reparto de CPU del ESP32-C6.
+ */
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdTRUE            1
+#define pdFALSE           0
+#define pdPASS            pdTRUE
+#define pdFAIL            pdFALSE
+#define portMAX_DELAY     ((TickType_t)0xFFFFFFFFu)
+
+#define configTICK_RATE_HZ   1000
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define configASSERT(x)      do { if (!(x)) __builtin_trap(); } while (0)
+
+#ifdef HOST_VIRTUAL_CLOCK
+/* Reloj virtual (la prueba define HOST_VIRTUAL_CLOCK antes de incluir nada):
+ * no corre solo, lo avanzan host_timers_run_until() (freertos/timers.h) y
+ * vTaskDelay(). Así una hora de tráfico se simula en milisegundos. */
+static int64_t host_vclock_us;
+static inline int64_t host_now_us(void) { return host_vclock_us; }
+#else
+// Reloj monotónico en us desde el primer uso (también es esp_timer_get_time)
+static inline int64_t host_now_us(void)
+{
+    static int64_t t0 = -1;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (t0 < 0) t0 = now;
+    return now - t0;
+}
+__attribute__((constructor)) static void host_clock_start(void) { host_now_us(); }
+#endif
+
+// Instante absoluto (CLOCK_MONOTONIC) a ticks de ahora, para pthread_cond_timedwait
+static inline void host_deadline(TickType_t ticks, struct timespec *ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = (uint64_t)ticks * (1000000000ull / configTICK_RATE_HZ) + ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ull;
+    ts->tv_nsec = ns % 1000000000ull;
+}
+
+static inline void host_cond_init(pthread_cond_t *c)
+{
+    pthread_condattr_t a;
+    pthread_condattr_init(&a);
+    pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &a);
+    pthread_condattr_destroy(&a);
+}
+
+/* Secciones críticas: un mutex por portMUX (en el C6 es un spinlock y
+ * además enmascara interrupciones; aquí basta con la exclusión). */
+typedef struct { pthread_mutex_t m; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->m)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->m)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(...)         ((void)0)
+
+// Un hilo de prueba puede marcarse como "ISR" (p.ej. el que inyecta flancos)
+static inline int *host_isr_flag(void)
+{
+    static __thread int in_isr;
+    return &in_isr;
+}
+static inline BaseType_t xPortInIsrContext(void) { return *host_isr_flag() != 0; }
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,137 @@
+#ifndef HOST_QUEUE_H
+#define HOST_QUEUE_H
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Cola de FreeRTOS: anillo de elementos de tamaño fijo con un mutex y dos
+ * condiciones. Con tamaño de elemento 0 es un semáforo (semphr.h).
+ */
+typedef struct host_queue {
+    pthread_mutex_t m;
+    pthread_cond_t  can_rx, can_tx;
+    UBaseType_t     len, size, count, head;
+    uint8_t        *buf;
+} host_queue_t;
+
+typedef host_queue_t *QueueHandle_t;
+
+static inline void host_queue_init(host_queue_t *q, UBaseType_t len, UBaseType_t size, UBaseType_t count)
+{
+    memset(q, 0, sizeof *q);
+    pthread_mutex_init(&q->m, NULL);
+    host_cond_init(&q->can_rx);
+    host_cond_init(&q->can_tx);
+    q->len = len;
+    q->size = size;
+    q->count = count;
+}
+
+static inline QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t size)
+{
+    host_queue_t *q = malloc(sizeof *q);
+    if (!q) return NULL;
+    host_queue_init(q, len, size, 0);
+    if (size && !(q->buf = malloc((size_t)len * size))) {
+        free(q);
+        return NULL;
+    }
+    return q;
+}
+
+// Espera en c hasta que cond deje de cumplirse; false si vencen los ticks
+static inline bool host_queue_wait(host_queue_t *q, pthread_cond_t *c, bool full, TickType_t ticks)
+{
+    struct timespec ts;
+    if (ticks != portMAX_DELAY) host_deadline(ticks, &ts);
+    while (full ? q->count == q->len : q->count == 0) {
+        if (ticks == 0) return false;
+        if (ticks == portMAX_DELAY) pthread_cond_wait(c, &q->m);
+        else if (pthread_cond_timedwait(c, &q->m, &ts) == ETIMEDOUT &&
+                 (full ? q->count == q->len : q->count == 0)) return false;
+    }
+    return true;
+}
+
+static inline BaseType_t host_queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    pthread_mutex_lock(&q->m);
+    if (!host_queue_wait(q, &q->can_tx, true, ticks)) {
+        pthread_mutex_unlock(&q->m);
+        return pdFALSE;
+    }
+    if (q->size) {
+        UBaseType_t slot;
+        if (front) slot = q->head = (q->head + q->len - 1) % q->len;
+        else       slot = (q->head + q->count) % q->len;
+        if (item) memcpy(q->buf + (size_t)slot * q->size, item, q->size);
+    }
+    q->count++;
+    pthread_cond_signal(&q->can_rx);
+    pthread_mutex_unlock(&q->m);
+    return pdTRUE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->m);
+    if (!host_queue_wait(q, &q->can_rx, false, ticks)) {
+        pthread_mutex_unlock(&q->m);
+        return pdFALSE;
+    }
+    if (q->size) {
+        if (item) memcpy(item, q->buf + (size_t)q->head * q->size, q->size);
+        q->head = (q->head + 1) % q->len;
+    }
+    q->count--;
+    pthread_cond_signal(&q->can_tx);
+    pthread_mutex_unlock(&q->m);
+    return pdTRUE;
+}
+
+// Como xQueueReceive pero sin sacarlo: el aviso pasa al siguiente que espere
+static inline BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->m);
+    if (!host_queue_wait(q, &q->can_rx, false, ticks)) {
+        pthread_mutex_unlock(&q->m);
+        return pdFALSE;
+    }
+    if (q->size && item) memcpy(item, q->buf + (size_t)q->head * q->size, q->size);
+    pthread_cond_signal(&q->can_rx);
+    pthread_mutex_unlock(&q->m);
+    return pdTRUE;
+}
+
+#define xQueueSend(q, item, ticks)         host_queue_send((q), (item), (ticks), false)
+#define xQueueSendToBack(q, item, ticks)   host_queue_send((q), (item), (ticks), false)
+#define xQueueSendToFront(q, item, ticks)  host_queue_send((q), (item), (ticks), true)
+
+static inline BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+    if (woken) *woken = pdFALSE;
+    return host_queue_send(q, item, 0, false);
+}
+
+static inline BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->m);
+    q->count = q->head = 0;
+    pthread_cond_broadcast(&q->can_tx);
+    pthread_mutex_unlock(&q->m);
+    return pdPASS;
+}
+
+static inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->m);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->m);
+    return n;
+}
+
+#endif // HOST_QUEUE_H
@@ -0,0 +1,32 @@
+#ifndef HOST_SEMPHR_H
+#define HOST_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Como en FreeRTOS: un semáforo es una cola de elementos vacíos
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef host_queue_t  StaticSemaphore_t;
+
+static inline SemaphoreHandle_t host_sem_create(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t s = xQueueCreate(max, 0);
+    if (s) s->count = initial;
+    return s;
+}
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf)
+{
+    host_queue_init(buf, 1, 0, 0);
+    return buf;
+}
+
+#define xSemaphoreCreateBinary()              host_sem_create(1, 0)
+#define xSemaphoreCreateCounting(max, init)   host_sem_create((max), (init))
+#define xSemaphoreCreateMutex()               host_sem_create(1, 1)
+#define xSemaphoreTake(s, ticks)              xQueueReceive((s), NULL, (ticks))
+#define xSemaphoreGive(s)                     xQueueSend((s), NULL, 0)
+#define xSemaphoreGiveFromISR(s, woken)       xQueueSendFromISR((s), NULL, (woken))
+#define uxSemaphoreGetCount(s)                uxQueueMessagesWaiting(s)
+
+#endif // HOST_SEMPHR_H
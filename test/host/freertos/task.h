@@ -0,0 +1,73 @@
+#ifndef HOST_TASK_H
+#define HOST_TASK_H
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef pthread_t *TaskHandle_t;
+
+typedef struct {
+    TaskFunction_t fn;
+    void          *arg;
+} host_task_start_t;
+
+static inline void *host_task_main(void *p)
+{
+    host_task_start_t s = *(host_task_start_t *)p;
+    free(p);
+    s.fn(s.arg);
+    return NULL;
+}
+
+// Un hilo suelto por tarea; la pila y la prioridad se ignoran
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                                     void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    (void)name; (void)stack; (void)prio;
+    host_task_start_t *s = malloc(sizeof *s);
+    if (!s) return pdFAIL;
+    s->fn = fn;
+    s->arg = arg;
+    pthread_t t;
+    if (pthread_create(&t, NULL, host_task_main, s) != 0) {
+        free(s);
+        return pdFAIL;
+    }
+    pthread_detach(t);
+    if (handle) *handle = NULL;
+    return pdPASS;
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+#ifdef HOST_VIRTUAL_CLOCK
+    // La tarea "duerme" y el reloj corre; lo que venza entretanto salta en el siguiente host_timers_run_until()
+    host_vclock_us += (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+    return;
+#endif
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0) {}
+}
+
+static inline void vTaskDelete(TaskHandle_t t)
+{
+    if (!t) pthread_exit(NULL);
+}
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_now_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+#endif // HOST_TASK_H
@@ -0,0 +1,110 @@
+#ifndef HOST_TIMERS_H
+#define HOST_TIMERS_H
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Temporizadores de software sobre el reloj virtual: no hay tarea de
+ * temporizadores, vencen por orden cuando la prueba avanza el reloj con
+ * host_timers_run_until(), y el callback corre en ese mismo hilo. Con el
+ * reloj real no tendrían quién los dispare, así que solo valen con
+ * HOST_VIRTUAL_CLOCK.
+ */
+#ifndef HOST_VIRTUAL_CLOCK
+#error "freertos/timers.h del host necesita HOST_VIRTUAL_CLOCK"
+#endif
+
+#define HOST_TIMERS_MAX  16
+
+typedef struct host_timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+struct host_timer {
+    const char             *name;
+    TickType_t              period;
+    bool                    reload;
+    void                   *id;
+    TimerCallbackFunction_t cb;
+    bool                    active;
+    int64_t                 due_us;
+};
+
+static struct {
+    struct host_timer *t[HOST_TIMERS_MAX];
+    int                n;
+    uint32_t           fired;
+} host_timers;
+
+static inline TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload, void *id,
+                                         TimerCallbackFunction_t cb)
+{
+    if (host_timers.n == HOST_TIMERS_MAX) return NULL;
+    struct host_timer *t = calloc(1, sizeof *t);
+    if (!t) return NULL;
+    *t = (struct host_timer){ .name = name, .period = period, .reload = reload, .id = id, .cb = cb };
+    host_timers.t[host_timers.n++] = t;
+    return t;
+}
+
+static inline BaseType_t xTimerReset(TimerHandle_t t, TickType_t wait)
+{
+    (void)wait;
+    t->active = true;
+    t->due_us = host_vclock_us + (int64_t)t->period * (1000000 / configTICK_RATE_HZ);
+    return pdPASS;
+}
+
+static inline BaseType_t xTimerStop(TimerHandle_t t, TickType_t wait)
+{
+    (void)wait;
+    t->active = false;
+    return pdPASS;
+}
+
+static inline BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t wait)
+{
+    t->period = period;
+    return xTimerReset(t, wait);
+}
+
+static inline BaseType_t xTimerResetFromISR(TimerHandle_t t, BaseType_t *woken)
+{
+    if (woken) *woken = pdFALSE;
+    return xTimerReset(t, 0);
+}
+
+static inline BaseType_t xTimerStopFromISR(TimerHandle_t t, BaseType_t *woken)
+{
+    if (woken) *woken = pdFALSE;
+    return xTimerStop(t, 0);
+}
+
+#define xTimerStart(t, wait)             xTimerReset((t), (wait))
+#define xTimerStartFromISR(t, woken)     xTimerResetFromISR((t), (woken))
+
+static inline BaseType_t xTimerIsTimerActive(TimerHandle_t t) { return t->active; }
+static inline void *pvTimerGetTimerID(TimerHandle_t t) { return t->id; }
+
+// Avanza el reloj hasta t_us disparando por orden lo que venza (también lo que se rearme entretanto)
+static inline void host_timers_run_until(int64_t t_us)
+{
+    for (;;) {
+        struct host_timer *next = NULL;
+        for (int i = 0; i < host_timers.n; i++) {
+            struct host_timer *t = host_timers.t[i];
+            if (t->active && t->due_us <= t_us && (!next || t->due_us < next->due_us)) next = t;
+        }
+        if (!next) break;
+        if (next->due_us > host_vclock_us) host_vclock_us = next->due_us;
+        if (next->reload) next->due_us += (int64_t)next->period * (1000000 / configTICK_RATE_HZ);
+        else next->active = false;
+        host_timers.fired++;
+        next->cb(next);
+    }
+    if (t_us > host_vclock_us) host_vclock_us = t_us;
+}
+
+static inline void host_timers_run_for_ms(uint32_t ms) { host_timers_run_until(host_vclock_us + (int64_t)ms * 1000); }
+
+#endif // HOST_TIMERS_H
@@ -0,0 +1,207 @@
+#ifndef HOST_ALERT_H
+#define HOST_ALERT_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * alert_core.h sobre un reloj virtual: el alert_hal_t de main.c con los
+ * pines, los relés y los temporizadores de FreeRTOS simulados.
+ *
+ * El tiempo solo avanza con ha_run_until(), que dispara por orden los
+ * temporizadores que vencen por el camino, así que 30 s de espera cuestan
+ * lo mismo que 30 us. Los eventos (lector puesto o quitado, ráfaga del
+ * sensor, botón) entran en el instante actual, como los manda alert_task
+ * tras la ISR. Con trace se imprime la línea de tiempo: los mensajes del
+ * propio motor (AC_LOG*) y lo que hace el HAL.
+ */
+
+typedef struct host_alert host_alert_t;
+static host_alert_t *ha_cur;                  // para sellar los AC_LOG* con el reloj virtual
+static void ha_log(char lvl, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define AC_LOGI(...)  ha_log('I', __VA_ARGS__)
+#define AC_LOGW(...)  ha_log('W', __VA_ARGS__)
+#define AC_LOGE(...)  ha_log('E', __VA_ARGS__)
+#include "alert_core.h"
+
+#define HA_OFF  (-1)
+
+struct host_alert {
+    alert_core_t  core;
+    alert_hal_t   hal;
+    app_config_t  cfg;
+    int64_t       now_us;
+    bool          trace;
+    bool          arm_level[AC_CH_MAX];            // lector presente, tal cual está el pin
+    int64_t       due_us[AC_T_COUNT][AC_CH_MAX];   // HA_OFF = parado
+    uint8_t       relays;                          // última salida
+    int64_t       relays_us;                       // desde cuándo
+    // Lo que ha pasado, para las pruebas
+    uint32_t      wakeups;                         // veces que se despertaría alert_task
+    uint32_t      timer_fired, timer_starts;
+    uint32_t      relay_writes;
+    uint32_t      escalations[AC_CH_MAX];
+    int64_t       escalated_us[AC_CH_MAX];         // cuándo empezaron las últimas llamadas
+    uint32_t      cancels, samples;
+    uint32_t      notes[JR_EV_COUNT];
+    uint16_t      last_note_arg;
+    bool          wake_high[AC_CH_MAX];            // nivel que despertaría del light sleep
+};
+
+static void ha_log(char lvl, const char *fmt, ...)
+{
+    if (!ha_cur || !ha_cur->trace) return;
+    va_list ap;
+    va_start(ap, fmt);
+    printf("  %9.3f s  %c  ", ha_cur->now_us / 1e6, lvl);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+/* ───────────────────────── HAL ───────────────────────── */
+static int64_t ha_now_us(void *ctx) { return ((host_alert_t *)ctx)->now_us; }
+static const app_config_t *ha_cfg(void *ctx) { return &((host_alert_t *)ctx)->cfg; }
+static bool ha_arm_present(void *ctx, int ch) { return ((host_alert_t *)ctx)->arm_level[ch]; }
+
+static void ha_relays(void *ctx, uint8_t mask)
+{
+    host_alert_t *s = ctx;
+    s->relay_writes++;
+    if (mask != s->relays) {
+        ha_log('-', "relés %c%c%c", mask & 1 ? 'V' : '.', mask & 2 ? 'V' : '.', mask & 4 ? 'L' : '.');
+        s->relays = mask;
+        s->relays_us = s->now_us;
+    }
+}
+
+static void ha_timer_start(void *ctx, ac_timer_t t, int ch, uint32_t ms)
+{
+    host_alert_t *s = ctx;
+    s->timer_starts++;
+    s->due_us[t][ch] = s->now_us + (int64_t)ms * 1000;
+}
+
+static void ha_timer_stop(void *ctx, ac_timer_t t, int ch) { ((host_alert_t *)ctx)->due_us[t][ch] = HA_OFF; }
+
+static void ha_escalate(void *ctx, int ch)
+{
+    host_alert_t *s = ctx;
+    s->escalations[ch]++;
+    s->escalated_us[ch] = s->now_us;
+    ha_log('-', "escalado: llamadas del canal %d", ch);
+}
+
+static void ha_cancel(void *ctx)
+{
+    host_alert_t *s = ctx;
+    s->cancels++;
+    ha_log('-', "escalado cancelado");
+}
+
+static void ha_sample(void *ctx, int ch)
+{
+    (void)ch;
+    ((host_alert_t *)ctx)->samples++;
+}
+static void ha_arm_changed(void *ctx, int ch, bool present) { ((host_alert_t *)ctx)->wake_high[ch] = !present; }
+
+static void ha_note(void *ctx, jr_event_t type, int ch, uint16_t arg)
+{
+    host_alert_t *s = ctx;
+    s->notes[type]++;
+    s->last_note_arg = arg;
+    ha_log('-', "diario: %s c%d %u", JR_EV_NAME[type], ch, arg);
+}
+
+/* ───────────────────────── simulación ───────────────────────── */
+
+// Motor con la configuración de fábrica; los canales se añaden después
+static void ha_init(host_alert_t *s, uint8_t light_relay)
+{
+    memset(s, 0, sizeof *s);
+    cfg_defaults(&s->cfg);
+    for (int t = 0; t < AC_T_COUNT; t++)
+        for (int c = 0; c < AC_CH_MAX; c++) s->due_us[t][c] = HA_OFF;
+    s->hal = (alert_hal_t){
+        .ctx = s, .now_us = ha_now_us, .cfg = ha_cfg, .arm_present = ha_arm_present,
+        .relays = ha_relays, .timer_start = ha_timer_start, .timer_stop = ha_timer_stop,
+        .escalate = ha_escalate, .cancel = ha_cancel, .sample = ha_sample,
+        .arm_changed = ha_arm_changed, .note = ha_note,
+    };
+    s->core.hal = &s->hal;
+    s->core.light = light_relay;
+    ha_cur = s;
+}
+
+static void ha_start(host_alert_t *s)
+{
+    ha_cur = s;
+    alert_core_start(&s->core);
+}
+
+// Avanza hasta t_us disparando por orden los temporizadores que vencen
+static void ha_run_until(host_alert_t *s, int64_t t_us)
+{
+    ha_cur = s;
+    for (;;) {
+        int bt = -1, bc = -1;
+        int64_t best = t_us + 1;
+        for (int t = 0; t < AC_T_COUNT; t++) {
+            for (uint32_t c = 0; c < s->core.n_ch; c++) {
+                int64_t d = s->due_us[t][c];
+                if (d != HA_OFF && d < best) { best = d; bt = t; bc = (int)c; }
+            }
+        }
+        if (bt < 0) break;
+        if (best > s->now_us) s->now_us = best;
+        s->due_us[bt][bc] = HA_OFF;
+        s->timer_fired++;
+        s->wakeups++;
+        alert_core_timeout(&s->core, (ac_timer_t)bt, bc);
+    }
+    if (t_us > s->now_us) s->now_us = t_us;
+}
+
+static int64_t ha_ms(double ms) { return (int64_t)(ms * 1000); }
+
+// Eventos en el instante actual, como los despacha alert_task
+static void ha_arm(host_alert_t *s, int ch, bool present)
+{
+    ha_cur = s;
+    s->wakeups++;
+    s->arm_level[ch] = present;
+    alert_core_arm_edge(&s->core, ch, present, s->now_us);
+}
+
+static void ha_vib(host_alert_t *s, int ch)
+{
+    ha_cur = s;
+    s->wakeups++;
+    alert_core_sensor(&s->core, ch, s->now_us);
+}
+
+static void ha_button(host_alert_t *s)
+{
+    ha_cur = s;
+    s->wakeups += 2;
+    ha_log('-', "botón");
+    alert_core_button(&s->core, true);
+    alert_core_button(&s->core, false);
+}
+
+// Fin de las llamadas sin que nadie atienda (lo que avisa g_called_mask)
+static void ha_called(host_alert_t *s, int ch)
+{
+    ha_cur = s;
+    s->wakeups++;
+    alert_core_called(&s->core, ch);
+}
+
+static uint8_t ha_state(const host_alert_t *s, int ch) { return s->core.ch[ch].state; }
+
+#endif // HOST_ALERT_H
@@ -0,0 +1,48 @@
+#ifndef HOST_MODEM_H
+#define HOST_MODEM_H
+
+#include "at_engine.h"
+#include "urc.h"
+#include "sim800.h"
+
+/*
+ * El lado del firmware del enlace sin modem.h (que arrastra audio y SMS):
+ * lo mismo que modem_init() y el bucle lector de modem_task, contra un
+ * SIM800 simulado. La prueba define MODEM_UART.
+ */
+
+static inline void host_modem_reader(void *arg)
+{
+    (void)arg;
+    modem_line_t l;
+    for (;;) {
+        if (!ml_next(&l, 30000)) continue;
+        if (at_activity_hook) at_activity_hook(false);
+        if (l.cont) continue;
+        if (urc_take_body(l.text)) continue;
+        int id = urc_lookup(l.text, l.len);
+        if (at_on_line(&l, id >= 0)) continue;
+        if (id >= 0) urc_feed(id, l.text, l.t_us);
+    }
+}
+
+// Solo el enlace: UART y simulador, sin tareas (para medir otro lector)
+static inline void host_modem_link(sim800_t *sim)
+{
+    ESP_ERROR_CHECK(uart_driver_install(MODEM_UART, 1024, 0, MIO_EVENT_QUEUE_LEN, &g_modem_uart_queue, 0));
+    sim800_start(sim, MODEM_UART);
+}
+
+static inline void host_modem_start(sim800_t *sim)
+{
+    if (!host_uart(MODEM_UART)->open) host_modem_link(sim);
+    uart_flush_input(MODEM_UART);
+    xQueueReset(g_modem_uart_queue);
+    ml_init();
+    urc_init();
+    ESP_ERROR_CHECK(at_engine_start());
+    xTaskCreate(urc_task, "urc_task", URC_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(host_modem_reader, "modem_task", 4096, NULL, 7, NULL);
+}
+
+#endif // HOST_MODEM_H
@@ -0,0 +1,63 @@
+#ifndef HOST_PROMPTS_H
+#define HOST_PROMPTS_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_partition.h"
+#include "prompt_bundle.h"
+#include "wav.h"
+
+/*
+ * Paquete de locuciones de prueba en la partición "prompts" (la del
+ * firmware: datos, subtipo 0x41), hecho en C como lo haría
+ * tools/pack_prompts.py: tonos PCM de 16 bits con la duración, la
+ * frecuencia de muestreo y los canales que se pidan.
+ */
+
+typedef struct {
+    const char *name;       // "menu.wav"
+    uint32_t    rate;
+    uint16_t    channels;
+    uint32_t    ms;
+    uint16_t    hz;         // tono; 0 = silencio
+} host_prompt_t;
+
+static inline esp_partition_t *host_prompts_install(const host_prompt_t *p, int n)
+{
+    uint32_t total = sizeof(pb_header_t) + n * sizeof(pb_entry_t);
+    for (int i = 0; i < n; i++) total += ((uint64_t)p[i].rate * p[i].ms / 1000 * 2 * p[i].channels + 3) & ~3u;
+    uint32_t size = (total + HOST_SECTOR - 1) / HOST_SECTOR * HOST_SECTOR;
+    esp_partition_t *part = host_partition_add(ESP_PARTITION_TYPE_DATA, 0x41, "prompts", size);
+    if (!part) return NULL;
+
+    uint8_t *base = part->mem;
+    pb_entry_t *idx = (pb_entry_t *)(base + sizeof(pb_header_t));
+    uint32_t off = sizeof(pb_header_t) + n * sizeof(pb_entry_t);
+    for (int i = 0; i < n; i++) {
+        uint32_t frames = (uint64_t)p[i].rate * p[i].ms / 1000;
+        int16_t *pcm = (int16_t *)(base + off);
+        for (uint32_t f = 0; f < frames; f++) {
+            int16_t v = p[i].hz ? (int16_t)(8000 * sin(2 * M_PI * p[i].hz * f / p[i].rate)) : 0;
+            if (p[i].hz && v == 0) v = 1;        // un tono no tiene muestras de silencio
+            for (int c = 0; c < p[i].channels; c++) pcm[f * p[i].channels + c] = v;
+        }
+        pb_entry_t *e = &idx[i];
+        memset(e, 0, sizeof *e);
+        snprintf(e->name, sizeof e->name, "%s", p[i].name);
+        e->off = off;
+        e->len = frames * 2 * p[i].channels;
+        e->rate = p[i].rate;
+        e->channels = p[i].channels;
+        e->format = WAV_FMT_PCM;
+        e->block_align = 2 * p[i].channels;
+        off += (e->len + 3) & ~3u;
+    }
+    pb_header_t h = { .magic = PB_MAGIC, .version = PB_VERSION, .count = (uint16_t)n, .total = off,
+                      .crc = pb_crc32(idx, n * sizeof(pb_entry_t)) };
+    memcpy(base, &h, sizeof h);
+    return part;
+}
+
+#endif // HOST_PROMPTS_H
@@ -0,0 +1,52 @@
+#ifndef HOST_UTIL_H
+#define HOST_UTIL_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Utilidades de las pruebas en el PC: tiempo de CPU, esperas y escritura
+ * al ritmo de un UART. */
+
+// CPU consumida por el hilo que llama, en us
+static inline int64_t host_cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void host_sleep_us(int64_t us)
+{
+    if (us <= 0) return;
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+/*
+ * Escribe len bytes en fd como los sacaría un UART a baud baudios (10
+ * bits por byte): en trozos de 32 bytes con la pausa que les toca.
+ * baud = 0: de golpe.
+ */
+static inline void host_paced_write(int fd, const void *data, size_t len, uint32_t baud)
+{
+    const uint8_t *p = data;
+    while (len) {
+        size_t n = baud && len > 32 ? 32 : len;
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        len -= w;
+        if (baud) host_sleep_us((int64_t)w * 10 * 1000000 / baud);
+    }
+}
+
+static inline void host_paced_puts(int fd, const char *s, uint32_t baud)
+{
+    host_paced_write(fd, s, strlen(s), baud);
+}
+
+#endif // HOST_UTIL_H
@@ -0,0 +1,195 @@
+#ifndef HOST_VIB_H
+#define HOST_VIB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Trazas del SW-420 (la salida del comparador, tal como llega al pin) con
+ * su etiqueta: si son el aviso de un lector o cualquier otra cosa.
+ *
+ * El muelle del sensor no da un pulso por golpe sino una ráfaga de
+ * rebotes: pulsos de decenas de us a un par de ms mientras dura la
+ * vibración. Sobre eso se montan los escenarios: el aviso del lector
+ * (pulsos de motor con su periodo y algo de deriva), golpes sueltos en la
+ * mesilla, pasos junto a la cama, alguien moviéndose en la cama, un
+ * camión por la calle y picos de interferencia de menos de 1 us. Cada
+ * traza sale de una semilla, así que el mismo (tipo, semilla) da siempre
+ * la misma traza y no hace falta guardar ficheros.
+ */
+
+#define HV_TRACE_US     (10 * 1000000LL)     // 10 s por traza
+#define HV_PULSES_MAX   16384
+
+typedef struct {
+    int64_t  t_us;          // flanco de subida
+    uint32_t w_ns;          // anchura del pulso alto
+} hv_pulse_t;
+
+typedef enum {
+    HV_ALERT_FAST = 0,      // lector_alarma: ~200 ms de motor cada 500 ms
+    HV_ALERT_SLOW,          // lector_aviso:  ~300 ms cada 1000 ms
+    HV_KNOCK,               // uno o dos golpes en la mesilla
+    HV_STEPS,               // pasos junto a la cama (casi periódicos, ~550 ms)
+    HV_RATTLE,              // alguien se mueve en la cama: irregular
+    HV_TRUCK,               // camión: ráfagas cortas cada 1-2,5 s
+    HV_EMI,                 // picos de interferencia (< 1 us)
+    HV_KINDS
+} hv_kind_t;
+
+static const char *const HV_KIND_NAME[HV_KINDS] = {
+    "aviso 500 ms", "aviso 1000 ms", "golpes", "pasos", "movimiento", "camión", "interferencia",
+};
+
+typedef struct {
+    hv_kind_t  kind;
+    bool       alarm;       // etiqueta: es el aviso de un lector
+    int64_t    alarm_us;    // cuándo empieza el aviso
+    int        n;
+    hv_pulse_t p[HV_PULSES_MAX];
+} hv_trace_t;
+
+/* ─────────────────────────── azar ─────────────────────────── */
+typedef struct { uint32_t s; } hv_rng_t;
+
+static inline uint32_t hv_rand(hv_rng_t *r)
+{
+    uint32_t x = r->s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return r->s = x;
+}
+
+static inline int64_t hv_uniform(hv_rng_t *r, int64_t lo, int64_t hi)
+{
+    return lo + (int64_t)(hv_rand(r) % (uint32_t)(hi - lo + 1));
+}
+
+/* ───────────────────────── piezas ───────────────────────── */
+static inline void hv_add(hv_trace_t *t, int64_t t_us, uint32_t w_ns)
+{
+    if (t->n < HV_PULSES_MAX && t_us >= 0 && t_us < HV_TRACE_US) t->p[t->n++] = (hv_pulse_t){ t_us, w_ns };
+}
+
+// Rebotes del muelle durante dur_us; strength 1..4 (más fuerte, más denso)
+static inline void hv_chatter(hv_trace_t *t, hv_rng_t *r, int64_t t0, int64_t dur_us, int strength)
+{
+    for (int64_t u = t0; u < t0 + dur_us;) {
+        int64_t w = hv_uniform(r, 30, 400 * strength);
+        hv_add(t, u, (uint32_t)(w * 1000));
+        u += w + hv_uniform(r, 100, 3000 / strength);
+    }
+}
+
+static inline void hv_glitch(hv_trace_t *t, hv_rng_t *r, int64_t t0)
+{
+    hv_add(t, t0, (uint32_t)hv_uniform(r, 80, 450));
+}
+
+// Motor del lector: on_ms de rebotes cada period_ms desde t0 hasta el final
+static inline void hv_motor(hv_trace_t *t, hv_rng_t *r, int64_t t0, int period_ms, int on_ms)
+{
+    int64_t period = period_ms * 1000LL * hv_uniform(r, 970, 1030) / 1000;   // deriva del modelo
+    int strength = (int)hv_uniform(r, 1, 3);                                   // cómo apoya el lector
+    for (int64_t u = t0; u < HV_TRACE_US; u += period) {
+        int64_t jitter = hv_uniform(r, -15000, 15000);
+        int64_t on = on_ms * 1000LL + hv_uniform(r, -40000, 40000);
+        if (hv_rand(r) % 20 == 0) continue;                                      // un pulso que no llega
+        hv_chatter(t, r, u + jitter, on, strength);
+    }
+}
+
+static inline void hv_knock(hv_trace_t *t, hv_rng_t *r, int64_t t0)
+{
+    hv_chatter(t, r, t0, hv_uniform(r, 5000, 30000), (int)hv_uniform(r, 2, 4));
+}
+
+static inline int hv_cmp(const void *a, const void *b)
+{
+    const hv_pulse_t *x = a, *y = b;
+    return x->t_us < y->t_us ? -1 : x->t_us > y->t_us;
+}
+
+// Ordena y funde los pulsos que se solapan (el pin solo ve su unión)
+static inline void hv_finish(hv_trace_t *t)
+{
+    qsort(t->p, t->n, sizeof t->p[0], hv_cmp);
+    int k = 0;
+    for (int i = 0; i < t->n; i++) {
+        if (k) {
+            hv_pulse_t *last = &t->p[k - 1];
+            int64_t end_ns = last->t_us * 1000 + last->w_ns;
+            if (t->p[i].t_us * 1000 <= end_ns) {
+                int64_t e = t->p[i].t_us * 1000 + t->p[i].w_ns;
+                if (e > end_ns) last->w_ns = (uint32_t)(e - last->t_us * 1000);
+                continue;
+            }
+        }
+        t->p[k++] = t->p[i];
+    }
+    t->n = k;
+}
+
+/* ───────────────────────── escenarios ───────────────────────── */
+static inline void hv_make(hv_trace_t *t, hv_kind_t kind, uint32_t seed)
+{
+    hv_rng_t r = { seed * 2654435761u + kind + 1 };
+    for (int i = 0; i < 4; i++) hv_rand(&r);
+    t->kind = kind;
+    t->alarm = kind == HV_ALERT_FAST || kind == HV_ALERT_SLOW;
+    t->alarm_us = 0;
+    t->n = 0;
+    int64_t t0 = hv_uniform(&r, 500000, 3000000);
+
+    switch (kind) {
+    case HV_ALERT_FAST:
+        t->alarm_us = t0;
+        hv_motor(t, &r, t0, 500, 200);
+        break;
+    case HV_ALERT_SLOW:
+        t->alarm_us = t0;
+        hv_motor(t, &r, t0, 1000, 300);
+        break;
+    case HV_KNOCK:
+        hv_knock(t, &r, t0);
+        if (hv_rand(&r) % 2) hv_knock(t, &r, t0 + hv_uniform(&r, 150000, 1500000));
+        break;
+    case HV_STEPS: {
+        int64_t step = hv_uniform(&r, 450000, 650000);
+        int n = (int)hv_uniform(&r, 4, 12);
+        for (int i = 0; i < n; i++, t0 += step * hv_uniform(&r, 88, 112) / 100) hv_knock(t, &r, t0);
+        break;
+    }
+    case HV_RATTLE:
+        for (int64_t end = t0 + hv_uniform(&r, 1000000, 4000000); t0 < end;) {
+            int64_t d = hv_uniform(&r, 20000, 150000);
+            hv_chatter(t, &r, t0, d, (int)hv_uniform(&r, 1, 4));
+            t0 += d + hv_uniform(&r, 30000, 400000);
+        }
+        break;
+    case HV_TRUCK:
+        for (t0 = hv_uniform(&r, 0, 500000); t0 < HV_TRACE_US; t0 += hv_uniform(&r, 800000, 2500000)) {
+            hv_chatter(t, &r, t0, hv_uniform(&r, 5000, 20000), 1);
+        }
+        break;
+    case HV_EMI:
+        for (t0 = 0; t0 < HV_TRACE_US; t0 += hv_uniform(&r, 20000, 600000)) hv_glitch(t, &r, t0);
+        break;
+    default:
+        break;
+    }
+    // Algo de interferencia de fondo en todas
+    for (int64_t u = hv_uniform(&r, 0, 3000000); u < HV_TRACE_US; u += hv_uniform(&r, 1000000, 5000000)) {
+        hv_glitch(t, &r, u);
+    }
+    hv_finish(t);
+}
+
+// Nivel del pin en t_us; *cur avanza con t_us (llamadas en orden creciente)
+static inline int hv_level(const hv_trace_t *t, int *cur, int64_t t_us)
+{
+    while (*cur < t->n && t->p[*cur].t_us * 1000 + t->p[*cur].w_ns <= t_us * 1000) (*cur)++;
+    return *cur < t->n && t->p[*cur].t_us <= t_us;
+}
+
+#endif // HOST_VIB_H
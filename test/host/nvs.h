@@ -0,0 +1,120 @@
+#ifndef HOST_NVS_H
+#define HOST_NVS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+
+/*
+ * NVS en RAM: pares (espacio, clave) → blob. Basta para config_store.h.
+ * Las pruebas pueden forzar el error de nvs_flash_init() (init_err) o
+ * que las escrituras fallen (fail_set).
+ */
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+#define HOST_NVS_ENTRIES  32
+#define HOST_NVS_HANDLES  8
+
+typedef struct {
+    char    ns[16];
+    char    key[16];
+    void   *blob;
+    size_t  len;
+} host_nvs_entry_t;
+
+typedef struct {
+    bool             inited;
+    esp_err_t        init_err;
+    bool             fail_set;
+    host_nvs_entry_t e[HOST_NVS_ENTRIES];
+    int              count;
+    struct { bool used, rw; char ns[16]; } h[HOST_NVS_HANDLES];
+    uint32_t         sets, gets;
+} host_nvs_t;
+
+static inline host_nvs_t *host_nvs(void)
+{
+    static host_nvs_t n;
+    return &n;
+}
+
+static inline esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    host_nvs_t *n = host_nvs();
+    if (!n->inited) return ESP_ERR_INVALID_STATE;
+    for (int i = 0; i < HOST_NVS_HANDLES; i++) {
+        if (n->h[i].used) continue;
+        n->h[i].used = true;
+        n->h[i].rw = mode == NVS_READWRITE;
+        snprintf(n->h[i].ns, sizeof n->h[i].ns, "%s", ns);
+        *out = i + 1;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static inline void nvs_close(nvs_handle_t h)
+{
+    if (h >= 1 && h <= HOST_NVS_HANDLES) host_nvs()->h[h - 1].used = false;
+}
+
+static inline host_nvs_entry_t *host_nvs_find(nvs_handle_t h, const char *key)
+{
+    host_nvs_t *n = host_nvs();
+    for (int i = 0; i < n->count; i++) {
+        if (strcmp(n->e[i].ns, n->h[h - 1].ns) == 0 && strcmp(n->e[i].key, key) == 0) return &n->e[i];
+    }
+    return NULL;
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    if (h < 1 || h > HOST_NVS_HANDLES || !host_nvs()->h[h - 1].used) return ESP_ERR_INVALID_ARG;
+    host_nvs()->gets++;
+    host_nvs_entry_t *e = host_nvs_find(h, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (!out) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, e->blob, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *src, size_t len)
+{
+    host_nvs_t *n = host_nvs();
+    if (h < 1 || h > HOST_NVS_HANDLES || !n->h[h - 1].used) return ESP_ERR_INVALID_ARG;
+    if (!n->h[h - 1].rw) return ESP_ERR_INVALID_STATE;
+    if (n->fail_set) return ESP_FAIL;
+    host_nvs_entry_t *e = host_nvs_find(h, key);
+    if (!e) {
+        if (n->count == HOST_NVS_ENTRIES) return ESP_ERR_NVS_NO_FREE_PAGES;
+        e = &n->e[n->count++];
+        memcpy(e->ns, n->h[h - 1].ns, sizeof e->ns);
+        snprintf(e->key, sizeof e->key, "%s", key);
+        e->blob = NULL;
+    }
+    free(e->blob);
+    e->blob = malloc(len);
+    memcpy(e->blob, src, len);
+    e->len = len;
+    n->sets++;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_OK;
+}
+
+#endif // HOST_NVS_H
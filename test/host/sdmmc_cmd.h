@@ -0,0 +1,6 @@
+#ifndef HOST_SDMMC_CMD_H
+#define HOST_SDMMC_CMD_H
+
+#include "driver/sdmmc_host.h"
+
+#endif // HOST_SDMMC_CMD_H
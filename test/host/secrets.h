@@ -0,0 +1,8 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+// Números de prueba (el secrets.h de verdad no está en el repositorio)
+#define NUM1 "+34600000001"
+#define NUM2 "+34600000002"
+
+#endif // SECRETS_H
@@ -0,0 +1,703 @@
+#ifndef HOST_SIM800_H
+#define HOST_SIM800_H
+
+#include <ctype.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "host_util.h"
+#include "sms_pdu.h"
+
+/*
+ * SIM800 de mentira al otro lado del pty del UART (driver/uart.h).
+ *
+ * Contesta al subconjunto AT que usa el firmware con el formato del
+ * módem ("\r\n<respuesta>\r\n"), saca sus respuestas al ritmo de sus
+ * baudios y tarda cmd_us en procesar cada comando. Si los baudios del
+ * firmware no son los suyos no entiende nada ni se le entiende; por
+ * encima de max_baud el enlace mete errores (ruido con semilla fija).
+ *
+ * Las pruebas pueden guionizar respuestas por prefijo de comando
+ * (sim800_script), inyectar URC y mirar lo que se ha enviado por SMS:
+ * cada AT+CMGS se decodifica y queda en sent[]. Los SMS recibidos van a
+ * una memoria de SIM_STORE_MAX índices (AT+CMGL/CMGR/CMGD/CMGDA).
+ * Llamadas: entrantes con sim800_ring() (RING y +CLIP hasta ATA o ATH),
+ * salientes con el resultado de sim800_dial_outcome(), y DTMF del otro
+ * extremo con sim800_dtmf().
+ */
+
+#define SIM_LINE_MAX     640
+#define SIM_SCRIPT_MAX   16
+#define SIM_REPLY_MAX    512
+#define SIM_SENT_MAX     256
+#define SIM_STORE_MAX    250     // índices 1..SIM_STORE_MAX de la memoria "ME"
+
+typedef struct {
+    char     prefix[40];
+    char     reply[SIM_REPLY_MAX];   // líneas separadas por "\r\n\r\n"; "" = no contesta
+    uint32_t delay_ms;
+    int      times;                  // usos que quedan; -1 = siempre
+} sim_script_t;
+
+typedef struct {
+    char     to[PDU_ADDR_MAX];
+    char     text[PDU_PART_TEXT + 1];
+    uint16_t ref;
+    uint8_t  total, seq;
+    bool     ucs2;
+    int64_t  t_us;
+} sim_sent_t;
+
+// SMS guardado en la memoria del módem (lo que lista AT+CMGL)
+typedef struct {
+    bool     used;
+    bool     read;
+    char     pdu[PDU_HEX_MAX];
+} sim_stored_t;
+
+typedef enum { SIM_CALL_IDLE = 0, SIM_CALL_RINGING, SIM_CALL_DIALING, SIM_CALL_ACTIVE } sim_call_t;
+
+#define SIM_RING_MS      3000     // entre RING y RING
+#define SIM_RINGS        5        // y luego cuelga quien llama
+
+typedef struct sim800 sim800_t;
+
+struct sim800 {
+    uart_port_t     port;
+    int             fd;
+    int             wake[2];    // despierta a sim_main cuando la prueba arma un temporizador
+    pthread_t       th;
+    pthread_mutex_t m;          // estado
+    pthread_mutex_t wm;         // salida
+    // Enlace
+    uint32_t        baud;
+    uint32_t        max_baud;   // 0 = sin límite
+    double          noise;      // probabilidad de error por byte por encima de max_baud
+    unsigned        seed;
+    bool            echo;
+    // Tiempos
+    uint32_t        cmd_us;     // procesado de cada comando
+    uint32_t        cmgs_ms;    // red: del Ctrl+Z al +CMGS
+    // Entrada
+    char            line[SIM_LINE_MAX];
+    int             len;
+    bool            payload;    // tras el '>' de AT+CMGS
+    int             payload_len;
+    // Resultado diferido (AT+CMGS, ATD...)
+    int64_t         due_us;     // 0 = nada pendiente
+    char            due[SIM_REPLY_MAX];
+    bool            due_abortable;
+    sim_script_t    script[SIM_SCRIPT_MAX];
+    int             n_script;
+    // SMS enviados
+    sim_sent_t      sent[SIM_SENT_MAX];
+    int             n_sent;
+    int             mr;
+    // SMS recibidos
+    sim_stored_t   *store;      // SIM_STORE_MAX + 1, el 0 no se usa
+    int             n_stored;
+    uint32_t        cmgl, cmgr, cmgd;
+    // Llamadas
+    sim_call_t      call;
+    char            caller[PDU_ADDR_MAX];  // como sale en +CLIP (sin +34)
+    int             rings_left;
+    int64_t         ring_us;               // próximo RING, 0 = ninguno
+    char            dial_reply[SIM_REPLY_MAX];   // resultado de ATD ("" = OK con +COLP)
+    uint32_t        dial_ms;
+    uint32_t        ata, ath, atd, dtmf;
+    int64_t         t_ata_us, t_ath_us;
+    // Contadores
+    uint32_t        commands, errors, garbled;
+    char            last_cmd[64];
+    void          (*on_cmd)(sim800_t *s, const char *cmd);   // gancho de las pruebas
+};
+
+/* ───────────────────────────── salida ───────────────────────────── */
+
+static inline bool sim_link_ok(sim800_t *s) { return host_uart(s->port)->baud == s->baud; }
+
+static inline bool sim_noisy(sim800_t *s)
+{
+    return s->max_baud && s->baud > s->max_baud &&
+           rand_r(&s->seed) < s->noise * ((double)RAND_MAX + 1);
+}
+
+static inline void sim_write(sim800_t *s, const void *data, size_t len)
+{
+    uint8_t buf[SIM_REPLY_MAX + 8];
+    pthread_mutex_lock(&s->wm);
+    while (len) {
+        size_t n = len < sizeof buf ? len : sizeof buf;
+        memcpy(buf, data, n);
+        for (size_t i = 0; i < n; i++) {
+            if (!sim_link_ok(s)) buf[i] = 0xF0 | (buf[i] & 0x0F);    // a otros baudios: basura
+            else if (sim_noisy(s)) buf[i] ^= 1 << (rand_r(&s->seed) % 7);
+        }
+        host_paced_write(s->fd, buf, n, s->baud);
+        data = (const uint8_t *)data + n;
+        len -= n;
+    }
+    pthread_mutex_unlock(&s->wm);
+}
+
+// Una o varias líneas de respuesta, cada una entre "\r\n"
+static inline void sim_reply(sim800_t *s, const char *text)
+{
+    char out[SIM_REPLY_MAX + 8];
+    int n = snprintf(out, sizeof out, "\r\n%s\r\n", text);
+    sim_write(s, out, n < (int)sizeof out ? (size_t)n : sizeof out - 1);
+}
+
+__attribute__((format(printf, 2, 3)))
+static inline void sim_replyf(sim800_t *s, const char *fmt, ...)
+{
+    char text[SIM_REPLY_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof text, fmt, ap);
+    va_end(ap);
+    sim_reply(s, text);
+}
+
+// URC inyectado por la prueba
+static inline void sim800_urc(sim800_t *s, const char *text) { sim_reply(s, text); }
+
+/* ────────────────────────── guion de pruebas ────────────────────────── */
+
+/*
+ * Los comandos que empiecen por prefix contestan reply tras delay_ms, en
+ * vez de lo que haría el módem. times = -1: siempre.
+ */
+static inline void sim800_script(sim800_t *s, const char *prefix, const char *reply,
+                                 uint32_t delay_ms, int times)
+{
+    pthread_mutex_lock(&s->m);
+    if (s->n_script < SIM_SCRIPT_MAX) {
+        sim_script_t *e = &s->script[s->n_script++];
+        snprintf(e->prefix, sizeof e->prefix, "%s", prefix);
+        snprintf(e->reply, sizeof e->reply, "%s", reply);
+        e->delay_ms = delay_ms;
+        e->times = times;
+    }
+    pthread_mutex_unlock(&s->m);
+}
+
+static inline void sim800_script_clear(sim800_t *s)
+{
+    pthread_mutex_lock(&s->m);
+    s->n_script = 0;
+    pthread_mutex_unlock(&s->m);
+}
+
+static inline void sim_defer(sim800_t *s, const char *reply, uint32_t ms, bool abortable)
+{
+    snprintf(s->due, sizeof s->due, "%s", reply);
+    s->due_us = host_now_us() + (int64_t)ms * 1000;
+    if (!s->due_us) s->due_us = 1;
+    s->due_abortable = abortable;
+}
+
+/* ─────────────────────────── SMS en PDU ─────────────────────────── */
+
+/*
+ * SMS-SUBMIT (lo que manda el firmware) a SMS-DELIVER (lo que recibe)
+ * con oa como remitente; oa = NULL deja el destinatario del SUBMIT. Así
+ * el simulador se apoya en pdu_decode_deliver() para leer lo enviado y
+ * en pdu_msg_part() para fabricar lo recibido. Devuelve false si la PDU
+ * no es un SUBMIT.
+ */
+static inline bool sim_submit_to_deliver(const char *submit_hex, const char *oa,
+                                         char *out, size_t outlen)
+{
+    uint8_t b[200], d[200];
+    int len = pdu_unhex(submit_hex, b, sizeof b);
+    if (len < 2) return false;
+    int p = 1 + b[0];
+    if (p + 3 > len) return false;
+    uint8_t fo = b[p++];
+    if ((fo & 0x03) != 0x01) return false;
+    p++;                                         // MR
+    int da = p, da_len = 2 + (b[p] + 1) / 2;
+    p += da_len;
+    if (p + 3 > len) return false;
+    uint8_t pid = b[p++], dcs = b[p++];
+    if ((fo & 0x18) == 0x10) p++;                // VP relativo
+    else if (fo & 0x08) p += 7;                  // VP absoluto/mejorado
+
+    int n = 0;
+    d[n++] = 0x00;                               // SCA: el de la SIM
+    d[n++] = 0x04 | (fo & 0x40);                 // SMS-DELIVER, sin más mensajes, UDHI
+    if (oa) n += pdu_put_addr(d + n, oa);
+    else {
+        memcpy(d + n, b + da, da_len);
+        n += da_len;
+    }
+    d[n++] = pid;
+    d[n++] = dcs;
+    static const uint8_t scts[7] = { 0x42, 0x50, 0x10, 0x01, 0x00, 0x00, 0x40 };  // 24/05/01 10:00:00 +1
+    memcpy(d + n, scts, sizeof scts);
+    n += sizeof scts;
+    if (p > len) return false;
+    memcpy(d + n, b + p, len - p);               // UDL + UD
+    n += len - p;
+    if (outlen < (size_t)(2 * n + 1)) return false;
+    for (int i = 0; i < n; i++) {
+        out[2 * i]     = PDU_HEX[d[i] >> 4];
+        out[2 * i + 1] = PDU_HEX[d[i] & 0x0F];
+    }
+    out[2 * n] = '\0';
+    return true;
+}
+
+/*
+ * PDU de SMS-DELIVER (parte i de text, de from) como la daría el módem;
+ * devuelve el número de partes o -1. Con ref se marca la concatenación.
+ */
+static inline int sim_deliver_pdu(const char *from, const char *text, uint8_t ref, int i,
+                                  char *out, size_t outlen)
+{
+    static pdu_msg_t pm;
+    static char submit[PDU_HEX_MAX];
+    int parts = pdu_msg_prepare(&pm, text, ref);
+    if (i >= parts || pdu_msg_part(&pm, "+34000000000", i, submit, sizeof submit) < 0) return -1;
+    return sim_submit_to_deliver(submit, from, out, outlen) ? parts : -1;
+}
+
+// Octetos del TPDU (sin SCA): el <len> de +CMT, +CMGR y +CMGL
+static inline int sim_tpdu_len(const char *hex)
+{
+    int sca = pdu_hex_nibble(hex[0]) << 4 | pdu_hex_nibble(hex[1]);
+    return (int)strlen(hex) / 2 - 1 - sca;
+}
+
+static inline void sim_cmgs_done(sim800_t *s)
+{
+    s->line[s->len] = '\0';
+    s->payload = false;
+    char deliver[PDU_HEX_MAX + 32];
+    static pdu_deliver_t d;
+    bool ok = sim_submit_to_deliver(s->line, NULL, deliver, sizeof deliver) &&
+              pdu_decode_deliver(deliver, &d) && sim_tpdu_len(s->line) == s->payload_len;
+    if (!ok) {
+        s->errors++;
+        sim_defer(s, "+CMS ERROR: 304", s->cmgs_ms, false);
+        return;
+    }
+    if (s->n_sent < SIM_SENT_MAX) {
+        sim_sent_t *e = &s->sent[s->n_sent++];
+        snprintf(e->to, sizeof e->to, "%s", d.from);
+        snprintf(e->text, sizeof e->text, "%s", d.text);
+        e->ref = d.ref;
+        e->total = d.total;
+        e->seq = d.seq;
+        e->ucs2 = d.ucs2;
+        e->t_us = host_now_us();
+    }
+    char r[32];
+    snprintf(r, sizeof r, "+CMGS: %d\r\n\r\nOK", s->mr++ & 0xFF);
+    sim_defer(s, r, s->cmgs_ms, false);
+}
+
+/* ──────────────────────── memoria de SMS ──────────────────────── */
+
+/*
+ * Guarda un SMS-DELIVER en el primer índice libre, sin avisar; devuelve
+ * el índice o -1 si la memoria está llena. sim800_receive_sms() además
+ * saca el +CMTI, como con AT+CNMI=2,1.
+ */
+static inline int sim800_store_sms(sim800_t *s, const char *pdu)
+{
+    int idx = -1;
+    pthread_mutex_lock(&s->m);
+    for (int i = 1; i <= SIM_STORE_MAX; i++) {
+        if (s->store[i].used) continue;
+        s->store[i].used = true;
+        s->store[i].read = false;
+        snprintf(s->store[i].pdu, sizeof s->store[i].pdu, "%s", pdu);
+        s->n_stored++;
+        idx = i;
+        break;
+    }
+    pthread_mutex_unlock(&s->m);
+    return idx;
+}
+
+static inline int sim800_receive_sms(sim800_t *s, const char *pdu)
+{
+    int idx = sim800_store_sms(s, pdu);
+    if (idx > 0) sim_replyf(s, "+CMTI: \"ME\",%d", idx);
+    return idx;
+}
+
+static inline void sim_delete(sim800_t *s, int idx)
+{
+    if (idx < 1 || idx > SIM_STORE_MAX || !s->store[idx].used) return;
+    s->store[idx].used = false;
+    s->n_stored--;
+}
+
+// AT+CMGL=<stat>: 0 no leídos, 1 leídos, 4 todos; los listados quedan leídos
+static inline void sim_cmgl(sim800_t *s, int stat)
+{
+    char head[48];
+    s->cmgl++;
+    for (int i = 1; i <= SIM_STORE_MAX; i++) {
+        sim_stored_t *e = &s->store[i];
+        if (!e->used || (stat == 0 && e->read) || (stat == 1 && !e->read)) continue;
+        int n = snprintf(head, sizeof head, "\r\n+CMGL: %d,%d,,%d\r\n", i, e->read ? 1 : 0,
+                         sim_tpdu_len(e->pdu));
+        sim_write(s, head, n);
+        sim_write(s, e->pdu, strlen(e->pdu));
+        e->read = true;
+    }
+    sim_write(s, "\r\n\r\nOK\r\n", 10);
+}
+
+// AT+CMGR=<idx>: un índice vacío contesta solo OK, como el SIM800
+static inline void sim_cmgr(sim800_t *s, int idx)
+{
+    s->cmgr++;
+    if (idx < 1 || idx > SIM_STORE_MAX) {
+        sim_reply(s, "+CMS ERROR: 321");
+        return;
+    }
+    sim_stored_t *e = &s->store[idx];
+    if (!e->used) {
+        sim_reply(s, "OK");
+        return;
+    }
+    char head[40];
+    int n = snprintf(head, sizeof head, "\r\n+CMGR: %d,,%d\r\n", e->read ? 1 : 0, sim_tpdu_len(e->pdu));
+    sim_write(s, head, n);
+    sim_write(s, e->pdu, strlen(e->pdu));
+    sim_write(s, "\r\n\r\nOK\r\n", 10);
+    e->read = true;
+}
+
+/* ──────────────────────────── llamadas ──────────────────────────── */
+
+// Con el estado tomado (s->m)
+static inline void sim_ring_locked(sim800_t *s)
+{
+    if (s->rings_left-- <= 0) {                       // quien llama se cansa
+        s->call = SIM_CALL_IDLE;
+        s->ring_us = 0;
+        sim_reply(s, "NO CARRIER");
+        return;
+    }
+    sim_replyf(s, "RING\r\n\r\n+CLIP: \"%s\",129,\"\",0,\"\",0", s->caller);
+    s->ring_us = host_now_us() + SIM_RING_MS * 1000;
+}
+
+/*
+ * Llamada entrante de number ("600111222", como lo da la red con tipo
+ * 129): RING y +CLIP ya y cada SIM_RING_MS hasta que se conteste o cuelgue.
+ */
+static inline void sim800_ring(sim800_t *s, const char *number)
+{
+    pthread_mutex_lock(&s->m);
+    snprintf(s->caller, sizeof s->caller, "%s", number);
+    s->call = SIM_CALL_RINGING;
+    s->rings_left = SIM_RINGS;
+    sim_ring_locked(s);
+    pthread_mutex_unlock(&s->m);
+    (void)!write(s->wake[1], "", 1);
+}
+
+// Tecla del otro extremo; false si no hay llamada en curso
+static inline bool sim800_dtmf(sim800_t *s, char key)
+{
+    pthread_mutex_lock(&s->m);
+    bool ok = s->call == SIM_CALL_ACTIVE;
+    if (ok) {
+        s->dtmf++;
+        sim_replyf(s, "+DTMF: %c", key);
+    }
+    pthread_mutex_unlock(&s->m);
+    return ok;
+}
+
+// El otro extremo cuelga
+static inline void sim800_remote_hangup(sim800_t *s)
+{
+    pthread_mutex_lock(&s->m);
+    if (s->call != SIM_CALL_IDLE) sim_reply(s, "NO CARRIER");
+    s->call = SIM_CALL_IDLE;
+    s->ring_us = 0;
+    pthread_mutex_unlock(&s->m);
+}
+
+/*
+ * Resultado de los próximos ATD: reply tras ms ("BUSY", "NO ANSWER"...;
+ * "" = descuelga: +COLP y OK). Mientras tanto cualquier carácter aborta.
+ */
+static inline void sim800_dial_outcome(sim800_t *s, const char *reply, uint32_t ms)
+{
+    pthread_mutex_lock(&s->m);
+    snprintf(s->dial_reply, sizeof s->dial_reply, "%s", reply);
+    s->dial_ms = ms;
+    pthread_mutex_unlock(&s->m);
+}
+
+static inline void sim_dial(sim800_t *s, const char *cmd)
+{
+    s->atd++;
+    if (s->call != SIM_CALL_IDLE) {
+        sim_reply(s, "BUSY");
+        return;
+    }
+    char num[PDU_ADDR_MAX] = "";
+    sscanf(cmd + 3, "%23[^;]", num);
+    char r[SIM_REPLY_MAX];
+    if (s->dial_reply[0]) snprintf(r, sizeof r, "%s", s->dial_reply);
+    else snprintf(r, sizeof r, "+COLP: \"%s\",129,\"\",0,\"\"\r\n\r\nOK", num);
+    s->call = s->dial_reply[0] ? SIM_CALL_IDLE : SIM_CALL_DIALING;
+    sim_defer(s, r, s->dial_ms, true);
+}
+
+/* ──────────────────────────── comandos ──────────────────────────── */
+
+// Configuración que el simulador acepta sin más
+static const char *const SIM_SETTINGS[] = {
+    "AT+CMGF=", "AT+CPMS=", "AT+CNMI=", "AT+CLIP=", "AT+COLP=", "AT+DDET=",
+    "AT+CSCLK=", "AT+CFGRI=", "AT+IFC=", "AT+CSQ", "AT+CREG", NULL,
+};
+
+static inline bool sim_settings(sim800_t *s, const char *cmd)
+{
+    for (const char *const *p = SIM_SETTINGS; *p; p++) {
+        if (strncmp(cmd, *p, strlen(*p)) == 0) {
+            if (strcmp(cmd, "AT+CSQ") == 0) sim_reply(s, "+CSQ: 18,0\r\n\r\nOK");
+            else if (strcmp(cmd, "AT+CREG?") == 0) sim_reply(s, "+CREG: 0,1\r\n\r\nOK");
+            else sim_reply(s, "OK");
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool sim_scripted(sim800_t *s, const char *cmd)
+{
+    for (int i = 0; i < s->n_script; i++) {
+        sim_script_t *e = &s->script[i];
+        if (e->times == 0 || strncmp(cmd, e->prefix, strlen(e->prefix)) != 0) continue;
+        if (e->times > 0) e->times--;
+        if (!e->reply[0]) return true;                 // no contesta
+        if (e->delay_ms) sim_defer(s, e->reply, e->delay_ms, false);
+        else sim_reply(s, e->reply);
+        return true;
+    }
+    return false;
+}
+
+static inline void sim_command(sim800_t *s, char *cmd)
+{
+    for (char *p = cmd; *p; p++) {                     // el SIM800 no distingue mayúsculas
+        if (*p == '"') break;
+        *p = toupper((unsigned char)*p);
+    }
+    s->commands++;
+    snprintf(s->last_cmd, sizeof s->last_cmd, "%.63s", cmd);
+    if (s->on_cmd) s->on_cmd(s, cmd);
+    if (s->cmd_us) host_sleep_us(s->cmd_us);
+
+    if (sim_scripted(s, cmd)) return;
+    if (strcmp(cmd, "AT") == 0) { sim_reply(s, "OK"); return; }
+    if (strcmp(cmd, "ATE0") == 0 || strcmp(cmd, "ATE1") == 0) {
+        s->echo = cmd[3] == '1';
+        sim_reply(s, "OK");
+        return;
+    }
+    if (strncmp(cmd, "AT+CMGS=", 8) == 0) {
+        s->payload_len = atoi(cmd + 8);
+        if (s->payload_len <= 0 || s->payload_len > 176) {
+            sim_reply(s, "+CMS ERROR: 304");
+            return;
+        }
+        s->payload = true;
+        s->len = 0;
+        sim_write(s, "\r\n> ", 4);
+        return;
+    }
+    if (strcmp(cmd, "ATA") == 0) {
+        s->ata++;
+        s->t_ata_us = host_now_us();
+        if (s->call != SIM_CALL_RINGING) {
+            sim_reply(s, "NO CARRIER");
+            return;
+        }
+        s->call = SIM_CALL_ACTIVE;
+        s->ring_us = 0;
+        sim_reply(s, "OK");
+        return;
+    }
+    if (strcmp(cmd, "ATH") == 0 || strcmp(cmd, "ATH0") == 0) {
+        s->ath++;
+        s->t_ath_us = host_now_us();
+        s->call = SIM_CALL_IDLE;
+        s->ring_us = 0;
+        sim_reply(s, "OK");
+        return;
+    }
+    if (strncmp(cmd, "ATD", 3) == 0) {
+        sim_dial(s, cmd);
+        return;
+    }
+    if (strncmp(cmd, "AT+CMGL=", 8) == 0) {
+        sim_cmgl(s, atoi(cmd + 8));
+        return;
+    }
+    if (strncmp(cmd, "AT+CMGR=", 8) == 0) {
+        sim_cmgr(s, atoi(cmd + 8));
+        return;
+    }
+    if (strncmp(cmd, "AT+CMGD=", 8) == 0) {
+        s->cmgd++;
+        sim_delete(s, atoi(cmd + 8));
+        sim_reply(s, "OK");
+        return;
+    }
+    if (strncmp(cmd, "AT+CMGDA=", 9) == 0) {      // 1 = leídos, 6 = todos (modo PDU)
+        int type = atoi(cmd + 9);
+        s->cmgd++;
+        for (int i = 1; i <= SIM_STORE_MAX; i++) {
+            if (s->store[i].used && (type == 6 || (type == 1 && s->store[i].read))) sim_delete(s, i);
+        }
+        sim_reply(s, "OK");
+        return;
+    }
+    if (strncmp(cmd, "AT+IPR=", 7) == 0) {
+        uint32_t b = strtoul(cmd + 7, NULL, 10);
+        if (b != 0 && b != 9600 && b != 19200 && b != 38400 && b != 57600 &&
+            b != 115200 && b != 230400 && b != 460800) {
+            sim_reply(s, "ERROR");
+            return;
+        }
+        sim_reply(s, "OK");                            // aún a la velocidad anterior
+        if (b) s->baud = b;
+        return;
+    }
+    if (sim_settings(s, cmd)) return;
+    s->errors++;
+    sim_reply(s, "ERROR");
+}
+
+static inline void sim_byte(sim800_t *s, uint8_t c)
+{
+    if (s->due_us && s->due_abortable) {             // cualquier carácter aborta (ATD)
+        sim_reply(s, "NO CARRIER");
+        s->due_us = 0;
+        s->call = SIM_CALL_IDLE;
+        return;
+    }
+    if (s->payload) {
+        if (c == 0x1A) sim_cmgs_done(s);
+        else if (c == 0x1B) { s->payload = false; s->len = 0; sim_reply(s, "OK"); }
+        else if (s->len < SIM_LINE_MAX - 1) s->line[s->len++] = c;
+        return;
+    }
+    if (s->echo) sim_write(s, &c, 1);
+    if (c == '\n') return;
+    if (c != '\r') {
+        if (s->len < SIM_LINE_MAX - 1) s->line[s->len++] = c;
+        return;
+    }
+    s->line[s->len] = '\0';
+    s->len = 0;
+    // Lo de antes de "AT" es ruido de línea (cambios de baudios, errores)
+    char *at = s->line;
+    while (*at && !((at[0] == 'A' || at[0] == 'a') && (at[1] == 'T' || at[1] == 't'))) at++;
+    if (at != s->line) s->garbled++;
+    if (!*at) return;
+    sim_command(s, at);
+}
+
+static inline void *sim_main(void *arg)
+{
+    sim800_t *s = arg;
+    uint8_t buf[256];
+    for (;;) {
+        int timeout = -1;
+        pthread_mutex_lock(&s->m);
+        if (s->due_us) {
+            int64_t left = s->due_us - host_now_us();
+            if (left <= 0) {
+                s->due_us = 0;
+                if (s->call == SIM_CALL_DIALING) s->call = SIM_CALL_ACTIVE;
+                sim_reply(s, s->due);
+                pthread_mutex_unlock(&s->m);
+                continue;
+            }
+            timeout = (int)(left / 1000) + 1;
+        }
+        if (s->ring_us) {
+            int64_t left = s->ring_us - host_now_us();
+            if (left <= 0) {
+                sim_ring_locked(s);
+                pthread_mutex_unlock(&s->m);
+                continue;
+            }
+            if (timeout < 0 || left / 1000 + 1 < timeout) timeout = (int)(left / 1000) + 1;
+        }
+        pthread_mutex_unlock(&s->m);
+
+        struct pollfd p[2] = { { .fd = s->fd, .events = POLLIN }, { .fd = s->wake[0], .events = POLLIN } };
+        int r = poll(p, 2, timeout);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 || (p[0].revents & (POLLERR | POLLNVAL))) return NULL;
+        if (p[1].revents & POLLIN) (void)!read(s->wake[0], buf, sizeof buf);
+        if (!(p[0].revents & POLLIN)) {
+            if (p[0].revents & POLLHUP) host_sleep_us(1000);   // nadie en el otro extremo todavía
+            continue;
+        }
+        ssize_t n = read(s->fd, buf, sizeof buf);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) return NULL;
+
+        pthread_mutex_lock(&s->m);
+        for (ssize_t i = 0; i < n; i++) {
+            if (!sim_link_ok(s)) {                   // a otros baudios: ruido
+                s->garbled++;
+                continue;
+            }
+            uint8_t c = buf[i];
+            if (sim_noisy(s)) c ^= 1 << (rand_r(&s->seed) % 7);
+            sim_byte(s, c);
+        }
+        pthread_mutex_unlock(&s->m);
+    }
+}
+
+/*
+ * Arranca el simulador sobre el UART port, que ya debe estar instalado
+ * (uart_driver_install). Empieza a 115200 y con eco, como de fábrica.
+ */
+static inline void sim800_start(sim800_t *s, uart_port_t port)
+{
+    sim_stored_t *store = s->store;
+    memset(s, 0, sizeof *s);
+    s->store = store ? store : malloc((SIM_STORE_MAX + 1) * sizeof *s->store);
+    memset(s->store, 0, (SIM_STORE_MAX + 1) * sizeof *s->store);
+    s->port = port;
+    s->fd = host_uart_peer(port);
+    s->baud = 115200;
+    s->echo = true;
+    s->cmd_us = 2000;
+    s->cmgs_ms = 20;
+    s->dial_ms = 2000;
+    s->noise = 0.1;
+    s->seed = 1;
+    pthread_mutex_init(&s->m, NULL);
+    pthread_mutex_init(&s->wm, NULL);
+    if (pipe(s->wake) != 0) abort();
+    pthread_create(&s->th, NULL, sim_main, s);
+    pthread_detach(s->th);
+}
+
+#endif // HOST_SIM800_H
@@ -0,0 +1,371 @@
+/*
+ * Decodificador IMA-ADPCM (adpcm.h) contra el codificador de
+ * tools/pack_prompts.py, portado aquí tal cual: el decodificador debe
+ * reconstruir exactamente lo que el codificador supuso, bloque a bloque,
+ * en mono y en estéreo, con el último bloque corto. Si hay python3 se
+ * comprueba además que el paquete que genera la herramienta es idéntico.
+ * Al final, el ruido (SNR) de cada locución de menus/ en ADPCM y lo que
+ * cuesta decodificarla por muestra frente a copiar el PCM sin comprimir.
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "adpcm.h"
+#include "host_util.h"
+#include "prompt_bundle.h"
+#include "wav.h"
+
+#define PACK_BLOCK   512           // --block por defecto de pack_prompts.py
+#define RATE         16000
+
+/* ───────────── el codificador de tools/pack_prompts.py ───────────── */
+
+// Devuelve los bytes escritos; rec (si no es NULL) recibe lo que reconstruye el codificador
+static uint32_t enc(const int16_t *pcm, uint32_t frames, uint32_t ch, uint32_t block, uint8_t *out, int16_t *rec)
+{
+    uint32_t spb = adpcm_block_samples(block, ch);
+    int32_t index[2] = { 0, 0 };
+    uint32_t n = 0;
+    static uint8_t nibs[2][ADPCM_MAX_SAMPLES + 8];
+    for (uint32_t start = 0; start < frames; start += spb) {
+        uint32_t cnt = frames - start < spb ? frames - start : spb, nn = 0;
+        for (uint32_t c = 0; c < ch; c++) {
+            int32_t pred = pcm[start * ch + c], idx = index[c];
+            out[n++] = (uint8_t)pred;
+            out[n++] = (uint8_t)(pred >> 8);
+            out[n++] = (uint8_t)idx;
+            out[n++] = 0;
+            if (rec) rec[start * ch + c] = (int16_t)pred;
+            nn = 0;
+            for (uint32_t i = 1; i < cnt; i++) {
+                int32_t step = ADPCM_STEP[idx], diff = pcm[(start + i) * ch + c] - pred, r = step >> 3;
+                uint8_t nib = 0;
+                if (diff < 0) { nib = 8; diff = -diff; }
+                if (diff >= step)      { nib |= 4; diff -= step;      r += step; }
+                if (diff >= step >> 1) { nib |= 2; diff -= step >> 1; r += step >> 1; }
+                if (diff >= step >> 2) { nib |= 1;                    r += step >> 2; }
+                pred += nib & 8 ? -r : r;
+                if (pred > 32767) pred = 32767;
+                else if (pred < -32768) pred = -32768;
+                idx += ADPCM_INDEX[nib];
+                if (idx < 0) idx = 0;
+                else if (idx > 88) idx = 88;
+                nibs[c][nn++] = nib;
+                if (rec) rec[(start + i) * ch + c] = (int16_t)pred;
+            }
+            uint32_t unit = ch == 2 ? 8 : 2;
+            while (nn % unit) nibs[c][nn++] = 0;
+            index[c] = idx;
+        }
+        for (uint32_t g = 0; g < nn; g += 8)
+            for (uint32_t c = 0; c < ch; c++)
+                for (uint32_t k = g; k < g + 8 && k < nn; k += 2) out[n++] = (uint8_t)(nibs[c][k] | nibs[c][k + 1] << 4);
+    }
+    return n;
+}
+
+// Todo el fichero, bloque a bloque como audio_out_adpcm(); devuelve las tramas
+static uint32_t dec(const uint8_t *in, uint32_t len, uint32_t ch, uint32_t block, int16_t *out)
+{
+    uint32_t frames = 0;
+    for (uint32_t off = 0; off < len; off += block) {
+        uint32_t n = len - off < block ? len - off : block;
+        frames += (uint32_t)adpcm_decode_block(in + off, n, ch, out + frames * ch);
+    }
+    return frames;
+}
+
+static double snr_db(const int16_t *ref, const int16_t *x, uint32_t n)
+{
+    double s = 0, e = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        double d = (double)ref[i] - x[i];
+        s += (double)ref[i] * ref[i];
+        e += d * d;
+    }
+    return e ? 10 * log10(s / e) : 99;
+}
+
+/* ───────────────────────── señales ───────────────────────── */
+
+#define SIG_MAX  (RATE * 4)
+
+static int16_t sig[SIG_MAX * 2], rec[SIG_MAX * 2 + 16], out[SIG_MAX * 2 + 16];
+static uint8_t packed[SIG_MAX + 4096];
+
+static uint32_t rnd_s = 1;
+static int32_t rnd(int32_t lo, int32_t hi)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return lo + (int32_t)(rnd_s % (uint32_t)(hi - lo + 1));
+}
+
+// Tono que sube y baja de volumen, con algo de ruido; en estéreo, otro tono a la derecha
+static void make_signal(uint32_t frames, uint32_t ch)
+{
+    for (uint32_t f = 0; f < frames; f++) {
+        double env = 0.5 + 0.5 * sin(2 * M_PI * f / (RATE / 3.0));
+        for (uint32_t c = 0; c < ch; c++) {
+            double v = env * 12000 * sin(2 * M_PI * (c ? 950 : 440) * f / RATE) + rnd(-300, 300);
+            sig[f * ch + c] = (int16_t)v;
+        }
+    }
+}
+
+void setUp(void) { rnd_s = 1; }
+void tearDown(void) {}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+// Lo que decodifica es exactamente lo que el codificador supuso
+static void check_bit_exact(uint32_t frames, uint32_t ch, uint32_t block)
+{
+    make_signal(frames, ch);
+    uint32_t len = enc(sig, frames, ch, block, packed, rec);
+    uint32_t spb = adpcm_block_samples(block, ch);
+    uint32_t blocks = (frames + spb - 1) / spb;
+    TEST_ASSERT_LESS_OR_EQUAL(blocks * block, len);
+    uint32_t got = dec(packed, len, ch, block, out);
+    // El último bloque se rellena hasta un grupo entero: unas tramas de más al final
+    TEST_ASSERT_GREATER_OR_EQUAL(frames, got);
+    TEST_ASSERT_LESS_THAN(frames + (ch == 2 ? 8 : 2), got);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(rec, out, frames * ch);
+}
+
+static void test_mono_bit_exact(void)
+{
+    check_bit_exact(RATE, 1, 256);
+    check_bit_exact(RATE + 1, 1, PACK_BLOCK);              // último bloque con una sola muestra
+    check_bit_exact(adpcm_block_samples(PACK_BLOCK, 1) * 3, 1, PACK_BLOCK);
+    check_bit_exact(RATE, 1, ADPCM_MAX_BLOCK);
+}
+
+static void test_stereo_bit_exact(void)
+{
+    check_bit_exact(RATE, 2, 2 * 256);
+    check_bit_exact(RATE + 3, 2, 2 * PACK_BLOCK);
+    // Los canales no se mezclan: cada uno conserva su tono
+    make_signal(RATE, 2);
+    uint32_t len = enc(sig, RATE, 2, 2 * PACK_BLOCK, packed, NULL);
+    dec(packed, len, 2, 2 * PACK_BLOCK, out);
+    static int16_t l[RATE], r[RATE], dl[RATE], dr[RATE];
+    for (int i = 0; i < RATE; i++) { l[i] = sig[2 * i]; r[i] = sig[2 * i + 1]; dl[i] = out[2 * i]; dr[i] = out[2 * i + 1]; }
+    TEST_ASSERT_GREATER_THAN(20, (int)snr_db(l, dl, RATE));
+    TEST_ASSERT_GREATER_THAN(20, (int)snr_db(r, dr, RATE));
+    TEST_ASSERT_LESS_THAN(0, (int)snr_db(l, dr, RATE));     // cruzados no se parecen
+}
+
+// Bloques rotos o cortos no se salen del búfer
+static void test_short_and_bad_blocks(void)
+{
+    uint8_t b[ADPCM_MAX_BLOCK];
+    memset(b, 0x77, sizeof b);
+    TEST_ASSERT_EQUAL_INT(0, adpcm_decode_block(b, 3, 1, out));
+    TEST_ASSERT_EQUAL_INT(0, adpcm_decode_block(b, 7, 2, out));
+    TEST_ASSERT_EQUAL_INT(0, adpcm_decode_block(b, 16, 3, out));
+    TEST_ASSERT_EQUAL_INT(1, adpcm_decode_block(b, 4, 1, out));                  // solo la cabecera
+    TEST_ASSERT_EQUAL_INT16((int16_t)0x7777, out[0]);
+    TEST_ASSERT_EQUAL_INT(1 + 2 * 6, adpcm_decode_block(b, 10, 1, out));
+    TEST_ASSERT_EQUAL_INT(1, adpcm_decode_block(b, 8 + 7, 2, out));              // menos de un grupo
+    TEST_ASSERT_EQUAL_INT(ADPCM_MAX_SAMPLES, adpcm_decode_block(b, ADPCM_MAX_BLOCK, 1, out));
+    // Índice fuera de tabla (0x77 > 88) y nibbles que empujan al límite: satura, no desborda
+    for (int i = 4; i < ADPCM_MAX_BLOCK; i++) b[i] = 0x77;
+    int n = adpcm_decode_block(b, ADPCM_MAX_BLOCK, 1, out);
+    TEST_ASSERT_EQUAL_INT16(32767, out[n - 1]);
+    for (int i = 4; i < ADPCM_MAX_BLOCK; i++) b[i] = 0xFF;
+    n = adpcm_decode_block(b, ADPCM_MAX_BLOCK, 1, out);
+    TEST_ASSERT_EQUAL_INT16(-32768, out[n - 1]);
+}
+
+// Silencio y tonos de amplitud completa
+static void test_extremes(void)
+{
+    memset(sig, 0, RATE * 2);
+    uint32_t len = enc(sig, RATE, 1, PACK_BLOCK, packed, NULL);
+    dec(packed, len, 1, PACK_BLOCK, out);
+    for (int i = 0; i < RATE; i++) TEST_ASSERT_INT_WITHIN(8, 0, out[i]);
+    for (int i = 0; i < RATE; i++) sig[i] = (i / 20) & 1 ? 32767 : -32768;   // cuadrada a 400 Hz
+    len = enc(sig, RATE, 1, PACK_BLOCK, packed, rec);
+    dec(packed, len, 1, PACK_BLOCK, out);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(rec, out, RATE);
+}
+
+/* ──────────────────────── menus/ ──────────────────────── */
+
+typedef struct {
+    char      name[NAME_MAX + 1];   // un d_name entero
+    int16_t  *pcm;
+    uint32_t  frames, ch, rate;
+} menu_pcm_t;
+
+#define MENUS_MAX  32
+static menu_pcm_t menus[MENUS_MAX];
+static int n_menus;
+
+static int file_read(void *ctx, uint32_t off, void *dst, size_t n)
+{
+    FILE *f = ctx;
+    if (fseek(f, (long)off, SEEK_SET) != 0) return -1;
+    return fread(dst, 1, n, f) == n ? 0 : -1;
+}
+
+static const char *menu_path(const char *name)
+{
+    static char path[512];
+    TEST_ASSERT_TRUE(snprintf(path, sizeof path, "%s/menus/%s", HOST_PROJECT_DIR, name) < (int)sizeof path);
+    return path;
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+    return strcmp(((const menu_pcm_t *)a)->name, ((const menu_pcm_t *)b)->name);
+}
+
+// Las copias a 16 kHz (*_fixed.wav), que son las que van al paquete
+static void load_menus(void)
+{
+    if (n_menus) return;
+    DIR *d = opendir(HOST_PROJECT_DIR "/menus");
+    TEST_ASSERT_NOT_NULL(d);
+    struct dirent *e;
+    while ((e = readdir(d)) && n_menus < MENUS_MAX) {
+        size_t l = strlen(e->d_name);
+        if (l < 10 || strcmp(e->d_name + l - 10, "_fixed.wav") != 0) continue;
+        snprintf(menus[n_menus++].name, sizeof menus[0].name, "%s", e->d_name);
+    }
+    closedir(d);
+    qsort(menus, n_menus, sizeof menus[0], cmp_name);
+    for (int k = 0; k < n_menus; k++) {
+        menu_pcm_t *m = &menus[k];
+        FILE *f = fopen(menu_path(m->name), "rb");
+        TEST_ASSERT_NOT_NULL(f);
+        wav_info_t w;
+        TEST_ASSERT_EQUAL_INT(WAV_OK, wav_parse(file_read, f, &w));
+        TEST_ASSERT_EQUAL_UINT16(WAV_FMT_PCM, w.format);
+        m->pcm = malloc(w.data_len);
+        fseek(f, (long)w.data_off, SEEK_SET);
+        TEST_ASSERT_EQUAL_UINT32(w.data_len, (uint32_t)fread(m->pcm, 1, w.data_len, f));
+        fclose(f);
+        m->ch = w.channels;
+        m->rate = w.rate;
+        m->frames = w.data_len / (2 * w.channels);
+    }
+}
+
+// El paquete de pack_prompts.py --adpcm lleva los mismos bytes que el codificador de aquí
+static void test_pack_prompts_matches(void)
+{
+    load_menus();
+    char bin[] = "/tmp/adpcm_XXXXXX";
+    int fd = mkstemp(bin);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+    char cmd[1024];
+    snprintf(cmd, sizeof cmd, "python3 %s/tools/pack_prompts.py --adpcm -o %s %s %s > /dev/null 2>&1",
+             HOST_PROJECT_DIR, bin, menu_path("error_fixed.wav"), HOST_PROJECT_DIR "/menus/test_sms_fixed.wav");
+    if (system(cmd) != 0) {
+        remove(bin);
+        TEST_IGNORE_MESSAGE("sin python3: no se compara con tools/pack_prompts.py");
+    }
+    FILE *f = fopen(bin, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    rewind(f);
+    uint8_t *blob = malloc(n);
+    TEST_ASSERT_EQUAL_INT(n, (long)fread(blob, 1, n, f));
+    fclose(f);
+    remove(bin);
+    TEST_ASSERT_EQUAL_INT(PB_OK, pb_check(blob, n));
+
+    static const char *names[] = { "error_fixed.wav", "test_sms_fixed.wav" };
+    for (int i = 0; i < 2; i++) {
+        const menu_pcm_t *m = NULL;
+        for (int k = 0; k < n_menus; k++) if (!strcmp(menus[k].name, names[i])) m = &menus[k];
+        TEST_ASSERT_NOT_NULL(m);
+        const pb_entry_t *e = pb_find(blob, names[i]);
+        TEST_ASSERT_NOT_NULL(e);
+        TEST_ASSERT_EQUAL_UINT16(WAV_FMT_IMA_ADPCM, e->format);
+        TEST_ASSERT_EQUAL_UINT16(PACK_BLOCK, e->block_align);
+        static uint8_t mine[SIG_MAX * 8];
+        uint32_t len = enc(m->pcm, m->frames, m->ch, PACK_BLOCK * m->ch, mine, NULL);
+        TEST_ASSERT_EQUAL_UINT32(len, e->len);
+        TEST_ASSERT_EQUAL_MEMORY(mine, pb_data(blob, e), len);
+    }
+    free(blob);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define BENCH_REPS  20
+#define COPY_RATIO_MAX  400     // ~35 con -O2, ~190 con -O0
+
+static void test_bench_menus(void)
+{
+    load_menus();
+    TEST_ASSERT_GREATER_THAN(0, n_menus);
+    printf("\nIMA-ADPCM de menus/*_fixed.wav (bloques de %d B, como pack_prompts.py)\n", PACK_BLOCK);
+    printf("  %-28s %8s %8s %7s %9s\n", "locución", "PCM", "ADPCM", "SNR", "ns/muestra");
+    uint64_t samples = 0, pcm_bytes = 0, adpcm_bytes = 0;
+    double snr_min = 99, ns_total = 0, memcpy_ns = 0;
+    for (int k = 0; k < n_menus; k++) {
+        const menu_pcm_t *m = &menus[k];
+        uint32_t n = m->frames * m->ch, block = PACK_BLOCK * m->ch;
+        uint8_t *a = malloc(n + 4096);
+        int16_t *pcm = malloc((n + 16) * 2);
+        uint32_t len = enc(m->pcm, m->frames, m->ch, block, a, NULL);
+        TEST_ASSERT_GREATER_OR_EQUAL(m->frames, dec(a, len, m->ch, block, pcm));
+        double snr = snr_db(m->pcm, pcm, n);
+        if (snr < snr_min) snr_min = snr;
+
+        int64_t t0 = host_cpu_us();
+        for (int r = 0; r < BENCH_REPS; r++) dec(a, len, m->ch, block, pcm);
+        double ns = (host_cpu_us() - t0) * 1000.0;
+        // Lo que cuesta el camino PCM: copiar las mismas muestras al búfer del I2S
+        t0 = host_cpu_us();
+        for (int r = 0; r < BENCH_REPS; r++) {
+            memcpy(pcm, m->pcm, n * 2);
+            __asm__ volatile("" ::: "memory");
+        }
+        memcpy_ns += (host_cpu_us() - t0) * 1000.0;
+
+        printf("  %-28s %8u %8u %5.1f dB %7.2f\n", m->name, (unsigned)n * 2, (unsigned)len, snr,
+               ns / ((double)n * BENCH_REPS));
+        samples += (uint64_t)n * BENCH_REPS;
+        ns_total += ns;
+        pcm_bytes += n * 2;
+        adpcm_bytes += len;
+        free(a);
+        free(pcm);
+    }
+    double ns = ns_total / samples, copy_ns = memcpy_ns / samples;
+    printf("Total: %llu KB de PCM en %llu KB (%.2f:1), SNR mínimo %.1f dB\n", (unsigned long long)pcm_bytes / 1024,
+           (unsigned long long)adpcm_bytes / 1024, (double)pcm_bytes / adpcm_bytes, snr_min);
+    printf("Decodificar: %.2f ns/muestra, %.0f veces copiar el PCM (%.3f ns); a %d Hz, %.4f %% de un núcleo del PC\n\n",
+           ns, ns / copy_ns, copy_ns, RATE, ns * RATE / 1e7);
+
+    TEST_ASSERT_GREATER_THAN(18, (int)snr_min);
+    TEST_ASSERT_GREATER_THAN(390, (int)(100.0 * pcm_bytes / adpcm_bytes));   // casi 4:1
+    // Relativo a la copia que hace el camino PCM, no en ciclos absolutos: vale en cualquier PC y con -O0
+    TEST_ASSERT_LESS_THAN(COPY_RATIO_MAX, (int)(ns / copy_ns));
+    TEST_ASSERT_LESS_THAN(1000, (int)ns);                         // del orden de ns en el PC
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_mono_bit_exact);
+    RUN_TEST(test_stereo_bit_exact);
+    RUN_TEST(test_short_and_bad_blocks);
+    RUN_TEST(test_extremes);
+    RUN_TEST(test_pack_prompts_matches);
+    RUN_TEST(test_bench_menus);
+    for (int k = 0; k < n_menus; k++) free(menus[k].pcm);
+    return UNITY_END();
+}
@@ -0,0 +1,288 @@
+/*
+ * Máquina de estados de la alerta (alert_core.h) sobre el reloj virtual
+ * de host_alert.h: un guion con el lector puesto con rebotes, una ráfaga
+ * del sensor, el botón a los 12 s, la espera de 30 s para atender que
+ * acaba en llamadas y los 30 s de la lámpara, con su línea de tiempo.
+ * Después, una semana de noches al azar en unos milisegundos, con las
+ * latencias de cada transición.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_alert.h"
+#include "host_util.h"
+
+#define RELAY_VIB1   (1u << 0)
+#define RELAY_VIB2   (1u << 1)
+#define RELAY_LIGHT  (1u << 2)
+#define RELAY_ALL    (RELAY_VIB1 | RELAY_VIB2 | RELAY_LIGHT)
+
+static host_alert_t sim;
+
+void setUp(void)
+{
+    ha_init(&sim, RELAY_LIGHT);
+    alert_core_add_channel(&sim.core, "cama1", RELAY_ALL);
+}
+void tearDown(void) {}
+
+// Motor del lector como lo ve alert_task: una ráfaga cada 25 ms (mudo 20 ms tras cada flanco)
+static void motor_pulse(host_alert_t *s, int ch, int64_t t0, int on_ms)
+{
+    for (int64_t t = t0; t < t0 + on_ms * 1000LL; t += 25000) {
+        ha_run_until(s, t);
+        ha_vib(s, ch);
+    }
+}
+
+static void test_scripted_night_timeline(void)
+{
+    sim.trace = true;
+    printf("\nLínea de tiempo (V = vibrador, L = lámpara)\n");
+    ha_start(&sim);
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 0));
+    TEST_ASSERT_TRUE(sim.wake_high[0]);                  // despertar al ponerlo
+
+    // Lector puesto a t = 1 s, con un rebote
+    ha_run_until(&sim, ha_ms(1000)); ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(1004)); ha_arm(&sim, 0, false);
+    ha_run_until(&sim, ha_ms(1009)); ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(1058));
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 0));
+    ha_run_until(&sim, ha_ms(1059));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    TEST_ASSERT_FALSE(sim.wake_high[0]);
+
+    // Un golpe suelto no alarma
+    ha_run_until(&sim, ha_ms(3000)); ha_vib(&sim, 0);
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+
+    // Aviso del lector a t = 5 s: alarma a la tercera ráfaga
+    motor_pulse(&sim, 0, ha_ms(5000), 200);
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_INT64(ha_ms(5050), sim.core.ch[0].alarm_us);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_ALL, sim.relays);
+    TEST_ASSERT_EQUAL_INT64(ha_ms(35050), sim.due_us[AC_T_ATTEND][0]);
+
+    // Botón a t = 12 s: atendida, vibradores fuera, lámpara 30 s
+    ha_run_until(&sim, ha_ms(12000));
+    ha_button(&sim);
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);
+    TEST_ASSERT_EQUAL_UINT32(1, sim.cancels);
+    TEST_ASSERT_EQUAL_UINT16(6, sim.last_note_arg);     // segundos desde la alarma
+    TEST_ASSERT_EQUAL_INT64(HA_OFF, sim.due_us[AC_T_ATTEND][0]);
+    ha_run_until(&sim, ha_ms(41999));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);
+    ha_run_until(&sim, ha_ms(42000));
+    TEST_ASSERT_EQUAL_UINT8(0, sim.relays);
+
+    // Aviso a t = 60 s sin nadie: a los 30 s, llamadas
+    motor_pulse(&sim, 0, ha_ms(60000), 200);
+    ha_run_until(&sim, ha_ms(90049));
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 0));
+    ha_run_until(&sim, ha_ms(90050));
+    TEST_ASSERT_EQUAL_UINT8(ST_CALLING, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, sim.escalations[0]);
+    // Terminan las llamadas sin respuesta: vibradores fuera, lámpara fija
+    ha_run_until(&sim, ha_ms(150000)); ha_called(&sim, 0);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);
+    ha_run_until(&sim, ha_ms(200000)); ha_button(&sim);
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_UINT32(2, sim.cancels);
+    ha_run_until(&sim, ha_ms(230000));
+    TEST_ASSERT_EQUAL_UINT8(0, sim.relays);
+
+    // Lector quitado a t = 300 s con un rebote: IDLE 300 ms después del último flanco
+    ha_run_until(&sim, ha_ms(300000)); ha_arm(&sim, 0, false);
+    ha_run_until(&sim, ha_ms(300002)); ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(300010)); ha_arm(&sim, 0, false);
+    ha_run_until(&sim, ha_ms(300309));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    ha_run_until(&sim, ha_ms(300310));
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 0));
+    // Sin lector no hay alarma
+    motor_pulse(&sim, 0, ha_ms(310000), 200);
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 0));
+
+    TEST_ASSERT_EQUAL_UINT32(2, sim.notes[JR_EV_ALARM]);
+    TEST_ASSERT_EQUAL_UINT32(2, sim.notes[JR_EV_ACK]);
+    printf("\n");
+}
+
+// La prueba por SMS manda sobre los relés; el botón la corta
+static void test_sms_test_overrides_and_button_cancels(void)
+{
+    ha_start(&sim);
+    ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(100));
+    alert_core_test(&sim.core, RELAY_VIB1, 5000);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_VIB1, sim.relays);
+    motor_pulse(&sim, 0, ha_ms(1000), 200);              // durante la prueba no alarma
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    ha_run_until(&sim, ha_ms(5100));
+    TEST_ASSERT_EQUAL_UINT8(0, sim.relays);
+    alert_core_test(&sim.core, RELAY_ALL, 5000);
+    ha_run_until(&sim, ha_ms(6000));
+    ha_button(&sim);
+    TEST_ASSERT_FALSE(sim.core.test_active);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);   // queda la lámpara del botón
+    TEST_ASSERT_EQUAL_INT64(HA_OFF, sim.due_us[AC_T_TEST][0]);
+}
+
+// Pulsar otra vez con la lámpara encendida la alarga 30 s desde la última pulsación
+static void test_lamp_restarts_on_each_press(void)
+{
+    ha_start(&sim);
+    ha_run_until(&sim, ha_ms(1000)); ha_button(&sim);
+    ha_run_until(&sim, ha_ms(20000)); ha_button(&sim);
+    ha_run_until(&sim, ha_ms(49999));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);
+    ha_run_until(&sim, ha_ms(50000));
+    TEST_ASSERT_EQUAL_UINT8(0, sim.relays);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.cancels);            // nada que atender
+}
+
+/* ─────────────────── una semana de noches al azar ─────────────────── */
+
+#define NIGHTS     7
+#define DAY_US     (24LL * 3600 * 1000000)
+#define LAT_MAX    256
+
+typedef struct { int64_t v[LAT_MAX]; int n; } lat_t;
+
+static void lat_add(lat_t *l, int64_t us) { if (l->n < LAT_MAX) l->v[l->n++] = us; }
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void lat_print(const char *name, lat_t *l)
+{
+    qsort(l->v, l->n, sizeof l->v[0], cmp_i64);
+    printf("  %-34s %4d   p50 %7.1f ms   máx %7.1f ms\n", name, l->n, l->v[l->n / 2] / 1e3,
+           l->v[l->n - 1] / 1e3);
+}
+
+static uint32_t rnd_s = 12345;
+static int64_t rnd(int64_t lo, int64_t hi)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return lo + (int64_t)(rnd_s % (uint32_t)(hi - lo + 1));
+}
+
+// Flancos del lector al ponerlo o quitarlo: unos rebotes y el nivel final
+static int64_t arm_with_bounce(host_alert_t *s, int64_t t, bool present)
+{
+    int bounces = (int)rnd(0, 3);
+    for (int i = 0; i < bounces; i++) {
+        ha_run_until(s, t); ha_arm(s, 0, present);
+        t += rnd(500, 4000);
+        ha_run_until(s, t); ha_arm(s, 0, !present);
+        t += rnd(500, 4000);
+    }
+    ha_run_until(s, t); ha_arm(s, 0, present);
+    return t;                                              // último flanco
+}
+
+static void test_week_of_random_nights(void)
+{
+    static lat_t l_insert, l_remove, l_alarm, l_escalate, l_lamp;
+    int alarms = 0, attended = 0, escalated = 0, knocks = 0;
+    int64_t w0 = host_cpu_us();
+    ha_start(&sim);
+
+    for (int night = 0; night < NIGHTS; night++) {
+        int64_t day = night * DAY_US;
+        // Lector puesto hacia las 22:00
+        int64_t first = day + 22 * 3600 * 1000000LL + rnd(0, 1800) * 1000000;
+        arm_with_bounce(&sim, first, true);
+        while (ha_state(&sim, 0) != ST_ARMED) ha_run_until(&sim, sim.now_us + 1000);
+        lat_add(&l_insert, sim.now_us - first);
+
+        int64_t t = first + 600 * 1000000LL;
+        int64_t end = day + DAY_US + 7 * 3600 * 1000000LL;          // 07:00 del día siguiente
+        for (;;) {
+            t += rnd(5, 90) * 60 * 1000000;                         // algo cada 5-90 min
+            if (t > end - 3600 * 1000000LL) break;
+            if (rnd(0, 2)) {                                        // golpe en la mesilla
+                ha_run_until(&sim, t); ha_vib(&sim, 0);
+                ha_run_until(&sim, t + rnd(50, 400) * 1000); ha_vib(&sim, 0);
+                knocks++;
+                TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+                continue;
+            }
+            // Aviso del lector: pulsos de 200 ms cada 500 ms hasta que alguien pulsa
+            alarms++;
+            int64_t press = t + rnd(2, 75) * 1000000;
+            uint32_t esc = sim.escalations[0];
+            bool raised = false;
+            for (int64_t p = t; p < press; p += 500000) {
+                motor_pulse(&sim, 0, p, 200);
+                if (!raised && ha_state(&sim, 0) == ST_ALARM) {
+                    raised = true;
+                    lat_add(&l_alarm, sim.core.ch[0].alarm_us - t);
+                }
+            }
+            TEST_ASSERT_TRUE(raised);
+            ha_run_until(&sim, press);
+            if (sim.escalations[0] != esc) {
+                escalated++;
+                lat_add(&l_escalate, sim.escalated_us[0] - sim.core.ch[0].alarm_us);
+                TEST_ASSERT_EQUAL_UINT8(ST_CALLING, ha_state(&sim, 0));
+            } else {
+                attended++;
+            }
+            ha_button(&sim);
+            TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+            ha_run_until(&sim, press + 40 * 1000000LL);
+            TEST_ASSERT_EQUAL_UINT8(0, sim.relays);
+            lat_add(&l_lamp, sim.relays_us - press);
+            t = press + 60 * 1000000LL;
+        }
+        // Lector quitado por la mañana
+        int64_t last = arm_with_bounce(&sim, end, false);
+        while (ha_state(&sim, 0) != ST_IDLE) ha_run_until(&sim, sim.now_us + 1000);
+        lat_add(&l_remove, sim.now_us - last);
+        ha_run_until(&sim, day + DAY_US + 12 * 3600 * 1000000LL);
+    }
+    double wall_ms = (host_cpu_us() - w0) / 1000.0;
+
+    printf("\n%d noches (%.0f h simuladas) en %.1f ms de CPU: %d avisos (%d atendidos, %d con llamadas), "
+           "%d golpes sin alarma\n", NIGHTS, sim.now_us / 3.6e9, wall_ms, alarms, attended, escalated, knocks);
+    lat_print("lector puesto → ARMED (1er flanco)", &l_insert);
+    lat_print("lector quitado → IDLE (últ. flanco)", &l_remove);
+    lat_print("1er pulso del aviso → ALARM", &l_alarm);
+    lat_print("ALARM → llamadas", &l_escalate);
+    lat_print("botón → lámpara apagada", &l_lamp);
+    printf("  alert_task despertada %u veces, %u temporizadores vencidos\n\n", (unsigned)sim.wakeups,
+           (unsigned)sim.timer_fired);
+
+    TEST_ASSERT_EQUAL_UINT32(alarms, sim.notes[JR_EV_ALARM]);
+    TEST_ASSERT_EQUAL_UINT32(alarms, sim.notes[JR_EV_ACK]);
+    TEST_ASSERT_EQUAL_UINT32(escalated, sim.escalations[0]);
+    TEST_ASSERT_GREATER_THAN(0, escalated);
+    TEST_ASSERT_GREATER_THAN(0, attended);
+    TEST_ASSERT_LESS_THAN(ARM_INSERT_MS * 1000 + 25000, l_insert.v[l_insert.n - 1]);   // 50 ms tras el último rebote
+    TEST_ASSERT_EQUAL_INT64(ARM_REMOVE_MS * 1000, l_remove.v[l_remove.n - 1]);
+    TEST_ASSERT_EQUAL_INT64(50000, l_alarm.v[l_alarm.n - 1]);                          // tercera ráfaga
+    TEST_ASSERT_EQUAL_INT64((int64_t)CFG_DEF_ATTEND_TIMEOUT_MS * 1000, l_escalate.v[0]);
+    TEST_ASSERT_EQUAL_INT64((int64_t)CFG_DEF_ATTEND_TIMEOUT_MS * 1000, l_escalate.v[l_escalate.n - 1]);
+    TEST_ASSERT_EQUAL_INT64((int64_t)CFG_DEF_LAMP_ON_MS * 1000, l_lamp.v[0]);
+    TEST_ASSERT_EQUAL_INT64((int64_t)CFG_DEF_LAMP_ON_MS * 1000, l_lamp.v[l_lamp.n - 1]);
+    TEST_ASSERT_LESS_THAN(2000, (int)wall_ms);            // una semana en menos de 2 s
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scripted_night_timeline);
+    RUN_TEST(test_sms_test_overrides_and_button_cancels);
+    RUN_TEST(test_lamp_restarts_on_each_press);
+    RUN_TEST(test_week_of_random_nights);
+    return UNITY_END();
+}
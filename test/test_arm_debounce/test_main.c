@@ -0,0 +1,260 @@
+/*
+ * Detección del lector por flanco y temporizador de histéresis
+ * (alert_core_arm_edge / ARM_INSERT_MS / ARM_REMOVE_MS) frente al sondeo
+ * de antes: arm_monitor_task leía el pin cada 100 ms y cambiaba de estado
+ * en cuanto lo veía distinto. Con el reloj virtual de host_alert.h se
+ * ponen y quitan lectores con rebotes y se mueven en la cama (contacto
+ * abierto unos ms) durante días simulados; se mide la latencia de cada
+ * transición, los cambios de estado falsos y cuántas veces por hora se
+ * despierta la CPU por el lector.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_alert.h"
+
+#define OLD_POLL_MS   100
+
+static host_alert_t sim;
+
+void setUp(void)
+{
+    ha_init(&sim, 1u << 2);
+    alert_core_add_channel(&sim.core, "cama1", 0x7);
+    ha_start(&sim);
+}
+void tearDown(void) {}
+
+/* ───────────────────────── trazas del pin ───────────────────────── */
+
+#define EDGES_MAX  8192
+
+// Flancos del lector (nivel lógico "presente" a partir de t_us)
+typedef struct { int64_t t_us; bool present; } edge_t;
+typedef struct {
+    edge_t  e[EDGES_MAX];
+    int     n;
+    // Etiquetas: cambios reales (con su primer flanco) y contactos sueltos
+    int64_t change_us[EDGES_MAX / 8];
+    bool    change_to[EDGES_MAX / 8];
+    int     changes, jostles;
+} arm_trace_t;
+
+static uint32_t rnd_s;
+static int64_t rnd(int64_t lo, int64_t hi)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return lo + (int64_t)(rnd_s % (uint32_t)(hi - lo + 1));
+}
+
+static void add_edge(arm_trace_t *tr, int64_t t, bool present)
+{
+    if (tr->n < EDGES_MAX) tr->e[tr->n++] = (edge_t){ t, present };
+}
+
+// Poner o quitar: 0-5 rebotes en los primeros ~15 ms y el nivel final
+static int64_t put_change(arm_trace_t *tr, int64_t t, bool present)
+{
+    tr->change_us[tr->changes] = t;
+    tr->change_to[tr->changes++] = present;
+    for (int b = (int)rnd(0, 5); b > 0; b--) {
+        add_edge(tr, t, present);
+        t += rnd(300, 3000);
+        add_edge(tr, t, !present);
+        t += rnd(300, 3000);
+    }
+    add_edge(tr, t, present);
+    return t;
+}
+
+// Noches de 22-23 h a 7-8 h; con el lector puesto, alguien se mueve y el contacto se abre 2-60 ms
+static void make_days(arm_trace_t *tr, int days, uint32_t seed)
+{
+    memset(tr, 0, sizeof *tr);
+    rnd_s = seed;
+    for (int d = 0; d < days; d++) {
+        int64_t day = d * 24LL * 3600 * 1000000;
+        int64_t on = day + 22 * 3600 * 1000000LL + rnd(0, 3600000000LL);
+        int64_t off = day + 31 * 3600 * 1000000LL + rnd(0, 3600000000LL);
+        int64_t t = put_change(tr, on, true);
+        for (t += rnd(60000000, 1800000000); t < off - 1000000; t += rnd(60000000, 1800000000)) {
+            int64_t open = rnd(2000, 60000);
+            add_edge(tr, t, false);
+            add_edge(tr, t + open, true);
+            tr->jostles++;
+        }
+        put_change(tr, off, false);
+    }
+}
+
+/* ───────────────────── los dos esquemas ───────────────────── */
+
+typedef struct {
+    int64_t  lat_sum_us[2], lat_max_us[2];   // [0] quitar, [1] poner
+    int      accepted[2];     // transiciones que siguen a un cambio real
+    int      spurious;        // transiciones de más (rebote o contacto suelto)
+    int      missed;          // cambios reales no vistos
+    uint64_t wakeups;
+} arm_result_t;
+
+// Cada transición del motor contra la etiqueta: la primera tras un cambio real cuenta como latencia
+static void score(arm_result_t *r, const arm_trace_t *tr, const int64_t *tt, const bool *to, int nt)
+{
+    int k = 0;
+    for (int c = 0; c < tr->changes; c++) {
+        int64_t next = c + 1 < tr->changes ? tr->change_us[c + 1] : INT64_MAX;
+        bool seen = false;
+        for (; k < nt && tt[k] < next; k++) {
+            if (tt[k] < tr->change_us[c]) { r->spurious++; continue; }
+            if (!seen && to[k] == tr->change_to[c]) {
+                seen = true;
+                int d = tr->change_to[c];
+                int64_t lat = tt[k] - tr->change_us[c];
+                r->lat_sum_us[d] += lat;
+                if (lat > r->lat_max_us[d]) r->lat_max_us[d] = lat;
+                r->accepted[d]++;
+            } else {
+                r->spurious++;
+            }
+        }
+        if (!seen) r->missed++;
+    }
+    r->spurious += nt - k;
+}
+
+static int64_t tt[EDGES_MAX];
+static bool    to[EDGES_MAX];
+
+// Antes: una tarea lee el pin cada 100 ms y cambia en cuanto lo ve distinto
+static void run_old(arm_result_t *r, const arm_trace_t *tr, int64_t end_us)
+{
+    memset(r, 0, sizeof *r);
+    bool state = false, level = false;
+    int i = 0, nt = 0;
+    for (int64_t t = OLD_POLL_MS * 1000; t < end_us; t += OLD_POLL_MS * 1000) {
+        while (i < tr->n && tr->e[i].t_us <= t) level = tr->e[i++].present;
+        r->wakeups++;
+        if (level != state) {
+            state = level;
+            if (nt < EDGES_MAX) { tt[nt] = t; to[nt++] = state; }
+        }
+    }
+    score(r, tr, tt, to, nt);
+}
+
+// Ahora: interrupción en cada flanco y temporizador de histéresis (alert_core.h)
+static void run_new(arm_result_t *r, const arm_trace_t *tr, int64_t end_us)
+{
+    memset(r, 0, sizeof *r);
+    ha_init(&sim, 1u << 2);
+    alert_core_add_channel(&sim.core, "cama1", 0x7);
+    ha_start(&sim);
+    bool state = sim.core.ch[0].arm_present;
+    int nt = 0;
+    for (int i = 0; i <= tr->n; i++) {
+        int64_t t = i < tr->n ? tr->e[i].t_us : end_us;
+        // Avanzar en pasos para ver cada transición en su instante
+        for (;;) {
+            int64_t due = sim.due_us[AC_T_ARM][0];
+            if (due == HA_OFF || due > t) break;
+            ha_run_until(&sim, due);
+            if (sim.core.ch[0].arm_present != state) {
+                state = sim.core.ch[0].arm_present;
+                if (nt < EDGES_MAX) { tt[nt] = due; to[nt++] = state; }
+            }
+        }
+        ha_run_until(&sim, t);
+        if (i < tr->n) ha_arm(&sim, 0, tr->e[i].present);
+    }
+    r->wakeups = sim.wakeups;
+    score(r, tr, tt, to, nt);
+}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+// Contacto abierto menos de ARM_REMOVE_MS: sigue ARMED; más, pasa a IDLE
+static void test_short_open_contact_is_ignored(void)
+{
+    ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(1000));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    ha_arm(&sim, 0, false);
+    ha_run_until(&sim, ha_ms(1000 + ARM_REMOVE_MS - 1));
+    ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(5000));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_INT64(HA_OFF, sim.due_us[AC_T_ARM][0]);
+    ha_arm(&sim, 0, false);
+    ha_run_until(&sim, ha_ms(5000 + ARM_REMOVE_MS));
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 0));
+}
+
+// Un contacto suelto durante la alarma no la borra
+static void test_edges_during_alarm_keep_alarm(void)
+{
+    ha_arm(&sim, 0, true);
+    ha_run_until(&sim, ha_ms(100));
+    for (int i = 0; i < 3; i++) { ha_vib(&sim, 0); ha_run_until(&sim, sim.now_us + 25000); }
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 0));
+    ha_arm(&sim, 0, false);
+    ha_run_until(&sim, sim.now_us + 20000);
+    ha_arm(&sim, 0, true);
+    ha_run_until(&sim, sim.now_us + 1000000);
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 0));
+}
+
+// Sin flancos no hay nada que despierte a la CPU por el lector
+static void test_no_edges_no_wakeups(void)
+{
+    uint32_t w = sim.wakeups;
+    ha_run_until(&sim, 3600LL * 1000000);
+    TEST_ASSERT_EQUAL_UINT32(w, sim.wakeups);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define BENCH_DAYS  30
+
+static arm_trace_t trace;
+
+static void test_bench_latency_and_wakeups(void)
+{
+    make_days(&trace, BENCH_DAYS, 2024);
+    int64_t end = BENCH_DAYS * 24LL * 3600 * 1000000 + 12LL * 3600 * 1000000;
+    arm_result_t o, n;
+    run_old(&o, &trace, end);
+    run_new(&n, &trace, end);
+    double hours = end / 3.6e9;
+
+    printf("\nLector: %d días, %d cambios reales (%d flancos con rebotes), %d contactos sueltos de 2-60 ms\n",
+           BENCH_DAYS, trace.changes, trace.n, trace.jostles);
+    printf("                         poner (media/máx)    quitar (media/máx)   falsos  perdidos  despertares/h\n");
+    const arm_result_t *rs[2] = { &o, &n };
+    for (int k = 0; k < 2; k++) {
+        const arm_result_t *r = rs[k];
+        printf("  %-20s %6.1f / %6.1f ms    %6.1f / %6.1f ms   %5d    %4d      %9.2f\n",
+               k ? "flanco + histéresis" : "sondeo cada 100 ms", r->lat_sum_us[1] / 1e3 / r->accepted[1],
+               r->lat_max_us[1] / 1e3, r->lat_sum_us[0] / 1e3 / r->accepted[0], r->lat_max_us[0] / 1e3,
+               r->spurious, r->missed, r->wakeups / hours);
+    }
+    printf("\n");
+
+    TEST_ASSERT_EQUAL_INT(0, n.spurious);
+    TEST_ASSERT_EQUAL_INT(0, n.missed);
+    TEST_ASSERT_GREATER_THAN(0, o.spurious);                       // el sondeo ve los contactos sueltos
+    TEST_ASSERT_LESS_THAN(ARM_INSERT_MS * 1000 + 20000, n.lat_max_us[1]);   // 50 ms tras el último rebote
+    TEST_ASSERT_LESS_THAN(ARM_REMOVE_MS * 1000 + 20000, n.lat_max_us[0]);
+    TEST_ASSERT_LESS_THAN(o.wakeups / 1000, n.wakeups);            // mil veces menos despertares
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_short_open_contact_is_ignored);
+    RUN_TEST(test_edges_during_alarm_keep_alarm);
+    RUN_TEST(test_no_edges_no_wakeups);
+    RUN_TEST(test_bench_latency_and_wakeups);
+    return UNITY_END();
+}
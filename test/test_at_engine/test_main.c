@@ -0,0 +1,306 @@
+/*
+ * Motor AT (at_engine.h) contra el SIM800 simulado: resultados finales,
+ * prompt de AT+CMGS, timeouts, URC que llegan con un comando en vuelo y
+ * prioridades. Al final, el arranque y la latencia por comando frente a
+ * send_at_wait() y at_send_sms() (200 ms fijos) de antes.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_modem.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+static sim800_t sim;
+
+void setUp(void) { sim800_script_clear(&sim); }
+void tearDown(void) {}
+
+/* ───────────────────── lo de antes, para comparar ───────────────────── */
+
+static int legacy_read_line(char *buf, int max, int timeout_ms)
+{
+    int len = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (((esp_timer_get_time() - t0) / 1000) < timeout_ms && len < max - 1) {
+        if (uart_read_bytes(MODEM_UART, (uint8_t *)buf + len, 1,
+                            pdMS_TO_TICKS(50)) == 1 && buf[len++] == '\n')
+            break;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static void legacy_send_at_wait(const char *cmd)
+{
+    uart_write_bytes(MODEM_UART, cmd, strlen(cmd));
+    uart_write_bytes(MODEM_UART, "\r", 1);
+    char l[96];
+    while (legacy_read_line(l, sizeof l, 1500) > 0) {
+        if (strstr(l, "OK") || strstr(l, "ERROR")) break;
+    }
+}
+
+static void legacy_at_send_sms(const char *cmd)
+{
+    uart_write_bytes(MODEM_UART, cmd, strlen(cmd));
+    uart_write_bytes(MODEM_UART, "\r", 1);
+    vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+static const char *const LEGACY_BOOT[] = {
+    "AT", "ATE0", "AT+IPR=115200", "AT+IFC=0,0", "AT+CMGF=1", "AT+CNMI=2,1,0,0,0", "AT+CLIP=1", "AT+DDET=1,0",
+};
+#define BOOT_N (int)(sizeof LEGACY_BOOT / sizeof LEGACY_BOOT[0])
+#define LATENCY_N 20
+
+static double legacy_boot_ms, legacy_cmd_ms;
+
+// Antes de arrancar el motor: el lector de antes es el único en el UART
+static void test_legacy_baseline(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < BOOT_N; i++) legacy_send_at_wait(LEGACY_BOOT[i]);
+    legacy_boot_ms = (esp_timer_get_time() - t0) / 1000.0;
+
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < LATENCY_N / 4; i++) legacy_at_send_sms("AT+CMGF=1");
+    legacy_cmd_ms = (esp_timer_get_time() - t0) / 1000.0 / (LATENCY_N / 4);
+    host_sleep_us(20000);
+    sim.echo = true;   // el motor arranca con el módem de fábrica
+}
+
+/* ────────────────────────── resultados ────────────────────────── */
+
+typedef struct {
+    char lines[8][80];
+    int  n;
+    char final[48];
+    at_result_t res;
+} capture_t;
+
+static void cap_line(const char *line, void *ctx)
+{
+    capture_t *c = ctx;
+    if (c->n < 8) snprintf(c->lines[c->n++], sizeof c->lines[0], "%s", line);
+}
+
+static void cap_done(at_result_t res, const char *final_line, void *ctx)
+{
+    capture_t *c = ctx;
+    c->res = res;
+    snprintf(c->final, sizeof c->final, "%s", final_line);
+}
+
+static at_result_t run(const char *cmd, capture_t *cap, const char *const *finals, uint32_t timeout_ms)
+{
+    memset(cap, 0, sizeof *cap);
+    at_cmd_t c = { .on_line = cap_line, .on_done = cap_done, .ctx = cap,
+                   .finals = finals, .timeout_ms = timeout_ms };
+    snprintf(c.cmd, sizeof c.cmd, "%s", cmd);
+    return at_exec(&c);
+}
+
+static void test_ok_with_echo(void)
+{
+    capture_t cap;
+    TEST_ASSERT_EQUAL(AT_RES_OK, run("AT", &cap, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(0, cap.n);          // el eco no llega como respuesta
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("ATE0", AT_TIMEOUT_MS));
+    TEST_ASSERT_FALSE(sim.echo);
+}
+
+static void test_response_lines_and_ok(void)
+{
+    capture_t cap;
+    TEST_ASSERT_EQUAL(AT_RES_OK, run("AT+CSQ", &cap, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(1, cap.n);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 18,0", cap.lines[0]);
+    TEST_ASSERT_EQUAL_STRING("OK", cap.final);
+}
+
+static void test_error_variants(void)
+{
+    capture_t cap;
+    TEST_ASSERT_EQUAL(AT_RES_ERROR, run("AT+NOEXISTE", &cap, NULL, 0));
+    sim800_script(&sim, "AT+CPIN", "+CME ERROR: 10", 0, 1);
+    TEST_ASSERT_EQUAL(AT_RES_ERROR, run("AT+CPIN?", &cap, NULL, 0));
+    TEST_ASSERT_EQUAL_STRING("+CME ERROR: 10", cap.final);
+    sim800_script(&sim, "AT+CMGR", "+CMS ERROR: 321", 0, 1);
+    TEST_ASSERT_EQUAL(AT_RES_ERROR, run("AT+CMGR=9", &cap, NULL, 0));
+}
+
+static void test_custom_finals(void)
+{
+    static const char *const finals[] = { "BUSY", "NO ANSWER", NULL };
+    capture_t cap;
+    sim800_script(&sim, "ATD", "BUSY", 80, 1);
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(AT_RES_FINAL, run("ATD600111222;", &cap, finals, 5000));
+    TEST_ASSERT_EQUAL_STRING("BUSY", cap.final);
+    TEST_ASSERT_GREATER_OR_EQUAL(80000, esp_timer_get_time() - t0);
+}
+
+static void test_timeout_without_answer(void)
+{
+    capture_t cap;
+    sim800_script(&sim, "AT+CSQ", "", 0, 1);
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(AT_RES_TIMEOUT, run("AT+CSQ", &cap, NULL, 150));
+    int64_t dt = esp_timer_get_time() - t0;
+    TEST_ASSERT_INT_WITHIN(60000, 150000, dt);
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("AT", AT_TIMEOUT_MS));   // el siguiente va bien
+}
+
+static void test_prompt_and_payload(void)
+{
+    static pdu_msg_t pm;
+    static char hex[PDU_HEX_MAX];
+    pdu_msg_prepare(&pm, "Prueba sistema OK", 1);
+    int len = pdu_msg_part(&pm, "+34600111222", 0, hex, sizeof hex);
+
+    capture_t cap;
+    memset(&cap, 0, sizeof cap);
+    at_cmd_t c = { .payload = hex, .on_line = cap_line, .on_done = cap_done, .ctx = &cap };
+    snprintf(c.cmd, sizeof c.cmd, "AT+CMGS=%d", len);
+    int sent0 = sim.n_sent;
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_exec(&c));
+    TEST_ASSERT_EQUAL_INT(1, cap.n);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(cap.lines[0], "+CMGS: ", 7));
+    TEST_ASSERT_EQUAL_INT(sent0 + 1, sim.n_sent);
+    TEST_ASSERT_EQUAL_STRING("+34600111222", sim.sent[sent0].to);
+    TEST_ASSERT_EQUAL_STRING("Prueba sistema OK", sim.sent[sent0].text);
+}
+
+// Sin '>' el motor aborta con ESC y no manda el payload
+static void test_no_prompt(void)
+{
+    sim800_script(&sim, "AT+CMGS", "", 0, 1);
+    at_cmd_t c = { .payload = "0011000B914306011122F20000A705D4F29C0E03" };
+    snprintf(c.cmd, sizeof c.cmd, "AT+CMGS=19");
+    int sent0 = sim.n_sent;
+    TEST_ASSERT_EQUAL(AT_RES_NO_PROMPT, at_exec(&c));
+    TEST_ASSERT_EQUAL_INT(sent0, sim.n_sent);
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("AT", AT_TIMEOUT_MS));
+}
+
+static int urc_cmti, urc_ring;
+static void on_cmti(const char *line, const char *body) { (void)line; (void)body; urc_cmti++; }
+static void on_ring(const char *line, const char *body) { (void)line; (void)body; urc_ring++; }
+
+// Los URC que llegan en medio de una respuesta van al despachador
+static void test_urc_during_command(void)
+{
+    urc_register(URC_CMTI, on_cmti);
+    urc_register(URC_RING, on_ring);
+    sim800_script(&sim, "AT+CPMS?", "+CPMS: \"ME\",3,50,\"ME\",3,50,\"ME\",3,50\r\n\r\nOK", 150, 1);
+
+    capture_t cap;
+    memset(&cap, 0, sizeof cap);
+    at_cmd_t c = { .on_line = cap_line, .on_done = cap_done, .ctx = &cap };
+    snprintf(c.cmd, sizeof c.cmd, "AT+CPMS?");
+    TEST_ASSERT_TRUE(at_submit(&c));
+    host_sleep_us(50000);
+    sim800_urc(&sim, "+CMTI: \"ME\",3");
+    sim800_urc(&sim, "RING");
+    host_sleep_us(250000);
+
+    TEST_ASSERT_EQUAL(AT_RES_OK, cap.res);
+    TEST_ASSERT_EQUAL_INT(1, cap.n);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(cap.lines[0], "+CPMS:", 6));
+    TEST_ASSERT_EQUAL_INT(1, urc_cmti);
+    TEST_ASSERT_EQUAL_INT(1, urc_ring);
+}
+
+static char order[8][24];
+static int n_order;
+static void record(sim800_t *s, const char *cmd)
+{
+    (void)s;
+    if (strncmp(cmd, "AT+CLIP", 7) == 0 && n_order < 8) snprintf(order[n_order++], sizeof order[0], "%s", cmd);
+}
+
+// Uno de prioridad alta adelanta a los normales ya encolados
+static void test_high_priority_jumps_queue(void)
+{
+    n_order = 0;
+    sim.on_cmd = record;
+    sim800_script(&sim, "AT+CLIP=0", "OK", 100, 1);   // el primero ocupa el motor
+    at_cmd_async("AT+CLIP=0", AT_PRIO_NORMAL);
+    host_sleep_us(20000);
+    at_cmd_async("AT+CLIP=1", AT_PRIO_NORMAL);
+    at_cmd_async("AT+CLIP=2", AT_PRIO_NORMAL);
+    at_cmd_async("AT+CLIP=9", AT_PRIO_HIGH);
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("AT", AT_TIMEOUT_MS));   // detrás de todos
+    sim.on_cmd = NULL;
+
+    TEST_ASSERT_EQUAL_INT(4, n_order);
+    TEST_ASSERT_EQUAL_STRING("AT+CLIP=0", order[0]);
+    TEST_ASSERT_EQUAL_STRING("AT+CLIP=9", order[1]);
+    TEST_ASSERT_EQUAL_STRING("AT+CLIP=1", order[2]);
+    TEST_ASSERT_EQUAL_STRING("AT+CLIP=2", order[3]);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+static SemaphoreHandle_t boot_done;
+static void on_boot_done(at_result_t res, const char *final_line, void *ctx)
+{
+    (void)res; (void)final_line; (void)ctx;
+    xSemaphoreGive(boot_done);
+}
+
+static void test_bench_boot_and_command_latency(void)
+{
+    // Los mismos comandos, encolados de una vez como modem_boot_sequence()
+    boot_done = xSemaphoreCreateBinary();
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < BOOT_N; i++) {
+        at_cmd_t c = {0};
+        snprintf(c.cmd, sizeof c.cmd, "%s", LEGACY_BOOT[i]);
+        if (i == BOOT_N - 1) c.on_done = on_boot_done;
+        TEST_ASSERT_TRUE(at_submit(&c));
+    }
+    TEST_ASSERT_TRUE(xSemaphoreTake(boot_done, pdMS_TO_TICKS(5000)));
+    double boot_ms = (esp_timer_get_time() - t0) / 1000.0;
+
+    double cmd_ms = 0, max_ms = 0;
+    for (int i = 0; i < LATENCY_N; i++) {
+        t0 = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("AT+CMGF=0", AT_TIMEOUT_MS));
+        double ms = (esp_timer_get_time() - t0) / 1000.0;
+        cmd_ms += ms / LATENCY_N;
+        if (ms > max_ms) max_ms = ms;
+    }
+
+    printf("\nSIM800 simulado: %u us por comando, %u baudios\n", (unsigned)sim.cmd_us, (unsigned)sim.baud);
+    printf("                          antes           ahora\n");
+    printf("  arranque (%d comandos)   %8.1f ms     %8.1f ms\n", BOOT_N, legacy_boot_ms, boot_ms);
+    printf("  comando (media)         %8.1f ms     %8.1f ms (máx %.1f)\n\n", legacy_cmd_ms, cmd_ms, max_ms);
+
+    // El arranque de antes ya esperaba al OK de cada comando: el motor no
+    // lo acorta contra un módem que contesta, pero tampoco lo alarga
+    TEST_ASSERT_LESS_THAN(legacy_cmd_ms / 20, cmd_ms);
+    TEST_ASSERT_LESS_THAN(legacy_boot_ms * 1.3 + 5, boot_ms);
+    TEST_ASSERT_LESS_THAN(10 * (sim.cmd_us / 1000.0 + 2), cmd_ms);   // lo que tarda el módem, no más
+}
+
+int main(void)
+{
+    host_modem_link(&sim);
+    UNITY_BEGIN();
+    RUN_TEST(test_legacy_baseline);
+    host_modem_start(&sim);
+    RUN_TEST(test_ok_with_echo);
+    RUN_TEST(test_response_lines_and_ok);
+    RUN_TEST(test_error_variants);
+    RUN_TEST(test_custom_finals);
+    RUN_TEST(test_timeout_without_answer);
+    RUN_TEST(test_prompt_and_payload);
+    RUN_TEST(test_no_prompt);
+    RUN_TEST(test_urc_during_command);
+    RUN_TEST(test_high_priority_jumps_queue);
+    RUN_TEST(test_bench_boot_and_command_latency);
+    return UNITY_END();
+}
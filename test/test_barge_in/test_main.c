@@ -0,0 +1,179 @@
+/*
+ * Corte de una locución por DTMF ("barge-in") de punta a punta: modem.h
+ * contra el SIM800 simulado, con la llamada descolgada y el menú sonando
+ * por el I2S de host/. En un instante al azar se pulsa una tecla; el
+ * "+DTMF:" cruza el UART, urc_task lo despacha, handle_dtmf_event manda
+ * la locución del dígito y audio_out calla el DMA. Se mide desde la
+ * pulsación hasta que deja de oírse el menú (host_i2s()->sound_end_us),
+ * a 16 y a 8 kHz, con el vaciado del DMA y sin él (ignore_zero: como
+ * antes, el anillo sigue sonando hasta agotarse). De paso, el tiempo
+ * desde la orden hasta la primera muestra en el DMA de las locuciones de
+ * la flash (s_audio.ttfs). El de la SD solo se mide en el equipo: aquí la
+ * tarjeta no se monta y leerla sería leer el disco del PC.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_modem.h"
+#include "host_prompts.h"
+#include "modem.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+// Lo que modem.h y sms.h esperan de main.c
+void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) { (void)vib1; (void)vib2; (void)lamp; (void)ms; }
+void set_relay_polarity(int active_high) { (void)active_high; }
+int  get_relay_polarity(void) { return 0; }
+void alert_test_start(uint32_t ms) { (void)ms; }
+
+static sim800_t sim;
+
+// El dígito 0 es silencio y largo: así se oye solo lo que queda del menú
+static const host_prompt_t PROMPTS[] = {
+    { "menu.wav", 16000, 1, 10000, 440 },
+    { "menu8.wav", 8000, 1, 10000, 440 },
+    { "0.wav", 16000, 1, 3000, 0 },
+};
+
+#define WAIT_FOR(cond, ms) ({                                               \
+        int64_t dl_ = esp_timer_get_time() + (int64_t)(ms) * 1000;          \
+        while (!(cond) && esp_timer_get_time() < dl_) vTaskDelay(pdMS_TO_TICKS(2)); \
+        (cond); })
+
+static void modem_start(void)
+{
+    host_modem_link(&sim);
+    ml_init();
+    urc_init();
+    TEST_ASSERT_EQUAL(ESP_OK, at_engine_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sms_outbox_start());
+    xTaskCreate(urc_task, "urc_task", URC_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(modem_task, "modem_task", MODEM_TASK_STACK, NULL, 7, NULL);
+}
+
+void setUp(void) { host_i2s()->ignore_zero = false; }
+void tearDown(void) { host_i2s()->ignore_zero = false; }
+
+static uint32_t rnd_s = 2025;
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return lo + rnd_s % (hi - lo + 1);
+}
+
+// Menú sonando, tecla en un instante al azar; ms desde la pulsación hasta el silencio
+static double barge_in_ms(const char *menu, uint32_t settle_ms)
+{
+    TEST_ASSERT_TRUE(audio_play(menu, NULL, NULL));
+    vTaskDelay(pdMS_TO_TICKS(rnd(300, 1500)));
+    int64_t now = esp_timer_get_time();
+    TEST_ASSERT_GREATER_THAN(now, host_i2s()->sound_end_us);        // el menú suena
+    uint32_t cuts = s_audio.cut.n;
+    int64_t t_key = esp_timer_get_time();
+    TEST_ASSERT_TRUE(sim800_dtmf(&sim, '0'));
+    TEST_ASSERT_TRUE(WAIT_FOR(s_audio.cut.n > cuts, 1000));
+    vTaskDelay(pdMS_TO_TICKS(settle_ms));                             // lo que quede en el DMA ya ha sonado
+    TEST_ASSERT_LESS_THAN(esp_timer_get_time(), host_i2s()->sound_end_us);
+    return (host_i2s()->sound_end_us - t_key) / 1000.0;
+}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+static void test_call_answered(void)
+{
+    modem_start();
+    TEST_ASSERT_TRUE_MESSAGE(WAIT_FOR(sim.cmgl == 1, 5000), "el arranque no terminó");
+    sim800_ring(&sim, NUM1 + 3);
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.call == SIM_CALL_ACTIVE, 2000));
+    TEST_ASSERT_TRUE(WAIT_FOR(audio_busy(), 3000));                  // menú tras descolgar
+}
+
+// Cortado por otra tecla, el dígito no cuelga; al acabar solo, sí
+static void test_cut_prompt_does_not_hang_up(void)
+{
+    uint32_t ath0 = sim.ath;
+    barge_in_ms("menu.wav", 100);
+    TEST_ASSERT_TRUE(audio_play("menu.wav", NULL, NULL));             // corta 0.wav
+    vTaskDelay(pdMS_TO_TICKS(200));
+    TEST_ASSERT_EQUAL_UINT32(ath0, sim.ath);
+    TEST_ASSERT_EQUAL(SIM_CALL_ACTIVE, sim.call);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define TRIALS  15
+
+typedef struct {
+    const char *menu;
+    uint32_t    rate;
+    bool        flush;
+    double      mean, max;
+    double      ttfs_mean, ttfs_max;    // orden → primera muestra en el DMA (flash)
+} barge_cfg_t;
+
+static void run_cfg(barge_cfg_t *c)
+{
+    host_i2s()->ignore_zero = !c->flush;
+    // Sin vaciar, el anillo entero (4 búferes) aún tiene que sonar
+    uint32_t settle = 4 * AUDIO_DMA_BUF_LEN * 1000 / c->rate + 150;
+    double sum = 0;
+    c->max = 0;
+    audio_lat_t *ttfs = &s_audio.ttfs[AUDIO_SRC_FLASH];
+    *ttfs = (audio_lat_t){ 0 };
+    for (int i = 0; i < TRIALS; i++) {
+        double ms = barge_in_ms(c->menu, settle);
+        sum += ms;
+        if (ms > c->max) c->max = ms;
+    }
+    c->mean = sum / TRIALS;
+    TEST_ASSERT_GREATER_OR_EQUAL(2 * TRIALS, ttfs->n);                // el menú y el dígito de cada pulsación
+    c->ttfs_mean = ttfs->sum_us / 1000.0 / ttfs->n;
+    c->ttfs_max = ttfs->max_us / 1000.0;
+    host_i2s()->ignore_zero = false;
+}
+
+static void test_bench_barge_in(void)
+{
+    barge_cfg_t cfg[] = {
+        { "menu.wav", 16000, false, 0, 0, 0, 0 }, { "menu.wav", 16000, true, 0, 0, 0, 0 },
+        { "menu8.wav", 8000, false, 0, 0, 0, 0 }, { "menu8.wav", 8000, true, 0, 0, 0, 0 },
+    };
+    for (size_t k = 0; k < 4; k++) run_cfg(&cfg[k]);
+
+    printf("\nDTMF durante el menú → silencio (%d pulsaciones al azar, enlace a %u baudios, DMA %d x %d tramas)\n",
+           TRIALS, (unsigned)modem_link_baud, 4, AUDIO_DMA_BUF_LEN);
+    printf("  %6s  %-22s %8s %8s   %-19s   un búfer\n", "Hz", "", "media", "máx", "1ª muestra (flash)");
+    for (size_t k = 0; k < 4; k++)
+        printf("  %6u  %-22s %5.1f ms %5.1f ms   %5.1f / %5.1f ms   %5.1f ms\n", (unsigned)cfg[k].rate,
+               cfg[k].flush ? "vaciando el DMA" : "sin vaciar (antes)", cfg[k].mean, cfg[k].max,
+               cfg[k].ttfs_mean, cfg[k].ttfs_max, AUDIO_DMA_BUF_LEN * 1000.0 / cfg[k].rate);
+    printf("\n");
+
+    for (size_t k = 0; k < 4; k += 2) {
+        double buf_ms = AUDIO_DMA_BUF_LEN * 1000.0 / cfg[k].rate;
+        // Como mucho un búfer más el URC y el despacho (tick de 10 ms en el C6, margen en el PC)
+        TEST_ASSERT_LESS_THAN((int)(buf_ms + 30), (int)cfg[k + 1].max);
+        TEST_ASSERT_GREATER_THAN((int)(cfg[k + 1].mean * 3), (int)cfg[k].mean);
+        // La locución nueva entra en cuanto se vacía el DMA: un búfer como mucho
+        TEST_ASSERT_LESS_THAN((int)(buf_ms + 30), (int)cfg[k + 1].ttfs_max);
+        TEST_ASSERT_GREATER_THAN((int)cfg[k + 1].ttfs_mean, (int)cfg[k].ttfs_mean);
+    }
+}
+
+int main(void)
+{
+    (void)dtmf_files;                              // como en main.c
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    config_init();
+    TEST_ASSERT_NOT_NULL(host_prompts_install(PROMPTS, sizeof PROMPTS / sizeof PROMPTS[0]));
+    audio_init();
+    TEST_ASSERT_TRUE(audio_ready);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_call_answered);
+    RUN_TEST(test_cut_prompt_does_not_hang_up);
+    RUN_TEST(test_bench_barge_in);
+    return UNITY_END();
+}
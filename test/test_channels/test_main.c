@@ -0,0 +1,195 @@
+/*
+ * Varios lectores en una placa (alert_core.h con AC_CH_MAX canales) sobre
+ * el reloj virtual de host_alert.h: cada canal con su lector, su sensor y
+ * sus relés, sin que las ráfagas de uno cuenten en la ventana de otro, y
+ * el botón atendiendo a todos. Al final, lo que cuesta cada ráfaga con 1
+ * y con 32 canales (no debe depender de cuántos hay) y una noche de
+ * residencia con 32 lectores.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_alert.h"
+#include "host_util.h"
+
+#define RELAY_VIB1   (1u << 0)
+#define RELAY_VIB2   (1u << 1)
+#define RELAY_LIGHT  (1u << 2)
+
+static host_alert_t sim;
+static char names[AC_CH_MAX][16];
+
+// n canales; los pares mueven el vibrador 1 y los impares el 2, todos la lámpara
+static void setup_channels(host_alert_t *s, int n)
+{
+    ha_init(s, RELAY_LIGHT);
+    for (int c = 0; c < n; c++) {
+        snprintf(names[c], sizeof names[c], "cama%d", c + 1);
+        TEST_ASSERT_EQUAL_INT(c, alert_core_add_channel(&s->core, names[c], (c & 1 ? RELAY_VIB2 : RELAY_VIB1) | RELAY_LIGHT));
+    }
+    ha_start(s);
+    for (int c = 0; c < n; c++) ha_arm(s, c, true);
+    ha_run_until(s, s->now_us + ARM_INSERT_MS * 1000);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void burst3(host_alert_t *s, int ch)
+{
+    for (int i = 0; i < 3; i++) {
+        ha_vib(s, ch);
+        ha_run_until(s, s->now_us + 25000);
+    }
+}
+
+static void test_table_is_bounded(void)
+{
+    ha_init(&sim, RELAY_LIGHT);
+    for (int c = 0; c < AC_CH_MAX; c++) TEST_ASSERT_EQUAL_INT(c, alert_core_add_channel(&sim.core, "x", 1));
+    TEST_ASSERT_EQUAL_INT(-1, alert_core_add_channel(&sim.core, "de más", 1));
+    TEST_ASSERT_EQUAL_UINT32(AC_CH_MAX, sim.core.n_ch);
+}
+
+// La alarma de un canal enciende sus relés y no toca a los demás
+static void test_alarm_is_per_channel(void)
+{
+    setup_channels(&sim, AC_CH_MAX);
+    for (int c = 0; c < AC_CH_MAX; c++) TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, c));
+    burst3(&sim, 5);
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 5));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_VIB2 | RELAY_LIGHT, sim.relays);
+    for (int c = 0; c < AC_CH_MAX; c++) if (c != 5) TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, c));
+    burst3(&sim, 10);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_VIB1 | RELAY_VIB2 | RELAY_LIGHT, sim.relays);   // se combinan
+    // El 5 sin atender pasa a llamadas; el 10, 75 ms después
+    ha_run_until(&sim, sim.core.ch[5].alarm_us + (int64_t)sim.cfg.attend_timeout_ms * 1000);
+    TEST_ASSERT_EQUAL_UINT8(ST_CALLING, ha_state(&sim, 5));
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 10));
+    TEST_ASSERT_EQUAL_UINT32(1, sim.escalations[5]);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.escalations[10]);
+    // Un botón atiende a los dos
+    ha_button(&sim);
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 5));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 10));
+    TEST_ASSERT_EQUAL_UINT32(2, sim.notes[JR_EV_ACK]);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_LIGHT, sim.relays);
+}
+
+// Dos ráfagas en un canal y una en otro no suman tres
+static void test_windows_do_not_mix(void)
+{
+    setup_channels(&sim, 4);
+    ha_vib(&sim, 0);
+    ha_run_until(&sim, sim.now_us + 25000);
+    ha_vib(&sim, 1);
+    ha_run_until(&sim, sim.now_us + 25000);
+    ha_vib(&sim, 0);
+    for (int c = 0; c < 4; c++) TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, c));
+    ha_run_until(&sim, sim.now_us + 25000);
+    ha_vib(&sim, 0);
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 0));
+    TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, 1));
+}
+
+// Quitar un lector solo apaga su canal
+static void test_arm_is_per_channel(void)
+{
+    setup_channels(&sim, 8);
+    ha_arm(&sim, 3, false);
+    ha_run_until(&sim, sim.now_us + ARM_REMOVE_MS * 1000);
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 3));
+    burst3(&sim, 3);
+    TEST_ASSERT_EQUAL_UINT8(ST_IDLE, ha_state(&sim, 3));
+    burst3(&sim, 4);
+    TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, 4));
+    TEST_ASSERT_TRUE(sim.wake_high[3]);
+    TEST_ASSERT_FALSE(sim.wake_high[4]);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define BENCH_EVENTS  2000000
+
+static uint32_t rnd_s = 777;
+static uint32_t rnd32(void)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return rnd_s;
+}
+
+// ns por ráfaga en alert_core_sensor, repartidas al azar entre n canales
+static double sensor_ns(int n)
+{
+    static host_alert_t s;
+    setup_channels(&s, n);
+    // Ventana corta y umbral alto: nunca alarma y cada ráfaga recorre el camino entero
+    s.cfg.vib_threshold = 8;
+    s.cfg.vib_window_ms = 100;
+    static uint8_t chs[BENCH_EVENTS];
+    for (int i = 0; i < BENCH_EVENTS; i++) chs[i] = (uint8_t)(rnd32() % (uint32_t)n);
+    int64_t t = s.now_us;
+    int64_t t0 = host_cpu_us();
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        t += 20000;                                   // una ráfaga cada 20 ms
+        alert_core_sensor(&s.core, chs[i], t);
+    }
+    double ns = (host_cpu_us() - t0) * 1000.0 / BENCH_EVENTS;
+    for (int c = 0; c < n; c++) TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&s, c));
+    return ns;
+}
+
+// Noche de residencia: 32 lectores, cada uno suena alguna vez y alguien atiende
+static void test_bench_scaling(void)
+{
+    static const int NS[] = { 1, 2, 4, 8, 16, 32 };
+    double ns[6];
+    for (int k = 0; k < 6; k++) ns[k] = sensor_ns(NS[k]);
+
+    setup_channels(&sim, AC_CH_MAX);
+    int64_t t = sim.now_us;
+    int alarms = 0, lat_max_ms = 0;
+    int64_t w0 = host_cpu_us();
+    for (int hour = 0; hour < 9; hour++) {
+        for (int c = 0; c < AC_CH_MAX; c++) {
+            if (rnd32() % 4) continue;                // ~1 de cada 4 lectores por hora
+            t += (int64_t)(rnd32() % 60) * 1000000;
+            ha_run_until(&sim, t);
+            // Golpes en otros canales mientras suena este
+            ha_vib(&sim, (c + 7) % AC_CH_MAX);
+            burst3(&sim, c);
+            TEST_ASSERT_EQUAL_UINT8(ST_ALARM, ha_state(&sim, c));
+            int lat = (int)((sim.core.ch[c].alarm_us - t) / 1000);
+            if (lat > lat_max_ms) lat_max_ms = lat;
+            alarms++;
+            t = sim.now_us + (int64_t)(rnd32() % 20 + 1) * 1000000;
+            ha_run_until(&sim, t);
+            ha_button(&sim);
+            for (int k = 0; k < AC_CH_MAX; k++) TEST_ASSERT_EQUAL_UINT8(ST_ARMED, ha_state(&sim, k));
+        }
+        t = (hour + 1) * 3600LL * 1000000;
+    }
+    double wall_ms = (host_cpu_us() - w0) / 1000.0;
+
+    printf("\nCanales: coste de una ráfaga en alert_core_sensor (repartidas al azar)\n");
+    for (int k = 0; k < 6; k++) printf("  %2d canales   %6.1f ns\n", NS[k], ns[k]);
+    printf("Noche de 9 h con %d lectores: %d avisos, todos en su canal a los %d ms, %.1f ms de CPU\n\n",
+           AC_CH_MAX, alarms, lat_max_ms, wall_ms);
+
+    TEST_ASSERT_EQUAL_UINT32(alarms, sim.notes[JR_EV_ALARM]);
+    TEST_ASSERT_EQUAL_INT(50, lat_max_ms);
+    TEST_ASSERT_LESS_THAN((int)(ns[0] * 2 + 20), (int)ns[5]);     // O(1): 32 canales no cuestan 32 veces
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table_is_bounded);
+    RUN_TEST(test_alarm_is_per_channel);
+    RUN_TEST(test_windows_do_not_mix);
+    RUN_TEST(test_arm_is_per_channel);
+    RUN_TEST(test_bench_scaling);
+    return UNITY_END();
+}
@@ -0,0 +1,285 @@
+/*
+ * Registro de configuración (config_record.h) y su carga desde NVS
+ * (config_store.h): valores de fábrica, registros de una versión
+ * anterior, CRC, tamaño y magic incorrectos, rangos de cada campo,
+ * cambios por nombre como los manda un SMS (desbordes incluidos) y la
+ * clave. Al final, lo que cuesta validar el registro y cargarlo al
+ * arrancar.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "config_store.h"
+#include "host_util.h"
+
+static app_config_t c;
+static uint8_t raw[sizeof(app_config_t)];
+
+void setUp(void) { cfg_defaults(&c); }
+void tearDown(void) {}
+
+// Registro v1: hasta la clave, sin los campos de la v2
+#define CFG_V1_SIZE  (offsetof(app_config_t, vib_mode) + sizeof(uint32_t))
+
+static size_t make_v1(const app_config_t *src, uint8_t *out)
+{
+    memcpy(out, src, CFG_V1_SIZE - sizeof(uint32_t));
+    app_config_t *h = (app_config_t *)out;
+    h->version = 1;
+    h->size = CFG_V1_SIZE;
+    uint32_t crc = cfg_crc32(out, CFG_V1_SIZE - sizeof crc);
+    memcpy(out + CFG_V1_SIZE - sizeof crc, &crc, sizeof crc);
+    return CFG_V1_SIZE;
+}
+
+static void test_defaults_are_valid_and_round_trip(void)
+{
+    app_config_t out;
+    TEST_ASSERT_NULL(cfg_check(&c));
+    TEST_ASSERT_EQUAL(CFG_OK, cfg_decode(&c, sizeof c, &out));
+    TEST_ASSERT_EQUAL_MEMORY(&c, &out, sizeof c);
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926u, cfg_crc32("123456789", 9));   // valor de control del CRC-32
+}
+
+// Una versión anterior, más corta: lo que trae se respeta, lo demás de fábrica
+static void test_older_shorter_version_is_upgraded(void)
+{
+    app_config_t old = c, out;
+    old.vib_window_ms = 1500;
+    old.lamp_on_ms = 5000;
+    strcpy(old.key, "4321");
+    old.vib_mode = 1;                            // no llega: la v1 no lo tenía
+    size_t len = make_v1(&old, raw);
+    TEST_ASSERT_EQUAL(CFG_OK, cfg_decode(raw, len, &out));
+    TEST_ASSERT_EQUAL_UINT32(1500, out.vib_window_ms);
+    TEST_ASSERT_EQUAL_UINT32(5000, out.lamp_on_ms);
+    TEST_ASSERT_EQUAL_STRING("4321", out.key);
+    TEST_ASSERT_EQUAL_UINT8(CFG_DEF_VIB_MODE, out.vib_mode);
+    TEST_ASSERT_EQUAL_UINT8(CFG_DEF_VIB_MIN_CONF, out.vib_min_conf);
+    // Queda como registro de la versión actual, listo para guardarse
+    TEST_ASSERT_EQUAL_UINT16(CFG_VERSION, out.version);
+    TEST_ASSERT_EQUAL_UINT16(sizeof out, out.size);
+    app_config_t again;
+    TEST_ASSERT_EQUAL(CFG_OK, cfg_decode(&out, sizeof out, &again));
+}
+
+static void test_bad_crc_falls_back_to_defaults(void)
+{
+    app_config_t out, def;
+    cfg_defaults(&def);
+    c.vib_threshold = 5;
+    cfg_seal(&c);
+    memcpy(raw, &c, sizeof c);
+    raw[offsetof(app_config_t, vib_threshold)] ^= 0x01;            // un bit en un campo
+    TEST_ASSERT_EQUAL(CFG_ERR_CRC, cfg_decode(raw, sizeof c, &out));
+    TEST_ASSERT_EQUAL_MEMORY(&def, &out, sizeof out);
+    memcpy(raw, &c, sizeof c);
+    raw[sizeof c - 1] ^= 0x80;                                       // en el propio CRC
+    TEST_ASSERT_EQUAL(CFG_ERR_CRC, cfg_decode(raw, sizeof c, &out));
+}
+
+static void test_wrong_size_is_rejected(void)
+{
+    app_config_t out;
+    memcpy(raw, &c, sizeof c);
+    TEST_ASSERT_EQUAL(CFG_ERR_SIZE, cfg_decode(raw, 0, &out));
+    TEST_ASSERT_EQUAL(CFG_ERR_SIZE, cfg_decode(raw, CFG_MIN_SIZE, &out));          // sin sitio para el CRC
+    TEST_ASSERT_EQUAL(CFG_ERR_SIZE, cfg_decode(raw, sizeof c - 4, &out));          // size dice otra cosa
+    uint8_t big[sizeof c + 8] = { 0 };
+    memcpy(big, &c, sizeof c);
+    TEST_ASSERT_EQUAL(CFG_ERR_SIZE, cfg_decode(big, sizeof big, &out));            // de un firmware futuro
+    // Un v1 que dice medir más de lo que se leyó
+    size_t len = make_v1(&c, raw);
+    TEST_ASSERT_EQUAL(CFG_ERR_SIZE, cfg_decode(raw, len - 4, &out));
+}
+
+static void test_bad_magic_and_future_version(void)
+{
+    app_config_t out, x = c;
+    x.magic = 0x31474643u;                      // "CFG1" al revés
+    TEST_ASSERT_EQUAL(CFG_ERR_MAGIC, cfg_decode(&x, sizeof x, &out));
+    x = c;
+    x.version = CFG_VERSION + 1;
+    x.crc = cfg_crc32(&x, offsetof(app_config_t, crc));
+    TEST_ASSERT_EQUAL(CFG_ERR_VERSION, cfg_decode(&x, sizeof x, &out));
+    x.version = 0;
+    TEST_ASSERT_EQUAL(CFG_ERR_VERSION, cfg_decode(&x, sizeof x, &out));
+}
+
+// Un registro bien sellado pero con un valor fuera de rango tampoco se carga
+static void test_sealed_out_of_range_is_rejected(void)
+{
+    app_config_t out;
+    c.vib_threshold = 9;                        // más que VIB_RING_LEN
+    cfg_seal(&c);
+    TEST_ASSERT_EQUAL(CFG_ERR_RANGE, cfg_decode(&c, sizeof c, &out));
+    cfg_defaults(&c);
+    memset(c.key, 'x', sizeof c.key);           // clave sin terminar
+    cfg_seal(&c);
+    TEST_ASSERT_EQUAL(CFG_ERR_RANGE, cfg_decode(&c, sizeof c, &out));
+}
+
+typedef struct {
+    const char *name;
+    const char *lo_ok, *hi_ok, *lo_bad, *hi_bad;
+} range_case_t;
+
+static void test_range_of_each_field(void)
+{
+    static const range_case_t R[] = {
+        { "ventana",   "100",  "10000",   "99",   "10001" },
+        { "umbral",    "1",    "8",       "0",    "9" },
+        { "atender",   "5000", "600000",  "4999", "600001" },
+        { "llamada",   "1000", "120000",  "999",  "120001" },
+        { "lampara",   "1000", "3600000", "999",  "3600001" },
+        { "polaridad", "0",    "1",       NULL,   "2" },
+        { "modo",      "0",    "1",       NULL,   "2" },
+        { "confianza", "1",    "255",     "0",    "256" },
+    };
+    TEST_ASSERT_EQUAL_INT(CFG_FIELD_COUNT, sizeof R / sizeof R[0]);   // un caso por campo
+    for (size_t i = 0; i < sizeof R / sizeof R[0]; i++) {
+        TEST_ASSERT_NULL_MESSAGE(cfg_set_field(&c, R[i].name, R[i].lo_ok), R[i].name);
+        TEST_ASSERT_NULL_MESSAGE(cfg_set_field(&c, R[i].name, R[i].hi_ok), R[i].name);
+        app_config_t before = c;
+        if (R[i].lo_bad) TEST_ASSERT_EQUAL_STRING_MESSAGE("fuera de rango", cfg_set_field(&c, R[i].name, R[i].lo_bad), R[i].name);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("fuera de rango", cfg_set_field(&c, R[i].name, R[i].hi_bad), R[i].name);
+        TEST_ASSERT_EQUAL_MEMORY(&before, &c, sizeof c);         // el fallo no toca nada
+    }
+}
+
+// Lo que cabe en un byte no se trunca: 256 no es 0, ni 2^32 + 800 es 800
+static void test_set_field_overflow(void)
+{
+    app_config_t before = c;
+    TEST_ASSERT_EQUAL_STRING("fuera de rango", cfg_set_field(&c, "polaridad", "256"));
+    TEST_ASSERT_EQUAL_STRING("fuera de rango", cfg_set_field(&c, "confianza", "257"));   // 257 & 0xFF = 1, válido
+    TEST_ASSERT_EQUAL_STRING("fuera de rango", cfg_set_field(&c, "ventana", "4294968096"));
+    TEST_ASSERT_EQUAL_STRING("fuera de rango", cfg_set_field(&c, "umbral", "99999999999999999999999"));
+    TEST_ASSERT_EQUAL_STRING("valor no numérico", cfg_set_field(&c, "umbral", "-4294967293"));   // strtoul: 3
+    TEST_ASSERT_EQUAL_MEMORY(&before, &c, sizeof c);
+    // Los bytes de al lado siguen intactos
+    TEST_ASSERT_NULL(cfg_set_field(&c, "modo", "1"));
+    TEST_ASSERT_EQUAL_UINT8(CFG_DEF_VIB_MIN_CONF, c.vib_min_conf);
+    TEST_ASSERT_EQUAL_UINT8(0, c.reserved2[0]);
+    TEST_ASSERT_EQUAL_UINT8(CFG_DEF_RELAY_ACTIVE_HIGH, c.relay_active_high);
+}
+
+static void test_set_field_rejects_bad_input(void)
+{
+    app_config_t before = c, out;
+    TEST_ASSERT_EQUAL_STRING("campo desconocido", cfg_set_field(&c, "Ventana", "800"));
+    TEST_ASSERT_EQUAL_STRING("campo desconocido", cfg_set_field(&c, "clave", "1234"));   // solo por cfg_set_key
+    TEST_ASSERT_EQUAL_STRING("valor no numérico", cfg_set_field(&c, "ventana", ""));
+    TEST_ASSERT_EQUAL_STRING("valor no numérico", cfg_set_field(&c, "ventana", "800ms"));
+    TEST_ASSERT_EQUAL_STRING("valor no numérico", cfg_set_field(&c, "ventana", "0x300"));
+    TEST_ASSERT_EQUAL_MEMORY(&before, &c, sizeof c);
+    TEST_ASSERT_NULL(cfg_set_field(&c, "ventana", "1200"));
+    TEST_ASSERT_EQUAL_UINT32(1200, c.vib_window_ms);
+    TEST_ASSERT_EQUAL(CFG_OK, cfg_decode(&c, sizeof c, &out));   // queda sellado
+}
+
+static void test_set_key(void)
+{
+    app_config_t out;
+    TEST_ASSERT_EQUAL_STRING("clave no válida", cfg_set_key(&c, ""));
+    TEST_ASSERT_EQUAL_STRING("clave no válida", cfg_set_key(&c, "12 34"));
+    TEST_ASSERT_EQUAL_STRING("clave no válida", cfg_set_key(&c, "0123456789abcdef"));   // 16: sin sitio para '\0'
+    TEST_ASSERT_EQUAL_STRING(CFG_DEF_KEY, c.key);
+    TEST_ASSERT_NULL(cfg_set_key(&c, "0123456789abcde"));
+    TEST_ASSERT_NULL(cfg_set_key(&c, "99"));
+    TEST_ASSERT_EQUAL_STRING("99", c.key);
+    for (size_t i = 2; i < sizeof c.key; i++) TEST_ASSERT_EQUAL_UINT8(0, c.key[i]);   // sin restos de la anterior
+    TEST_ASSERT_EQUAL(CFG_OK, cfg_decode(&c, sizeof c, &out));
+}
+
+// El resumen no lleva la clave y no se sale del búfer
+static void test_format(void)
+{
+    char out[256];
+    cfg_set_key(&c, "secreta");
+    int n = cfg_format(&c, out, sizeof out);
+    TEST_ASSERT_EQUAL_INT((int)strlen(out), n);
+    TEST_ASSERT_NOT_NULL(strstr(out, "ventana=800\n"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "confianza=104"));
+    TEST_ASSERT_NULL(strstr(out, "secreta"));
+
+    char small[24 + 8];
+    memset(small, '#', sizeof small);
+    cfg_format(&c, small, 24);
+    TEST_ASSERT_EQUAL_INT(23, (int)strlen(small));
+    for (size_t i = 24; i < sizeof small; i++) TEST_ASSERT_EQUAL_UINT8('#', small[i]);
+}
+
+/* ─────────────────────────── NVS ─────────────────────────── */
+
+// Guardar, arrancar y leer: lo guardado es lo que manda cfg()
+static void test_store_commit_and_boot(void)
+{
+    config_init();                                    // NVS vacía: fábrica
+    TEST_ASSERT_EQUAL_UINT32(CFG_DEF_VIB_WINDOW_MS, cfg()->vib_window_ms);
+    app_config_t x = *cfg();
+    TEST_ASSERT_NULL(cfg_set_field(&x, "umbral", "4"));
+    TEST_ASSERT_EQUAL(ESP_OK, config_commit(&x));
+    TEST_ASSERT_EQUAL_UINT32(4, cfg()->vib_threshold);
+    const app_config_t *prev = cfg();
+    config_init();                                    // "reinicio"
+    TEST_ASSERT_EQUAL_UINT32(4, cfg()->vib_threshold);
+    TEST_ASSERT_TRUE(prev != cfg());                  // se publica en el otro búfer
+
+    // Un v1 guardado por un firmware anterior también carga
+    nvs_handle_t h;
+    size_t len = make_v1(&x, raw);
+    nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &h);
+    nvs_set_blob(h, CFG_NVS_KEY, raw, len);
+    nvs_commit(h);
+    nvs_close(h);
+    config_init();
+    TEST_ASSERT_EQUAL_UINT32(4, cfg()->vib_threshold);
+    TEST_ASSERT_EQUAL_UINT16(CFG_VERSION, cfg()->version);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+static void test_bench_boot_cost(void)
+{
+    app_config_t out;
+    const int N = 200000;
+    volatile int ok = 0;
+    int64_t t0 = host_cpu_us();
+    for (int i = 0; i < N; i++) ok += cfg_decode(&c, sizeof c, &out) == CFG_OK;
+    double decode_ns = (host_cpu_us() - t0) * 1000.0 / N;
+    TEST_ASSERT_EQUAL_INT(N, ok);
+
+    const int M = 2000;
+    t0 = host_cpu_us();
+    for (int i = 0; i < M; i++) config_init();
+    double init_us = (double)(host_cpu_us() - t0) / M;
+
+    // CRC bit a bit, sin tabla: 8 vueltas por byte
+    printf("\nRegistro de %u bytes\n", (unsigned)sizeof(app_config_t));
+    printf("  cfg_decode (CRC + rangos)        %6.0f ns  (%.1f ns/byte de CRC)\n", decode_ns,
+           decode_ns / (sizeof(app_config_t) - 4));
+    printf("  config_init con la NVS del PC    %6.1f us  (un nvs_get_blob)\n\n", init_us);
+    TEST_ASSERT_LESS_THAN(20000, (int)decode_ns);        // ni 20 us en el PC: nada frente al arranque
+}
+
+int main(void)
+{
+    esp_log_level_set(CFG_TAG, ESP_LOG_ERROR);
+    UNITY_BEGIN();
+    RUN_TEST(test_defaults_are_valid_and_round_trip);
+    RUN_TEST(test_older_shorter_version_is_upgraded);
+    RUN_TEST(test_bad_crc_falls_back_to_defaults);
+    RUN_TEST(test_wrong_size_is_rejected);
+    RUN_TEST(test_bad_magic_and_future_version);
+    RUN_TEST(test_sealed_out_of_range_is_rejected);
+    RUN_TEST(test_range_of_each_field);
+    RUN_TEST(test_set_field_overflow);
+    RUN_TEST(test_set_field_rejects_bad_input);
+    RUN_TEST(test_set_key);
+    RUN_TEST(test_format);
+    RUN_TEST(test_store_commit_and_boot);
+    RUN_TEST(test_bench_boot_cost);
+    return UNITY_END();
+}
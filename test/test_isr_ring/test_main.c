@@ -0,0 +1,251 @@
+/*
+ * Anillo de eventos de las ISR (isr_ring.h): orden, anillo lleno, vuelta
+ * de los índices de 32 bits y un productor y un consumidor en hilos
+ * distintos a toda velocidad. El sensor con el anillo lleno no se queda
+ * mudo. Al final, lo que cuesta encolar (lo que
+ * dura ahora la ISR) y la latencia de evento a acción con la tarea
+ * despertada por un semáforo, como alert_task con su notificación.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unity.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "host_util.h"
+#include "isr_ring.h"
+
+static isr_ring_t ring;
+
+void setUp(void) { memset(&ring, 0, sizeof ring); }
+void tearDown(void) {}
+
+static void test_fifo_order(void)
+{
+    isr_event_t e;
+    TEST_ASSERT_FALSE(isr_ring_pop(&ring, &e));
+    for (int i = 0; i < 5; i++) TEST_ASSERT_TRUE(isr_ring_push(&ring, 1, i, i & 1));
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+        TEST_ASSERT_EQUAL_UINT8(1, e.type);
+        TEST_ASSERT_EQUAL_UINT8(i, e.ch);
+        TEST_ASSERT_EQUAL_UINT8(i & 1, e.level);
+        TEST_ASSERT_GREATER_THAN(0, e.t_us);
+    }
+    TEST_ASSERT_FALSE(isr_ring_pop(&ring, &e));
+}
+
+// Lleno: el evento nuevo se pierde y se cuenta; los que había siguen
+static void test_full_drops_newest_and_counts(void)
+{
+    isr_event_t e;
+    for (int i = 0; i < ISR_RING_LEN; i++) TEST_ASSERT_TRUE(isr_ring_push(&ring, 0, i, 0));
+    TEST_ASSERT_FALSE(isr_ring_push(&ring, 0, 99, 0));
+    TEST_ASSERT_FALSE(isr_ring_push(&ring, 0, 99, 0));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.dropped);
+    TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+    TEST_ASSERT_EQUAL_UINT8(0, e.ch);
+    TEST_ASSERT_TRUE(isr_ring_push(&ring, 0, 100, 0));      // cabe otra vez
+    for (int i = 1; i < ISR_RING_LEN; i++) {
+        TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+        TEST_ASSERT_EQUAL_UINT8(i, e.ch);
+    }
+    TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+    TEST_ASSERT_EQUAL_UINT8(100, e.ch);
+}
+
+// El sensor se calla tras su evento; si el evento se pierde, sigue activo
+#define SENSOR_PIN  GPIO_NUM_4
+
+static void test_full_ring_does_not_mute_sensor(void)
+{
+    isr_event_t e;
+    gpio_intr_enable(SENSOR_PIN);
+    // Ráfagas de otros pines (el lector rebotando) llenan el anillo
+    for (int i = 0; i < ISR_RING_LEN; i++) TEST_ASSERT_TRUE(isr_ring_push(&ring, 2, 1, i & 1));
+    TEST_ASSERT_FALSE(isr_ring_push_mute(&ring, 1, 0, SENSOR_PIN));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.dropped);
+    TEST_ASSERT_TRUE(host_gpio_intr()[SENSOR_PIN]);          // nadie lo reactivaría: no se calla
+    // La tarea vacía el anillo y el siguiente golpe del sensor sí llega
+    while (isr_ring_pop(&ring, &e)) TEST_ASSERT_EQUAL_UINT8(2, e.type);
+    gpio_set_level(SENSOR_PIN, 1);
+    TEST_ASSERT_TRUE(isr_ring_push_mute(&ring, 1, 0, SENSOR_PIN));
+    TEST_ASSERT_FALSE(host_gpio_intr()[SENSOR_PIN]);         // el resto de la ráfaga, callado
+    TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+    TEST_ASSERT_EQUAL_UINT8(1, e.type);
+    TEST_ASSERT_EQUAL_UINT8(1, e.level);
+    gpio_intr_enable(SENSOR_PIN);                             // lo que hace alert_rearm_due
+    TEST_ASSERT_TRUE(isr_ring_push_mute(&ring, 1, 0, SENSOR_PIN));
+}
+
+// Varios canales a la vez con el anillo casi lleno: los que no caben siguen activos
+#define N_SENSORS  8
+
+static void test_full_ring_per_channel(void)
+{
+    isr_event_t e;
+    gpio_num_t pin[N_SENSORS];
+    for (int c = 0; c < N_SENSORS; c++) {
+        pin[c] = (gpio_num_t)(GPIO_NUM_10 + c);
+        gpio_intr_enable(pin[c]);
+    }
+    for (int i = 0; i < ISR_RING_LEN - N_SENSORS / 2; i++) TEST_ASSERT_TRUE(isr_ring_push(&ring, 2, 0, 0));
+    for (int c = 0; c < N_SENSORS; c++) {
+        bool in = isr_ring_push_mute(&ring, 1, (uint8_t)c, pin[c]);
+        TEST_ASSERT_EQUAL(c < N_SENSORS / 2, in);
+        TEST_ASSERT_EQUAL(!in, host_gpio_intr()[pin[c]]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(N_SENSORS / 2, ring.dropped);
+    // alert_task: vacía el anillo y reactiva los canales que recibió
+    while (isr_ring_pop(&ring, &e))
+        if (e.type == 1) gpio_intr_enable(pin[e.ch]);
+    for (int c = 0; c < N_SENSORS; c++) TEST_ASSERT_TRUE(host_gpio_intr()[pin[c]]);
+    for (int c = 0; c < N_SENSORS; c++) TEST_ASSERT_TRUE(isr_ring_push_mute(&ring, 1, (uint8_t)c, pin[c]));
+    for (int c = 0; c < N_SENSORS; c++) {
+        TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+        TEST_ASSERT_EQUAL_UINT8(c, e.ch);
+    }
+}
+
+// head y tail dan la vuelta a los 2^32 eventos sin perder la cuenta
+static void test_index_wraparound(void)
+{
+    isr_event_t e;
+    ring.head = ring.tail = UINT32_MAX - 3;
+    for (int i = 0; i < ISR_RING_LEN; i++) TEST_ASSERT_TRUE(isr_ring_push(&ring, 0, i, 0));
+    TEST_ASSERT_FALSE(isr_ring_push(&ring, 0, 0, 0));
+    TEST_ASSERT_LESS_THAN(UINT32_MAX - 3, ring.head);       // ha dado la vuelta
+    for (int i = 0; i < ISR_RING_LEN; i++) {
+        TEST_ASSERT_TRUE(isr_ring_pop(&ring, &e));
+        TEST_ASSERT_EQUAL_UINT8(i, e.ch);
+    }
+    TEST_ASSERT_FALSE(isr_ring_pop(&ring, &e));
+}
+
+/* ───────────────── productor y consumidor en paralelo ───────────────── */
+
+#define STRESS_EVENTS 2000000u
+
+// El número de secuencia va en type/ch/level (24 bits)
+static void *stress_producer(void *arg)
+{
+    (void)arg;
+    *host_isr_flag() = 1;
+    for (uint32_t i = 0; i < STRESS_EVENTS; i++) {
+        while (!isr_ring_push(&ring, i & 0xFF, i >> 8 & 0xFF, i >> 16 & 0xFF)) sched_yield();
+    }
+    return NULL;
+}
+
+static uint32_t stress_full;          // veces que el productor encontró el anillo lleno
+
+static void test_spsc_threads_keep_order(void)
+{
+    pthread_t t;
+    pthread_create(&t, NULL, stress_producer, NULL);
+    uint32_t next = 0, bad = 0;
+    int64_t last_us = 0;
+    isr_event_t e;
+    while (next < STRESS_EVENTS) {
+        if (!isr_ring_pop(&ring, &e)) {
+            sched_yield();                 // con una sola CPU, que avance el productor
+            continue;
+        }
+        uint32_t seq = e.type | e.ch << 8 | (uint32_t)e.level << 16;
+        if (seq != (next & 0xFFFFFF) || e.t_us < last_us) bad++;
+        last_us = e.t_us;
+        next++;
+    }
+    pthread_join(t, NULL);
+    stress_full = ring.dropped;
+    TEST_ASSERT_EQUAL_UINT32(0, bad);
+    TEST_ASSERT_FALSE(isr_ring_pop(&ring, &e));
+    TEST_ASSERT_EQUAL_UINT32(STRESS_EVENTS, ring.head);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_EVENTS, ring.tail);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define LAT_EVENTS   2000
+#define LAT_GAP_US   250          // un flanco cada 250 us, como un sensor con ruido
+
+static SemaphoreHandle_t wake;
+static int64_t lat_us[LAT_EVENTS];
+static volatile int lat_n;
+
+// alert_task: despierta con la notificación y vacía el anillo
+static void consumer_task(void *arg)
+{
+    (void)arg;
+    isr_event_t e;
+    while (lat_n < LAT_EVENTS) {
+        xSemaphoreTake(wake, pdMS_TO_TICKS(100));
+        while (isr_ring_pop(&ring, &e)) lat_us[lat_n++] = esp_timer_get_time() - e.t_us;
+    }
+    vTaskDelete(NULL);
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_bench_isr_cost_and_latency(void)
+{
+    // Coste de encolar: lo que hace ahora la ISR además de leer el pin
+    isr_event_t e;
+    const int N = 1000000;
+    int64_t t0 = host_cpu_us();
+    for (int i = 0; i < N; i++) {
+        isr_ring_push(&ring, 0, 0, i & 1);
+        isr_ring_pop(&ring, &e);
+    }
+    double push_ns = (host_cpu_us() - t0) * 1000.0 / N;
+
+    // Evento → acción
+    wake = xSemaphoreCreateBinary();
+    lat_n = 0;
+    xTaskCreate(consumer_task, "alert_task", 4096, NULL, 6, NULL);
+    *host_isr_flag() = 1;
+    for (int i = 0; i < LAT_EVENTS; i++) {
+        BaseType_t hpw = pdFALSE;
+        isr_ring_push(&ring, 1, 0, i & 1);
+        xSemaphoreGiveFromISR(wake, &hpw);
+        host_sleep_us(LAT_GAP_US);
+    }
+    *host_isr_flag() = 0;
+    int64_t dl = esp_timer_get_time() + 2000000;
+    while (lat_n < LAT_EVENTS && esp_timer_get_time() < dl) host_sleep_us(1000);
+    TEST_ASSERT_EQUAL_INT(LAT_EVENTS, lat_n);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropped);
+    qsort(lat_us, LAT_EVENTS, sizeof lat_us[0], cmp_i64);
+
+    printf("\nAnillo ISR → tarea\n");
+    printf("  encolar + desencolar              %6.1f ns\n", push_ns);
+    printf("  %d eventos, productor y consumidor en hilos: %u veces lleno, orden intacto\n", (int)STRESS_EVENTS,
+           (unsigned)stress_full);
+    printf("  evento → acción (%d, uno cada %d us)   p50 %lld us   p99 %lld us   máx %lld us\n\n", LAT_EVENTS,
+           LAT_GAP_US, (long long)lat_us[LAT_EVENTS / 2], (long long)lat_us[LAT_EVENTS * 99 / 100],
+           (long long)lat_us[LAT_EVENTS - 1]);
+
+    TEST_ASSERT_LESS_THAN(1000, (int)push_ns);                 // sin llamadas al sistema ni bloqueos
+    TEST_ASSERT_LESS_THAN(1000, lat_us[LAT_EVENTS / 2]);      // el PC no es tiempo real: solo la mediana
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_full_drops_newest_and_counts);
+    RUN_TEST(test_index_wraparound);
+    RUN_TEST(test_full_ring_does_not_mute_sensor);
+    RUN_TEST(test_full_ring_per_channel);
+    RUN_TEST(test_spsc_threads_keep_order);
+    RUN_TEST(test_bench_isr_cost_and_latency);
+    return UNITY_END();
+}
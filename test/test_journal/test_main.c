@@ -0,0 +1,332 @@
+/*
+ * Diario de eventos (journal.h) sobre una partición en RAM con la
+ * semántica de la NOR: montaje de una partición vacía, después de dar la
+ * vuelta y con un registro a medio escribir justo al entrar en un sector
+ * nuevo; jr_tail parando en un salto de secuencia y el número de arranque
+ * recuperado tras un corte. Al final, cuántas lecturas cuesta montar y
+ * consultar frente a recorrer la partición, y cómo se reparten los
+ * borrados entre sectores.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_util.h"
+#include "journal.h"
+
+#define SECTORS     4
+#define PART_SIZE   (SECTORS * JR_SECTOR)
+#define SLOTS       (SECTORS * JR_PER_SECTOR)
+
+// Partición en RAM: escribir solo baja bits y borrar deja 0xFF
+typedef struct {
+    uint8_t  *mem;
+    uint32_t  size;
+    uint32_t  reads, writes, erases;
+    uint32_t  sector_erases[64];
+    int       tear;          // > 0: la próxima escritura se corta tras tantos bytes
+} ram_flash_t;
+
+static int ram_read(void *ctx, uint32_t off, void *dst, size_t n)
+{
+    ram_flash_t *f = ctx;
+    if (off + n > f->size) return -1;
+    f->reads++;
+    memcpy(dst, f->mem + off, n);
+    return 0;
+}
+
+static int ram_write(void *ctx, uint32_t off, const void *src, size_t n)
+{
+    ram_flash_t *f = ctx;
+    if (off + n > f->size) return -1;
+    f->writes++;
+    if (f->tear > 0 && (size_t)f->tear < n) n = (size_t)f->tear;
+    for (size_t i = 0; i < n; i++) f->mem[off + i] &= ((const uint8_t *)src)[i];
+    if (f->tear > 0) {
+        f->tear = 0;
+        return -1;                       // se fue la corriente
+    }
+    return 0;
+}
+
+static int ram_erase(void *ctx, uint32_t off, size_t n)
+{
+    ram_flash_t *f = ctx;
+    if (off % JR_SECTOR || n % JR_SECTOR || off + n > f->size) return -1;
+    f->erases++;
+    for (uint32_t s = off / JR_SECTOR; s < (off + n) / JR_SECTOR; s++) f->sector_erases[s]++;
+    memset(f->mem + off, 0xFF, n);
+    return 0;
+}
+
+static ram_flash_t rf;
+static jr_flash_t  fl;
+static journal_t   j;
+
+static void flash_new(uint32_t size)
+{
+    free(rf.mem);
+    memset(&rf, 0, sizeof rf);
+    rf.mem = malloc(size);
+    rf.size = size;
+    memset(rf.mem, 0xFF, size);
+    fl = (jr_flash_t){ .ctx = &rf, .size = size, .read = ram_read, .write = ram_write, .erase = ram_erase };
+}
+
+void setUp(void) { flash_new(PART_SIZE); }
+void tearDown(void) {}
+
+// Un reinicio: se monta otra vez sobre lo que quedó en la flash
+static void remount(void)
+{
+    TEST_ASSERT_TRUE(jr_mount(&j, &fl));
+}
+
+static void append_n(int n)
+{
+    for (int i = 0; i < n; i++) TEST_ASSERT_TRUE(jr_append(&j, JR_EV_ALARM, 0, (uint16_t)i, j.seq));
+}
+
+static void test_empty_partition_mounts_fresh(void)
+{
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(SLOTS, j.slots);
+    TEST_ASSERT_EQUAL_UINT32(0, j.head);
+    TEST_ASSERT_EQUAL_UINT32(1, j.seq);
+    TEST_ASSERT_EQUAL_UINT16(1, j.boot);
+    jr_record_t r[4];
+    TEST_ASSERT_EQUAL_INT(0, jr_tail(&j, r, 4));
+    // Basura que no es un diario (todo ceros) también se da por nueva
+    memset(rf.mem, 0, PART_SIZE);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(1, j.seq);
+    TEST_ASSERT_EQUAL_INT(0, jr_tail(&j, r, 4));
+    // Menos de dos sectores no sirve
+    flash_new(JR_SECTOR);
+    TEST_ASSERT_FALSE(jr_mount(&j, &fl));
+}
+
+static void test_append_and_remount_keeps_head(void)
+{
+    remount();
+    append_n(10);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(10, j.head);
+    TEST_ASSERT_EQUAL_UINT32(11, j.seq);
+    jr_record_t r[16];
+    TEST_ASSERT_EQUAL_INT(10, jr_tail(&j, r, 16));
+    for (int i = 0; i < 10; i++) TEST_ASSERT_EQUAL_UINT32(10 - i, r[i].seq);   // del más nuevo al más antiguo
+    TEST_ASSERT_EQUAL_UINT16(9, r[0].arg);
+}
+
+// Dos vueltas y media: la cabeza se encuentra y la cola llega hasta el sector borrado
+static void test_mount_after_wraparound(void)
+{
+    remount();
+    const int total = 2 * SLOTS + SLOTS / 2 + 7;
+    append_n(total);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(total % SLOTS, j.head);
+    TEST_ASSERT_EQUAL_UINT32(total + 1, j.seq);
+
+    static jr_record_t r[SLOTS];
+    int got = jr_tail(&j, r, SLOTS);
+    // Del sector de la cabeza quedan 7; los tres anteriores, enteros
+    TEST_ASSERT_EQUAL_INT(7 + 3 * (int)JR_PER_SECTOR, got);
+    for (int i = 0; i < got; i++) TEST_ASSERT_EQUAL_UINT32(total - i, r[i].seq);
+
+    // Justo al completar la vuelta: la cabeza vuelve al hueco 0 sin haberlo borrado
+    flash_new(PART_SIZE);
+    remount();
+    append_n(SLOTS);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(0, j.head);
+    TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, j.seq);
+    TEST_ASSERT_EQUAL_INT(SLOTS, jr_tail(&j, r, SLOTS));
+    append_n(1);                                       // ahora sí se borra el sector 0
+    TEST_ASSERT_EQUAL_INT(1 + 3 * (int)JR_PER_SECTOR, jr_tail(&j, r, SLOTS));
+}
+
+// Corte al escribir el primer registro de un sector recién borrado
+static void test_torn_record_at_start_of_new_sector(void)
+{
+    remount();
+    append_n(JR_PER_SECTOR);                           // sector 0 lleno
+    rf.tear = 6;                                       // seq y parte del tiempo
+    TEST_ASSERT_FALSE(jr_append(&j, JR_EV_ALARM, 0, 0, 0));
+    jr_record_t r0;
+    memcpy(&r0, rf.mem + JR_SECTOR, sizeof r0);
+    TEST_ASSERT_FALSE(jr_is_valid(&r0));
+    TEST_ASSERT_FALSE(jr_is_erased(&r0));
+
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR, j.head);  // el sector 1 no cuenta
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR + 1, j.seq);
+    jr_record_t r[8];
+    TEST_ASSERT_EQUAL_INT(8, jr_tail(&j, r, 8));
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR, r[0].seq);
+
+    // Lo siguiente vuelve a borrar el sector y ocupa su hueco 0
+    TEST_ASSERT_TRUE(jr_append(&j, JR_EV_ACK, 0, 42, 0));
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR + 1, j.head);
+    TEST_ASSERT_EQUAL_INT(8, jr_tail(&j, r, 8));
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR + 1, r[0].seq);
+    TEST_ASSERT_EQUAL_UINT16(42, r[0].arg);
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR, r[1].seq);
+}
+
+// Un registro a medio escribir en mitad del sector se salta sin perder la cuenta
+static void test_torn_record_mid_sector_is_skipped(void)
+{
+    remount();
+    append_n(5);
+    rf.tear = 10;
+    TEST_ASSERT_FALSE(jr_append(&j, JR_EV_ALARM, 0, 0, 0));
+    append_n(2);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(8, j.head);
+    TEST_ASSERT_EQUAL_UINT32(9, j.seq);
+    jr_record_t r[16];
+    TEST_ASSERT_EQUAL_INT(7, jr_tail(&j, r, 16));
+    const uint32_t want[] = { 8, 7, 5, 4, 3, 2, 1 };
+    for (int i = 0; i < 7; i++) TEST_ASSERT_EQUAL_UINT32(want[i], r[i].seq);
+}
+
+// Escribe a mano un registro válido con la secuencia dada
+static void put_record(uint32_t slot, uint32_t seq, uint16_t boot)
+{
+    jr_record_t r = { .seq = seq, .time_s = seq, .boot = boot, .type = JR_EV_ALARM, .ch = 0 };
+    r.crc = jr_crc16(&r, offsetof(jr_record_t, crc));
+    memcpy(rf.mem + slot * sizeof r, &r, sizeof r);
+}
+
+// Delante de la vuelta actual hay registros de otra anterior: ahí se para
+static void test_tail_stops_at_sequence_gap(void)
+{
+    // Sector 0 con una vuelta vieja (100..), sector 1 con la actual (5000..)
+    for (uint32_t i = 0; i < JR_PER_SECTOR; i++) put_record(i, 100 + i, 1);
+    for (uint32_t i = 0; i < 20; i++) put_record(JR_PER_SECTOR + i, 5000 + i, 3);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(JR_PER_SECTOR + 20, j.head);
+    TEST_ASSERT_EQUAL_UINT32(5020, j.seq);
+    jr_record_t r[64];
+    TEST_ASSERT_EQUAL_INT(20, jr_tail(&j, r, 64));
+    TEST_ASSERT_EQUAL_UINT32(5000, r[19].seq);
+
+    // Un registro suelto fuera de secuencia dentro del sector también corta
+    put_record(JR_PER_SECTOR + 20, 1, 3);
+    remount();
+    TEST_ASSERT_EQUAL_UINT32(5021, j.seq);
+    TEST_ASSERT_EQUAL_INT(0, jr_tail(&j, r, 64));      // el más nuevo ya no es el esperado
+}
+
+// El arranque sale del último registro válido, aunque el último esté roto
+static void test_boot_counter_recovery(void)
+{
+    remount();
+    for (int boot = 1; boot <= 3; boot++) {
+        TEST_ASSERT_EQUAL_UINT16(boot, j.boot);
+        TEST_ASSERT_TRUE(jr_append(&j, JR_EV_BOOT, 0xFF, 0, 0));
+        append_n(3);
+        remount();
+    }
+    TEST_ASSERT_EQUAL_UINT16(4, j.boot);
+
+    // Corte en el último registro: el arranque sigue saliendo del anterior
+    rf.tear = 3;
+    TEST_ASSERT_FALSE(jr_append(&j, JR_EV_BOOT, 0xFF, 0, 0));
+    remount();
+    TEST_ASSERT_EQUAL_UINT16(4, j.boot);
+
+    // Corte al empezar sector: el arranque se recupera del sector anterior
+    append_n(JR_PER_SECTOR - j.head % JR_PER_SECTOR);
+    rf.tear = 8;
+    TEST_ASSERT_FALSE(jr_append(&j, JR_EV_BOOT, 0xFF, 0, 0));
+    remount();
+    TEST_ASSERT_EQUAL_UINT16(5, j.boot);
+    TEST_ASSERT_EQUAL_UINT32(0, j.head % JR_PER_SECTOR);
+
+    // Y tras dar la vuelta sigue contando
+    append_n(SLOTS);
+    remount();
+    TEST_ASSERT_EQUAL_UINT16(6, j.boot);
+}
+
+static void test_format(void)
+{
+    jr_record_t r[2] = {
+        { .seq = 12, .time_s = 125, .boot = 3, .type = JR_EV_ALARM, .ch = 0, .arg = 160 },
+        { .seq = 11, .time_s = 2, .boot = 3, .type = JR_EV_BOOT, .ch = 0xFF, .arg = 0 },
+    };
+    char out[64];
+    jr_format(r, 2, out, sizeof out);
+    TEST_ASSERT_EQUAL_STRING("#12 b3 +125s ALARMA c0 160\n#11 b3 +2s ARRANQUE", out);
+    char small[16 + 4];
+    memset(small, '#', sizeof small);
+    jr_format(r, 2, small, 16);
+    TEST_ASSERT_EQUAL_INT(15, (int)strlen(small));
+    for (size_t i = 16; i < sizeof small; i++) TEST_ASSERT_EQUAL_UINT8('#', small[i]);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define BENCH_SECTORS 16          // la partición "journal" de 64 KB
+
+static void test_bench_mount_tail_and_wear(void)
+{
+    flash_new(BENCH_SECTORS * JR_SECTOR);
+    remount();
+    const uint32_t slots = BENCH_SECTORS * JR_PER_SECTOR;
+    const int total = 10 * slots + 1234;              // diez vueltas y pico
+    rf.writes = rf.erases = 0;
+    int64_t t0 = host_cpu_us();
+    for (int i = 0; i < total; i++) jr_append(&j, JR_EV_ALARM, 0, 0, 0);
+    double append_ns = (host_cpu_us() - t0) * 1000.0 / total;
+    uint32_t writes = rf.writes, erases = rf.erases;
+
+    rf.reads = 0;
+    remount();
+    uint32_t mount_reads = rf.reads;
+    rf.reads = 0;
+    jr_record_t r[10];
+    TEST_ASSERT_EQUAL_INT(10, jr_tail(&j, r, 10));
+    uint32_t tail_reads = rf.reads;
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (int s = 0; s < BENCH_SECTORS; s++) {
+        if (rf.sector_erases[s] < lo) lo = rf.sector_erases[s];
+        if (rf.sector_erases[s] > hi) hi = rf.sector_erases[s];
+    }
+
+    printf("\nDiario de %d KB (%u registros), %d añadidos\n", BENCH_SECTORS * JR_SECTOR / 1024, (unsigned)slots,
+           total);
+    printf("  añadir                 %.2f escrituras, %.4f borrados, %.0f ns en el PC\n", (double)writes / total,
+           (double)erases / total, append_ns);
+    printf("  montar                 %u lecturas   (recorrerla entera: %u)\n", (unsigned)mount_reads,
+           (unsigned)slots);
+    printf("  últimos 10             %u lecturas\n", (unsigned)tail_reads);
+    printf("  borrados por sector    %u..%u\n\n", (unsigned)lo, (unsigned)hi);
+
+    TEST_ASSERT_EQUAL_UINT32(total, writes);
+    TEST_ASSERT_LESS_THAN(BENCH_SECTORS + 16, mount_reads);      // un registro por sector + búsqueda binaria
+    TEST_ASSERT_EQUAL_UINT32(10, tail_reads);
+    TEST_ASSERT_LESS_THAN(3, hi - lo);      // repartido: una vuelta a medias y el borrado de la partición nueva
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_partition_mounts_fresh);
+    RUN_TEST(test_append_and_remount_keeps_head);
+    RUN_TEST(test_mount_after_wraparound);
+    RUN_TEST(test_torn_record_at_start_of_new_sector);
+    RUN_TEST(test_torn_record_mid_sector_is_skipped);
+    RUN_TEST(test_tail_stops_at_sequence_gap);
+    RUN_TEST(test_boot_counter_recovery);
+    RUN_TEST(test_format);
+    RUN_TEST(test_bench_mount_tail_and_wear);
+    return UNITY_END();
+}
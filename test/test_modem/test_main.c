@@ -0,0 +1,272 @@
+/*
+ * modem.h entero contra el SIM800 simulado: arranque y negociación del
+ * enlace, SMS por +CMT y +CMTI con su respuesta por AT+CMGS, llamada
+ * entrante con menú y DTMF, llamadas salientes (descuelgue, ocupado,
+ * cancelada). Las locuciones salen de un paquete de prueba en la
+ * partición "prompts" y suenan por el I2S de host/. Al final, latencias
+ * de punta a punta y SMS/s.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_modem.h"
+#include "host_prompts.h"
+#include "modem.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+// Lo que modem.h y sms.h esperan de main.c
+static int alert_tests;
+void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) { (void)vib1; (void)vib2; (void)lamp; (void)ms; }
+void set_relay_polarity(int active_high) { (void)active_high; }
+int  get_relay_polarity(void) { return 0; }
+void alert_test_start(uint32_t ms) { (void)ms; alert_tests++; }
+
+static sim800_t sim;
+
+static const host_prompt_t PROMPTS[] = {
+    { "menu.wav", 16000, 1, 4000, 440 },
+    { "0.wav", 16000, 1, 300, 600 }, { "1.wav", 16000, 1, 300, 600 }, { "2.wav", 16000, 1, 300, 600 },
+    { "3.wav", 16000, 1, 300, 600 }, { "4.wav", 16000, 1, 300, 600 }, { "5.wav", 16000, 1, 300, 600 },
+    { "6.wav", 16000, 1, 300, 600 }, { "7.wav", 16000, 1, 300, 600 }, { "8.wav", 16000, 1, 300, 600 },
+    { "9.wav", 16000, 1, 300, 600 },
+};
+
+// Lo que hace modem_init() en main.c, salvo configurar pines
+static void modem_start(void)
+{
+    host_modem_link(&sim);
+    ml_init();
+    urc_init();
+    TEST_ASSERT_EQUAL(ESP_OK, at_engine_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sms_outbox_start());
+    xTaskCreate(urc_task, "urc_task", URC_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(modem_task, "modem_task", MODEM_TASK_STACK, NULL, 7, NULL);
+}
+
+void setUp(void)
+{
+    sim800_script_clear(&sim);
+    sim800_dial_outcome(&sim, "", 2000);
+}
+void tearDown(void) {}
+
+// Espera a que cond sea cierta; false si vencen ms
+#define WAIT_FOR(cond, ms) ({                                               \
+        int64_t dl_ = esp_timer_get_time() + (int64_t)(ms) * 1000;          \
+        while (!(cond) && esp_timer_get_time() < dl_) vTaskDelay(pdMS_TO_TICKS(2)); \
+        (cond); })
+
+// Primer SMS enviado desde from cuyo texto empieza por prefix; -1 si no hay
+static int sent_find(int from, const char *prefix)
+{
+    for (int i = from; i < sim.n_sent; i++)
+        if (strncmp(sim.sent[i].text, prefix, strlen(prefix)) == 0) return i;
+    return -1;
+}
+
+/* ─────────────────────────── arranque ─────────────────────────── */
+
+static double boot_ms;
+
+static void test_boot_negotiates_and_configures(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    modem_start();
+    // El último paso del arranque es el vaciado de la bandeja (AT+CMGL)
+    TEST_ASSERT_TRUE_MESSAGE(WAIT_FOR(sim.cmgl == 1, 5000), "el arranque no terminó");
+    boot_ms = (esp_timer_get_time() - t0) / 1000.0;
+    TEST_ASSERT_EQUAL_UINT32(460800, sim.baud);
+    TEST_ASSERT_EQUAL_UINT32(460800, host_uart(MODEM_UART)->baud);
+    TEST_ASSERT_FALSE(sim.echo);
+    TEST_ASSERT_EQUAL_UINT32(0, at.stats.timeouts);
+}
+
+/* ───────────────────────────── SMS ───────────────────────────── */
+
+// +CMT: ,<len> y la PDU: el SMS llega sin pasar por la memoria
+static void push_sms(const char *from, const char *text)
+{
+    char pdu[PDU_HEX_MAX];
+    TEST_ASSERT_EQUAL_INT(1, sim_deliver_pdu(from, text, 0, 0, pdu, sizeof pdu));
+    sim_replyf(&sim, "+CMT: ,%d\r\n%s", sim_tpdu_len(pdu), pdu);
+}
+
+#define SMS_N 20
+
+static double sms_lat_ms[SMS_N], cmti_ms;
+
+static void test_sms_push_answered(void)
+{
+    for (int i = 0; i < SMS_N; i++) {
+        int sent0 = sim.n_sent;
+        int64_t t0 = esp_timer_get_time();
+        push_sms(NUM1, "0000 9");
+        TEST_ASSERT_TRUE(WAIT_FOR(sim.n_sent == sent0 + 1, 3000));
+        sms_lat_ms[i] = (sim.sent[sent0].t_us - t0) / 1000.0;
+        TEST_ASSERT_EQUAL_STRING(NUM1, sim.sent[sent0].to);
+        TEST_ASSERT_EQUAL_INT(0, strncmp(sim.sent[sent0].text, "Tiempo activo", 13));
+    }
+}
+
+static void test_sms_stored_then_cmti(void)
+{
+    char pdu[PDU_HEX_MAX];
+    int sent0 = sim.n_sent;
+    TEST_ASSERT_EQUAL_INT(1, sim_deliver_pdu(NUM2, "0000 8", 0, 0, pdu, sizeof pdu));
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_GREATER_THAN(0, sim800_receive_sms(&sim, pdu));
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.n_sent == sent0 + 1, 3000));
+    cmti_ms = (sim.sent[sent0].t_us - t0) / 1000.0;
+    TEST_ASSERT_EQUAL_INT(1, alert_tests);
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.n_stored == 0, 1000));
+}
+
+/* ─────────────────────────── llamadas ─────────────────────────── */
+
+static double ata_ms, cut_ms;
+
+static void test_incoming_call_menu_and_dtmf(void)
+{
+    int sent0 = sim.n_sent;
+    uint32_t ata0 = sim.ata, ath0 = sim.ath;
+    int64_t t0 = esp_timer_get_time();
+    sim800_ring(&sim, NUM1 + 3);                     // la red lo da sin +34
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.ata == ata0 + 1, 2000));
+    ata_ms = (sim.t_ata_us - t0) / 1000.0;
+    TEST_ASSERT_EQUAL(SIM_CALL_ACTIVE, sim.call);
+
+    // Descolgado: lista de comandos por SMS (varias partes) y menú sonando
+    TEST_ASSERT_TRUE(WAIT_FOR(sent_find(sent0, "Comando 1") >= 0, 3000));
+    uint64_t f0 = host_i2s()->frames;
+    vTaskDelay(pdMS_TO_TICKS(500));
+    TEST_ASSERT_GREATER_THAN(16000 * 4 / 10, host_i2s()->frames - f0);   // 0,5 s a 16 kHz
+    TEST_ASSERT_GREATER_THAN(esp_timer_get_time(), host_i2s()->sound_end_us);
+
+    // Un 9 corta el menú, contesta por SMS y cuelga al acabar su locución
+    sent0 = sim.n_sent;
+    t0 = esp_timer_get_time();
+    TEST_ASSERT_TRUE(sim800_dtmf(&sim, '9'));
+    TEST_ASSERT_TRUE(WAIT_FOR(sent_find(sent0, "Tiempo activo") >= 0, 3000));
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.ath == ath0 + 1, 3000));
+    cut_ms = (s_audio.cut.n ? s_audio.cut.sum_us / s_audio.cut.n : 0) / 1000.0;
+    TEST_ASSERT_GREATER_OR_EQUAL(300000, sim.t_ath_us - t0);   // 9.wav entero
+    TEST_ASSERT_GREATER_OR_EQUAL(host_i2s()->sound_end_us, sim.t_ath_us);   // ... y ya sonado
+    TEST_ASSERT_EQUAL(SIM_CALL_IDLE, sim.call);
+    TEST_ASSERT_TRUE(audio_wait_idle(1000));
+}
+
+static void test_unknown_caller_not_answered(void)
+{
+    uint32_t ata0 = sim.ata;
+    sim800_ring(&sim, "699999999");
+    vTaskDelay(pdMS_TO_TICKS(500));
+    TEST_ASSERT_EQUAL_UINT32(ata0, sim.ata);
+    sim800_remote_hangup(&sim);
+}
+
+typedef struct {
+    SemaphoreHandle_t done;
+    call_result_t     r;
+    int64_t           t_us;
+} call_wait_t;
+
+static void on_call(call_result_t r, void *ctx)
+{
+    call_wait_t *w = ctx;
+    w->r = r;
+    w->t_us = esp_timer_get_time();
+    xSemaphoreGive(w->done);
+}
+
+static call_result_t dial(const char *outcome, uint32_t ms, int abort_after_ms, int64_t *dt_us)
+{
+    static call_wait_t w;
+    if (!w.done) w.done = xSemaphoreCreateBinary();
+    sim800_dial_outcome(&sim, outcome, ms);
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_TRUE(modem_call_start("+34600000001", on_call, &w));
+    if (abort_after_ms >= 0) {
+        vTaskDelay(pdMS_TO_TICKS(abort_after_ms));
+        t0 = esp_timer_get_time();
+        modem_call_abort();
+    }
+    TEST_ASSERT_TRUE(xSemaphoreTake(w.done, pdMS_TO_TICKS(ms + 3000)));
+    *dt_us = w.t_us - t0;
+    return w.r;
+}
+
+static double abort_ms;
+
+static void test_outgoing_call_outcomes(void)
+{
+    int64_t dt;
+    TEST_ASSERT_EQUAL(CALL_BUSY, dial("BUSY", 150, -1, &dt));
+    TEST_ASSERT_EQUAL(CALL_NO_ANSWER, dial("NO ANSWER", 150, -1, &dt));
+    TEST_ASSERT_FALSE(modem_call_active());
+
+    TEST_ASSERT_EQUAL(CALL_ANSWERED, dial("", 200, -1, &dt));
+    TEST_ASSERT_TRUE(modem_call_active());
+    TEST_ASSERT_EQUAL(SIM_CALL_ACTIVE, sim.call);
+    sim800_remote_hangup(&sim);
+    TEST_ASSERT_TRUE(WAIT_FOR(!modem_call_active(), 1000));
+
+    // Cancelada mientras suena: no se espera a los 5 s de la red
+    uint32_t ath0 = sim.ath;
+    TEST_ASSERT_EQUAL(CALL_CANCELLED, dial("NO ANSWER", 5000, 100, &dt));
+    abort_ms = dt / 1000.0;
+    TEST_ASSERT_LESS_THAN(200000, dt);
+    TEST_ASSERT_TRUE(WAIT_FOR(sim.ath == ath0 + 1, 1000));
+    TEST_ASSERT_EQUAL(SIM_CALL_IDLE, sim.call);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void test_bench_end_to_end(void)
+{
+    qsort(sms_lat_ms, SMS_N, sizeof sms_lat_ms[0], cmp_double);
+    double sum = 0;
+    for (int i = 0; i < SMS_N; i++) sum += sms_lat_ms[i];
+    printf("\nmodem.h contra el SIM800 simulado (2 ms por comando, enlace a %u baudios)\n",
+           (unsigned)modem_link_baud);
+    printf("  arranque hasta el vaciado de la bandeja     %7.1f ms\n", boot_ms);
+    printf("  +CMT → respuesta enviada (media, p50, máx)   %7.1f %7.1f %7.1f ms  (%.1f SMS/s)\n",
+           sum / SMS_N, sms_lat_ms[SMS_N / 2], sms_lat_ms[SMS_N - 1], 1000.0 * SMS_N / sum);
+    printf("  +CMTI → respuesta enviada                   %7.1f ms  (300 ms de espera a la ráfaga)\n", cmti_ms);
+    printf("  RING → ATA                                  %7.1f ms\n", ata_ms);
+    printf("  DTMF → menú en silencio (media)             %7.1f ms\n", cut_ms);
+    printf("  cancelación de ATD → resultado              %7.1f ms\n\n", abort_ms);
+
+    TEST_ASSERT_LESS_THAN(1000, boot_ms);
+    TEST_ASSERT_LESS_THAN(200, sms_lat_ms[SMS_N - 1]);
+    TEST_ASSERT_LESS_THAN(600, cmti_ms);
+    TEST_ASSERT_LESS_THAN(100, ata_ms);
+    TEST_ASSERT_LESS_THAN(80, cut_ms);
+}
+
+int main(void)
+{
+    (void)dtmf_files;                              // como en main.c
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    config_init();
+    TEST_ASSERT_NOT_NULL(host_prompts_install(PROMPTS, sizeof PROMPTS / sizeof PROMPTS[0]));
+    audio_init();
+    TEST_ASSERT_TRUE(audio_ready);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_negotiates_and_configures);
+    RUN_TEST(test_sms_push_answered);
+    RUN_TEST(test_sms_stored_then_cmti);
+    RUN_TEST(test_incoming_call_menu_and_dtmf);
+    RUN_TEST(test_unknown_caller_not_answered);
+    RUN_TEST(test_outgoing_call_outcomes);
+    RUN_TEST(test_bench_end_to_end);
+    return UNITY_END();
+}
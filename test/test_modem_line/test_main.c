@@ -0,0 +1,294 @@
+/*
+ * Ensamblador de líneas (modem_line.h) contra un pty.
+ *
+ * Lo que escribe la prueba por el maestro del pty le llega al firmware
+ * como si viniera del SIM800. Al final, la medida que justificó el
+ * ensamblador: llamadas al driver y CPU por URC, y llamadas con el
+ * enlace parado, frente al read_line() de un byte por llamada que había
+ * antes en modem.h.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_util.h"
+#include "modem_line.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+#define LINK_BAUD   115200
+
+static int peer;
+
+static void send(const char *s) { host_paced_puts(peer, s, LINK_BAUD); }
+
+// Lo que no cabe en el driver tiene que llegar mientras el firmware lee
+static void *send_main(void *arg)
+{
+    send(arg);
+    return NULL;
+}
+
+static pthread_t send_async(const char *s)
+{
+    pthread_t t;
+    pthread_create(&t, NULL, send_main, (void *)s);
+    return t;
+}
+
+// Nada pendiente en el driver ni en el ensamblador
+static void drain(void)
+{
+    host_sleep_us(20000);
+    uart_flush_input(MODEM_UART);
+    xQueueReset(g_modem_uart_queue);
+    ml_init();
+    ml_prompt_armed = false;
+}
+
+void setUp(void) { drain(); }
+void tearDown(void) {}
+
+static modem_line_t next(int timeout_ms)
+{
+    modem_line_t l;
+    TEST_ASSERT_TRUE_MESSAGE(ml_next(&l, timeout_ms), "no llegó la línea");
+    return l;
+}
+
+static void test_lines_without_crlf_and_empty_skipped(void)
+{
+    send("\r\nOK\r\n+CMTI: \"ME\",3\r\n\r\nRING\r\nSIN CR\n");
+    modem_line_t l = next(500);
+    TEST_ASSERT_EQUAL_STRING("OK", l.text);
+    TEST_ASSERT_EQUAL_INT(2, l.len);
+    TEST_ASSERT_FALSE(l.partial);
+    TEST_ASSERT_FALSE(l.cont);
+    TEST_ASSERT_EQUAL_STRING("+CMTI: \"ME\",3", next(500).text);
+    TEST_ASSERT_EQUAL_STRING("RING", next(500).text);
+    TEST_ASSERT_EQUAL_STRING("SIN CR", next(500).text);
+}
+
+static void test_line_split_across_reads(void)
+{
+    send("+CLIP: \"6001");
+    host_sleep_us(30000);
+    send("11222\",129\r\n");
+    modem_line_t l = next(500);
+    TEST_ASSERT_EQUAL_STRING("+CLIP: \"600111222\",129", l.text);
+}
+
+static void test_lines_stay_valid_until_next_call(void)
+{
+    send("UNO\r\nDOS\r\n");
+    modem_line_t a = next(500);
+    char copy[8];
+    snprintf(copy, sizeof copy, "%s", a.text);
+    TEST_ASSERT_EQUAL_STRING("UNO", copy);
+    TEST_ASSERT_EQUAL_STRING("DOS", next(500).text);
+}
+
+static void test_long_line_delivered_in_pieces(void)
+{
+    static char big[ML_BUF_LEN + 300 + 8];
+    memset(big, 'A', ML_BUF_LEN);
+    memset(big + ML_BUF_LEN, 'B', 300);
+    strcpy(big + ML_BUF_LEN + 300, "\r\n");
+    uint32_t long0 = ml.stats.long_lines;
+    strcat(big, "OK\r\n");
+    pthread_t w = send_async(big);
+
+    modem_line_t l = next(1000);
+    TEST_ASSERT_TRUE(l.partial);
+    TEST_ASSERT_FALSE(l.cont);
+    TEST_ASSERT_EQUAL_INT(ML_BUF_LEN, l.len);
+    TEST_ASSERT_EQUAL_INT('A', l.text[ML_BUF_LEN - 1]);
+    l = next(1000);
+    TEST_ASSERT_FALSE(l.partial);
+    TEST_ASSERT_TRUE(l.cont);
+    TEST_ASSERT_EQUAL_INT(300, l.len);
+    TEST_ASSERT_EQUAL_INT('B', l.text[0]);
+    TEST_ASSERT_EQUAL_STRING("OK", next(500).text);
+    pthread_join(w, NULL);
+    TEST_ASSERT_EQUAL_UINT32(long0 + 1, ml.stats.long_lines);
+}
+
+static void test_prompt_without_newline(void)
+{
+    ml_prompt_armed = true;
+    send("> ");
+    modem_line_t l = next(500);
+    TEST_ASSERT_EQUAL_STRING(">", l.text);
+    TEST_ASSERT_FALSE(ml_prompt_armed);
+    send("\r\n+CMGS: 12\r\n\r\nOK\r\n");
+    TEST_ASSERT_EQUAL_STRING("+CMGS: 12", next(500).text);
+    TEST_ASSERT_EQUAL_STRING("OK", next(500).text);
+}
+
+static void test_prompt_not_taken_when_not_armed(void)
+{
+    send("> no es un prompt\r\n");
+    TEST_ASSERT_EQUAL_STRING("> no es un prompt", next(500).text);
+}
+
+// Sin tráfico, ml_next duerme en la cola: ni una llamada al driver
+static void test_idle_timeout_does_not_poll(void)
+{
+    modem_line_t l;
+    uint32_t calls0 = ml.stats.driver_calls;
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_FALSE(ml_next(&l, 200));
+    int64_t dt = esp_timer_get_time() - t0;
+    TEST_ASSERT_GREATER_OR_EQUAL(195000, dt);
+    TEST_ASSERT_LESS_THAN(400000, dt);
+    TEST_ASSERT_EQUAL_UINT32(calls0, ml.stats.driver_calls);
+}
+
+// Búfer del driver desbordado: la línea a medias se tira y se sigue limpio
+static void test_overflow_drops_partial_line(void)
+{
+    static char junk[1600];
+    memset(junk, 'x', sizeof junk - 1);
+    junk[sizeof junk - 1] = '\0';
+    uint32_t ovf0 = ml.stats.overflows;
+    host_paced_puts(peer, junk, 0);        // de golpe: no cabe en los 1024 del driver
+    host_sleep_us(50000);
+
+    modem_line_t l;
+    while (ml_next(&l, 200)) TEST_ASSERT_TRUE(l.partial || l.cont);
+    TEST_ASSERT_GREATER_THAN(ovf0, ml.stats.overflows);
+    TEST_ASSERT_GREATER_THAN(0, host_uart(MODEM_UART)->lost);
+
+    send("\r\nOK\r\n");
+    l = next(500);
+    TEST_ASSERT_EQUAL_STRING("OK", l.text);
+    TEST_ASSERT_FALSE(l.cont);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+// El read_line() que había en modem.h: un uart_read_bytes por byte
+static int legacy_read_line(char *buf, int max, int timeout_ms)
+{
+    int len = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (((esp_timer_get_time() - t0) / 1000) < timeout_ms && len < max - 1) {
+        if (uart_read_bytes(MODEM_UART, (uint8_t *)buf + len, 1,
+                            pdMS_TO_TICKS(50)) == 1 && buf[len++] == '\n')
+            break;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+#define BENCH_URCS   200
+#define BENCH_GAP_US 3000   // entre URC: llegan sueltos, como en la realidad
+
+static const char *const BENCH_CORPUS[] = {
+    "\r\n+CMTI: \"ME\",%d\r\n",
+    "\r\nRING\r\n\r\n+CLIP: \"600111222\",129,\"\",0,\"\",%d\r\n",
+    "\r\n+DTMF: %d\r\n",
+    "\r\n+CSQ: %d,0\r\n",
+    "\r\nNO CARRIER\r\n",
+};
+
+static int bench_lines;   // líneas no vacías que manda el escritor
+
+static void *bench_writer(void *arg)
+{
+    (void)arg;
+    char s[96];
+    for (int i = 0; i < BENCH_URCS; i++) {
+        snprintf(s, sizeof s, BENCH_CORPUS[i % 5], i % 10);
+        send(s);
+        host_sleep_us(BENCH_GAP_US);
+    }
+    return NULL;
+}
+
+typedef struct {
+    double calls_per_urc;
+    double cpu_us_per_urc;
+    double idle_calls_per_s;
+} bench_t;
+
+static uint32_t driver_calls(void)
+{
+    host_uart_t *u = host_uart(MODEM_UART);
+    return u->read_calls + u->len_calls;
+}
+
+static bench_t bench_run(bool legacy)
+{
+    bench_t r;
+    drain();
+    pthread_t w;
+    uint32_t c0 = driver_calls();
+    int64_t cpu0 = host_cpu_us();
+    pthread_create(&w, NULL, bench_writer, NULL);
+    int got = 0;
+    char buf[512];
+    modem_line_t l;
+    while (got < bench_lines) {
+        if (legacy) {
+            int n = legacy_read_line(buf, sizeof buf, 2000);
+            if (n == 0) break;
+            if (n > 2) got++;                  // las "\r\n" sueltas no cuentan
+        } else {
+            if (!ml_next(&l, 2000)) break;
+            got++;
+        }
+    }
+    pthread_join(w, NULL);
+    TEST_ASSERT_EQUAL_INT(bench_lines, got);
+    r.calls_per_urc = (double)(driver_calls() - c0) / BENCH_URCS;
+    r.cpu_us_per_urc = (double)(host_cpu_us() - cpu0) / BENCH_URCS;
+
+    // Un segundo sin tráfico
+    c0 = driver_calls();
+    if (legacy) legacy_read_line(buf, sizeof buf, 1000);
+    else        ml_next(&l, 1000);
+    r.idle_calls_per_s = driver_calls() - c0;
+    return r;
+}
+
+static void test_bench_driver_calls_and_cpu_per_urc(void)
+{
+    bench_lines = 0;
+    for (int i = 0; i < BENCH_URCS; i++) bench_lines += (i % 5 == 1) ? 2 : 1;
+
+    bench_t old = bench_run(true);
+    bench_t now = bench_run(false);
+    printf("\n%d URC a %d baudios        antes (byte a byte)   ahora (eventos)\n", BENCH_URCS, LINK_BAUD);
+    printf("  llamadas driver / URC   %10.1f            %10.1f\n", old.calls_per_urc, now.calls_per_urc);
+    printf("  CPU / URC (us)          %10.1f            %10.1f\n", old.cpu_us_per_urc, now.cpu_us_per_urc);
+    printf("  llamadas / s en reposo  %10.0f            %10.0f\n\n", old.idle_calls_per_s, now.idle_calls_per_s);
+
+    // En el PC la CPU por URC la domina despertar al hilo, no la llamada
+    // al driver; en el C6 cada llamada son sus semáforos y su ringbuffer.
+    TEST_ASSERT_LESS_THAN(old.calls_per_urc / 4, now.calls_per_urc);
+    TEST_ASSERT_LESS_THAN(old.cpu_us_per_urc * 125, now.cpu_us_per_urc * 100);   // en centésimas: el assert trunca
+    TEST_ASSERT_EQUAL(0, now.idle_calls_per_s);
+    TEST_ASSERT_GREATER_OR_EQUAL(15, old.idle_calls_per_s);   // un timeout de 50 ms tras otro
+}
+
+int main(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, uart_driver_install(MODEM_UART, 1024, 0, MIO_EVENT_QUEUE_LEN,
+                                                  &g_modem_uart_queue, 0));
+    peer = host_uart_peer(MODEM_UART);
+    ml_init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lines_without_crlf_and_empty_skipped);
+    RUN_TEST(test_line_split_across_reads);
+    RUN_TEST(test_lines_stay_valid_until_next_call);
+    RUN_TEST(test_long_line_delivered_in_pieces);
+    RUN_TEST(test_prompt_without_newline);
+    RUN_TEST(test_prompt_not_taken_when_not_armed);
+    RUN_TEST(test_idle_timeout_does_not_poll);
+    RUN_TEST(test_overflow_drops_partial_line);
+    RUN_TEST(test_bench_driver_calls_and_cpu_per_urc);
+    return UNITY_END();
+}
@@ -0,0 +1,246 @@
+/*
+ * Puesta en marcha del enlace (modem_link.h) contra el SIM800 simulado:
+ * encontrar al módem a otra velocidad, subir a la más alta que aguante,
+ * volver atrás con errores o si rechaza AT+IPR, y RTS/CTS. Al final,
+ * caudal y pérdidas de una ráfaga AT+CMGL con el lector parado un rato
+ * (como cuando modem_task estaba ocupada con el audio): 115200 sin
+ * control de flujo como antes, 460800 sin él y 460800 con RTS/CTS.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#define MODEM_HW_FLOWCTRL 1
+#include "host_modem.h"
+#include "modem_link.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+static sim800_t sim;
+
+void setUp(void)
+{
+    sim800_script_clear(&sim);
+    sim.max_baud = 0;
+}
+void tearDown(void) {}
+
+static void sim_set_baud(uint32_t baud)
+{
+    pthread_mutex_lock(&sim.m);
+    sim.baud = baud;
+    pthread_mutex_unlock(&sim.m);
+}
+
+// Módem y ESP32 de vuelta a la velocidad de arranque, enlace comprobado
+static void back_to_boot_baud(void)
+{
+    if (modem_link_baud != MODEM_BAUD) {
+        TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("AT+IPR=115200", 1000));
+        link_set_baud(MODEM_BAUD);
+    }
+    TEST_ASSERT_TRUE(link_check(2));
+}
+
+/* ─────────────────────────── negociación ─────────────────────────── */
+
+// Solo se reinició el ESP32: el módem sigue a la velocidad negociada
+static void test_probe_finds_modem_at_other_baud(void)
+{
+    sim_set_baud(230400);
+    TEST_ASSERT_TRUE(modem_link_probe());
+    TEST_ASSERT_EQUAL_UINT32(230400, modem_link_baud);
+    back_to_boot_baud();
+}
+
+static double t_clean_ms;
+
+static void test_negotiates_highest(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_EQUAL_UINT32(460800, modem_link_negotiate());
+    t_clean_ms = (esp_timer_get_time() - t0) / 1000.0;
+    TEST_ASSERT_EQUAL_UINT32(460800, sim.baud);
+    TEST_ASSERT_EQUAL_UINT32(460800, host_uart(MODEM_UART)->baud);
+    back_to_boot_baud();
+}
+
+static double t_noisy_ms;
+
+// Por encima de 230400 el cableado mete errores: se queda en 230400
+static void test_falls_back_when_link_is_noisy(void)
+{
+    sim.max_baud = 230400;
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_EQUAL_UINT32(230400, modem_link_negotiate());
+    t_noisy_ms = (esp_timer_get_time() - t0) / 1000.0;
+    TEST_ASSERT_EQUAL_UINT32(230400, sim.baud);
+    TEST_ASSERT_TRUE(link_check(MODEM_LINK_CHECKS));
+    back_to_boot_baud();
+}
+
+// Nada por encima de 115200 aguanta: se queda donde arrancó
+static void test_stays_at_boot_baud_when_nothing_holds(void)
+{
+    sim.max_baud = 115200;
+    TEST_ASSERT_EQUAL_UINT32(115200, modem_link_negotiate());
+    TEST_ASSERT_EQUAL_UINT32(115200, sim.baud);
+    TEST_ASSERT_TRUE(link_check(MODEM_LINK_CHECKS));
+}
+
+static void test_ipr_refused_tries_next(void)
+{
+    sim800_script(&sim, "AT+IPR=460800", "ERROR", 0, -1);
+    TEST_ASSERT_EQUAL_UINT32(230400, modem_link_negotiate());
+    TEST_ASSERT_EQUAL_UINT32(230400, sim.baud);
+    back_to_boot_baud();
+}
+
+/* ───────────────────── ráfaga: caudal y pérdidas ───────────────────── */
+
+#define BURST_SMS 40
+
+typedef struct {
+    int     entries;           // +CMGL con su PDU entera
+    size_t  bytes;
+    int64_t t_first, t_last;
+    int     want_pdu;          // índice del +CMGL anterior, 0 si no
+} burst_t;
+
+static void on_cmgl_line(const char *line, void *ctx)
+{
+    burst_t *b = ctx;
+    int64_t now = esp_timer_get_time();
+    if (!b->t_first) b->t_first = now;
+    b->t_last = now;
+    b->bytes += strlen(line) + 2;
+    int idx;
+    if (sscanf(line, "+CMGL: %d,", &idx) == 1) {
+        b->want_pdu = idx;
+        return;
+    }
+    if (b->want_pdu && b->want_pdu <= SIM_STORE_MAX && strcmp(line, sim.store[b->want_pdu].pdu) == 0) b->entries++;
+    b->want_pdu = 0;
+}
+
+// El lector se para stall_ms tras la primera línea que le llega
+static volatile int64_t stall_us;
+
+static void on_activity(bool tx)
+{
+    if (tx || !stall_us) return;
+    int64_t us = stall_us;
+    stall_us = 0;
+    host_sleep_us(us);
+}
+
+typedef struct {
+    double      kBps;          // caudal útil de la respuesta, sin parar el lector
+    int         lost;          // entradas perdidas con el lector parado
+    uint32_t    lost_bytes;
+    at_result_t res;
+} burst_result_t;
+
+static at_result_t cmgl(burst_t *b)
+{
+    memset(b, 0, sizeof *b);
+    at_cmd_t c = { .timeout_ms = 3000, .on_line = on_cmgl_line, .ctx = b };
+    snprintf(c.cmd, sizeof c.cmd, "AT+CMGL=4");
+    return at_exec(&c);
+}
+
+static burst_result_t burst_run(uint32_t stall_ms)
+{
+    burst_result_t r = { 0 };
+    burst_t b;
+    TEST_ASSERT_EQUAL(AT_RES_OK, cmgl(&b));
+    TEST_ASSERT_EQUAL_INT(BURST_SMS, b.entries);
+    r.kBps = b.bytes * 1000.0 / (b.t_last - b.t_first);
+
+    uint32_t lost0 = host_uart(MODEM_UART)->lost;
+    stall_us = (int64_t)stall_ms * 1000;
+    r.res = cmgl(&b);
+    r.lost = BURST_SMS - b.entries;
+    r.lost_bytes = host_uart(MODEM_UART)->lost - lost0;
+    host_sleep_us(50000);
+    uart_flush_input(MODEM_UART);
+    return r;
+}
+
+#define STALL_MS 300
+
+static burst_result_t slow, fast, fast_flow;
+
+static void test_burst_115200_without_flow_control(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(115200, modem_link_baud);
+    slow = burst_run(STALL_MS);
+    TEST_ASSERT_GREATER_THAN(0, slow.lost);          // lo que pasaba antes
+}
+
+static void test_burst_460800_without_flow_control(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(460800, modem_link_negotiate());
+    fast = burst_run(STALL_MS);
+    TEST_ASSERT_GREATER_THAN(0, fast.lost);
+}
+
+static void test_burst_460800_with_rts_cts(void)
+{
+    modem_link_flowctrl();
+    TEST_ASSERT_TRUE(host_uart(MODEM_UART)->flowctrl);
+    fast_flow = burst_run(STALL_MS);
+    TEST_ASSERT_EQUAL(AT_RES_OK, fast_flow.res);
+    TEST_ASSERT_EQUAL_INT(0, fast_flow.lost);
+    TEST_ASSERT_EQUAL_UINT32(0, fast_flow.lost_bytes);
+}
+
+static const char *res_name(at_result_t r)
+{
+    return r == AT_RES_OK ? "OK" : r == AT_RES_TIMEOUT ? "timeout" : "error";
+}
+
+static void test_bench_link(void)
+{
+    printf("\nNegociación: %.0f ms sin errores, %.0f ms con ruido por encima de 230400\n", t_clean_ms, t_noisy_ms);
+    printf("Ráfaga AT+CMGL de %d SMS, lector parado %d ms tras la primera línea\n", BURST_SMS, STALL_MS);
+    printf("                          caudal     perdidos   bytes perdidos   resultado\n");
+    printf("  115200, sin RTS/CTS   %5.1f kB/s   %4d       %6u         %s\n", slow.kBps, slow.lost,
+           (unsigned)slow.lost_bytes, res_name(slow.res));
+    printf("  460800, sin RTS/CTS   %5.1f kB/s   %4d       %6u         %s\n", fast.kBps, fast.lost,
+           (unsigned)fast.lost_bytes, res_name(fast.res));
+    printf("  460800, RTS/CTS       %5.1f kB/s   %4d       %6u         %s\n\n", fast_flow.kBps,
+           fast_flow.lost, (unsigned)fast_flow.lost_bytes, res_name(fast_flow.res));
+
+    TEST_ASSERT_GREATER_THAN(slow.kBps * 3, fast_flow.kBps);
+    TEST_ASSERT_LESS_THAN(5000, t_noisy_ms);
+}
+
+int main(void)
+{
+    esp_log_level_set(LINK_TAG, ESP_LOG_ERROR);      // los avisos de cada velocidad que no aguanta
+    esp_log_level_set(MIO_TAG, ESP_LOG_ERROR);
+    esp_log_level_set(ML_TAG, ESP_LOG_ERROR);
+    host_modem_start(&sim);
+    at_activity_hook = on_activity;
+    at_cmd("ATE0", AT_TIMEOUT_MS);
+    for (int i = 1; i <= BURST_SMS; i++) {
+        char from[PDU_ADDR_MAX], text[32], pdu[PDU_HEX_MAX];
+        snprintf(from, sizeof from, "+3461100%04d", i);
+        snprintf(text, sizeof text, "hola %d, ráfaga de prueba", i);
+        sim_deliver_pdu(from, text, 0, 0, pdu, sizeof pdu);
+        sim800_store_sms(&sim, pdu);
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_probe_finds_modem_at_other_baud);
+    RUN_TEST(test_negotiates_highest);
+    RUN_TEST(test_falls_back_when_link_is_noisy);
+    RUN_TEST(test_stays_at_boot_baud_when_nothing_holds);
+    RUN_TEST(test_ipr_refused_tries_next);
+    RUN_TEST(test_burst_115200_without_flow_control);
+    RUN_TEST(test_burst_460800_without_flow_control);
+    RUN_TEST(test_burst_460800_with_rts_cts);
+    RUN_TEST(test_bench_link);
+    return UNITY_END();
+}
@@ -0,0 +1,253 @@
+/*
+ * Reproducción de una sesión grabada (mio_replay_load(), lo que hace
+ * main.c con -D MODEM_REPLAY). Un proceso hijo graba una sesión de
+ * modem.h contra el SIM800 simulado (arranque, un SMS, una llamada con
+ * menú y un 9) y la vuelca con modem_trace_dump(); después el firmware
+ * entero la repite sin simulador. Sus comandos deben ser los mismos y en
+ * el mismo orden, y salir cuando salieron en la sesión original.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unity.h>
+
+#include "host_modem.h"
+#include "host_prompts.h"
+#include "modem.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+// Lo que modem.h y sms.h esperan de main.c
+void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) { (void)vib1; (void)vib2; (void)lamp; (void)ms; }
+void set_relay_polarity(int active_high) { (void)active_high; }
+int  get_relay_polarity(void) { return 0; }
+void alert_test_start(uint32_t ms) { (void)ms; }
+
+static const host_prompt_t PROMPTS[] = {
+    { "menu.wav", 16000, 1, 2000, 440 },
+    { "9.wav", 16000, 1, 300, 600 },
+};
+
+static char rec_path[] = "/tmp/replay_rec_XXXXXX";
+static char run_path[] = "/tmp/replay_run_XXXXXX";
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define WAIT_FOR(cond, ms) ({                                               \
+        int64_t dl_ = esp_timer_get_time() + (int64_t)(ms) * 1000;          \
+        while (!(cond) && esp_timer_get_time() < dl_) vTaskDelay(pdMS_TO_TICKS(2)); \
+        (cond); })
+
+// Lo que hace modem_init() en main.c después de instalar el UART
+static void firmware_start(void)
+{
+    audio_init();
+    ml_init();
+    urc_init();
+    at_engine_start();
+    sms_outbox_start();
+    xTaskCreate(urc_task, "urc_task", URC_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(modem_task, "modem_task", MODEM_TASK_STACK, NULL, 7, NULL);
+}
+
+// Vuelca la traza de este proceso a path
+static void dump_to(const char *path)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), fd = open(path, O_WRONLY | O_TRUNC);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+    modem_trace_dump();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+/* ─────────────── la sesión original (proceso hijo) ─────────────── */
+
+static sim800_t sim;
+
+static bool sent_with(int from, const char *prefix)
+{
+    for (int i = from; i < sim.n_sent; i++)
+        if (strncmp(sim.sent[i].text, prefix, strlen(prefix)) == 0) return true;
+    return false;
+}
+
+// Devuelve el paso en que falló, 0 si la sesión se grabó entera
+static int record_session(void)
+{
+    char pdu[PDU_HEX_MAX];
+    host_modem_link(&sim);
+    firmware_start();
+    if (!WAIT_FOR(sim.cmgl == 1, 5000)) return 1;
+
+    if (sim_deliver_pdu(NUM1, "0000 9", 0, 0, pdu, sizeof pdu) != 1) return 2;
+    sim_replyf(&sim, "+CMT: ,%d\r\n%s", sim_tpdu_len(pdu), pdu);
+    if (!WAIT_FOR(sim.n_sent == 1, 3000)) return 3;
+
+    vTaskDelay(pdMS_TO_TICKS(200));
+    sim800_ring(&sim, NUM1 + 3);
+    if (!WAIT_FOR(sim.ata == 1, 2000)) return 4;
+    if (!WAIT_FOR(sent_with(1, "Comando 1"), 3000)) return 5;
+    vTaskDelay(pdMS_TO_TICKS(300));
+    int sent = sim.n_sent;
+    if (!sim800_dtmf(&sim, '9')) return 6;
+    if (!WAIT_FOR(sim.ath == 1, 3000)) return 7;
+    if (!sent_with(sent, "Tiempo activo")) return 8;
+    vTaskDelay(pdMS_TO_TICKS(200));
+    if (mt.overwritten) return 9;                 // la sesión no cabe en el anillo
+    dump_to(rec_path);
+    return 0;
+}
+
+/* ─────────────────── comparación de trazas ─────────────────── */
+
+#define CMDS_MAX 64
+
+typedef struct {
+    int64_t t_ms;
+    char    name[24];          // hasta el '=' o '?': AT+CMGS= vale para cualquier longitud
+} tx_cmd_t;
+
+typedef struct {
+    tx_cmd_t cmd[CMDS_MAX];
+    int      n;
+    int      rx;               // registros RX
+} trace_t;
+
+// Comandos AT que escribió el firmware (los cuerpos de AT+CMGS no cuentan)
+static void trace_load(const char *path, trace_t *tr)
+{
+    memset(tr, 0, sizeof *tr);
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    char line[1024], cur[64];
+    int len = 0;
+    int64_t t_cur = 0;
+    while (fgets(line, sizeof line, f)) {
+        int64_t t;
+        if (mio_replay_record(line, "RX", &t)) tr->rx++;
+        int off = mio_replay_record(line, "TX", &t);
+        if (!off) continue;
+        for (const char *q = line + off; *q && *q != '\n'; q++) {
+            char c = *q;
+            if (c == '\\' && q[1]) {
+                c = *++q;
+                if (c == 'r') c = '\r';
+                else if (c == 'x') { c = (char)strtoul((char[3]){ q[1], q[2], 0 }, NULL, 16); q += 2; }
+            }
+            if (len == 0) t_cur = t;
+            if (c != '\r' && c != 0x1A) {
+                if (len < (int)sizeof cur - 1) cur[len++] = c;
+                continue;
+            }
+            cur[len] = '\0';
+            if (strncmp(cur, "AT", 2) == 0 && tr->n < CMDS_MAX) {
+                tx_cmd_t *e = &tr->cmd[tr->n++];
+                e->t_ms = t_cur;
+                size_t k = strcspn(cur, "=?");
+                snprintf(e->name, sizeof e->name, "%.*s", (int)(k + (cur[k] != '\0')), cur);
+            }
+            len = 0;
+        }
+    }
+    fclose(f);
+}
+
+static int count_cmd(const trace_t *tr, const char *name)
+{
+    int n = 0;
+    for (int i = 0; i < tr->n; i++) n += strcmp(tr->cmd[i].name, name) == 0;
+    return n;
+}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+static trace_t rec, run;
+static double dev_mean_ms, dev_max_ms;
+
+static int record_status = -1;
+
+static void test_session_recorded(void)
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, record_status, "la sesión original falló en ese paso");
+    trace_load(rec_path, &rec);
+    TEST_ASSERT_GREATER_THAN(20, rec.rx);
+    TEST_ASSERT_GREATER_OR_EQUAL(3, count_cmd(&rec, "AT+CMGS="));   // respuesta, menú (en partes), 9
+    TEST_ASSERT_EQUAL_INT(1, count_cmd(&rec, "ATA"));
+    TEST_ASSERT_EQUAL_INT(1, count_cmd(&rec, "ATH"));
+}
+
+static void test_replay_drives_firmware(void)
+{
+    ESP_ERROR_CHECK(uart_driver_install(MODEM_UART, 1024, 0, MIO_EVENT_QUEUE_LEN, &g_modem_uart_queue, 0));
+    TEST_ASSERT_TRUE(mio_replay_load(rec_path));
+    firmware_start();
+
+    // Hasta que se entregue el último RX, y lo que el firmware tarde en contestarlo
+    TEST_ASSERT_TRUE_MESSAGE(WAIT_FOR(mio_rp.p >= mio_rp.end && !mio_rp.ready, 15000), "la reproducción no terminó");
+    vTaskDelay(pdMS_TO_TICKS(500));
+    TEST_ASSERT_EQUAL_UINT32(0, mt.overwritten);
+    dump_to(run_path);
+    trace_load(run_path, &run);
+
+    // Los mismos comandos, en el mismo orden
+    if (rec.n != run.n) {
+        for (int i = 0; i < rec.n || i < run.n; i++)
+            printf("  %-14s %6lld   %-14s %6lld\n", i < rec.n ? rec.cmd[i].name : "",
+                   i < rec.n ? (long long)(rec.cmd[i].t_ms - rec.cmd[0].t_ms) : 0LL, i < run.n ? run.cmd[i].name : "",
+                   i < run.n ? (long long)(run.cmd[i].t_ms - run.cmd[0].t_ms) : 0LL);
+    }
+    TEST_ASSERT_EQUAL_INT(rec.n, run.n);
+    for (int i = 0; i < rec.n; i++) TEST_ASSERT_EQUAL_STRING(rec.cmd[i].name, run.cmd[i].name);
+    TEST_ASSERT_GREATER_OR_EQUAL(2, s_audio.files);   // menú y 9.wav, como en la original
+}
+
+// Cada comando sale a su tiempo: medido desde el primer TX, como ancla la reproducción
+static void test_replay_timing(void)
+{
+    TEST_ASSERT_GREATER_THAN(0, run.n);
+    double sum = 0;
+    dev_max_ms = 0;
+    for (int i = 0; i < run.n; i++) {
+        double d = (double)llabs((run.cmd[i].t_ms - run.cmd[0].t_ms) - (rec.cmd[i].t_ms - rec.cmd[0].t_ms));
+        sum += d;
+        if (d > dev_max_ms) dev_max_ms = d;
+    }
+    dev_mean_ms = sum / run.n;
+    printf("\nReproducción de %d comandos / %d registros RX en %.1f s\n", run.n, rec.rx,
+           (rec.cmd[rec.n - 1].t_ms - rec.cmd[0].t_ms) / 1000.0);
+    printf("  desvío de cada comando frente a la original   media %.1f ms, máx %.1f ms\n\n", dev_mean_ms, dev_max_ms);
+    TEST_ASSERT_LESS_THAN(50, dev_max_ms);
+}
+
+int main(void)
+{
+    (void)dtmf_files;                              // como en main.c
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    close(mkstemp(rec_path));
+    close(mkstemp(run_path));
+    config_init();
+    host_prompts_install(PROMPTS, sizeof PROMPTS / sizeof PROMPTS[0]);
+
+    // Sin hilos todavía: el hijo graba y el padre arranca limpio
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) _exit(record_session());
+    int status = -1;
+    waitpid(pid, &status, 0);
+
+    record_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_session_recorded);
+    RUN_TEST(test_replay_drives_firmware);
+    RUN_TEST(test_replay_timing);
+    unlink(rec_path);
+    unlink(run_path);
+    return UNITY_END();
+}
@@ -0,0 +1,324 @@
+/*
+ * power.h sobre el reloj virtual: cuándo despierta el enlace con el
+ * SIM800 (DTR bajo y el bloqueo NO_LIGHT_SLEEP) y cuándo vuelve a dormir,
+ * con RI, las líneas que recibe modem_task y los comandos que manda
+ * at_task; y qué pines de alerta despiertan al chip sin tocar el enlace.
+ * Al final, una hora de tráfico típico (URC sueltos, SMS entrantes con su
+ * respuesta, una llamada entrante con menú y una alarma con SMS y llamada)
+ * con los despertares del enlace por hora y el tiempo despierto.
+ */
+#define HOST_VIRTUAL_CLOCK
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "power.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+// Lo que modem.h y sms.h esperan de main.c
+void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) { (void)vib1; (void)vib2; (void)lamp; (void)ms; }
+void set_relay_polarity(int active_high) { (void)active_high; }
+int  get_relay_polarity(void) { return 0; }
+void alert_test_start(uint32_t ms) { (void)ms; }
+
+// Los pines de alerta de main.c
+#define PIN_SENSOR   GPIO_NUM_2    // activo alto
+#define PIN_ARM      GPIO_NUM_3    // lector puesto = bajo
+#define PIN_BTN      GPIO_NUM_4    // activo bajo
+
+#define RI_URC_MS    120           // lo que baja RI por un URC o un SMS (SIM800, AT+CFGRI=1)
+
+static at_cmd_t in_flight;
+
+/* ───────────────────────── el módem, a mano ───────────────────────── */
+
+static int64_t now_us(void) { return esp_timer_get_time(); }
+static void run_ms(uint32_t ms) { host_timers_run_for_ms(ms); }
+static void run_until_s(double s) { host_timers_run_until((int64_t)(s * 1e6)); }
+
+// Una línea del módem, como la despacha modem_task
+static void rx_line(void) { at_activity_hook(false); }
+
+// RI baja, llega el texto a los pocos ms y RI vuelve a subir
+static void ev_urc(int lines)
+{
+    host_gpio_input(MODEM_RI_PIN, 0);
+    run_ms(5);
+    for (int i = 0; i < lines; i++) rx_line();
+    run_ms(RI_URC_MS - 5);
+    host_gpio_input(MODEM_RI_PIN, 1);
+}
+
+// Un comando de at_task: despierta al módem si hace falta, ms en curso y sus líneas de respuesta
+static void ev_cmd(uint32_t ms, int lines)
+{
+    at.cur = &in_flight;                       // at_idle() falso mientras tanto
+    at_activity_hook(true);
+    run_ms(ms);
+    for (int i = 0; i < lines; i++) rx_line();
+    at.cur = NULL;
+}
+
+static bool link_awake(void)
+{
+    return s_power.awake && gpio_get_level(MODEM_DTR_PIN) == 0 && host_pm()->no_sleep == 1;
+}
+
+static bool link_asleep(void)
+{
+    return !s_power.awake && gpio_get_level(MODEM_DTR_PIN) == 1 && host_pm()->no_sleep == 0 &&
+           host_gpio_intr()[MODEM_RI_PIN];
+}
+
+// Tiempo despierto hasta ahora, contando el tramo en curso
+static int64_t awake_us(void)
+{
+    return s_power.stats.awake_us + (s_power.awake ? now_us() - s_power.t_wake_us : 0);
+}
+
+// El enlace duerme del todo: sin tráfico pendiente, más que el plazo de inactividad
+static void settle(void)
+{
+    run_ms(2 * POWER_MODEM_IDLE_MS);
+    TEST_ASSERT_TRUE(link_asleep());
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+static void test_boot_then_sleeps(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, power_init());
+    power_uart_wake_init();
+    TEST_ASSERT_TRUE(host_pm()->configured);
+    TEST_ASSERT_TRUE(host_pm()->cfg.light_sleep_enable);
+    TEST_ASSERT_TRUE(host_sleep()->gpio);
+    TEST_ASSERT_EQUAL(MODEM_UART, host_sleep()->uart);
+    TEST_ASSERT_EQUAL(GPIO_INTR_LOW_LEVEL, host_gpio_pins()[MODEM_RI_PIN].wakeup);
+    TEST_ASSERT_EQUAL(1, gpio_get_level(MODEM_RI_PIN));                 // pull-up: RI en reposo
+    TEST_ASSERT_TRUE(link_awake());                                     // DTR bajo hasta el primer silencio
+
+    run_ms(POWER_MODEM_IDLE_MS - 10);
+    TEST_ASSERT_TRUE(link_awake());
+    run_ms(20);
+    TEST_ASSERT_TRUE(link_asleep());
+    TEST_ASSERT_EQUAL_UINT32(0, s_power.stats.modem_wakeups);
+    TEST_ASSERT_EQUAL(POWER_MODEM_IDLE_MS * 1000, (int)s_power.stats.awake_us);
+}
+
+// Cada línea alarga el plazo; el primer comando tras dormir espera a que el módem atienda
+static void test_traffic_wakes_and_extends(void)
+{
+    rx_line();
+    TEST_ASSERT_TRUE(link_awake());
+    TEST_ASSERT_EQUAL_UINT32(1, s_power.stats.modem_wakeups);
+    run_ms(POWER_MODEM_IDLE_MS - 100);
+    rx_line();
+    run_ms(POWER_MODEM_IDLE_MS - 100);
+    TEST_ASSERT_TRUE(link_awake());
+    settle();
+    TEST_ASSERT_EQUAL_UINT32(1, s_power.stats.modem_wakeups);
+
+    int64_t t0 = now_us();
+    at_activity_hook(true);
+    TEST_ASSERT_EQUAL(POWER_DTR_WAKE_MS * 1000, (int)(now_us() - t0));
+    t0 = now_us();
+    at_activity_hook(true);                                             // ya despierto: no espera
+    TEST_ASSERT_EQUAL(0, (int)(now_us() - t0));
+    TEST_ASSERT_EQUAL_UINT32(2, s_power.stats.modem_wakeups);
+    settle();
+}
+
+// Un comando largo (AT+CMGS) y una llamada sostienen el enlace aunque no llegue nada
+static void test_busy_at_and_call_hold_link(void)
+{
+    at.cur = &in_flight;
+    at_activity_hook(true);
+    run_ms(5 * POWER_MODEM_IDLE_MS);
+    TEST_ASSERT_TRUE(link_awake());
+    at.cur = NULL;
+    run_ms(POWER_MODEM_IDLE_MS + 10);
+    TEST_ASSERT_TRUE(link_asleep());
+
+    ev_cmd(200, 1);                                                     // ATD contestado
+    call_active = true;
+    run_ms(30000);
+    TEST_ASSERT_TRUE(link_awake());
+    call_active = false;
+    settle();
+}
+
+/*
+ * RI despierta el enlace desde la ISR. Mientras siga bajo (una llamada
+ * sonando) la interrupción queda callada: el enlace duerme entre RING y lo
+ * despierta cada línea, pero RI no dispara en bucle.
+ */
+static void test_ri_wakes_link(void)
+{
+    uint32_t w0 = s_power.stats.modem_wakeups, ri0 = s_power.stats.ri_wakeups;
+    TEST_ASSERT_TRUE(host_gpio_input(MODEM_RI_PIN, 0));
+    TEST_ASSERT_TRUE(link_awake());
+    TEST_ASSERT_FALSE(host_gpio_intr()[MODEM_RI_PIN]);
+    TEST_ASSERT_EQUAL_UINT32(w0 + 1, s_power.stats.modem_wakeups);
+    TEST_ASSERT_EQUAL_UINT32(ri0 + 1, s_power.stats.ri_wakeups);
+
+    run_ms(2 * POWER_MODEM_IDLE_MS);
+    TEST_ASSERT_FALSE(s_power.awake);
+    TEST_ASSERT_FALSE(host_gpio_intr()[MODEM_RI_PIN]);                  // RI sigue bajo
+    rx_line();                                                          // RING
+    TEST_ASSERT_TRUE(link_awake());
+    run_ms(4000);
+    TEST_ASSERT_FALSE(host_gpio_intr()[MODEM_RI_PIN]);
+    TEST_ASSERT_EQUAL_UINT32(ri0 + 1, s_power.stats.ri_wakeups);
+    host_gpio_input(MODEM_RI_PIN, 1);
+    settle();                                                           // y vuelve a avisar
+    TEST_ASSERT_EQUAL_UINT32(w0 + 2, s_power.stats.modem_wakeups);
+
+    // Un URC con el enlace dormido: un despertar, no uno por RI y otro por la línea
+    ev_urc(1);
+    TEST_ASSERT_EQUAL_UINT32(w0 + 3, s_power.stats.modem_wakeups);
+    settle();
+}
+
+// Los pines de alerta despiertan al chip por su nivel activo, pero no al módem
+static void test_alert_pins_wake_chip_only(void)
+{
+    uint32_t w0 = s_power.stats.modem_wakeups;
+    power_wake_on_level(PIN_BTN, false);
+    power_wake_on_level(PIN_SENSOR, true);
+    power_wake_on_level(PIN_ARM, true);                                 // lector puesto: despierta al quitarlo
+
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_SENSOR, 1));
+    TEST_ASSERT_FALSE(host_sleep_ext1_wakes(PIN_SENSOR, 0));
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_BTN, 0));
+    TEST_ASSERT_FALSE(host_sleep_ext1_wakes(PIN_BTN, 1));
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_ARM, 1));
+
+    power_wake_on_level(PIN_ARM, false);                                // quitado: despierta al ponerlo
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_ARM, 0));
+    TEST_ASSERT_FALSE(host_sleep_ext1_wakes(PIN_ARM, 1));
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_SENSOR, 1));            // los demás siguen igual
+    power_wake_on_level(PIN_ARM, true);
+
+    run_ms(10000);
+    TEST_ASSERT_TRUE(link_asleep());
+    TEST_ASSERT_EQUAL_UINT32(w0, s_power.stats.modem_wakeups);
+}
+
+/* ─────────────────────────── una hora ─────────────────────────── */
+
+static uint32_t rnd_s = 2025;
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+    rnd_s ^= rnd_s << 13; rnd_s ^= rnd_s >> 17; rnd_s ^= rnd_s << 5;
+    return lo + rnd_s % (hi - lo + 1);
+}
+
+#define HOUR_S        3600.0
+#define URC_PER_H     12           // +CIEV, *PSUTTZ, +CREG... de la red
+#define SMS_PER_H     4            // órdenes por SMS, cada una con su respuesta
+#define WAKEUPS_MAX   30           // por hora
+#define AWAKE_MAX_S   120          // por hora, el 3,3 %
+
+// +CMTI, AT+CMGL tras dejar llegar la ráfaga, la respuesta por AT+CMGS y el borrado
+static void ev_sms(void)
+{
+    ev_urc(1);
+    run_ms(SMS_DRAIN_SETTLE_MS);
+    ev_cmd(400, 3);
+    ev_cmd(3000, 2);
+    ev_cmd(300, 1);
+}
+
+// Llamada entrante: RI bajo mientras suena (el enlace duerme entre RING), ATA, menú con dos teclas y cuelga el otro
+static void ev_call(void)
+{
+    host_gpio_input(MODEM_RI_PIN, 0);
+    for (int ring = 0; ring < 2; ring++) {
+        rx_line(); rx_line();                                           // RING y +CLIP
+        run_ms(3000);
+    }
+    ev_cmd(200, 1);
+    host_gpio_input(MODEM_RI_PIN, 1);
+    call_active = true;
+    for (int k = 0; k < 2; k++) {
+        run_ms(8000);
+        rx_line();                                                      // +DTMF
+    }
+    run_ms(10000);
+    rx_line();                                                          // NO CARRIER
+    call_active = false;
+}
+
+// Golpes del sensor (despiertan al chip), SMS al primer número, llamada y botón para cancelar
+static void ev_alarm(void)
+{
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_SENSOR, 1));
+    run_ms(3000);                                                       // ráfagas hasta decidir
+    ev_cmd(3000, 2);
+    ev_cmd(12000, 1);                                                   // ATD hasta que descuelgan
+    call_active = true;
+    run_ms(20000);                                                      // alert.wav en bucle
+    ev_cmd(100, 1);                                                     // ATH al pulsar el botón
+    call_active = false;
+    TEST_ASSERT_TRUE(host_sleep_ext1_wakes(PIN_BTN, 0));
+}
+
+static void test_bench_hour(void)
+{
+    settle();
+    double t0 = now_us() / 1e6;
+    power_stats_t s0 = s_power.stats;
+    int64_t awake0 = awake_us(), no_sleep0 = host_pm()->no_sleep_us;
+    uint32_t timers0 = host_timers.fired;
+
+    // Cada evento en su hueco de la hora, en un instante al azar dentro de él
+    for (int slot = 0; slot < 60; slot++) {
+        run_until_s(t0 + slot * 60 + rnd(0, 40));
+        if (slot % (60 / URC_PER_H) == 1) ev_urc(1);
+        else if (slot % (60 / SMS_PER_H) == 7) ev_sms();
+        else if (slot == 24) ev_call();
+        else if (slot == 43) ev_alarm();
+    }
+    run_until_s(t0 + HOUR_S);
+    TEST_ASSERT_TRUE(link_asleep());
+
+    uint32_t wakeups = s_power.stats.modem_wakeups - s0.modem_wakeups;
+    uint32_t ri = s_power.stats.ri_wakeups - s0.ri_wakeups;
+    double awake_s = (awake_us() - awake0) / 1e6;
+    double no_sleep_s = (host_pm()->no_sleep_us - no_sleep0) / 1e6;
+
+    printf("\nUna hora de tráfico: %d URC, %d SMS con respuesta, 1 llamada entrante, 1 alarma\n",
+           URC_PER_H, SMS_PER_H);
+    printf("  despertares del enlace  %4u/h (%u por RI)   máx %d\n", (unsigned)wakeups, (unsigned)ri, WAKEUPS_MAX);
+    printf("  enlace despierto        %6.1f s/h (%.2f %%)   máx %d s\n", awake_s, awake_s * 100 / HOUR_S,
+           AWAKE_MAX_S);
+    printf("  sin light sleep         %6.1f s/h\n", no_sleep_s);
+    printf("  temporizador de reposo  %4u disparos\n\n", (unsigned)(host_timers.fired - timers0));
+
+    // Al menos un despertar por ráfaga de tráfico, y no más de lo que pide
+    TEST_ASSERT_GREATER_OR_EQUAL(URC_PER_H + SMS_PER_H + 2, wakeups);
+    TEST_ASSERT_LESS_OR_EQUAL(WAKEUPS_MAX, wakeups);
+    TEST_ASSERT_LESS_OR_EQUAL(AWAKE_MAX_S, (int)awake_s);
+    TEST_ASSERT_EQUAL(0, (int)(awake_s * 1000 - no_sleep_s * 1000));   // el bloqueo va con el enlace
+}
+
+int main(void)
+{
+    (void)dtmf_files;                              // como en main.c
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    at.work = xSemaphoreCreateCounting(2 * AT_QUEUE_LEN, 0);           // at_idle() sin arrancar at_task
+    gpio_set_level(MODEM_RI_PIN, 1);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_then_sleeps);
+    RUN_TEST(test_traffic_wakes_and_extends);
+    RUN_TEST(test_busy_at_and_call_hold_link);
+    RUN_TEST(test_ri_wakes_link);
+    RUN_TEST(test_alert_pins_wake_chip_only);
+    RUN_TEST(test_bench_hour);
+    return UNITY_END();
+}
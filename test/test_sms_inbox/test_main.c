@@ -0,0 +1,219 @@
+/*
+ * Vaciado de la bandeja de entrada (sms.h) contra el SIM800 simulado con
+ * la memoria llena: un AT+CMGL por pasada, los que no caben leídos uno a
+ * uno y un AT+CMGDA al final. Ningún SMS puede perderse, tampoco cuando
+ * hay más de los que caben en la pasada. Al final, SMS/s frente al
+ * read_sms() de antes (un índice por +CMTI, con sus esperas fijas).
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "host_modem.h"
+#include "sms.h"
+
+const uart_port_t MODEM_UART = UART_NUM_1;
+
+// Lo que sms.h espera de main.c
+void relays_force_for_ms(bool vib1, bool vib2, bool lamp, uint32_t ms) { (void)vib1; (void)vib2; (void)lamp; (void)ms; }
+void set_relay_polarity(int active_high) { (void)active_high; }
+int  get_relay_polarity(void) { return 0; }
+void alert_test_start(uint32_t ms) { (void)ms; }
+
+static sim800_t sim;
+
+void setUp(void) { sim800_script_clear(&sim); }
+void tearDown(void) {}
+
+static void on_cmti(const char *line, const char *body)
+{
+    (void)line;
+    (void)body;
+    sms_inbox_request();
+}
+
+// SMS de una parte de from con text; con cmti avisa como con AT+CNMI=2,1
+static int put_sms(const char *from, const char *text, bool cmti)
+{
+    char pdu[PDU_HEX_MAX];
+    TEST_ASSERT_EQUAL_INT(1, sim_deliver_pdu(from, text, 0, 0, pdu, sizeof pdu));
+    int idx = cmti ? sim800_receive_sms(&sim, pdu) : sim800_store_sms(&sim, pdu);
+    TEST_ASSERT_GREATER_THAN(0, idx);
+    return idx;
+}
+
+// Espera a que la memoria del módem quede vacía y la bandeja de salida también
+static bool wait_drained(int sent, uint32_t timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (sim.n_stored > 0 || s_drain_queued || outbox.busy > 0 || sim.n_sent < sent) {
+        if (esp_timer_get_time() > deadline) return false;
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+/* ───────────────────── lo de antes, para comparar ───────────────────── */
+
+static void legacy_at_send_sms(const char *cmd)
+{
+    uart_write_bytes(MODEM_UART, cmd, strlen(cmd));
+    uart_write_bytes(MODEM_UART, "\r", 1);
+    vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+// El read_sms() de antes sin el análisis del texto: solo sus esperas
+static bool legacy_read_sms(int idx)
+{
+    char cmd[32];
+    legacy_at_send_sms("AT+CMGF=1");
+    legacy_at_send_sms("AT+CPMS=\"ME\",\"ME\",\"ME\"");
+    snprintf(cmd, sizeof cmd, "AT+CMGR=%d", idx);
+    legacy_at_send_sms(cmd);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    static char buf[UART_BUF_LEN * 4];
+    int pos = 0, len;
+    while ((len = uart_read_bytes(MODEM_UART, (uint8_t *)buf + pos, sizeof buf - pos - 1,
+                                  pdMS_TO_TICKS(200))) > 0) {
+        pos += len;
+    }
+    buf[pos] = '\0';
+    snprintf(cmd, sizeof cmd, "AT+CMGD=%d", idx);
+    legacy_at_send_sms(cmd);
+    return strstr(buf, "+CMGR:") != NULL;
+}
+
+#define LEGACY_N 4
+
+static double legacy_rate;
+
+// Antes de arrancar el motor: el lector de antes es el único en el UART
+static void test_legacy_baseline(void)
+{
+    int idx[LEGACY_N];
+    for (int i = 0; i < LEGACY_N; i++) idx[i] = put_sms("+34611000000", "hola", false);
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < LEGACY_N; i++) TEST_ASSERT_TRUE(legacy_read_sms(idx[i]));
+    legacy_rate = LEGACY_N * 1e6 / (esp_timer_get_time() - t0);
+    TEST_ASSERT_EQUAL_INT(0, sim.n_stored);
+    host_sleep_us(20000);
+}
+
+/* ─────────────────────────── vaciado ─────────────────────────── */
+
+static void test_single_cmti_answered(void)
+{
+    int sent0 = sim.n_sent;
+    put_sms(NUM1, "0000 9", true);
+    TEST_ASSERT_TRUE(wait_drained(sent0 + 1, 5000));
+    TEST_ASSERT_EQUAL_STRING(NUM1, sim.sent[sent0].to);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(sim.sent[sent0].text, "Tiempo activo", 13));
+}
+
+static void test_unauthorized_and_bad_key_deleted_silently(void)
+{
+    int sent0 = sim.n_sent;
+    put_sms("+34699999999", "0000 9", false);
+    put_sms(NUM2, "1234 9", true);
+    TEST_ASSERT_TRUE(wait_drained(sent0, 5000));
+    host_sleep_us(100000);
+    TEST_ASSERT_EQUAL_INT(sent0, sim.n_sent);
+}
+
+// Un comando largo en dos partes se procesa una vez, ya reconstruido
+static void test_concatenated_parts_joined(void)
+{
+    char text[200], pdu[PDU_HEX_MAX];
+    memset(text, ' ', sizeof text - 1);
+    memcpy(text, "0000 9", 6);
+    text[sizeof text - 1] = '\0';
+    int sent0 = sim.n_sent;
+    for (int i = 1; i >= 0; i--) {                  // en desorden, como a veces llegan
+        TEST_ASSERT_EQUAL_INT(2, sim_deliver_pdu(NUM2, text, 77, i, pdu, sizeof pdu));
+        TEST_ASSERT_GREATER_THAN(0, sim800_receive_sms(&sim, pdu));
+    }
+    TEST_ASSERT_TRUE(wait_drained(sent0 + 1, 5000));
+    host_sleep_us(100000);
+    TEST_ASSERT_EQUAL_INT(sent0 + 1, sim.n_sent);
+    TEST_ASSERT_EQUAL_STRING(NUM2, sim.sent[sent0].to);
+}
+
+/*
+ * Ráfaga de n SMS guardados (con el módem apagado, p.ej.) y unos pocos
+ * +CMTI al final. Uno de cada AUTH_EVERY es de NUM1 y pide el estado: su
+ * respuesta demuestra que se leyó. Devuelve SMS/s.
+ */
+#define AUTH_EVERY 40
+
+static double burst(int n)
+{
+    int sent0 = sim.n_sent, auth = 0;
+    uint32_t cmgr0 = sim.cmgr, cmgl0 = sim.cmgl;
+    char from[PDU_ADDR_MAX], text[32];
+    for (int i = 1; i <= n; i++) {
+        bool mine = i % AUTH_EVERY == 0;
+        snprintf(from, sizeof from, "+3461100%04d", i);
+        snprintf(text, sizeof text, mine ? "0000 9" : "hola %d", i);
+        auth += mine;
+        put_sms(mine ? NUM1 : from, text, i > n - 5);
+    }
+    int64_t t0 = esp_timer_get_time();
+    TEST_ASSERT_TRUE_MESSAGE(wait_drained(sent0 + auth, 60000), "la bandeja no se vació");
+    double rate = n * 1e6 / (esp_timer_get_time() - t0);
+    host_sleep_us(100000);
+
+    // Los +CMTI de la ráfaga se agrupan en un solo AT+CMGL
+    TEST_ASSERT_EQUAL_UINT32(cmgl0 + 1, sim.cmgl);
+    // Lo que no cupo en la pasada se lee por índice, todo
+    int extra = n > SMS_DRAIN_MAX ? n - SMS_DRAIN_MAX : 0;
+    TEST_ASSERT_EQUAL_UINT32(cmgr0 + extra, sim.cmgr);
+    TEST_ASSERT_EQUAL_INT(sent0 + auth, sim.n_sent);
+    for (int i = sent0; i < sim.n_sent; i++) TEST_ASSERT_EQUAL_STRING(NUM1, sim.sent[i].to);
+    return rate;
+}
+
+static double rate_fit, rate_over;
+
+static void test_burst_that_fits_one_pass(void)
+{
+    rate_fit = burst(SMS_DRAIN_MAX - 4);
+}
+
+// Antes se perdían en silencio los que pasaban de 2 × SMS_DRAIN_MAX
+static void test_burst_beyond_pass_loses_nothing(void)
+{
+    rate_over = burst(SIM_STORE_MAX - 10);
+}
+
+static void test_bench_drain_rate(void)
+{
+    printf("\nSMS/s vaciando la memoria del módem a 115200 baudios\n");
+    printf("  antes (read_sms por índice)      %6.2f\n", legacy_rate);
+    printf("  ahora, %3d SMS (una pasada)      %6.2f\n", SMS_DRAIN_MAX - 4, rate_fit);
+    printf("  ahora, %3d SMS (pasada + CMGR)   %6.2f\n\n", SIM_STORE_MAX - 10, rate_over);
+
+    TEST_ASSERT_GREATER_THAN(1800, 1000 / legacy_rate);   // 2 s fijos por SMS
+    TEST_ASSERT_GREATER_THAN(legacy_rate * 20, rate_fit);
+    TEST_ASSERT_GREATER_THAN(legacy_rate * 10, rate_over);
+}
+
+int main(void)
+{
+    esp_log_level_set(SMS_TAG, ESP_LOG_ERROR);     // un aviso por remitente no autorizado
+    config_init();
+    host_modem_link(&sim);
+    UNITY_BEGIN();
+    RUN_TEST(test_legacy_baseline);
+    host_modem_start(&sim);
+    urc_register(URC_CMTI, on_cmti);
+    TEST_ASSERT_EQUAL(AT_RES_OK, at_cmd("ATE0", AT_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ESP_OK, sms_outbox_start());
+    RUN_TEST(test_single_cmti_answered);
+    RUN_TEST(test_unauthorized_and_bad_key_deleted_silently);
+    RUN_TEST(test_concatenated_parts_joined);
+    RUN_TEST(test_burst_that_fits_one_pass);
+    RUN_TEST(test_burst_beyond_pass_loses_nothing);
+    RUN_TEST(test_bench_drain_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,323 @@
+/*
+ * Codificador/decodificador PDU (sms_pdu.h): PDU conocidas, elección de
+ * alfabeto, reparto en partes con su cabecera, tabla de extensión en el
+ * borde de una parte, remitentes alfanuméricos, referencias de 16 bits y
+ * PDU malformadas. Al final, coste de codificar y decodificar frente al
+ * tiempo que la parte tarda en cruzar el UART.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "sms_pdu.h"
+#include "sim800.h"          // sim_submit_to_deliver(): SUBMIT → DELIVER, como la red
+
+#define TO "+34600111222"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Codifica text, pasa cada parte a DELIVER y la decodifica; devuelve las partes
+static int round_trip(const char *text, uint8_t ref, pdu_msg_t *m, pdu_deliver_t *d)
+{
+    char hex[PDU_HEX_MAX], deliver[PDU_HEX_MAX + 32];
+    int parts = pdu_msg_prepare(m, text, ref);
+    for (int i = 0; i < parts; i++) {
+        int len = pdu_msg_part(m, TO, i, hex, sizeof hex);
+        TEST_ASSERT_GREATER_THAN(0, len);
+        TEST_ASSERT_EQUAL_INT(len * 2 + 2, (int)strlen(hex));    // <len> de AT+CMGS sin el SCA
+        TEST_ASSERT_TRUE(sim_submit_to_deliver(hex, "+34611222333", deliver, sizeof deliver));
+        TEST_ASSERT_TRUE(pdu_decode_deliver(deliver, &d[i]));
+        TEST_ASSERT_EQUAL_STRING("+34611222333", d[i].from);
+    }
+    return parts;
+}
+
+// Las partes decodificadas, juntas
+static void join(const pdu_deliver_t *d, int parts, char *out, size_t len)
+{
+    out[0] = '\0';
+    for (int i = 0; i < parts; i++) strncat(out, d[i].text, len - strlen(out) - 1);
+}
+
+static pdu_msg_t m;
+static pdu_deliver_t d[PDU_MAX_PARTS];
+static char text[PDU_TEXT_MAX * 3 + 1], back[PDU_MAX_PARTS * (PDU_PART_TEXT + 1)];
+
+/* ─────────────────────────── envío ─────────────────────────── */
+
+static void test_gsm7_known_pdu(void)
+{
+    char hex[PDU_HEX_MAX];
+    TEST_ASSERT_EQUAL_INT(1, pdu_msg_prepare(&m, "hellohello", 0));
+    TEST_ASSERT_FALSE(m.ucs2);
+    // SUBMIT, VP relativo; 11 dígitos +34...; DCS 0; 24 h; 10 septetos
+    TEST_ASSERT_EQUAL_INT(23, pdu_msg_part(&m, TO, 0, hex, sizeof hex));
+    TEST_ASSERT_EQUAL_STRING("0011000B914306101122F20000A70AE8329BFD4697D9EC37", hex);
+}
+
+static void test_ucs2_known_pdu(void)
+{
+    char hex[PDU_HEX_MAX];
+    TEST_ASSERT_EQUAL_INT(1, pdu_msg_prepare(&m, "Opción", 0));
+    TEST_ASSERT_TRUE(m.ucs2);
+    // DCS 08; 6 caracteres, 12 octetos big-endian
+    TEST_ASSERT_EQUAL_INT(26, pdu_msg_part(&m, TO, 0, hex, sizeof hex));
+    TEST_ASSERT_EQUAL_STRING("0011000B914306101122F20008A70C004F00700063006900F3006E", hex);
+}
+
+// Los acentos que están en GSM-7 (é, ñ, ü...) no obligan a UCS-2; la ó sí
+static void test_alphabet_choice(void)
+{
+    pdu_msg_prepare(&m, "Ñandú, qué pingüino", 0);
+    TEST_ASSERT_TRUE(m.ucs2);                    // ú no está en GSM-7
+    pdu_msg_prepare(&m, "Ñandu, qué pingüino", 0);
+    TEST_ASSERT_FALSE(m.ucs2);
+    pdu_msg_prepare(&m, "precio 5€ {ok}", 0);
+    TEST_ASSERT_FALSE(m.ucs2);                   // tabla de extensión
+    TEST_ASSERT_EQUAL_INT(1, round_trip("precio 5€ {ok} [a|b] ~^\\", 0, &m, d));
+    TEST_ASSERT_EQUAL_STRING("precio 5€ {ok} [a|b] ~^\\", d[0].text);
+    TEST_ASSERT_EQUAL_INT(1, round_trip("Opción 3: Mostrar alertas", 0, &m, d));
+    TEST_ASSERT_EQUAL_STRING("Opción 3: Mostrar alertas", d[0].text);
+    TEST_ASSERT_TRUE(d[0].ucs2);
+}
+
+static void fill(char *out, char c, int n)
+{
+    memset(out, c, n);
+    out[n] = '\0';
+}
+
+static void test_single_part_limits(void)
+{
+    fill(text, 'a', PDU_GSM7_SINGLE);
+    TEST_ASSERT_EQUAL_INT(1, pdu_msg_prepare(&m, text, 0));
+    fill(text, 'a', PDU_GSM7_SINGLE + 1);
+    TEST_ASSERT_EQUAL_INT(2, pdu_msg_prepare(&m, text, 0));
+
+    // Con escape cuentan dos septetos: 80 llaves llenan un SMS
+    text[0] = '\0';
+    for (int i = 0; i < 80; i++) strcat(text, "{");
+    TEST_ASSERT_EQUAL_INT(1, pdu_msg_prepare(&m, text, 0));
+    strcat(text, "{");
+    TEST_ASSERT_EQUAL_INT(2, pdu_msg_prepare(&m, text, 0));
+
+    text[0] = '\0';
+    for (int i = 0; i < PDU_UCS2_SINGLE; i++) strcat(text, "ó");
+    TEST_ASSERT_EQUAL_INT(1, pdu_msg_prepare(&m, text, 0));
+    strcat(text, "ó");
+    TEST_ASSERT_EQUAL_INT(2, pdu_msg_prepare(&m, text, 0));
+}
+
+static void test_concatenated_gsm7(void)
+{
+    for (int i = 0; i < 400; i++) text[i] = 'a' + i % 26;
+    text[400] = '\0';
+    TEST_ASSERT_EQUAL_INT(3, round_trip(text, 0x5A, &m, d));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT16(0x5A, d[i].ref);
+        TEST_ASSERT_EQUAL_UINT8(3, d[i].total);
+        TEST_ASSERT_EQUAL_UINT8(i + 1, d[i].seq);
+    }
+    TEST_ASSERT_EQUAL_INT(PDU_GSM7_MULTI, (int)strlen(d[0].text));
+    join(d, 3, back, sizeof back);
+    TEST_ASSERT_EQUAL_STRING(text, back);
+}
+
+static void test_concatenated_ucs2(void)
+{
+    text[0] = '\0';
+    for (int i = 0; i < 150; i++) strcat(text, i % 10 == 0 ? "ó" : "x");
+    TEST_ASSERT_EQUAL_INT(3, round_trip(text, 7, &m, d));
+    TEST_ASSERT_TRUE(d[0].ucs2);
+    join(d, 3, back, sizeof back);
+    TEST_ASSERT_EQUAL_STRING(text, back);
+}
+
+// Un escape y su código nunca quedan en partes distintas
+static void test_escape_not_split_across_parts(void)
+{
+    fill(text, 'a', PDU_GSM7_MULTI - 1);
+    strcat(text, "€ y mas texto para que haga falta otra parte");
+    TEST_ASSERT_EQUAL_INT(2, round_trip(text, 1, &m, d));
+    TEST_ASSERT_EQUAL_INT(PDU_GSM7_MULTI - 1, (int)strlen(d[0].text));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(d[1].text, "€", strlen("€")));
+    join(d, 2, back, sizeof back);
+    TEST_ASSERT_EQUAL_STRING(text, back);
+}
+
+// Lo que pasa de PDU_TEXT_MAX caracteres se corta y se avisa; lo que queda
+// cabe siempre en PDU_MAX_PARTS, aun con todo escapes
+static void test_truncated_beyond_text_max(void)
+{
+    fill(text, 'b', PDU_TEXT_MAX + 40);
+    TEST_ASSERT_EQUAL_INT(4, pdu_msg_prepare(&m, text, 0));
+    TEST_ASSERT_TRUE(m.truncated);
+    TEST_ASSERT_EQUAL_INT(PDU_TEXT_MAX, m.n);
+    fill(text, 'b', PDU_TEXT_MAX);
+    pdu_msg_prepare(&m, text, 0);
+    TEST_ASSERT_FALSE(m.truncated);
+
+    text[0] = '\0';
+    for (int i = 0; i < PDU_TEXT_MAX; i++) strcat(text, "{");
+    TEST_ASSERT_EQUAL_INT(7, round_trip(text, 2, &m, d));   // 76 por parte
+    TEST_ASSERT_FALSE(m.truncated);
+    join(d, 7, back, sizeof back);
+    TEST_ASSERT_EQUAL_STRING(text, back);
+}
+
+// El número sin '+' va como nacional (TON 0x81)
+static void test_national_number(void)
+{
+    char hex[PDU_HEX_MAX];
+    pdu_msg_prepare(&m, "a", 0);
+    TEST_ASSERT_GREATER_THAN(0, pdu_msg_part(&m, "600111222", 0, hex, sizeof hex));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(hex, "001100098106101122F2", 20));
+    TEST_ASSERT_EQUAL_INT(-1, pdu_msg_part(&m, TO, 0, hex, 20));   // no cabe
+}
+
+/* ───────────────────────── recepción ───────────────────────── */
+
+// Remitente alfanumérico "Movistar" (TOA D0), texto GSM-7 "hola"
+static void test_decode_alphanumeric_sender(void)
+{
+    pdu_deliver_t x;
+    TEST_ASSERT_TRUE(pdu_decode_deliver("07914306091010F0" "04" "0ED0CDB73D3DA787E5" "0000" "42501001000040"
+                                        "04E8373B0C", &x));
+    TEST_ASSERT_EQUAL_STRING("Movistar", x.from);
+    TEST_ASSERT_EQUAL_STRING("hola", x.text);
+    TEST_ASSERT_EQUAL_UINT8(1, x.total);
+}
+
+// Concatenación con referencia de 16 bits (IEI 08), 8 bits de datos (DCS 04)
+static void test_decode_16bit_ref_and_8bit_data(void)
+{
+    pdu_deliver_t x;
+    TEST_ASSERT_TRUE(pdu_decode_deliver("00440B914316101122F30004425010010000400A"
+                                        "060804BEEF0302" "E96F6B", &x));
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, x.ref);
+    TEST_ASSERT_EQUAL_UINT8(3, x.total);
+    TEST_ASSERT_EQUAL_UINT8(2, x.seq);
+    TEST_ASSERT_EQUAL_STRING("éok", x.text);
+}
+
+static void test_decode_rejects_malformed(void)
+{
+    pdu_deliver_t x;
+    char deliver[PDU_HEX_MAX + 32], hex[PDU_HEX_MAX];
+    TEST_ASSERT_FALSE(pdu_decode_deliver("", &x));
+    TEST_ASSERT_FALSE(pdu_decode_deliver("00", &x));
+    TEST_ASSERT_FALSE(pdu_decode_deliver("0011000B914306101122F20000A7", &x));   // SUBMIT, no DELIVER
+    TEST_ASSERT_FALSE(pdu_decode_deliver("00040B9143", &x));                     // cortada en el remitente
+    TEST_ASSERT_FALSE(pdu_decode_deliver("00040B914316101122F30000ZZ", &x));     // no es hex
+
+    // Cortada a mitad de los datos: se decodifica lo que hay, sin leer de más
+    pdu_msg_prepare(&m, "un texto de prueba bastante largo", 0);
+    pdu_msg_part(&m, TO, 0, hex, sizeof hex);
+    TEST_ASSERT_TRUE(sim_submit_to_deliver(hex, "+34611222333", deliver, sizeof deliver));
+    deliver[strlen(deliver) - 20] = '\0';
+    TEST_ASSERT_TRUE(pdu_decode_deliver(deliver, &x));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(x.text, "un texto de prueba", 18));
+    TEST_ASSERT_LESS_THAN(33, (int)strlen(x.text));
+
+    // Cabecera de concatenación absurda (parte 5 de 2): se toma como suelto
+    TEST_ASSERT_TRUE(pdu_decode_deliver("00440B914316101122F30000425010010000400A"
+                                        "050003010205" "C2F03C", &x));
+    TEST_ASSERT_EQUAL_UINT8(1, x.total);
+    TEST_ASSERT_EQUAL_UINT8(1, x.seq);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+typedef struct {
+    const char *name;
+    int         parts;
+    double      enc_us, dec_us, wire_ms;   // por mensaje
+} bench_t;
+
+#define BENCH_ITERS 20000
+
+static bench_t bench(const char *name, const char *msg)
+{
+    bench_t b = { .name = name };
+    static char hex[PDU_MAX_PARTS][PDU_HEX_MAX], deliver[PDU_MAX_PARTS][PDU_HEX_MAX + 32];
+    volatile int sink = 0;
+    size_t hex_chars = 0;
+
+    double t0 = now_us();
+    for (int it = 0; it < BENCH_ITERS; it++) {
+        b.parts = pdu_msg_prepare(&m, msg, (uint8_t)it);
+        for (int i = 0; i < b.parts; i++) sink += pdu_msg_part(&m, TO, i, hex[i], sizeof hex[i]);
+    }
+    b.enc_us = (now_us() - t0) / BENCH_ITERS;
+
+    for (int i = 0; i < b.parts; i++) {
+        sim_submit_to_deliver(hex[i], "+34611222333", deliver[i], sizeof deliver[i]);
+        hex_chars += strlen(hex[i]) + 12;          // "AT+CMGS=nnn\r" + Ctrl+Z
+    }
+    t0 = now_us();
+    for (int it = 0; it < BENCH_ITERS; it++) {
+        for (int i = 0; i < b.parts; i++) sink += pdu_decode_deliver(deliver[i], &d[i]);
+    }
+    b.dec_us = (now_us() - t0) / BENCH_ITERS;
+    b.wire_ms = hex_chars * 10 * 1000.0 / 115200;
+    (void)sink;
+    return b;
+}
+
+static void test_bench_encode_decode(void)
+{
+    static char menu[PDU_TEXT_MAX];
+    snprintf(menu, sizeof menu, "%s",
+             "Comando 1: Listar comandos.\nComando 2: Cambiar clave.\nComando 3: Mostrar alertas.\n"
+             "Comando 4: Probar llamadas.\nComando 5: Probar SMS.\nComando 6: Cancelar alerta.\n"
+             "Comando 7: Reiniciar dispositivo.\nComando 8: Prueba sistema.\nComando 9: Estado del sistema.");
+    fill(text, 'a', PDU_GSM7_SINGLE);
+    bench_t r[4];
+    r[0] = bench("GSM-7, 160 caracteres", text);
+    r[1] = bench("UCS-2, una parte", "Opción 3: Mostrar alertas. Opción 6: Cancelar alerta.");
+    r[2] = bench("menu de comandos", menu);
+    static char big[PDU_TEXT_MAX + 1];
+    for (int i = 0; i < PDU_TEXT_MAX; i++) big[i] = i % 40 == 39 ? '\n' : 'a' + i % 26;
+    big[PDU_TEXT_MAX] = '\0';
+    r[3] = bench("512 caracteres", big);
+
+    printf("\nPDU por mensaje (media de %d)       partes  codificar  decodificar  en el UART a 115200\n", BENCH_ITERS);
+    for (int i = 0; i < 4; i++) {
+        printf("  %-28s %6d  %7.2f us  %8.2f us  %8.1f ms\n", r[i].name, r[i].parts, r[i].enc_us, r[i].dec_us,
+               r[i].wire_ms);
+    }
+    printf("\n");
+
+    for (int i = 0; i < 4; i++) {
+        // Aun 20 veces más lento en el C6, muy por debajo del tiempo en el cable
+        TEST_ASSERT_LESS_THAN(r[i].wire_ms * 1000 / 20, r[i].enc_us + r[i].dec_us);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gsm7_known_pdu);
+    RUN_TEST(test_ucs2_known_pdu);
+    RUN_TEST(test_alphabet_choice);
+    RUN_TEST(test_single_part_limits);
+    RUN_TEST(test_concatenated_gsm7);
+    RUN_TEST(test_concatenated_ucs2);
+    RUN_TEST(test_escape_not_split_across_parts);
+    RUN_TEST(test_truncated_beyond_text_max);
+    RUN_TEST(test_national_number);
+    RUN_TEST(test_decode_alphanumeric_sender);
+    RUN_TEST(test_decode_16bit_ref_and_8bit_data);
+    RUN_TEST(test_decode_rejects_malformed);
+    RUN_TEST(test_bench_encode_decode);
+    return UNITY_END();
+}
@@ -0,0 +1,199 @@
+/*
+ * Despachador de URC (urc.h): clasificación por prefijo, URC de dos
+ * líneas, entrega en urc_task y coste de urc_lookup() frente a la cadena
+ * de strstr() que había en modem_task.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "freertos/semphr.h"
+#include "urc.h"
+
+void setUp(void) { urc_init(); }
+void tearDown(void) {}
+
+static int lookup(const char *s) { return urc_lookup(s, strlen(s)); }
+
+static void test_every_key_found_with_and_without_params(void)
+{
+    char line[64];
+    for (int id = 0; id < URC_COUNT; id++) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(id, lookup(URC_TABLE[id].key), URC_TABLE[id].key);
+        if (URC_TABLE[id].key[0] != '+') continue;
+        snprintf(line, sizeof line, "%s \"ME\",12", URC_TABLE[id].key);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(id, lookup(line), line);
+    }
+}
+
+static void test_similar_prefixes_not_confused(void)
+{
+    TEST_ASSERT_EQUAL_INT(URC_CMT, lookup("+CMT: \"+34600111222\",\"\",\"24/05/01,10:00:00+08\""));
+    TEST_ASSERT_EQUAL_INT(URC_CMTI, lookup("+CMTI: \"SM\",1"));
+    TEST_ASSERT_EQUAL_INT(URC_CMGS, lookup("+CMGS: 44"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("+CMGR: \"REC UNREAD\",\"+34600111222\""));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("+CLIP2: \"600111222\",129"));
+}
+
+// Los códigos sin parámetros tienen que ser la línea entera
+static void test_bare_codes_match_whole_line(void)
+{
+    TEST_ASSERT_EQUAL_INT(URC_RING, lookup("RING"));
+    TEST_ASSERT_EQUAL_INT(URC_NO_CARRIER, lookup("NO CARRIER"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("RINGING"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("RING "));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("NO"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("OK"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("ERROR"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("UNDER-VOLTAGE WARNNING Y ALGO MAS LARGO"));
+}
+
+// strstr() las habría tomado por URC: el texto está en medio de la línea
+static void test_only_line_start_counts(void)
+{
+    TEST_ASSERT_EQUAL_INT(-1, lookup("ESTADO +DTMF: 5"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup(" +CLIP: \"600111222\",129"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("+CMTI"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("+"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup("+AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA: 1"));
+}
+
+static void test_two_line_urc_queued_with_body(void)
+{
+    urc_item_t it;
+    urc_feed(URC_CMT, "+CMT: \"+34600111222\",\"\",\"24/05/01,10:00:00+08\"", 1234);
+    TEST_ASSERT_FALSE(xQueueReceive(urc.queue, &it, 0));
+    TEST_ASSERT_TRUE(urc_take_body("ESTADO 1234"));
+    TEST_ASSERT_FALSE(urc_take_body("OK"));
+    TEST_ASSERT_TRUE(xQueueReceive(urc.queue, &it, 0));
+    TEST_ASSERT_EQUAL_INT(URC_CMT, it.id);
+    TEST_ASSERT_EQUAL_INT(1234, (int)it.t_us);
+    TEST_ASSERT_EQUAL_STRING("+CMT: \"+34600111222\",\"\",\"24/05/01,10:00:00+08\"", it.text);
+    TEST_ASSERT_EQUAL_STRING("ESTADO 1234", it.text + it.body);
+
+    urc_feed(URC_RING, "RING", 0);
+    TEST_ASSERT_TRUE(xQueueReceive(urc.queue, &it, 0));
+    TEST_ASSERT_EQUAL_INT(0, it.body);
+}
+
+static void test_full_queue_counts_drops(void)
+{
+    uint32_t d0 = urc.dropped;
+    for (int i = 0; i < URC_QUEUE_LEN + 2; i++) urc_feed(URC_RING, "RING", 0);
+    TEST_ASSERT_EQUAL_UINT32(d0 + 2, urc.dropped);
+    xQueueReset(urc.queue);
+}
+
+static SemaphoreHandle_t seen;
+static char seen_line[64], seen_body[64];
+static int seen_calls;
+
+static void on_dtmf(const char *line, const char *body)
+{
+    snprintf(seen_line, sizeof seen_line, "%s", line);
+    snprintf(seen_body, sizeof seen_body, "%s", body ? body : "(null)");
+    xSemaphoreGive(seen);
+}
+
+static void deferred(void)
+{
+    seen_calls++;
+    xSemaphoreGive(seen);
+}
+
+static void test_handlers_run_in_urc_task(void)
+{
+    seen = xSemaphoreCreateBinary();
+    urc_register(URC_DTMF, on_dtmf);
+    xTaskCreate(urc_task, "urc", URC_TASK_STACK, NULL, 5, NULL);
+
+    urc_feed(URC_RING, "RING", 0);   // sin manejador: se ignora
+    urc_feed(URC_DTMF, "+DTMF: 5", 0);
+    TEST_ASSERT_TRUE(xSemaphoreTake(seen, pdMS_TO_TICKS(500)));
+    TEST_ASSERT_EQUAL_STRING("+DTMF: 5", seen_line);
+    TEST_ASSERT_EQUAL_STRING("(null)", seen_body);
+
+    TEST_ASSERT_TRUE(urc_call(deferred));
+    TEST_ASSERT_TRUE(xSemaphoreTake(seen, pdMS_TO_TICKS(500)));
+    TEST_ASSERT_EQUAL_INT(1, seen_calls);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+// Lo que de verdad pasa por modem_task en una sesión: respuestas, eco y URC
+static const char *const CORPUS[] = {
+    "OK", "OK", "OK", "ERROR", "+CSQ: 18,0", "+CREG: 0,1", "+CMGR: \"REC UNREAD\",\"+34600111222\"",
+    "ESTADO 1234", "AT+CMGR=3", "+CMTI: \"SM\",3", "RING", "+CLIP: \"600111222\",129,\"\",0,\"\",0",
+    "+DTMF: 5", "NO CARRIER", "+CMGS: 12", "+CMT: \"+34600111222\",\"\",\"24/05/01,10:00:00+08\"",
+    "Call Ready", "SMS Ready", "+CPIN: READY", "BUSY",
+};
+#define CORPUS_N (int)(sizeof CORPUS / sizeof CORPUS[0])
+
+// La cadena de modem_task antes del despachador: solo los cuatro de entonces
+static int legacy_dispatch4(const char *l)
+{
+    if (strstr(l, "+CMT:"))       return URC_CMT;
+    else if (strstr(l, "+CMTI:")) return URC_CMTI;
+    else if (strstr(l, "+CLIP:")) return URC_CLIP;
+    else if (strstr(l, "+DTMF:")) return URC_DTMF;
+    return -1;
+}
+
+// La misma cadena alargada a todos los URC que se atienden hoy
+static int legacy_dispatch_all(const char *l)
+{
+    for (int id = 0; id < URC_COUNT; id++)
+        if (strstr(l, URC_TABLE[id].key)) return id;
+    return -1;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define BENCH_ROUNDS 50000
+
+static volatile int sink;
+
+static double bench(int (*fn)(const char *))
+{
+    int64_t t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+        for (int i = 0; i < CORPUS_N; i++) sink += fn(CORPUS[i]);
+    return (double)(now_ns() - t0) / ((double)BENCH_ROUNDS * CORPUS_N);
+}
+
+static int hash_dispatch(const char *l) { return urc_lookup(l, strlen(l)); }
+
+static void test_bench_lookup_vs_strstr_chain(void)
+{
+    double old4 = bench(legacy_dispatch4);
+    double oldn = bench(legacy_dispatch_all);
+    double now = bench(hash_dispatch);
+    printf("\nns por línea (%d líneas de sesión típica)\n", CORPUS_N);
+    printf("  strstr, 4 URC (antes)          %6.1f\n", old4);
+    printf("  strstr, %d URC                 %6.1f\n", URC_COUNT, oldn);
+    printf("  urc_lookup, %d URC (ahora)     %6.1f\n\n", URC_COUNT, now);
+
+    // Con todos los URC la cadena recorre la línea una vez por clave
+    TEST_ASSERT_LESS_THAN(oldn / 2, now);
+    TEST_ASSERT_LESS_THAN(old4, now);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_key_found_with_and_without_params);
+    RUN_TEST(test_similar_prefixes_not_confused);
+    RUN_TEST(test_bare_codes_match_whole_line);
+    RUN_TEST(test_only_line_start_counts);
+    RUN_TEST(test_two_line_urc_queued_with_body);
+    RUN_TEST(test_full_queue_counts_drops);
+    RUN_TEST(test_handlers_run_in_urc_task);
+    RUN_TEST(test_bench_lookup_vs_strstr_chain);
+    return UNITY_END();
+}
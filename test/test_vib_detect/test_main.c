@@ -0,0 +1,249 @@
+/*
+ * Detector "N ráfagas en T ms" (vib_detect.h) y, al final, la
+ * comparación con el esquema de antes sobre trazas del SW-420
+ * (host_vib.h): un contador por flanco cuya ventana se reiniciaba desde la
+ * ISR (parar y arrancar el temporizador, dos mensajes al demonio de
+ * temporizadores por flanco) frente al filtro de glitches, la interrupción
+ * muda VIB_DEBOUNCE_MS tras cada ráfaga y el anillo de marcas. Se cuentan
+ * interrupciones, mensajes al demonio y despertares de alert_task, y las
+ * alarmas que da cada uno por tipo de traza.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "config_record.h"
+#include "vib_detect.h"
+#include "host_vib.h"
+
+// Como main.c
+#define VIB_DEBOUNCE_MS   20
+#define VIB_GLITCH_NS     600
+
+#define MS(x)   ((int64_t)(x) * 1000)
+
+static vib_detect_t d;
+
+void setUp(void) { memset(&d, 0, sizeof d); }
+void tearDown(void) {}
+
+static void test_fires_on_nth_burst_inside_window(void)
+{
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(0), 3, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(300), 3, MS(800)));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(600), 3, MS(800)));
+    TEST_ASSERT_EQUAL_UINT32(1, d.detections);
+    TEST_ASSERT_EQUAL_UINT32(3, d.bursts);
+}
+
+// Ráfagas que nunca caben N en la ventana: no dispara por muchas que sean
+static void test_spread_bursts_never_fire(void)
+{
+    for (int i = 0; i < 50; i++) TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(450 * i), 3, MS(800)));
+    TEST_ASSERT_EQUAL_UINT32(0, d.detections);
+}
+
+static void test_window_edge_is_inclusive(void)
+{
+    vib_detect_feed(&d, MS(1000), 3, MS(800));
+    vib_detect_feed(&d, MS(1400), 3, MS(800));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(1800), 3, MS(800)));
+    vib_detect_feed(&d, MS(5000), 3, MS(800));
+    vib_detect_feed(&d, MS(5400), 3, MS(800));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(5800) + 1, 3, MS(800)));
+}
+
+// Tras disparar cuenta de cero: las ráfagas de antes no sirven para otra
+static void test_restarts_after_detection(void)
+{
+    vib_detect_feed(&d, MS(0), 3, MS(800));
+    vib_detect_feed(&d, MS(100), 3, MS(800));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(200), 3, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(300), 3, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(400), 3, MS(800)));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(500), 3, MS(800)));
+}
+
+static void test_reset_forgets_pending_bursts(void)
+{
+    vib_detect_feed(&d, MS(0), 3, MS(800));
+    vib_detect_feed(&d, MS(100), 3, MS(800));
+    vib_detect_reset(&d);
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(200), 3, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(300), 3, MS(800)));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(400), 3, MS(800)));
+}
+
+// need = 1 dispara siempre; need = VIB_RING_LEN usa el anillo entero; más, nunca
+static void test_threshold_limits(void)
+{
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(0), 1, MS(800)));
+    for (int i = 0; i < VIB_RING_LEN - 1; i++) TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(10 * i), VIB_RING_LEN, MS(800)));
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, MS(100), VIB_RING_LEN, MS(800)));
+    for (int i = 0; i < 3 * VIB_RING_LEN; i++) TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(200 + i), VIB_RING_LEN + 1, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(300), 0, MS(800)));
+}
+
+// Con el anillo dado la vuelta sigue mirando la N-ésima anterior
+static void test_ring_wraps_keeping_latest(void)
+{
+    for (int i = 0; i < 3 * VIB_RING_LEN; i++) TEST_ASSERT_FALSE(vib_detect_feed(&d, MS(1000 * i), 3, MS(800)));
+    int64_t t = MS(1000 * 3 * VIB_RING_LEN);
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, t, 3, MS(800)));
+    TEST_ASSERT_FALSE(vib_detect_feed(&d, t + MS(300), 3, MS(800)));  // la tercera anterior es t-1000
+    TEST_ASSERT_TRUE(vib_detect_feed(&d, t + MS(700), 3, MS(800)));   // t, t+300, t+700
+}
+
+/* ──────────────────── antes y ahora sobre trazas ──────────────────── */
+
+typedef struct {
+    uint32_t irqs;         // interrupciones del sensor
+    uint32_t timer_msgs;   // mensajes al demonio de temporizadores
+    uint32_t wakeups;      // despertares de alert_task por el sensor
+    int64_t  alarm_us;     // primera alarma, -1 si ninguna
+} scheme_t;
+
+/*
+ * Las dos se recorren como si el canal siguiera armado toda la traza (la
+ * alarma se atiende en el acto): lo que cuesta vigilar, no solo disparar.
+ *
+ * Antes: cada flanco de subida interrumpe (sin filtro de glitches), suma
+ * uno y reinicia la ventana; al llegar al umbral, alarma. La ventana vence
+ * tras window sin flancos y pone la cuenta a cero.
+ */
+static scheme_t run_old(const hv_trace_t *t, uint32_t need, int64_t window_us)
+{
+    scheme_t s = { .alarm_us = -1 };
+    uint32_t count = 0;
+    int64_t last = -1;
+    for (int i = 0; i < t->n; i++) {
+        int64_t u = t->p[i].t_us;
+        s.irqs++;
+        if (last >= 0 && u - last > window_us) count = 0;   // venció la ventana
+        last = u;
+        s.timer_msgs += 2;                             // xTimerStop + xTimerStart
+        if (++count >= need) {
+            s.timer_msgs++;                            // xTimerStop
+            count = 0;
+            if (s.alarm_us < 0) s.alarm_us = u;
+        }
+    }
+    return s;
+}
+
+/*
+ * Ahora: el filtro del C6 descarta los pulsos de menos de VIB_GLITCH_NS;
+ * el primer flanco interrumpe, la ISR se silencia y alert_task la
+ * reactiva VIB_DEBOUNCE_MS después (un despertar por el evento y otro por
+ * el vencimiento). Cada evento es una ráfaga para vib_detect.
+ */
+static scheme_t run_new(const hv_trace_t *t, uint32_t need, int64_t window_us, vib_detect_t *v, double *feed_ns)
+{
+    scheme_t s = { .alarm_us = -1 };
+    memset(v, 0, sizeof *v);
+    int64_t mute_until = 0;
+    struct timespec a, b;
+    for (int i = 0; i < t->n; i++) {
+        if (t->p[i].w_ns < VIB_GLITCH_NS) continue;
+        int64_t u = t->p[i].t_us;
+        if (u < mute_until) continue;
+        s.irqs++;
+        s.wakeups += 2;
+        mute_until = u + MS(VIB_DEBOUNCE_MS);
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        bool hit = vib_detect_feed(v, u, need, window_us);
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        *feed_ns += (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+        if (hit && s.alarm_us < 0) s.alarm_us = u;
+    }
+    return s;
+}
+
+#define SEEDS 60
+
+typedef struct {
+    int      alarms_old, alarms_new;
+    uint64_t irqs_old, irqs_new, msgs_old, wake_new, edges;
+    int64_t  lat_old_us, lat_new_us;     // suma, solo trazas con aviso detectado
+    int      lat_n_old, lat_n_new;
+} kind_stats_t;
+
+static kind_stats_t ks[HV_KINDS];
+static hv_trace_t tr;
+
+static void test_bench_edge_traces_old_vs_new(void)
+{
+    const uint32_t need = CFG_DEF_VIB_THRESHOLD;
+    const int64_t window = MS(CFG_DEF_VIB_WINDOW_MS);
+    vib_detect_t v;
+    double feed_ns = 0;
+    uint64_t feeds = 0;
+
+    for (int k = 0; k < HV_KINDS; k++) {
+        kind_stats_t *st = &ks[k];
+        for (uint32_t seed = 1; seed <= SEEDS; seed++) {
+            hv_make(&tr, (hv_kind_t)k, seed);
+            scheme_t o = run_old(&tr, need, window);
+            scheme_t n = run_new(&tr, need, window, &v, &feed_ns);
+            feeds += v.bursts;
+            st->edges += tr.n;
+            st->irqs_old += o.irqs;
+            st->irqs_new += n.irqs;
+            st->msgs_old += o.timer_msgs;
+            st->wake_new += n.wakeups;
+            st->alarms_old += o.alarm_us >= 0;
+            st->alarms_new += n.alarm_us >= 0;
+            if (tr.alarm && o.alarm_us >= tr.alarm_us) { st->lat_old_us += o.alarm_us - tr.alarm_us; st->lat_n_old++; }
+            if (tr.alarm && n.alarm_us >= tr.alarm_us) { st->lat_new_us += n.alarm_us - tr.alarm_us; st->lat_n_new++; }
+        }
+    }
+
+    printf("\n%d trazas de 10 s por tipo, %u ráfagas en %u ms\n", SEEDS, (unsigned)need, (unsigned)(window / 1000));
+    printf("                    alarmas       interrupciones/traza   demonio/traza   despertares/traza   detección\n");
+    printf("  tipo              antes ahora     antes     ahora        antes            ahora        antes  ahora\n");
+    for (int k = 0; k < HV_KINDS; k++) {
+        kind_stats_t *st = &ks[k];
+        char lat[48] = "";
+        if (st->lat_n_old || st->lat_n_new) {
+            snprintf(lat, sizeof lat, "%4lld  %4lld ms", (long long)(st->lat_n_old ? st->lat_old_us / st->lat_n_old / 1000 : -1),
+                     (long long)(st->lat_n_new ? st->lat_new_us / st->lat_n_new / 1000 : -1));
+        }
+        printf("  %-16s  %3d   %3d     %6llu    %6llu       %7llu          %6llu        %s\n", HV_KIND_NAME[k],
+               st->alarms_old, st->alarms_new, (unsigned long long)(st->irqs_old / SEEDS),
+               (unsigned long long)(st->irqs_new / SEEDS), (unsigned long long)(st->msgs_old / SEEDS),
+               (unsigned long long)(st->wake_new / SEEDS), lat);
+    }
+    printf("  vib_detect_feed(): %.0f ns por ráfaga en el PC; el demonio de temporizadores ya no recibe nada\n\n",
+           feeds ? feed_ns / feeds : 0);
+
+    uint64_t irqs_old = 0, irqs_new = 0;
+    for (int k = 0; k < HV_KINDS; k++) {
+        irqs_old += ks[k].irqs_old;
+        irqs_new += ks[k].irqs_new;
+    }
+    TEST_ASSERT_LESS_THAN(irqs_old / 10, irqs_new);                       // una interrupción por ráfaga
+    // Los avisos se siguen detectando todos, en menos de un periodo
+    TEST_ASSERT_EQUAL_INT(SEEDS, ks[HV_ALERT_FAST].alarms_new);
+    TEST_ASSERT_EQUAL_INT(SEEDS, ks[HV_ALERT_SLOW].alarms_new);
+    TEST_ASSERT_LESS_THAN(MS(500), ks[HV_ALERT_SLOW].lat_new_us / SEEDS);
+    // Un golpe ya no basta; interferencia y camión ya no alarman
+    TEST_ASSERT_LESS_THAN(ks[HV_KNOCK].alarms_old / 2, ks[HV_KNOCK].alarms_new);
+    TEST_ASSERT_EQUAL_INT(0, ks[HV_EMI].alarms_new);
+    TEST_ASSERT_EQUAL_INT(0, ks[HV_TRUCK].alarms_new);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fires_on_nth_burst_inside_window);
+    RUN_TEST(test_spread_bursts_never_fire);
+    RUN_TEST(test_window_edge_is_inclusive);
+    RUN_TEST(test_restarts_after_detection);
+    RUN_TEST(test_reset_forgets_pending_bursts);
+    RUN_TEST(test_threshold_limits);
+    RUN_TEST(test_ring_wraps_keeping_latest);
+    RUN_TEST(test_bench_edge_traces_old_vs_new);
+    return UNITY_END();
+}
@@ -0,0 +1,281 @@
+/*
+ * Clasificador de patrones (vib_pattern.h) y, al final, la evaluación
+ * sobre trazas etiquetadas del SW-420 (host_vib.h): cada traza pasa por
+ * lo mismo que en main.c con vib_mode = 1 (filtro de glitches, la primera
+ * ráfaga con el lector puesto abre una ventana de 3 s muestreada cada
+ * 5 ms en bins de 20 ms, y vp_classify con los patrones del lector). Se
+ * barre la confianza mínima y se sacan precisión y exhaustividad para
+ * elegir CFG_DEF_VIB_MIN_CONF, frente al modo de ráfagas (3 en 800 ms).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "config_record.h"
+#include "host_util.h"
+#include "host_vib.h"
+#include "vib_detect.h"
+#include "vib_pattern.h"
+
+// Como main.c
+#define VIB_DEBOUNCE_MS         20
+#define VIB_GLITCH_NS           600
+#define VIB_SAMPLE_US           5000
+#define VIB_SAMPLES_PER_BIN     (VP_BIN_MS * 1000 / VIB_SAMPLE_US)
+#define VIB_PATTERN_WINDOW_MS   3000
+#define VIB_PATTERN_BINS        (VIB_PATTERN_WINDOW_MS / VP_BIN_MS)
+
+static const vp_pattern_t PATS[] = {
+    { "lector_alarma", 500,  60  },
+    { "lector_aviso",  1000, 100 },
+};
+#define NPATS  ((int)(sizeof PATS / sizeof PATS[0]))
+
+static vp_window_t w;
+static vp_result_t r;
+
+void setUp(void) { memset(&w, 0, sizeof w); }
+void tearDown(void) {}
+
+// on_bins activos de cada period_bins, con energía e
+static void fill_periodic(vp_window_t *win, int n, int period_bins, int on_bins, int e)
+{
+    win->n = (uint16_t)n;
+    for (int i = 0; i < n; i++) win->bins[i] = (uint8_t)(i % period_bins < on_bins ? e : 0);
+}
+
+static void test_periodic_500ms_matches_first_pattern(void)
+{
+    fill_periodic(&w, VIB_PATTERN_BINS, 25, 10, 4);
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_INT(0, r.best);
+    TEST_ASSERT_EQUAL_UINT16(500, r.period_ms[0]);
+    TEST_ASSERT_GREATER_THAN(200, r.conf[0]);
+    TEST_ASSERT_EQUAL_UINT16(VIB_PATTERN_BINS / 25 * 10, r.active_bins);
+}
+
+static void test_periodic_1000ms_matches_second_pattern(void)
+{
+    fill_periodic(&w, VIB_PATTERN_BINS, 50, 15, 3);
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_INT(1, r.best);
+    TEST_ASSERT_EQUAL_UINT16(1000, r.period_ms[1]);
+    TEST_ASSERT_GREATER_THAN(r.conf[0], r.conf[1]);
+}
+
+// Un golpe: actividad en un solo sitio, nada periódico
+static void test_single_knock_has_no_confidence(void)
+{
+    w.n = VIB_PATTERN_BINS;
+    for (int i = 3; i < 6; i++) w.bins[i] = 4;
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_UINT16(0, r.conf[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, r.conf[1]);
+    TEST_ASSERT_EQUAL_INT(-1, r.best);
+}
+
+static void test_too_few_active_bins_not_evaluated(void)
+{
+    w.n = VIB_PATTERN_BINS;
+    w.bins[0] = w.bins[25] = 4;
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_INT(-1, r.best);
+    TEST_ASSERT_EQUAL_UINT16(2, r.active_bins);
+}
+
+// La ventana debe abarcar dos periodos: 1,5 s no sirve para el de 1000 ms
+static void test_window_shorter_than_two_periods(void)
+{
+    fill_periodic(&w, 75, 50, 15, 3);
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_UINT16(0, r.conf[1]);
+}
+
+// Vibración continua: R(P) y R(P/2) iguales, confianza nula
+static void test_continuous_vibration_is_not_periodic(void)
+{
+    fill_periodic(&w, VIB_PATTERN_BINS, 1, 1, 4);
+    vp_classify(&w, PATS, NPATS, &r);
+    TEST_ASSERT_EQUAL_UINT16(0, r.conf[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, r.conf[1]);
+}
+
+/* ──────────────────── evaluación con trazas ──────────────────── */
+
+#define SEEDS        200
+#define MAX_WINDOWS  8
+
+typedef struct {
+    hv_kind_t kind;
+    bool      alarm;
+    int64_t   alarm_us;
+    int       nwin;
+    uint16_t  conf[MAX_WINDOWS];     // confianza del mejor patrón en cada ventana
+    int64_t   end_us[MAX_WINDOWS];   // cuándo se clasifica
+    int64_t   burst_alarm_us;        // modo ráfagas: cuándo alarma (-1 = no)
+} trace_eval_t;
+
+static trace_eval_t ev[HV_KINDS * SEEDS];
+static hv_trace_t   tr;
+static double       classify_ns;
+static uint64_t     classify_n;
+
+// Sin los pulsos que el filtro de glitches no deja pasar
+static void drop_glitches(hv_trace_t *t)
+{
+    int k = 0;
+    for (int i = 0; i < t->n; i++) if (t->p[i].w_ns >= VIB_GLITCH_NS) t->p[k++] = t->p[i];
+    t->n = k;
+}
+
+// Modo patrón: ventanas de 3 s abiertas por la primera ráfaga tras la anterior
+static void eval_pattern(const hv_trace_t *t, trace_eval_t *e)
+{
+    int i = 0, cur = 0;
+    e->nwin = 0;
+    while (e->nwin < MAX_WINDOWS) {
+        while (i < t->n && e->nwin && t->p[i].t_us < e->end_us[e->nwin - 1]) i++;
+        if (i >= t->n) break;
+        int64_t t0 = t->p[i].t_us;
+        int64_t end = t0 + (int64_t)VIB_PATTERN_BINS * VIB_SAMPLES_PER_BIN * VIB_SAMPLE_US;
+        if (end > HV_TRACE_US) break;                   // la traza se acaba antes que la ventana
+        vp_window_t win = { .n = 0 };
+        int acc = 0, acc_n = 0;
+        cur = 0;
+        for (int64_t u = t0 + VIB_SAMPLE_US; u <= end; u += VIB_SAMPLE_US) {
+            acc += hv_level(t, &cur, u);
+            if (++acc_n < VIB_SAMPLES_PER_BIN) continue;
+            win.bins[win.n++] = (uint8_t)acc;
+            acc = acc_n = 0;
+        }
+        vp_result_t res;
+        int64_t c0 = host_cpu_us();
+        vp_classify(&win, PATS, NPATS, &res);
+        classify_ns += (host_cpu_us() - c0) * 1000.0;
+        classify_n++;
+        e->conf[e->nwin] = res.best < 0 ? 0 : res.conf[res.best];
+        e->end_us[e->nwin++] = end;
+    }
+}
+
+// Modo ráfagas, como test_vib_detect: interrupción muda 20 ms y 3 en 800 ms
+static void eval_bursts(const hv_trace_t *t, trace_eval_t *e)
+{
+    vib_detect_t d;
+    memset(&d, 0, sizeof d);
+    int64_t mute_until = 0;
+    e->burst_alarm_us = -1;
+    for (int i = 0; i < t->n && e->burst_alarm_us < 0; i++) {
+        int64_t u = t->p[i].t_us;
+        if (u < mute_until) continue;
+        mute_until = u + VIB_DEBOUNCE_MS * 1000;
+        if (vib_detect_feed(&d, u, CFG_DEF_VIB_THRESHOLD, CFG_DEF_VIB_WINDOW_MS * 1000)) e->burst_alarm_us = u;
+    }
+}
+
+// Primera ventana que pasa el umbral (-1 si ninguna)
+static int first_hit(const trace_eval_t *e, int min_conf)
+{
+    for (int k = 0; k < e->nwin; k++) if (e->conf[k] >= min_conf) return k;
+    return -1;
+}
+
+typedef struct { int tp, fp, fn, tn; double precision, recall, f1; } pr_t;
+
+static pr_t score(int min_conf, int n)
+{
+    pr_t p = { 0 };
+    for (int i = 0; i < n; i++) {
+        bool hit = first_hit(&ev[i], min_conf) >= 0;
+        if (ev[i].alarm) { if (hit) p.tp++; else p.fn++; }
+        else             { if (hit) p.fp++; else p.tn++; }
+    }
+    p.precision = p.tp + p.fp ? (double)p.tp / (p.tp + p.fp) : 1;
+    p.recall = p.tp + p.fn ? (double)p.tp / (p.tp + p.fn) : 1;
+    p.f1 = p.precision + p.recall > 0 ? 2 * p.precision * p.recall / (p.precision + p.recall) : 0;
+    return p;
+}
+
+static void test_bench_precision_recall(void)
+{
+    int n = 0;
+    for (int k = 0; k < HV_KINDS; k++) {
+        for (int s = 0; s < SEEDS; s++) {
+            hv_make(&tr, (hv_kind_t)k, 1000 + s);
+            drop_glitches(&tr);
+            trace_eval_t *e = &ev[n++];
+            e->kind = tr.kind;
+            e->alarm = tr.alarm;
+            e->alarm_us = tr.alarm_us;
+            eval_pattern(&tr, e);
+            eval_bursts(&tr, e);
+        }
+    }
+
+    // Barrido: el umbral con mejor F1; a igualdad, el más bajo (perder un aviso es lo peor)
+    printf("\nModo patrón, %d trazas por tipo (%d con aviso)\n", SEEDS, 2 * SEEDS);
+    printf("  confianza   precisión   exhaustividad   F1      falsas  perdidas\n");
+    int best = 0;
+    pr_t bp = { 0 };
+    for (int c = 16; c <= 256; c += 4) {
+        pr_t p = score(c, n);
+        if (p.f1 > bp.f1 + 1e-9) { bp = p; best = c; }
+    }
+    for (int c = 32; c <= 256; c += 4) {
+        if (c % 32 && c != best && c != CFG_DEF_VIB_MIN_CONF) continue;
+        pr_t p = score(c, n);
+        printf("  %5d%s      %5.3f        %5.3f        %5.3f   %4d    %4d\n", c,
+               c == CFG_DEF_VIB_MIN_CONF ? "*" : " ", p.precision, p.recall, p.f1, p.fp, p.fn);
+    }
+    // Cerca del máximo el F1 es casi plano: el de fábrica debe quedar a 0,01 del mejor
+    int lo = best, hi = best;
+    while (lo - 4 >= 16 && score(lo - 4, n).f1 >= bp.f1 - 0.01) lo -= 4;
+    while (hi + 4 <= 256 && score(hi + 4, n).f1 >= bp.f1 - 0.01) hi += 4;
+    printf("  mejor F1 %.3f con confianza %d (a 0,01: %d..%d); CFG_DEF_VIB_MIN_CONF = %d\n", bp.f1, best, lo, hi,
+           CFG_DEF_VIB_MIN_CONF);
+
+    // Por tipo, con el valor de fábrica, frente al modo ráfagas
+    printf("\n  tipo             alarmas (patrón / ráfagas)   latencia media (patrón / ráfagas)\n");
+    for (int k = 0; k < HV_KINDS; k++) {
+        int ap = 0, ab = 0, nl = 0;
+        double lp = 0, lb = 0;
+        for (int i = 0; i < n; i++) {
+            if (ev[i].kind != (hv_kind_t)k) continue;
+            int h = first_hit(&ev[i], CFG_DEF_VIB_MIN_CONF);
+            if (h >= 0) ap++;
+            if (ev[i].burst_alarm_us >= 0) ab++;
+            if (ev[i].alarm && h >= 0 && ev[i].burst_alarm_us >= 0) {
+                lp += (ev[i].end_us[h] - ev[i].alarm_us) / 1e3;
+                lb += (ev[i].burst_alarm_us - ev[i].alarm_us) / 1e3;
+                nl++;
+            }
+        }
+        if (nl) printf("  %-15s  %4d / %4d de %d             %6.0f / %4.0f ms\n", HV_KIND_NAME[k], ap, ab, SEEDS,
+                       lp / nl, lb / nl);
+        else printf("  %-15s  %4d / %4d de %d\n", HV_KIND_NAME[k], ap, ab, SEEDS);
+    }
+    double per_win = classify_ns / classify_n;
+    printf("\n  vp_classify: %.1f us por ventana de %d bins, %.1f ns por muestra (%d muestras)\n\n", per_win / 1e3,
+           VIB_PATTERN_BINS, per_win / (VIB_PATTERN_BINS * VIB_SAMPLES_PER_BIN),
+           VIB_PATTERN_BINS * VIB_SAMPLES_PER_BIN);
+
+    pr_t def = score(CFG_DEF_VIB_MIN_CONF, n);
+    TEST_ASSERT_TRUE_MESSAGE(CFG_DEF_VIB_MIN_CONF >= lo && CFG_DEF_VIB_MIN_CONF <= hi,
+                             "CFG_DEF_VIB_MIN_CONF lejos del mejor F1");
+    TEST_ASSERT_GREATER_THAN(900, (int)(def.recall * 1000));
+    TEST_ASSERT_GREATER_THAN(def.fp * 5, score(0, n).fp);          // cinco veces menos falsas que sin umbral
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_periodic_500ms_matches_first_pattern);
+    RUN_TEST(test_periodic_1000ms_matches_second_pattern);
+    RUN_TEST(test_single_knock_has_no_confidence);
+    RUN_TEST(test_too_few_active_bins_not_evaluated);
+    RUN_TEST(test_window_shorter_than_two_periods);
+    RUN_TEST(test_continuous_vibration_is_not_periodic);
+    RUN_TEST(test_bench_precision_recall);
+    return UNITY_END();
+}
@@ -0,0 +1,397 @@
+/*
+ * Cabecera RIFF/WAVE (wav.h) y cambio de reloj del I2S (audio_set_format
+ * de audio.h): WAV con chunks de más, tamaños impares, EXTENSIBLE,
+ * IMA-ADPCM, data sin cerrar, truncados y formatos que no sabemos
+ * reproducir, que se rechazan nada más leer fmt. Al final, lo que cuesta
+ * recorrer los chunks de cada WAV de menus/ (desde memoria y con
+ * fseek/fread, como la SD) y cuántas veces cambia el reloj al ir
+ * sonando uno tras otro.
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "audio.h"
+#include "host_util.h"
+
+#define OLD_HEADER   44            // lo que se saltaba playWav() antes
+#define OLD_RATE     16000         // ... y la frecuencia que suponía
+
+// Fichero en memoria que cuenta lo que se lee
+typedef struct {
+    const uint8_t *p;
+    uint32_t       n;
+    uint32_t       reads, bytes;
+} mem_file_t;
+
+static int mem_read(void *ctx, uint32_t off, void *dst, size_t n)
+{
+    mem_file_t *m = ctx;
+    m->reads++;
+    if (off > m->n || n > m->n - off) return -1;
+    memcpy(dst, m->p + off, n);
+    m->bytes += n;
+    return 0;
+}
+
+/* ───────────────────── WAV hechos a mano ───────────────────── */
+
+static uint8_t wb[4096];
+static uint32_t wn;
+
+static void put16(uint32_t v) { wb[wn++] = (uint8_t)v; wb[wn++] = (uint8_t)(v >> 8); }
+static void put32(uint32_t v) { put16(v & 0xFFFF); put16(v >> 16); }
+static void tag(const char *t) { memcpy(wb + wn, t, 4); wn += 4; }
+
+static void riff_begin(void) { wn = 0; tag("RIFF"); put32(0); tag("WAVE"); }
+static void riff_end(void) { uint32_t s = wn - 8; memcpy(wb + 4, &s, 4); }
+
+static void chunk(const char *t, uint32_t size)
+{
+    tag(t);
+    put32(size);
+    memset(wb + wn, 0x55, size);
+    wn += size + (size & 1);
+}
+
+static void fmt(uint16_t format, uint16_t ch, uint32_t rate, uint16_t bits, uint16_t align)
+{
+    tag("fmt "); put32(16);
+    put16(format); put16(ch); put32(rate); put32(rate * align); put16(align); put16(bits);
+}
+
+static void data(uint32_t declared, uint32_t real)
+{
+    tag("data"); put32(declared);
+    for (uint32_t i = 0; i < real; i++) wb[wn++] = (uint8_t)i;
+}
+
+static wav_status_t parse(wav_info_t *w, mem_file_t *m)
+{
+    *m = (mem_file_t){ .p = wb, .n = wn };
+    return wav_parse(mem_read, m, w);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ─────────────────────────── pruebas ─────────────────────────── */
+
+// El caso de menus/: LIST entre fmt y data
+static void test_list_between_fmt_and_data(void)
+{
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 24000, 16, 2); chunk("LIST", 26); data(200, 200); riff_end();
+    wav_info_t w; mem_file_t m;
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT32(12 + 24 + 34 + 8, w.data_off);
+    TEST_ASSERT_EQUAL_UINT32(200, w.data_len);
+    TEST_ASSERT_EQUAL_UINT32(24000, w.rate);
+    TEST_ASSERT_EQUAL_UINT16(1, w.channels);
+    TEST_ASSERT_EQUAL_UINT16(3, w.chunks);
+    // 12 de cabecera, 8 por chunk y los 16 de fmt: el audio no se toca
+    TEST_ASSERT_EQUAL_UINT32(5, m.reads);
+    TEST_ASSERT_EQUAL_UINT32(12 + 3 * 8 + 16, m.bytes);
+}
+
+// Chunks de tamaño impar llevan un byte de relleno
+static void test_odd_chunk_is_padded(void)
+{
+    riff_begin(); chunk("junk", 3); fmt(WAV_FMT_PCM, 2, 44100, 16, 4); chunk("fact", 7); data(64, 64); riff_end();
+    wav_info_t w; mem_file_t m;
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT32(12 + 12 + 24 + 16 + 8, w.data_off);
+    TEST_ASSERT_EQUAL_UINT16(2, w.channels);
+    TEST_ASSERT_EQUAL_UINT32(64, w.data_len);
+}
+
+// data con tamaño 0 o 0xFFFFFFFF (grabación sin cerrar) o más largo que el RIFF
+static void test_unclosed_and_oversized_data(void)
+{
+    wav_info_t w; mem_file_t m;
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); data(0, 100); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT32(100, w.data_len);
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); data(0xFFFFFFFFu, 100); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT32(100, w.data_len);
+    riff_begin(); fmt(WAV_FMT_PCM, 2, 16000, 16, 4); data(5000, 102); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT32(100, w.data_len);                  // tramas enteras
+}
+
+// WAVE_FORMAT_EXTENSIBLE con PCM dentro
+static void test_extensible_is_unwrapped(void)
+{
+    riff_begin();
+    tag("fmt "); put32(40);
+    put16(WAV_FMT_EXTENSIBLE); put16(1); put32(22050); put32(44100); put16(2); put16(16);
+    put16(22); put16(16); put32(4); put16(WAV_FMT_PCM);
+    for (int i = 0; i < 14; i++) wb[wn++] = 0;
+    data(20, 20); riff_end();
+    wav_info_t w; mem_file_t m;
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT16(WAV_FMT_PCM, w.format);
+    TEST_ASSERT_EQUAL_UINT32(22050, w.rate);
+}
+
+// IMA-ADPCM: bloques que caben en audio_out; el último puede venir corto
+static void test_adpcm(void)
+{
+    wav_info_t w; mem_file_t m;
+    riff_begin(); fmt(WAV_FMT_IMA_ADPCM, 1, 16000, 4, 256); chunk("fact", 4); data(300, 300); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_OK, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT16(256, w.block_align);
+    TEST_ASSERT_EQUAL_UINT32(300, w.data_len);
+    riff_begin(); fmt(WAV_FMT_IMA_ADPCM, 1, 16000, 4, 2048); data(300, 300); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_FORMAT, parse(&w, &m));     // no cabe en el búfer
+    riff_begin(); fmt(WAV_FMT_IMA_ADPCM, 2, 16000, 4, 250); data(300, 300); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_FORMAT, parse(&w, &m));     // no son grupos de 4 por canal
+}
+
+// Lo que no sabemos reproducir se rechaza al leer fmt, sin buscar data
+static void test_unsupported_rejected_at_fmt(void)
+{
+    static const struct { uint16_t format, ch; uint32_t rate; uint16_t bits, align; } bad[] = {
+        { WAV_FMT_PCM, 1, 16000, 8, 1 },          // 8 bits
+        { WAV_FMT_PCM, 1, 16000, 24, 3 },         // 24 bits
+        { WAV_FMT_PCM, 3, 16000, 16, 6 },         // 3 canales
+        { WAV_FMT_PCM, 0, 16000, 16, 0 },
+        { WAV_FMT_PCM, 1, 96000, 16, 2 },         // fuera de lo que admite el I2S
+        { WAV_FMT_PCM, 1, 4000, 16, 2 },
+        { WAV_FMT_PCM, 1, 16000, 16, 4 },         // block_align que no cuadra
+        { 0x0055, 1, 16000, 0, 1 },               // MP3
+        { 0x0003, 1, 16000, 32, 4 },              // float
+    };
+    for (size_t i = 0; i < sizeof bad / sizeof bad[0]; i++) {
+        riff_begin(); fmt(bad[i].format, bad[i].ch, bad[i].rate, bad[i].bits, bad[i].align);
+        for (int k = 0; k < 10; k++) chunk("LIST", 100);
+        data(100, 100); riff_end();
+        wav_info_t w; mem_file_t m;
+        TEST_ASSERT_EQUAL_INT(WAV_ERR_FORMAT, parse(&w, &m));
+        TEST_ASSERT_EQUAL_UINT32(3, m.reads);
+    }
+}
+
+static void test_broken_files(void)
+{
+    wav_info_t w; mem_file_t m;
+    riff_begin(); wb[0] = 'X'; riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_RIFF, parse(&w, &m));
+    wn = 6;
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_IO, parse(&w, &m));
+    // data antes que fmt
+    riff_begin(); data(10, 10); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_FMT, parse(&w, &m));
+    // fmt sin data
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); chunk("LIST", 10); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_DATA, parse(&w, &m));
+    // data vacío
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); data(0, 0); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_DATA, parse(&w, &m));
+    // fmt corto
+    riff_begin(); chunk("fmt ", 12); data(10, 10); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_FORMAT, parse(&w, &m));
+    // Truncado en mitad de un chunk
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); chunk("LIST", 40); data(10, 10); riff_end();
+    wn = 12 + 24 + 20;
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_DATA, parse(&w, &m));
+    // Un chunk que dice medir más que el RIFF
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2); tag("LIST"); put32(0x7FFFFFF0); data(10, 10); riff_end();
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_DATA, parse(&w, &m));
+}
+
+// Más de WAV_MAX_CHUNKS antes de data: no es de los nuestros y no se sigue leyendo
+static void test_chunk_limit(void)
+{
+    riff_begin(); fmt(WAV_FMT_PCM, 1, 16000, 16, 2);
+    for (int k = 0; k < WAV_MAX_CHUNKS + 4; k++) chunk("LIST", 2);
+    data(10, 10); riff_end();
+    wav_info_t w; mem_file_t m;
+    TEST_ASSERT_EQUAL_INT(WAV_ERR_NO_DATA, parse(&w, &m));
+    TEST_ASSERT_EQUAL_UINT16(WAV_MAX_CHUNKS, w.chunks);
+    TEST_ASSERT_LESS_OR_EQUAL(WAV_MAX_CHUNKS + 2, m.reads);
+}
+
+// El reloj del I2S solo se toca cuando cambian frecuencia o canales
+static void test_reclock_only_on_change(void)
+{
+    host_i2s_t *i = host_i2s();
+    uint32_t r0 = i->reclocks;
+    wav_info_t a = { .rate = I2S_SAMPLE_RATE, .channels = 1 };
+    wav_info_t b = { .rate = 24000, .channels = 1 };
+    wav_info_t c = { .rate = 24000, .channels = 2 };
+    TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&a));
+    TEST_ASSERT_EQUAL_UINT32(r0, i->reclocks);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&b));
+    TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&b));
+    TEST_ASSERT_EQUAL_UINT32(r0 + 1, i->reclocks);
+    TEST_ASSERT_EQUAL_UINT32(24000, i->rate);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&c));
+    TEST_ASSERT_EQUAL_INT(2, i->channels);
+    // Si el driver no acepta el reloj, se queda como estaba y se vuelve a intentar la próxima vez
+    wav_info_t bad = { .rate = 96000, .channels = 1 };
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, audio_set_format(&bad));
+    TEST_ASSERT_EQUAL_UINT32(24000, s_i2s_rate);
+    TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&a));
+    TEST_ASSERT_EQUAL_UINT32(r0 + 3, i->reclocks);
+    TEST_ASSERT_EQUAL_UINT32(I2S_SAMPLE_RATE, i->rate);
+}
+
+/* ─────────────────────────── medida ─────────────────────────── */
+
+#define MENUS_MAX    32
+#define BENCH_REPS   200000
+#define FILE_REPS    2000
+
+typedef struct {
+    char       name[NAME_MAX + 1];   // un d_name entero
+    uint8_t   *buf;
+    uint32_t   len;
+    wav_info_t w;
+    uint32_t   reads, bytes;
+    double     mem_ns, file_us;
+} menu_wav_t;
+
+static menu_wav_t menus[MENUS_MAX];
+
+static int cmp_name(const void *a, const void *b)
+{
+    return strcmp(((const menu_wav_t *)a)->name, ((const menu_wav_t *)b)->name);
+}
+
+static const char *menu_path(const char *dir, const char *name)
+{
+    static char path[512];
+    TEST_ASSERT_TRUE(snprintf(path, sizeof path, "%s/%s", dir, name) < (int)sizeof path);
+    return path;
+}
+
+static int load_menus(const char *dir)
+{
+    DIR *d = opendir(dir);
+    TEST_ASSERT_NOT_NULL_MESSAGE(d, dir);
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) && n < MENUS_MAX) {
+        size_t l = strlen(e->d_name);
+        if (l < 5 || strcmp(e->d_name + l - 4, ".wav") != 0) continue;
+        menu_wav_t *m = &menus[n++];
+        snprintf(m->name, sizeof m->name, "%s", e->d_name);
+    }
+    closedir(d);
+    qsort(menus, n, sizeof menus[0], cmp_name);
+    for (int k = 0; k < n; k++) {
+        const char *path = menu_path(dir, menus[k].name);
+        FILE *f = fopen(path, "rb");
+        TEST_ASSERT_NOT_NULL_MESSAGE(f, path);
+        fseek(f, 0, SEEK_END);
+        menus[k].len = (uint32_t)ftell(f);
+        menus[k].buf = malloc(menus[k].len);
+        rewind(f);
+        TEST_ASSERT_EQUAL_UINT32(menus[k].len, (uint32_t)fread(menus[k].buf, 1, menus[k].len, f));
+        fclose(f);
+    }
+    return n;
+}
+
+static void test_bench_menus(void)
+{
+    const char *dir = HOST_PROJECT_DIR "/menus";
+    int n = load_menus(dir);
+    TEST_ASSERT_GREATER_THAN(0, n);
+
+    volatile uint32_t sink = 0;
+    for (int k = 0; k < n; k++) {
+        menu_wav_t *m = &menus[k];
+        mem_file_t mf = { .p = m->buf, .n = m->len };
+        TEST_ASSERT_EQUAL_INT_MESSAGE(WAV_OK, wav_parse(mem_read, &mf, &m->w), m->name);
+        m->reads = mf.reads;
+        m->bytes = mf.bytes;
+
+        int64_t t0 = host_cpu_us();
+        for (int r = 0; r < BENCH_REPS; r++) {
+            wav_info_t w;
+            mf.reads = 0;
+            wav_parse(mem_read, &mf, &w);
+            sink += w.data_off;
+        }
+        m->mem_ns = (host_cpu_us() - t0) * 1000.0 / BENCH_REPS;
+
+        FILE *f = fopen(menu_path(dir, m->name), "rb");
+        t0 = host_cpu_us();
+        for (int r = 0; r < FILE_REPS; r++) {
+            wav_info_t w;
+            TEST_ASSERT_EQUAL_INT(WAV_OK, wav_parse(audio_file_read, f, &w));
+            sink += w.data_off;
+        }
+        m->file_us = (double)(host_cpu_us() - t0) / FILE_REPS;
+        fclose(f);
+    }
+    (void)sink;
+
+    // Sonando uno tras otro, como el menú: cambios de reloj
+    host_i2s_t *i = host_i2s();
+    audio_set_format(&(wav_info_t){ .rate = I2S_SAMPLE_RATE, .channels = 1 });
+    uint32_t r0 = i->reclocks, plays = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int k = 0; k < n; k++) {
+            // Primero todos los originales y luego todas las copias *_fixed
+            if ((strstr(menus[k].name, "_fixed") != NULL) != pass) continue;
+            TEST_ASSERT_EQUAL_INT(ESP_OK, audio_set_format(&menus[k].w));
+            plays++;
+        }
+    }
+    uint32_t reclocks = i->reclocks - r0;
+
+    printf("\nWAV de menus/: recorrido de chunks (%d ficheros)\n", n);
+    printf("  %-28s %6s %3s %7s %5s %7s  %8s %8s  %s\n", "fichero", "Hz", "ch", "chunks", "audio",
+           "lecturas", "memoria", "fread", "antes (44 B, 16 kHz)");
+    int clicks = 0, wrong_speed = 0;
+    double mem_max = 0, file_max = 0;
+    uint32_t bytes_max = 0;
+    for (int k = 0; k < n; k++) {
+        const menu_wav_t *m = &menus[k];
+        int hdr = (int)m->w.data_off - OLD_HEADER;
+        clicks += hdr > 0;
+        wrong_speed += m->w.rate != OLD_RATE;
+        if (m->mem_ns > mem_max) mem_max = m->mem_ns;
+        if (m->file_us > file_max) file_max = m->file_us;
+        if (m->bytes > bytes_max) bytes_max = m->bytes;
+        printf("  %-28s %6u %3u %7u %5u %3u/%3uB %6.0f ns %5.2f us  %d B de cabecera, %3.0f %% de velocidad\n",
+               m->name, (unsigned)m->w.rate, m->w.channels, m->w.chunks, (unsigned)m->w.data_off,
+               (unsigned)m->reads, (unsigned)m->bytes, m->mem_ns, m->file_us, hdr,
+               100.0 * OLD_RATE / m->w.rate);
+    }
+    printf("%u reproducciones seguidas (originales y luego *_fixed): %u cambios de reloj del I2S\n\n",
+           (unsigned)plays, (unsigned)reclocks);
+
+    for (int k = 0; k < n; k++) {
+        // Lo que se lee no depende del tamaño del audio (menu.wav pesa 2,4 MB)
+        TEST_ASSERT_EQUAL_UINT32(2 + menus[k].w.chunks, menus[k].reads);
+        TEST_ASSERT_EQUAL_UINT32(menus[k].len - menus[k].w.data_off, menus[k].w.data_len);
+    }
+    TEST_ASSERT_LESS_THAN(128, bytes_max);
+    TEST_ASSERT_LESS_THAN(2000, (int)mem_max);                // del orden de cien ns en el PC
+    TEST_ASSERT_EQUAL_INT(n, clicks);                          // todos tienen LIST: antes sonaba la cabecera
+    TEST_ASSERT_EQUAL_UINT32(2, reclocks);                     // 16k -> 24k y 24k -> 16k, no uno por fichero
+    for (int k = 0; k < n; k++) free(menus[k].buf);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_list_between_fmt_and_data);
+    RUN_TEST(test_odd_chunk_is_padded);
+    RUN_TEST(test_unclosed_and_oversized_data);
+    RUN_TEST(test_extensible_is_unwrapped);
+    RUN_TEST(test_adpcm);
+    RUN_TEST(test_unsupported_rejected_at_fmt);
+    RUN_TEST(test_broken_files);
+    RUN_TEST(test_chunk_limit);
+    RUN_TEST(test_reclock_only_on_change);
+    RUN_TEST(test_bench_menus);
+    return UNITY_END();
+}
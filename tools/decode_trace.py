@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+"""
+Decodifica el volcado de la traza del módem (modem_trace_dump() en
+include/modem_trace.h, comando SMS 92) capturado de la consola serie.
+
+    python3 tools/decode_trace.py consola.log                 # líneas con tiempos
+    python3 tools/decode_trace.py --stats consola.log         # latencias por comando
+    python3 tools/decode_trace.py --replay replay.txt consola.log
+    idf.py monitor | tee consola.log                          # para capturarlo
+
+El volcado puede venir mezclado con el resto del registro: solo se mira
+lo que hay entre "---- traza módem" y "---- fin traza ----" (el último
+volcado del fichero, o todos con --all). Cada registro es un trozo de lo
+que pasó por el UART; aquí se vuelven a juntar en líneas por sentido,
+se marcan los URC y cada comando se empareja con su resultado final.
+
+Con --replay se escribe el volcado limpio (sin el resto del registro),
+en el formato que lee mio_use_replay() (include/modem_io.h), para
+repetir la sesión en el banco o en el PC sin SIM800. Los TX no se
+envían: marcan tras qué escritura del firmware llega cada RX.
+"""
+import argparse
+import re
+import sys
+
+HEADER = re.compile(r"---- traza m\S*dem: (\d+) registros, (\d+) pisados ----")
+FOOTER = "---- fin traza ----"
+RECORD = re.compile(r"\[\s*(\d+)\.(\d{3})\] (TX|RX) (.*)$")
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+
+# Como URC_TABLE en include/urc.h
+URC_KEYS = [
+    "+CMT:", "+CMTI:", "+CMGS:", "+CLIP:", "+DTMF:", "RING", "NO CARRIER", "BUSY",
+    "NO ANSWER", "NO DIALTONE", "+COLP:", "+CLCC:", "+CPIN:", "Call Ready", "SMS Ready",
+    "UNDER-VOLTAGE WARNNING", "OVER-VOLTAGE WARNNING",
+]
+# Como at_on_line() en include/at_engine.h (más los finales propios de cada comando)
+FINALS = ("OK", "ERROR", "+CME ERROR:", "+CMS ERROR:", "NO CARRIER", "BUSY", "NO ANSWER",
+          "NO DIALTONE", "CONNECT")
+
+
+def unescape(s):
+    """Deshace el escapado de modem_trace_dump(): \\\\ \\r \\n \\xHH."""
+    out = bytearray()
+    i = 0
+    while i < len(s):
+        c = s[i]
+        if c != "\\" or i + 1 >= len(s):
+            out += c.encode("latin-1", "replace")
+            i += 1
+            continue
+        n = s[i + 1]
+        if n == "r":
+            out += b"\r"
+        elif n == "n":
+            out += b"\n"
+        elif n == "x" and re.fullmatch(r"[0-9A-Fa-f]{2}", s[i + 2:i + 4]):
+            out.append(int(s[i + 2:i + 4], 16))
+            i += 2
+        else:
+            out += n.encode("latin-1", "replace")
+        i += 2
+    return bytes(out)
+
+
+def read_dumps(f):
+    """Lista de volcados: (registros, pisados, [(t_ms, dir, bytes)])."""
+    dumps, cur = [], None
+    for raw in f:
+        line = ANSI.sub("", raw.rstrip("\r\n"))
+        m = HEADER.search(line)
+        if m:
+            cur = (int(m.group(1)), int(m.group(2)), [])
+            continue
+        if cur is None:
+            continue
+        if FOOTER in line:
+            dumps.append(cur)
+            cur = None
+            continue
+        m = RECORD.match(line)
+        if m:
+            t = int(m.group(1)) * 1000 + int(m.group(2))
+            cur[2].append((t, m.group(3), unescape(m.group(4))))
+    if cur is not None:
+        print("aviso: volcado sin \"%s\" (cortado)" % FOOTER, file=sys.stderr)
+        dumps.append(cur)
+    return dumps
+
+
+def to_lines(records):
+    """Junta los trozos en líneas por sentido: [(t_ms, dir, texto)].
+
+    El tiempo de cada línea es el del trozo que la empieza. TX termina en
+    \\r (comandos) o en Ctrl+Z/ESC (cuerpo de AT+CMGS); RX en \\n. El
+    prompt "> " del SIM800 no lleva fin de línea y se corta aparte.
+    """
+    out = []
+    pend = {"TX": [None, bytearray()], "RX": [None, bytearray()]}
+
+    def flush(d):
+        t, buf = pend[d]
+        text = bytes(buf).rstrip(b"\r\n").lstrip(b"\r\n")
+        if text:
+            out.append((t, d, text.decode("utf-8", "replace")))
+        pend[d][0], pend[d][1] = None, bytearray()
+
+    for t, d, data in records:
+        for b in data:
+            if pend[d][0] is None:
+                pend[d][0] = t
+            pend[d][1].append(b)
+            if d == "TX" and b in (0x0D, 0x1A, 0x1B):
+                flush(d)
+            elif d == "RX" and b == 0x0A:
+                flush(d)
+            elif d == "RX" and bytes(pend[d][1]).lstrip(b"\r\n") == b"> ":
+                flush(d)
+    for d in pend:
+        if pend[d][1]:
+            flush(d)
+    out.sort(key=lambda x: x[0])   # sort es estable: el orden del anillo se mantiene
+    return out
+
+
+def is_urc(text):
+    for k in URC_KEYS:
+        if k.endswith(":") and text.startswith(k):
+            return True
+        if text == k:
+            return True
+    return False
+
+
+def is_final(text):
+    return any(text == f or (f.endswith(":") and text.startswith(f)) for f in FINALS)
+
+
+def pair_commands(lines):
+    """[(t_tx, comando, t_final, final)]: cada comando con su resultado."""
+    out, open_cmd = [], None
+    for t, d, text in lines:
+        if d == "TX":
+            if text.startswith("AT") or text.startswith("at"):
+                if open_cmd:
+                    out.append((open_cmd[0], open_cmd[1], None, None))
+                open_cmd = (t, text)
+            continue
+        if open_cmd and text == open_cmd[1]:
+            continue                                   # eco
+        if open_cmd and is_final(text) and not (is_urc(text) and open_cmd[1][:3] not in ("ATD", "ATA")):
+            out.append((open_cmd[0], open_cmd[1], t, text))
+            open_cmd = None
+    if open_cmd:
+        out.append((open_cmd[0], open_cmd[1], None, None))
+    return out
+
+
+def command_name(cmd):
+    """AT+CMGR=3 → AT+CMGR=, ATD+34600...; → ATD: agrupa por comando."""
+    m = re.match(r"(AT[+&]?[A-Za-z]+[=?]?|AT[A-Za-z])", cmd)
+    return m.group(1).upper() if m else cmd
+
+
+def fmt_t(t):
+    return "%6d.%03d" % (t // 1000, t % 1000)
+
+
+def print_lines(lines, urcs_only):
+    prev = None
+    for t, d, text in lines:
+        urc = d == "RX" and is_urc(text)
+        if urcs_only and not urc:
+            continue
+        delta = "" if prev is None else "+%d" % (t - prev)
+        prev = t
+        print("[%s] %7s  %s %s %s" % (fmt_t(t), delta, d, "URC" if urc else "   ", text))
+
+
+def print_stats(nrec, lost, records, lines):
+    rx = sum(len(r[2]) for r in records if r[1] == "RX")
+    tx = sum(len(r[2]) for r in records if r[1] == "TX")
+    span = (records[-1][0] - records[0][0]) / 1000 if records else 0
+    print("registros %d (pisados %d), RX %d B, TX %d B, %.1f s" % (nrec, lost, rx, tx, span))
+    if lost:
+        print("  el anillo dio la vuelta: falta el principio de la sesión")
+    urcs = {}
+    for _, d, text in lines:
+        if d == "RX" and is_urc(text):
+            k = next(k for k in URC_KEYS if text.startswith(k))
+            urcs[k] = urcs.get(k, 0) + 1
+    if urcs:
+        print("URC: " + ", ".join("%s %d" % kv for kv in sorted(urcs.items(), key=lambda kv: -kv[1])))
+
+    by = {}
+    for t0, cmd, t1, final in pair_commands(lines):
+        s = by.setdefault(command_name(cmd), {"n": 0, "lat": [], "err": 0, "open": 0})
+        s["n"] += 1
+        if t1 is None:
+            s["open"] += 1
+            continue
+        s["lat"].append(t1 - t0)
+        if "ERROR" in final:
+            s["err"] += 1
+    if not by:
+        return
+    print("\n%-16s %5s %5s %5s %8s %8s %8s" % ("comando", "n", "error", "sin fin", "media ms", "p50 ms", "máx ms"))
+    for name, s in sorted(by.items(), key=lambda kv: -kv[1]["n"]):
+        lat = sorted(s["lat"])
+        if lat:
+            mean, p50, mx = sum(lat) / len(lat), lat[len(lat) // 2], lat[-1]
+            print("%-16s %5d %5d %7d %8.0f %8d %8d" % (name, s["n"], s["err"], s["open"], mean, p50, mx))
+        else:
+            print("%-16s %5d %5d %7d %8s %8s %8s" % (name, s["n"], s["err"], s["open"], "-", "-", "-"))
+
+
+def escape(data):
+    out = []
+    for b in data:
+        if b == 0x5C:
+            out.append("\\\\")
+        elif b == 0x0D:
+            out.append("\\r")
+        elif b == 0x0A:
+            out.append("\\n")
+        elif 0x20 <= b < 0x7F:
+            out.append(chr(b))
+        else:
+            out.append("\\x%02X" % b)
+    return "".join(out)
+
+
+def write_replay(path, records, nrec, lost):
+    with open(path, "w") as f:
+        f.write("---- traza módem: %d registros, %d pisados ----\n" % (nrec, lost))
+        for t, d, data in records:
+            f.write("[%s] %s %s\n" % (fmt_t(t), d, escape(data)))
+        f.write(FOOTER + "\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("log", nargs="?", help="captura de la consola (por defecto, la entrada estándar)")
+    ap.add_argument("--all", action="store_true", help="todos los volcados del fichero, no solo el último")
+    ap.add_argument("--stats", action="store_true", help="resumen y latencia de cada comando hasta su resultado")
+    ap.add_argument("--urc", action="store_true", help="solo los URC")
+    ap.add_argument("--replay", metavar="FICHERO", help="escribir los RX para mio_use_replay()")
+    args = ap.parse_args()
+
+    try:
+        f = open(args.log, encoding="utf-8", errors="replace") if args.log else sys.stdin
+    except OSError as e:
+        sys.exit(str(e))
+    with f:
+        dumps = read_dumps(f)
+    if not dumps:
+        sys.exit("no hay ningún volcado de traza (\"---- traza módem ...\")")
+    if not args.all:
+        dumps = dumps[-1:]
+
+    for i, (nrec, lost, records) in enumerate(dumps):
+        if len(dumps) > 1:
+            print("%s== volcado %d ==" % ("\n" if i else "", i + 1))
+        lines = to_lines(records)
+        if args.stats:
+            print_stats(nrec, lost, records, lines)
+        else:
+            print_lines(lines, args.urc)
+    if args.replay:                                    # con --all, el último
+        nrec, lost, records = dumps[-1]
+        write_replay(args.replay, records, nrec, lost)
+        print("%s: %d registros RX" % (args.replay, sum(1 for r in records if r[1] == "RX")), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
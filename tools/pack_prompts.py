@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+Empaqueta locuciones WAV en el formato de include/prompt_bundle.h para la
+partición "prompts".
+
+    python3 tools/pack_prompts.py -o prompts.bin menus/menu_fixed.wav:menu.wav data/alert.wav ...
+
+Cada argumento es un WAV, opcionalmente con ":nombre" para el nombre con
+el que lo pide el firmware (por defecto, el del fichero). Solo PCM de 16
+bits, mono o estéreo, de 8 a 48 kHz: el reproductor ajusta el reloj del
+I2S a cada locución, así que no hace falta remuestrear.
+
+Con --adpcm se guardan en IMA-ADPCM (include/adpcm.h): la cuarta parte de
+espacio, a cambio de algo de ruido de cuantización que en la voz del menú
+apenas se nota. --block fija el tamaño de bloque (como mucho 1024 bytes,
+lo que decodifica audio_out de una vez).
+
+Para grabarlo:
+
+    parttool.py --port /dev/ttyUSB0 write_partition --partition-name prompts --input prompts.bin
+"""
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+PB_MAGIC = 0x314D5250          # "PRM1"
+PB_VERSION = 2
+PB_NAME_MAX = 24
+PB_MAX_COUNT = 64
+PB_PARTITION_SIZE = 0x600000   # partitions.csv
+
+WAV_FMT_PCM = 0x0001
+WAV_FMT_IMA_ADPCM = 0x0011
+WAV_FMT_EXTENSIBLE = 0xFFFE
+
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<%dsIIIHHHH" % PB_NAME_MAX)
+
+ADPCM_MAX_BLOCK = 1024
+ADPCM_STEP = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+ADPCM_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def read_wav(path):
+    """(formato, canales, frecuencia, audio) recorriendo los chunks como wav.h."""
+    with open(path, "rb") as f:
+        d = f.read()
+    if len(d) < 12 or d[0:4] != b"RIFF" or d[8:12] != b"WAVE":
+        raise ValueError("no es RIFF/WAVE")
+    off, fmt = 12, None
+    while off + 8 <= len(d):
+        cid, size = d[off:off + 4], struct.unpack_from("<I", d, off + 4)[0]
+        body = off + 8
+        if cid == b"fmt ":
+            tag, ch, rate, _, align, bits = struct.unpack_from("<HHIIHH", d, body)
+            if tag == WAV_FMT_EXTENSIBLE and size >= 26:
+                tag = struct.unpack_from("<H", d, body + 24)[0]
+            fmt = (tag, ch, rate, align, bits)
+        elif cid == b"data":
+            if fmt is None:
+                raise ValueError("data antes de fmt")
+            tag, ch, rate, align, bits = fmt
+            if tag != WAV_FMT_PCM or bits != 16 or ch not in (1, 2) or not 8000 <= rate <= 48000:
+                raise ValueError("formato no soportado (fmt %d, %d bits, %d canales, %d Hz)"
+                                 % (tag, bits, ch, rate))
+            audio = d[body:body + size]
+            return tag, ch, rate, audio[:len(audio) - len(audio) % align]
+        off = body + size + (size & 1)
+    raise ValueError("sin data" if fmt else "sin fmt")
+
+
+def adpcm_encode(ch, audio, block):
+    """PCM de 16 bits a bloques IMA-ADPCM como los de WAV (el último, corto)."""
+    pcm = struct.unpack("<%dh" % (len(audio) // 2), audio)
+    chans = [pcm[c::ch] for c in range(ch)]
+    spb = (block // ch - 4) * 2 + 1                 # muestras por canal y bloque
+    index = [0] * ch
+    out = bytearray()
+    for start in range(0, len(chans[0]), spb):
+        head, body = bytearray(), [bytearray() for _ in range(ch)]
+        for c in range(ch):
+            x = chans[c][start:start + spb]
+            pred, idx = x[0], index[c]
+            head += struct.pack("<hBB", pred, idx, 0)
+            nibs = []
+            for v in x[1:]:
+                step = ADPCM_STEP[idx]
+                diff, nib = v - pred, 0
+                if diff < 0:
+                    nib, diff = 8, -diff
+                # Cuantiza igual que reconstruye el decodificador (step/8 + bits)
+                rec = step >> 3
+                if diff >= step:
+                    nib |= 4
+                    diff -= step
+                    rec += step
+                if diff >= step >> 1:
+                    nib |= 2
+                    diff -= step >> 1
+                    rec += step >> 1
+                if diff >= step >> 2:
+                    nib |= 1
+                    rec += step >> 2
+                pred = max(-32768, min(32767, pred - rec if nib & 8 else pred + rec))
+                idx = max(0, min(88, idx + ADPCM_INDEX[nib]))
+                nibs.append(nib)
+            unit = 8 if ch == 2 else 2              # estéreo: grupos de 4 bytes por canal
+            if len(nibs) % unit:
+                nibs += [0] * (unit - len(nibs) % unit)   # el último bloque: unas muestras de casi silencio
+            body[c] = bytes(nibs[i] | nibs[i + 1] << 4 for i in range(0, len(nibs), 2))
+            index[c] = idx
+        out += head
+        for g in range(0, len(body[0]), 4):
+            for c in range(ch):
+                out += body[c][g:g + 4]
+    return bytes(out)
+
+
+def pack(items):
+    if len(items) > PB_MAX_COUNT:
+        raise ValueError("demasiadas locuciones (máx %d)" % PB_MAX_COUNT)
+    index_end = HEADER.size + len(items) * ENTRY.size
+    entries, blobs, off = [], [], (index_end + 3) & ~3
+    for name, (tag, ch, rate, align, audio) in items:
+        raw = name.encode("ascii")
+        if len(raw) >= PB_NAME_MAX:
+            raise ValueError("%s: nombre demasiado largo (máx %d)" % (name, PB_NAME_MAX - 1))
+        entries.append(ENTRY.pack(raw, off, len(audio), rate, ch, tag, align, 0))
+        pad = (-len(audio)) & 3
+        blobs.append(audio + b"\0" * pad)
+        off += len(audio) + pad
+    index = b"".join(entries)
+    head = HEADER.pack(PB_MAGIC, PB_VERSION, len(items), off, zlib.crc32(index) & 0xFFFFFFFF)
+    out = head + index
+    out += b"\0" * (((index_end + 3) & ~3) - index_end)
+    return out + b"".join(blobs)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("wav", nargs="+", help="fichero.wav[:nombre]")
+    ap.add_argument("-o", "--output", default="prompts.bin")
+    ap.add_argument("--adpcm", action="store_true", help="guardar en IMA-ADPCM (4:1)")
+    ap.add_argument("--block", type=int, default=512, help="bytes por bloque ADPCM y canal (por defecto 512)")
+    args = ap.parse_args()
+    if args.adpcm and (args.block % 4 or not 8 <= args.block <= ADPCM_MAX_BLOCK):
+        sys.exit("--block: múltiplo de 4 entre 8 y %d" % ADPCM_MAX_BLOCK)
+
+    items, names = [], set()
+    for arg in args.wav:
+        path, _, name = arg.partition(":")
+        name = name or os.path.basename(path)
+        if name.lower() in names:
+            sys.exit("%s: nombre repetido" % name)
+        names.add(name.lower())
+        try:
+            tag, ch, rate, audio = read_wav(path)
+            seconds = len(audio) / (2.0 * ch * rate)
+            if args.adpcm:
+                if args.block * ch > ADPCM_MAX_BLOCK:
+                    raise ValueError("estéreo: --block como mucho %d" % (ADPCM_MAX_BLOCK // 2))
+                items.append((name, (WAV_FMT_IMA_ADPCM, ch, rate, args.block * ch,
+                                     adpcm_encode(ch, audio, args.block * ch)), seconds))
+            else:
+                items.append((name, (tag, ch, rate, 2 * ch, audio), seconds))
+        except (OSError, ValueError, struct.error) as e:
+            sys.exit("%s: %s" % (path, e))
+
+    try:
+        blob = pack([(name, fmt) for name, fmt, _ in items])
+    except ValueError as e:
+        sys.exit(str(e))
+    if len(blob) > PB_PARTITION_SIZE:
+        sys.exit("el paquete (%d bytes) no cabe en la partición (%d)" % (len(blob), PB_PARTITION_SIZE))
+    with open(args.output, "wb") as f:
+        f.write(blob)
+
+    for name, (tag, ch, rate, _, audio), seconds in items:
+        print("  %-24s %6d Hz %d can. %-5s %8d bytes %6.1f s"
+              % (name, rate, ch, "ADPCM" if tag == WAV_FMT_IMA_ADPCM else "PCM", len(audio), seconds))
+    print("%s: %d locuciones, %d bytes (%.0f%% de la partición)"
+          % (args.output, len(items), len(blob), 100.0 * len(blob) / PB_PARTITION_SIZE))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+"""
+Script de PlatformIO (extra_scripts): genera la imagen de la partición
+"prompts" al compilar y añade un objetivo para grabarla.
+
+Las locuciones salen de custom_prompts en platformio.ini, con la misma
+sintaxis que tools/pack_prompts.py (fichero.wav[:nombre]); con
+custom_prompts_adpcm = yes se empaquetan en IMA-ADPCM. La imagen queda en
+.pio/build/<env>/prompts.bin y solo se rehace si cambia algún WAV, la
+lista o la herramienta.
+
+    pio run                    # firmware + prompts.bin
+    pio run -t uploadprompts   # graba prompts.bin en la partición "prompts"
+
+El "upload" normal no la graba: el paquete ocupa cientos de KB y casi
+nunca cambia.
+"""
+import csv
+import os
+
+Import("env")
+
+PARTITION = "prompts"
+
+
+def prompt_list(env):
+    """[(ruta absoluta, nombre o "")] de custom_prompts."""
+    items = []
+    for line in env.GetProjectOption("custom_prompts", "").splitlines():
+        item = line.split(";")[0].strip()
+        if item:
+            path, _, name = item.partition(":")
+            items.append((os.path.join(env.subst("$PROJECT_DIR"), path), name))
+    return items
+
+
+def partition_offset(env, name):
+    """Dirección de la partición en la tabla de board_build.partitions."""
+    table = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions", "partitions.csv"))
+    with open(table, newline="") as f:
+        for row in csv.reader(f):
+            row = [c.strip() for c in row]
+            if row and not row[0].startswith("#") and row[0] == name:
+                return row[3]
+    raise ValueError("%s: no hay partición \"%s\"" % (table, name))
+
+
+items = prompt_list(env)
+if items:
+    tool = os.path.join(env.subst("$PROJECT_DIR"), "tools", "pack_prompts.py")
+    image = os.path.join(env.subst("$BUILD_DIR"), "prompts.bin")
+    adpcm = env.GetProjectOption("custom_prompts_adpcm", "no").lower() in ("yes", "true", "1")
+    cmd = '"$PYTHONEXE" "%s" -o "$TARGET"%s %s' % (
+        tool, " --adpcm" if adpcm else "", " ".join('"%s%s"' % (p, ":" + n if n else "") for p, n in items))
+
+    prompts = env.Command(image, [tool] + [p for p, _ in items],
+                          env.VerboseAction(cmd, "Empaquetando locuciones en $TARGET"))
+    # Cambiar la lista o --adpcm también rehace la imagen
+    env.Depends(prompts, env.Value(cmd))
+    env.Depends("$BUILD_DIR/${PROGNAME}.bin", prompts)
+
+    env.AddCustomTarget(
+        name="uploadprompts",
+        dependencies=prompts,
+        actions=[
+            env.VerboseAction(env.AutodetectUploadPort, "Buscando el puerto..."),
+            '"$PYTHONEXE" "$UPLOADER" --chip %s --port "$UPLOAD_PORT" --baud $UPLOAD_SPEED write_flash %s "%s"'
+            % (env.BoardConfig().get("build.mcu"), partition_offset(env, PARTITION), image),
+        ],
+        title="Upload prompts",
+        description="Graba las locuciones en la partición \"%s\"" % PARTITION)